@@ -10,6 +10,11 @@
 #include "IAnimatedMeshSceneNode.h"
 #include "os.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define _IRR_SKINNING_USE_SSE_
+#endif
+
 namespace irr
 {
 namespace scene
@@ -19,7 +24,7 @@ namespace scene
 //! constructor
 CSkinnedMesh::CSkinnedMesh()
 : SkinningBuffers(0), AnimationFrames(0.f), FramesPerSecond(25.f),
-	LastAnimatedFrame(-1), SkinnedLastFrame(false),
+	SkinningTable(0), LastAnimatedFrame(-1), SkinnedLastFrame(false),
 	InterpolationMode(EIM_LINEAR),
 	HasAnimation(false), PreparedForSkinning(false),
 	AnimateNormals(true), HardwareSkinning(false)
@@ -43,6 +48,9 @@ CSkinnedMesh::~CSkinnedMesh()
 		if (LocalBuffers[j])
 			LocalBuffers[j]->drop();
 	}
+
+	if (SkinningTable)
+		SkinningTable->drop();
 }
 
 
@@ -471,14 +479,7 @@ void CSkinnedMesh::skinMesh(f32 strength)
 			}
 		}
 
-		//clear skinning helper array
-		for (i=0; i<Vertices_Moved.size(); ++i)
-			for (u32 j=0; j<Vertices_Moved[i].size(); ++j)
-				Vertices_Moved[i][j]=false;
-
-		//skin starting with the root joints
-		for (i=0; i<RootJoints.size(); ++i)
-			skinJoint(RootJoints[i], 0, strength);
+		skinVertices(strength);
 
 		for (i=0; i<SkinningBuffers->size(); ++i)
 			(*SkinningBuffers)[i]->setDirty(EBT_VERTEX);
@@ -486,65 +487,200 @@ void CSkinnedMesh::skinMesh(f32 strength)
 	updateBoundingBox();
 }
 
-void CSkinnedMesh::skinJoint(SJoint *joint, SJoint *parentJoint, f32 strength)
+//! Collects all weights into the flat arrays used by skinVertices
+void CSkinnedMesh::buildSkinningTable()
 {
-	if (joint->Weights.size())
+	if (SkinningTable)
+		return;
+
+	SkinningTable = new SSkinningTable();
+	SSkinningTable &table = *SkinningTable;
+	const u32 bufferCount = LocalBuffers.size();
+
+	// Number of influences of each vertex
+	core::array< core::array<u32> > counts;
+	counts.reallocate(bufferCount);
+	for (u32 b=0; b<bufferCount; ++b)
 	{
-		//Find this joints pull on vertices...
-		core::matrix4 jointVertexPull(core::matrix4::EM4CONST_NOTHING);
-		jointVertexPull.setbyproduct(joint->GlobalAnimatedMatrix, joint->GlobalInversedMatrix);
+		counts.push_back(core::array<u32>());
+		counts[b].set_used(LocalBuffers[b]->getVertexCount());
+		for (u32 v=0; v<counts[b].size(); ++v)
+			counts[b][v] = 0;
+	}
+	for (u32 i=0; i<AllJoints.size(); ++i)
+	{
+		const SJoint *joint = AllJoints[i];
+		for (u32 j=0; j<joint->Weights.size(); ++j)
+			counts[joint->Weights[j].buffer_id][joint->Weights[j].vertex_id]++;
+	}
+
+	// Give each skinned vertex a slot, and reserve space for its influences.
+	// Afterwards counts contains the index of the vertex slot plus one.
+	u32 influenceCount = 0;
+	for (u32 b=0; b<bufferCount; ++b)
+	{
+		table.BufferStart.push_back(table.VertexIds.size());
+		for (u32 v=0; v<counts[b].size(); ++v)
+		{
+			if (!counts[b][v])
+				continue;
+			table.VertexIds.push_back(v);
+			table.InfluenceStart.push_back(influenceCount);
+			influenceCount += counts[b][v];
+			counts[b][v] = table.VertexIds.size();
+		}
+	}
+	table.BufferStart.push_back(table.VertexIds.size());
+	table.InfluenceStart.push_back(influenceCount);
 
-		core::vector3df thisVertexMove, thisNormalMove;
+	const u32 vertexCount = table.VertexIds.size();
+	table.InfluenceJoint.set_used(influenceCount);
+	table.InfluenceStrength.set_used(influenceCount);
+	table.StaticPos.set_used(vertexCount*4);
+	table.StaticNormal.set_used(vertexCount*4);
 
-		core::array<scene::SSkinMeshBuffer*> &buffersUsed=*SkinningBuffers;
+	// Fill in the influences in joint order
+	core::array<u32> filled;
+	filled.set_used(vertexCount);
+	for (u32 v=0; v<vertexCount; ++v)
+		filled[v] = 0;
 
-		//Skin Vertices Positions and Normals...
-		for (u32 i=0; i<joint->Weights.size(); ++i)
+	for (u32 i=0; i<AllJoints.size(); ++i)
+	{
+		const SJoint *joint = AllJoints[i];
+		for (u32 j=0; j<joint->Weights.size(); ++j)
 		{
-			SWeight& weight = joint->Weights[i];
+			const SWeight &weight = joint->Weights[j];
+			const u32 slot = counts[weight.buffer_id][weight.vertex_id] - 1;
+			const u32 n = table.InfluenceStart[slot] + filled[slot]++;
+			table.InfluenceJoint[n] = i;
+			table.InfluenceStrength[n] = weight.strength;
+
+			f32 *pos = &table.StaticPos[slot*4];
+			pos[0] = weight.StaticPos.X;
+			pos[1] = weight.StaticPos.Y;
+			pos[2] = weight.StaticPos.Z;
+			pos[3] = 1.f;
+			f32 *normal = &table.StaticNormal[slot*4];
+			normal[0] = weight.StaticNormal.X;
+			normal[1] = weight.StaticNormal.Y;
+			normal[2] = weight.StaticNormal.Z;
+			normal[3] = 0.f;
+		}
+	}
+}
 
-			// Pull this vertex...
-			jointVertexPull.transformVect(thisVertexMove, weight.StaticPos);
 
-			if (AnimateNormals)
-				jointVertexPull.rotateVect(thisNormalMove, weight.StaticNormal);
+//! Moves all weighted vertices of the skinning buffers
+/** The skinning matrices of all joints are computed once, then each vertex
+is transformed with the weighted sum of the matrices of its joints. */
+void CSkinnedMesh::skinVertices(f32 strength)
+{
+	buildSkinningTable();
+	const SSkinningTable &table = *SkinningTable;
 
-			// Apply animation strength
-			if(strength != 1.f)
-			{
-				thisVertexMove = core::lerp(weight.StaticPos, thisVertexMove, strength);
-				if(AnimateNormals)
-					thisNormalMove = core::lerp(weight.StaticNormal, thisNormalMove, strength);
-			}
+	SkinningMatrices.set_used(AllJoints.size());
+	for (u32 i=0; i<AllJoints.size(); ++i)
+	{
+		core::matrix4 &m = SkinningMatrices[i];
+		m.setbyproduct(AllJoints[i]->GlobalAnimatedMatrix, AllJoints[i]->GlobalInversedMatrix);
 
-			if (! (*(weight.Moved)) )
-			{
-				*(weight.Moved) = true;
+		// Apply animation strength, lerp(p, m*p, s) = ((1-s)*I + s*m)*p
+		if (strength != 1.f)
+		{
+			f32 *M = m.pointer();
+			for (u32 k=0; k<16; ++k)
+				M[k] *= strength;
+			M[0] += 1.f-strength;
+			M[5] += 1.f-strength;
+			M[10] += 1.f-strength;
+			M[15] += 1.f-strength;
+		}
+	}
 
-				buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Pos = thisVertexMove * weight.strength;
+	core::array<SSkinMeshBuffer*> &buffersUsed = *SkinningBuffers;
+	const u32 bufferCount = core::min_(buffersUsed.size(), table.BufferStart.size()-1);
+	for (u32 b=0; b<bufferCount; ++b)
+	{
+		const u32 first = table.BufferStart[b];
+		const u32 last = table.BufferStart[b+1];
+		if (first == last)
+			continue;
 
-				if (AnimateNormals)
-					buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Normal = thisNormalMove * weight.strength;
+		// Position and normal are the first members of all vertex types
+		u8 *vertices = (u8*)buffersUsed[b]->getVertices();
+		const u32 pitch = video::getVertexPitchFromType(buffersUsed[b]->getVertexType());
 
-				//*(weight._Pos) = thisVertexMove * weight.strength;
-			}
-			else
+		for (u32 v=first; v<last; ++v)
+		{
+			core::vector3df *dest = (core::vector3df*)(vertices + table.VertexIds[v]*pitch);
+			const u32 influenceEnd = table.InfluenceStart[v+1];
+#ifdef _IRR_SKINNING_USE_SSE_
+			// Sum up the weighted columns of the joint matrices
+			__m128 c0 = _mm_setzero_ps(), c1 = c0, c2 = c0, c3 = c0;
+			for (u32 n=table.InfluenceStart[v]; n<influenceEnd; ++n)
 			{
-				buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Pos += thisVertexMove * weight.strength;
+				const f32 *M = SkinningMatrices[table.InfluenceJoint[n]].pointer();
+				const __m128 w = _mm_set1_ps(table.InfluenceStrength[n]);
+				c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(M)));
+				c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(M+4)));
+				c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_loadu_ps(M+8)));
+				c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_loadu_ps(M+12)));
+			}
 
-				if (AnimateNormals)
-					buffersUsed[weight.buffer_id]->getVertex(weight.vertex_id)->Normal += thisNormalMove * weight.strength;
+			const __m128 p = _mm_loadu_ps(&table.StaticPos[v*4]);
+			__m128 pos = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0,0,0,0))),
+					_mm_mul_ps(c1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1,1,1,1)))),
+				_mm_add_ps(_mm_mul_ps(c2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2,2,2,2))), c3));
+			_mm_storel_pi((__m64*)&dest[0].X, pos);
+			_mm_store_ss(&dest[0].Z, _mm_movehl_ps(pos, pos));
 
-				//*(weight._Pos) += thisVertexMove * weight.strength;
+			if (AnimateNormals)
+			{
+				const __m128 n = _mm_loadu_ps(&table.StaticNormal[v*4]);
+				__m128 normal = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(n, n, _MM_SHUFFLE(0,0,0,0))),
+						_mm_mul_ps(c1, _mm_shuffle_ps(n, n, _MM_SHUFFLE(1,1,1,1)))),
+					_mm_mul_ps(c2, _mm_shuffle_ps(n, n, _MM_SHUFFLE(2,2,2,2))));
+				_mm_storel_pi((__m64*)&dest[1].X, normal);
+				_mm_store_ss(&dest[1].Z, _mm_movehl_ps(normal, normal));
 			}
+#else
+			f32 c[16] = {0.f};
+			for (u32 n=table.InfluenceStart[v]; n<influenceEnd; ++n)
+			{
+				const f32 *M = SkinningMatrices[table.InfluenceJoint[n]].pointer();
+				const f32 w = table.InfluenceStrength[n];
+				for (u32 k=0; k<16; ++k)
+					c[k] += w*M[k];
+			}
+
+			const f32 *p = &table.StaticPos[v*4];
+			dest[0].X = c[0]*p[0] + c[4]*p[1] + c[8]*p[2] + c[12];
+			dest[0].Y = c[1]*p[0] + c[5]*p[1] + c[9]*p[2] + c[13];
+			dest[0].Z = c[2]*p[0] + c[6]*p[1] + c[10]*p[2] + c[14];
 
-			buffersUsed[weight.buffer_id]->boundingBoxNeedsRecalculated();
+			if (AnimateNormals)
+			{
+				const f32 *n = &table.StaticNormal[v*4];
+				dest[1].X = c[0]*n[0] + c[4]*n[1] + c[8]*n[2];
+				dest[1].Y = c[1]*n[0] + c[5]*n[1] + c[9]*n[2];
+				dest[1].Z = c[2]*n[0] + c[6]*n[1] + c[10]*n[2];
+			}
+#endif
 		}
+
+		buffersUsed[b]->boundingBoxNeedsRecalculated();
 	}
+}
 
-	//Skin all children
-	for (u32 j=0; j<joint->Children.size(); ++j)
-		skinJoint(joint->Children[j], joint, strength);
+
+//! Returns the number of vertices moved by software skinning.
+u32 CSkinnedMesh::getSkinnedVertexCount()
+{
+	buildSkinningTable();
+	return SkinningTable->VertexIds.size();
 }
 
 
@@ -888,6 +1024,13 @@ void CSkinnedMesh::checkForAnimation()
 
 		// normalize weights
 		normalizeWeights();
+
+		// the weights have changed, the table is rebuilt on next skinning
+		if (SkinningTable)
+		{
+			SkinningTable->drop();
+			SkinningTable = 0;
+		}
 	}
 	SkinnedLastFrame=false;
 }
@@ -1539,6 +1682,16 @@ CSkinnedMesh *CSkinnedMesh::clone()
     }
     skinned_mesh->finalize();
 
+    // The copy has the same weights, so it can use the same skinning table
+    if (!HardwareSkinning)
+    {
+        buildSkinningTable();
+        if (skinned_mesh->SkinningTable)
+            skinned_mesh->SkinningTable->drop();
+        skinned_mesh->SkinningTable = SkinningTable;
+        SkinningTable->grab();
+    }
+
 
 
     return skinned_mesh;
@@ -160,6 +160,9 @@ namespace scene
 				IAnimatedMeshSceneNode* node,
 				ISceneManager* smgr);
         CSkinnedMesh *clone();
+
+		//! Returns the number of vertices moved by software skinning.
+		u32 getSkinnedVertexCount();
 private:
 		void checkForAnimation();
 
@@ -176,7 +179,9 @@ private:
 
 		void calculateGlobalMatrices(SJoint *Joint,SJoint *ParentJoint);
 
-		void skinJoint(SJoint *Joint, SJoint *ParentJoint, f32 strength=1.f);
+		void buildSkinningTable();
+
+		void skinVertices(f32 strength);
 
 		void calculateTangents(core::vector3df& normal,
 			core::vector3df& tangent, core::vector3df& binormal,
@@ -192,6 +197,32 @@ private:
 
 		core::array< core::array<bool> > Vertices_Moved;
 
+		//! All weights of the mesh, sorted by buffer and vertex, as flat
+		//! arrays for software skinning. The table only depends on the
+		//! weights and the static pose, so it is shared between clones.
+		struct SSkinningTable : public virtual IReferenceCounted
+		{
+			//! Index of the first skinned vertex of each buffer (plus one
+			//! entry for the end of the last buffer).
+			core::array<u32> BufferStart;
+			//! Index of each skinned vertex in its buffer.
+			core::array<u32> VertexIds;
+			//! Index of the first influence of each skinned vertex (plus one
+			//! entry for the end of the last vertex).
+			core::array<u32> InfluenceStart;
+			//! Index into AllJoints and strength of each influence.
+			core::array<u32> InfluenceJoint;
+			core::array<f32> InfluenceStrength;
+			//! Static position and normal of each skinned vertex, padded
+			//! to four floats so that they can be loaded into SSE registers.
+			core::array<f32> StaticPos;
+			core::array<f32> StaticNormal;
+		};
+		SSkinningTable *SkinningTable;
+
+		//! Skinning matrix of each joint for the current frame.
+		core::array<core::matrix4> SkinningMatrices;
+
 		core::aabbox3d<f32> BoundingBox;
 
 		f32 AnimationFrames;
@@ -497,6 +497,9 @@ bool AddonsManager::install(const Addon &addon)
                     from.c_str());
     }
 
+    // New files and directories were added to the addons directory.
+    file_manager->clearDirectoryIndex();
+
     int index = getAddonIndex(addon.getId());
     assert(index>=0 && index < (int)m_addons_list.getData().size());
     m_addons_list.getData()[index].setInstalled(true);
@@ -559,6 +562,7 @@ bool AddonsManager::uninstall(const Addon &addon)
     if (file_manager->fileExists(addon.getDataDir()))
     {
         error = !file_manager->removeDirectory(addon.getDataDir());
+        file_manager->clearDirectoryIndex();
 
         // Even if an error happened when removing the data files
         // still remove the addon, since it is unknown if e.g. only
@@ -18,9 +18,11 @@
 
 #include "animations/ipo.hpp"
 
+#include "io/file_manager.hpp"
 #include "io/xml_node.hpp"
 #include "utils/vs.hpp"
 #include "utils/log.hpp"
+#include "utils/string_utils.hpp"
 
 #include <string.h>
 #include <algorithm>
@@ -88,6 +90,7 @@ Ipo::IpoData::IpoData(const XMLNode &curve, float fps, bool reverse)
     else
         readIPO(curve, fps, reverse);
 
+    bake();
 }   // IpoData
 
 // ----------------------------------------------------------------------------
@@ -319,6 +322,100 @@ float Ipo::IpoData::adjustTime(float time)
 }   // adjustTime
 
 // ----------------------------------------------------------------------------
+/** Converts the control points into one cubic polynomial per segment (see
+ *  m_coefficients), so that an evaluation only needs to find the segment
+ *  and then computes all components in one pass. Constant and linear
+ *  interpolation are special cases of the polynomial. A curve with a
+ *  single control point is baked into one constant segment.
+ */
+void Ipo::IpoData::bake()
+{
+    m_times.clear();
+    m_inv_duration.clear();
+    m_coefficients.clear();
+
+    const unsigned int num_points = (unsigned int)m_points.size();
+    for(unsigned int i=0; i<num_points; i++)
+        m_times.push_back(m_points[i].getW());
+
+    const unsigned int num_segments = num_points>1 ? num_points-1
+                                                   : num_points;
+    m_inv_duration.resize(num_segments, 0.0f);
+    m_coefficients.resize(num_segments*12, 0.0f);
+    for(unsigned int n=0; n<num_segments; n++)
+    {
+        float *a = &m_coefficients[n*12];
+        float *b = a+3, *c = a+6, *d = a+9;
+        for(unsigned int j=0; j<3; j++)
+            d[j] = m_points[n][j];
+        if(num_points==1 || m_interpolation==IP_CONST)
+            continue;
+
+        float duration = m_points[n+1].getW()-m_points[n].getW();
+        if(duration>0)
+            m_inv_duration[n] = 1.0f/duration;
+        for(unsigned int j=0; j<3; j++)
+        {
+            if(m_interpolation==IP_LINEAR)
+            {
+                c[j] = m_points[n+1][j]-m_points[n][j];
+                continue;
+            }
+            // Same coefficients as in getCubicBezier
+            c[j] = 3.0f*(m_handle2[n][j]-m_points[n][j]);
+            b[j] = 3.0f*(m_handle1[n+1][j]-m_handle2[n][j])-c[j];
+            a[j] = m_points[n+1][j]-m_points[n][j]-c[j]-b[j];
+        }
+    }   // for n<num_segments
+}   // bake
+
+// ----------------------------------------------------------------------------
+/** Returns the segment to use for the given time (which must already be
+ *  adjusted with adjustTime): the last segment starting at or before the
+ *  given time (or the first segment if the time is before the start).
+ *  \param time The adjusted time.
+ *  \param hint The segment used in the previous call, which is tested first
+ *         since usually the time has not moved into another segment.
+ */
+unsigned int Ipo::IpoData::findSegment(float time, unsigned int hint) const
+{
+    const unsigned int num_segments = (unsigned int)m_inv_duration.size();
+    if(hint<num_segments                     &&
+       (hint==0 || time>=m_times[hint])      &&
+       (hint+1>=num_segments || time<m_times[hint+1]) )
+        return hint;
+
+    // Find the first point after the first segment with a time greater
+    // than the current time, the segment ends at this point.
+    std::vector<float>::const_iterator end =
+        std::upper_bound(m_times.begin()+1, m_times.begin()+num_segments,
+                         time);
+    return (unsigned int)(end-m_times.begin())-1;
+}   // findSegment
+
+// ----------------------------------------------------------------------------
+/** Evaluates the baked curve.
+ *  \param time The adjusted time.
+ *  \param segment The segment for this time, see findSegment().
+ *  \param num_components Number of components to compute.
+ *  \param result On return the values of the components 0 to
+ *         num_components-1.
+ */
+void Ipo::IpoData::evaluate(float time, unsigned int segment,
+                            unsigned int num_components, float *result) const
+{
+    const float t = (time-m_times[segment])*m_inv_duration[segment];
+    const float *a = &m_coefficients[segment*12];
+    const float *b = a+3, *c = a+6, *d = a+9;
+    for(unsigned int j=0; j<num_components; j++)
+        result[j] = ((a[j]*t+b[j])*t+c[j])*t+d[j];
+}   // evaluate
+
+// ----------------------------------------------------------------------------
+/** Evaluates the curve directly from the control points for the segment
+ *  starting at point n. This is not used for the animations anymore (see
+ *  bake()), it is only used to test the baked curves.
+ */
 float Ipo::IpoData::get(float time, unsigned int index, unsigned int n)
 {
     switch(m_interpolation)
@@ -430,7 +527,7 @@ void  Ipo::setInitialTransform(const Vec3 &xyz,
  */
 void Ipo::reset()
 {
-    m_next_n = 1;
+    m_segment = 0;
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -460,8 +557,10 @@ void Ipo::update(float time, Vec3 *xyz, Vec3 *hpr,Vec3 *scale)
         {
             if(xyz)
             {
+                float values[3];
+                getValues(time, 3, values);
                 for(unsigned int j=0; j<3; j++)
-                    (*xyz)[j] = get(time, j);
+                    (*xyz)[j] = values[j];
             }
             break;
         }
@@ -472,30 +571,118 @@ void Ipo::update(float time, Vec3 *xyz, Vec3 *hpr,Vec3 *scale)
 }   // update
 
 // ----------------------------------------------------------------------------
-/** Returns the interpolated value at the current time (which this objects
- *  keeps track of).
- *  \param time The time for which the interpolated value should be computed.
+/** Computes the values of the first components of the curve at the given
+ *  time.
+ *  \param time The time for which the values should be computed.
+ *  \param num_components Number of components to compute (1 for a single
+ *         channel IPO, 3 for a 3d curve).
+ *  \param values On return the interpolated values.
  */
-float Ipo::get(float time, unsigned int index) const
+void Ipo::getValues(float time, unsigned int num_components,
+                    float *values) const
 {
     assert(!std::isnan(time));
 
-    // Avoid crash in case that only one point is given for this IPO.
-    if(m_next_n==0)
-        return m_ipo_data->m_points[0][index];
+    // Avoid crash in case that no point is given for this IPO.
+    if(m_ipo_data->m_times.empty())
+    {
+        for(unsigned int j=0; j<num_components; j++)
+            values[j] = 0;
+        return;
+    }
 
     time = m_ipo_data->adjustTime(time);
+    m_segment = m_ipo_data->findSegment(time, m_segment);
+    m_ipo_data->evaluate(time, m_segment, num_components, values);
+#ifdef DEBUG
+    for(unsigned int j=0; j<num_components; j++)
+        assert(!std::isnan(values[j]));
+#endif
+}   // getValues
 
-    // Time was reset since the last cached value for n,
-    // reset n to start from the beginning again.
-    if(time < m_ipo_data->m_points[m_next_n-1].getW())
-        m_next_n = 1;
-    // Search for the first point in the (sorted) array which is greater or equal
-    // to the current time.
-    while(m_next_n<m_ipo_data->m_points.size()-1 &&
-         time >=m_ipo_data->m_points[m_next_n].getW())
-        m_next_n++;
-    float rval = m_ipo_data->get(time, index, m_next_n-1);
-    assert(!std::isnan(rval));
-    return rval;
+// ----------------------------------------------------------------------------
+/** Returns the interpolated value at the current time (which this objects
+ *  keeps track of).
+ *  \param time The time for which the interpolated value should be computed.
+ *  \param index The component to compute.
+ */
+float Ipo::get(float time, unsigned int index) const
+{
+    float values[3];
+    getValues(time, index+1, values);
+    return values[index];
 }   // get
+
+// ----------------------------------------------------------------------------
+/** Compares the baked curves with the evaluation directly from the control
+ *  points for all interpolation and extend types, for IPO curves and 3d
+ *  curves (the latter also in reverse, as used by cannons).
+ */
+void Ipo::unitTesting()
+{
+    // Times (in frames) of 1, 26, 51, 101 are 0, 1, 2, 4 seconds at 25 fps
+    const std::string ipo_points =
+        "  <p c=\"1 0\"    h1=\"-9 -1\" h2=\"11 1\"/>"
+        "  <p c=\"26 3\"   h1=\"16 4\"  h2=\"36 2\"/>"
+        "  <p c=\"51 -2\"  h1=\"41 -2\" h2=\"61 -2\"/>"
+        "  <p c=\"101 5\"  h1=\"81 6\"  h2=\"121 4\"/>";
+    const std::string curve_points =
+        "  <p c=\"0 0 0\"     h1=\"-5 0 -5\"  h2=\"5 0 5\"/>"
+        "  <p c=\"20 5 10\"   h1=\"15 5 0\"   h2=\"25 5 20\"/>"
+        "  <p c=\"40 0 0\"    h1=\"40 -5 10\" h2=\"40 5 -10\"/>"
+        "  <p c=\"60 10 -20\" h1=\"55 10 -10\" h2=\"65 10 -30\"/>";
+    const char *interpolations[] = {"const", "linear", "bezier"};
+    const char *extends[]        = {"const", "cyclic"};
+
+    for(unsigned int curve_type=0; curve_type<3; curve_type++)
+    {
+        for(unsigned int i=0; i<3; i++)
+        {
+            for(unsigned int e=0; e<2; e++)
+            {
+                std::string xml = StringUtils::insertValues(
+                    "<curve channel=\"%s\" interpolation=\"%s\" "
+                    "extend=\"%s\" speed=\"10\">",
+                    curve_type==0 ? "LocX" : "LocXYZ",
+                    interpolations[i], extends[e]);
+                xml += curve_type==0 ? ipo_points : curve_points;
+                xml += "</curve>";
+                XMLNode *node = file_manager->createXMLTreeFromString(xml);
+                Ipo ipo(*node, 25, /*reverse*/curve_type==2);
+                delete node;
+
+                IpoData *data = ipo.m_ipo_data;
+                const unsigned int num_components =
+                    data->m_channel==IPO_LOCXYZ ? 3 : 1;
+                const float end = data->m_end_time;
+
+                // This is the evaluation as it was done before the
+                // curves were baked.
+                unsigned int next_n = 1;
+                for(unsigned int step=0; step<2000; step++)
+                {
+                    // First move forward in time, then jump around
+                    float time = step<1000
+                               ? -1.0f + step*(3.0f*end+2.0f)/1000.0f
+                               : fmodf(step*7.31f, 3.0f*end+2.0f) - 1.0f;
+                    float t = data->adjustTime(time);
+                    if(t < data->m_points[next_n-1].getW())
+                        next_n = 1;
+                    while(next_n<data->m_points.size()-1 &&
+                          t >= data->m_points[next_n].getW())
+                        next_n++;
+
+                    float values[3];
+                    ipo.getValues(time, num_components, values);
+                    for(unsigned int j=0; j<num_components; j++)
+                    {
+                        float expected = data->get(t, j, next_n-1);
+                        assert(fabsf(values[j]-expected)
+                               <= 0.001f*(1.0f+fabsf(expected)));
+                        assert(ipo.get(time, j)==values[j]);
+                    }
+                }
+            }   // for e < 2
+        }   // for i < 3
+    }   // for curve_type < 3
+}   // unitTesting
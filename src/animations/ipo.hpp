@@ -78,6 +78,21 @@ private:
 
         /** Stores the inital rotation of the object. */
         Vec3 m_initial_hpr;
+
+        /** The time of each control point, used to find the segment for
+         *  a given time with a binary search. */
+        std::vector<float> m_times;
+
+        /** 1/duration of each segment (0 for segments without a duration,
+         *  and for constant interpolation). */
+        std::vector<float> m_inv_duration;
+
+        /** The curve baked into one cubic polynomial per segment, in the
+         *  normalised time t in [0,1] of that segment. For each segment
+         *  the coefficients a, b, c, d (value = ((a*t+b)*t+c)*t+d) are
+         *  stored for all three components, i.e. 12 floats per segment,
+         *  so that all components are evaluated in one pass. */
+        std::vector<float> m_coefficients;
     private:
         float  getCubicBezier(float t, float p0, float p1,
                               float p2, float p3) const;
@@ -89,6 +104,10 @@ private:
                IpoData(const XMLNode &curve, float fps, bool reverse);
         void   readCurve(const XMLNode &node, bool reverse);
         void   readIPO(const XMLNode &node, float fps, bool reverse);
+        void   bake();
+        unsigned int findSegment(float time, unsigned int hint) const;
+        void   evaluate(float time, unsigned int segment,
+                        unsigned int num_components, float *result) const;
         float  approximateLength(float t0, float t1,
                                  const Vec3 &p0, const Vec3 &p1,
                                  const Vec3 &h1, const Vec3 &h2);
@@ -99,7 +118,7 @@ private:
     // ------------------------------------------------------------------------
     /** The actual data of the IPO. This can be shared between Ipo (e.g. each
      *  cannon animation will use the same IpoData block, but its own instance
-     *  of Ipo, since data like m_next_n should not be shared). */
+     *  of Ipo, since data like m_segment should not be shared). */
     IpoData *m_ipo_data;
 
     /** True if m_ipo_data is 'owned' by this object and therefore needs to be
@@ -107,13 +126,15 @@ private:
      *  and must therefore not free it. */
     bool m_own_ipo_data;
 
-    /** Which control points will be the next one (so m_next_n-1 and
-    *  m_next_n are the control points to use now). This just reduces
-    *  lookup time in get(t). To allow modifying this in get() const,
-    *  it is declared mutable). */
-    mutable unsigned int m_next_n;
+    /** The segment used in the last evaluation. Usually the next
+    *  evaluation uses the same segment, so this avoids the binary search
+    *  in most cases. To allow modifying this in get() const, it is
+    *  declared mutable). */
+    mutable unsigned int m_segment;
 
     Ipo(const Ipo *ipo);
+    void getValues(float time, unsigned int num_components,
+                   float *values) const;
 public:
              Ipo(const XMLNode &curve, float fps=25, bool reverse=false);
     virtual ~Ipo();
@@ -123,6 +144,7 @@ public:
     float    get(float time, unsigned int index) const;
     void     setInitialTransform(const Vec3 &xyz, const Vec3 &hpr);
     void     reset();
+    static void unitTesting();
 
     // ------------------------------------------------------------------------
     /** Returns the raw data points for this IPO. */
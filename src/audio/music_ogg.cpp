@@ -27,19 +27,30 @@
 #  include <AL/al.h>
 #endif
 
+#include "audio/music_information.hpp"
 #include "audio/music_manager.hpp"
 #include "audio/sfx_manager.hpp"
+#include "config/user_config.hpp"
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
+#include "utils/time.hpp"
+#include "utils/vs.hpp"
+
+#include <assert.h>
+#include <cerrno>
 
 MusicOggStream::MusicOggStream(float loop_start)
 {
     //m_oggStream= NULL;
-    m_soundBuffers[0] = m_soundBuffers[1]= 0;
     m_soundSource     = -1;
     m_pausedMusic     = true;
     m_playing         = false;
     m_loop_start      = loop_start;
+    m_decoder_thread  = NULL;
+    m_underruns       = 0;
+    m_late_buffers    = 0;
+    pthread_cond_init(&m_cond_space, NULL);
+    pthread_cond_init(&m_cond_data,  NULL);
 }   // MusicOggStream
 
 //-----------------------------------------------------------------------------
@@ -47,6 +58,8 @@ MusicOggStream::~MusicOggStream()
 {
     if(stopMusic() == false)
         Log::warn("MusicOgg", "problems while stopping music.");
+    pthread_cond_destroy(&m_cond_space);
+    pthread_cond_destroy(&m_cond_data);
 }   // ~MusicOggStream
 
 //-----------------------------------------------------------------------------
@@ -112,8 +125,15 @@ bool MusicOggStream::load(const std::string& filename)
     if (m_vorbisInfo->channels == 1) nb_channels = AL_FORMAT_MONO16;
     else                             nb_channels = AL_FORMAT_STEREO16;
 
-    alGenBuffers(2, m_soundBuffers);
+    // The number of buffers is both the number of buffers queued in OpenAL
+    // and the number of buffers the decoder decodes ahead.
+    int num_buffers = UserConfigParams::m_music_stream_buffers;
+    if (num_buffers <  2) num_buffers =  2;
+    if (num_buffers > 64) num_buffers = 64;
+    m_sound_buffers.resize(num_buffers);
+    alGenBuffers(num_buffers, m_sound_buffers.data());
     if (check("alGenBuffers") == false) return false;
+    m_free_buffers = m_sound_buffers;
 
     alGenSources(1, &m_soundSource);
     if (check("alGenSources") == false) return false;
@@ -126,9 +146,102 @@ bool MusicOggStream::load(const std::string& filename)
     alSourcei (m_soundSource, AL_SOURCE_RELATIVE, AL_TRUE      );
 
     m_error=false;
+    startDecoder();
     return true;
 }   // load
 
+//-----------------------------------------------------------------------------
+/** Starts the thread that decodes the music ahead of time.
+ */
+void MusicOggStream::startDecoder()
+{
+    m_decoded.lock();
+    DecodedBuffers &decoded = m_decoded.getData();
+    decoded.m_data.resize(m_sound_buffers.size());
+    for (unsigned int i = 0; i < decoded.m_data.size(); i++)
+        decoded.m_data[i].reserve(m_buffer_size);
+    decoded.m_first = 0;
+    decoded.m_count = 0;
+    decoded.m_quit  = false;
+    decoded.m_error = false;
+    m_decoded.unlock();
+
+    pthread_attr_t  attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    m_decoder_thread = new pthread_t();
+    int error = pthread_create(m_decoder_thread, &attr,
+                               &MusicOggStream::decoderLoop, this);
+    if (error)
+    {
+        delete m_decoder_thread;
+        m_decoder_thread = NULL;
+        m_decoded.lock();
+        m_decoded.getData().m_error = true;
+        m_decoded.unlock();
+        Log::error("MusicOgg", "Could not create decoder thread, error=%d.",
+                   errno);
+    }
+    pthread_attr_destroy(&attr);
+}   // startDecoder
+
+//-----------------------------------------------------------------------------
+/** Stops the decoder thread and waits for it to finish. */
+void MusicOggStream::stopDecoder()
+{
+    if (!m_decoder_thread) return;
+
+    m_decoded.lock();
+    m_decoded.getData().m_quit = true;
+    pthread_cond_signal(&m_cond_space);
+    m_decoded.unlock();
+
+    pthread_join(*m_decoder_thread, NULL);
+    delete m_decoder_thread;
+    m_decoder_thread = NULL;
+}   // stopDecoder
+
+//-----------------------------------------------------------------------------
+/** The decoder thread: fills all free buffers of the ring with decoded
+ *  data, then waits till a buffer is used.
+ *  \param obj Pointer to the MusicOggStream.
+ */
+void* MusicOggStream::decoderLoop(void *obj)
+{
+    VS::setThreadName("MusicDecoder");
+    MusicOggStream *me = (MusicOggStream*)obj;
+
+    me->m_decoded.lock();
+    DecodedBuffers &decoded = me->m_decoded.getData();
+    while (true)
+    {
+        // The 'while' is necessary because of spurious wakeups
+        while (!decoded.m_quit && decoded.m_count == decoded.m_data.size())
+            pthread_cond_wait(&me->m_cond_space, me->m_decoded.getMutex());
+        if (decoded.m_quit) break;
+
+        // The buffer after the last decoded buffer is not used by the sfx
+        // thread, so it can be filled without holding the lock.
+        unsigned int index = (decoded.m_first + decoded.m_count)
+                           % decoded.m_data.size();
+        me->m_decoded.unlock();
+        bool ok = me->decodeIntoBuffer(&decoded.m_data[index]);
+        me->m_decoded.lock();
+
+        if (!ok)
+        {
+            decoded.m_error = true;
+            pthread_cond_signal(&me->m_cond_data);
+            break;
+        }
+        decoded.m_count++;
+        pthread_cond_signal(&me->m_cond_data);
+    }
+    me->m_decoded.unlock();
+    return NULL;
+}   // decoderLoop
+
 //-----------------------------------------------------------------------------
 bool MusicOggStream::empty()
 {
@@ -156,13 +269,25 @@ bool MusicOggStream::release()
     }
 
     pauseMusic();
+    // Stop the source, so that all queued buffers can be unqueued.
+    alSourceStop(m_soundSource);
+    stopDecoder();
+    if (m_underruns > 0 || m_late_buffers > 0)
+    {
+        Log::info("MusicOgg", "'%s': %u underruns, %u buffers refilled late.",
+                  m_fileName.c_str(), m_underruns, m_late_buffers);
+    }
     m_fileName= "";
 
     empty();
     alDeleteSources(1, &m_soundSource);
     check("alDeleteSources");
-    alDeleteBuffers(2, m_soundBuffers);
+    if (!m_sound_buffers.empty())
+        alDeleteBuffers((ALsizei)m_sound_buffers.size(),
+                        m_sound_buffers.data());
     check("alDeleteBuffers");
+    m_sound_buffers.clear();
+    m_free_buffers.clear();
 
     // Handle error correctly
     if(!m_error) ov_clear(&m_oggStream);
@@ -179,13 +304,12 @@ bool MusicOggStream::playMusic()
     if(isPlaying())
         return true;
 
-    if(!streamIntoBuffer(m_soundBuffers[0]))
-        return false;
-
-    if(!streamIntoBuffer(m_soundBuffers[1]))
+    // Usually the decoder is far ahead already, only if the music is played
+    // immediately after loading this needs to wait for the first buffer.
+    if(!waitForDecodedData())
         return false;
 
-    alSourceQueueBuffers(m_soundSource, 2, m_soundBuffers);
+    fillFreeBuffers();
 
     alSourcePlay(m_soundSource);
     m_pausedMusic = false;
@@ -226,7 +350,9 @@ bool MusicOggStream::pauseMusic()
         return true;
     }
 
-    alSourceStop(m_soundSource);
+    // Pause (and not stop) the source, otherwise all queued buffers would
+    // be played again when the music is resumed.
+    alSourcePause(m_soundSource);
     m_pausedMusic= true;
     return true;
 }   // pauseMusic
@@ -276,8 +402,6 @@ void MusicOggStream::update()
     }
 
     int processed= 0;
-    bool active= true;
-
     alGetSourcei(m_soundSource, AL_BUFFERS_PROCESSED, &processed);
 
     while(processed--)
@@ -286,20 +410,19 @@ void MusicOggStream::update()
 
         alSourceUnqueueBuffers(m_soundSource, 1, &buffer);
         if(!check("alSourceUnqueueBuffers")) return;
-
-        active = streamIntoBuffer(buffer);
-        if(!active)
-        {
-            // no more data. Seek to loop start (causes the sound to loop)
-            ov_time_seek(&m_oggStream, m_loop_start);
-            active = streamIntoBuffer(buffer);//now there really should be data
-        }
-
-        alSourceQueueBuffers(m_soundSource, 1, &buffer);
-        if (!check("alSourceQueueBuffers")) return;
+        m_free_buffers.push_back(buffer);
     }
 
-    if (active)
+    unsigned int num_free = (unsigned int)m_free_buffers.size();
+    fillFreeBuffers();
+    // Count buffers that had been processed but could not be refilled,
+    // i.e. the decoder is not keeping up.
+    if (!m_free_buffers.empty() && m_free_buffers.size() == num_free)
+        m_late_buffers++;
+
+    int queued = 0;
+    alGetSourcei(m_soundSource, AL_BUFFERS_QUEUED, &queued);
+    if (queued > 0)
     {
         // For debugging
         SFXManager::checkError("before source state");
@@ -308,54 +431,126 @@ void MusicOggStream::update()
         alGetSourcei(m_soundSource, AL_SOURCE_STATE, &state);
         if (state != AL_PLAYING)
         {
+            // The source played all queued buffers before new data was
+            // available.
+            m_underruns++;
             // Prevent flooding
             static int count = 0;
             count++;
             if (count<10)
                 Log::warn("MusicOgg", "Music not playing when it should be. "
                           "Source state: %d", state);
-            alGetSourcei(m_soundSource, AL_BUFFERS_PROCESSED, &processed);
             alSourcePlay(m_soundSource);
         }
     }
     else
     {
-        Log::warn("MusicOgg", "Attempt to stream music into buffer failed "
-                              "twice in a row.");
+        m_decoded.lock();
+        bool error = m_decoded.getData().m_error;
+        m_decoded.unlock();
+        if (error)
+            Log::warn("MusicOgg", "Attempt to stream music into buffer "
+                                  "failed.");
     }
 }   // update
 
 //-----------------------------------------------------------------------------
-bool MusicOggStream::streamIntoBuffer(ALuint buffer)
+/** Waits till the decoder has decoded at least one buffer.
+ *  \return False if the decoder stopped because of an error.
+ */
+bool MusicOggStream::waitForDecodedData()
+{
+    m_decoded.lock();
+    DecodedBuffers &decoded = m_decoded.getData();
+    while (decoded.m_count == 0 && !decoded.m_error && m_decoder_thread)
+        pthread_cond_wait(&m_cond_data, m_decoded.getMutex());
+    bool has_data = decoded.m_count > 0;
+    m_decoded.unlock();
+    return has_data;
+}   // waitForDecodedData
+
+//-----------------------------------------------------------------------------
+/** Copies decoded data into all free OpenAL buffers (as long as decoded data
+ *  is available) and queues them.
+ */
+void MusicOggStream::fillFreeBuffers()
+{
+    DecodedBuffers &decoded = m_decoded.getData();
+    while (!m_free_buffers.empty())
+    {
+        m_decoded.lock();
+        if (decoded.m_count == 0)
+        {
+            m_decoded.unlock();
+            return;
+        }
+        // The decoder does not touch decoded buffers, so no lock is
+        // necessary while OpenAL copies the data.
+        const std::vector<char> &pcm = decoded.m_data[decoded.m_first];
+        m_decoded.unlock();
+
+        ALuint buffer = m_free_buffers.back();
+        m_free_buffers.pop_back();
+        alBufferData(buffer, nb_channels, pcm.data(), (ALsizei)pcm.size(),
+                     m_vorbisInfo->rate);
+        check("alBufferData");
+
+        m_decoded.lock();
+        decoded.m_first = (decoded.m_first + 1) % decoded.m_data.size();
+        decoded.m_count--;
+        pthread_cond_signal(&m_cond_space);
+        m_decoded.unlock();
+
+        alSourceQueueBuffers(m_soundSource, 1, &buffer);
+        if (!check("alSourceQueueBuffers")) return;
+    }
+}   // fillFreeBuffers
+
+//-----------------------------------------------------------------------------
+/** Decodes the next m_buffer_size bytes of music. This is called from the
+ *  decoder thread. At the end of the file it continues at the loop start.
+ *  \param pcm The buffer to fill.
+ *  \return False if no data could be decoded.
+ */
+bool MusicOggStream::decodeIntoBuffer(std::vector<char> *pcm)
 {
-    char pcm[m_buffer_size];
     const int isBigEndian = (IS_LITTLE_ENDIAN ? 0 : 1);
 
+    pcm->resize(m_buffer_size);
     int  size = 0;
     int  portion;
     int  result;
+    bool seeked = false;
 
     while(size < m_buffer_size)
     {
-        result = ov_read(&m_oggStream, pcm + size, m_buffer_size - size,
+        result = ov_read(&m_oggStream, pcm->data() + size, m_buffer_size - size,
                          isBigEndian, 2, 1, &portion);
 
         if(result > 0)
-            size += result;
+        {
+            size  += result;
+            seeked = false;
+        }
+        else if(result < 0)
+        {
+            Log::error("MusicOgg", "Decoding '%s' failed: %s",
+                       m_fileName.c_str(), errorString(result).c_str());
+            break;
+        }
         else
-            if(result < 0)
-                throw errorString(result);
-            else
-                break;
+        {
+            // End of file. Seek to loop start (causes the sound to loop),
+            // unless that does not give any data either.
+            if(seeked) break;
+            ov_time_seek(&m_oggStream, m_loop_start);
+            seeked = true;
+        }
     }
 
-    if(size == 0) return false;
-
-    alBufferData(buffer, nb_channels, pcm, size, m_vorbisInfo->rate);
-    check("alBufferData");
-
-    return true;
-}   // streamIntoBuffer
+    pcm->resize(size);
+    return size > 0;
+}   // decodeIntoBuffer
 
 //-----------------------------------------------------------------------------
 bool MusicOggStream::check(const char* what)
@@ -392,4 +587,75 @@ std::string MusicOggStream::errorString(int code)
     }
 }   // errorString
 
+//-----------------------------------------------------------------------------
+/** Plays the menu music (silently) for a few seconds and checks that the
+ *  decoder keeps up. Without a sound card this can be run using the
+ *  OpenAL null device (e.g. ALSOFT_DRIVERS=null for OpenAL Soft).
+ */
+void MusicOggStream::unitTesting()
+{
+    if (!music_manager->initialized())
+    {
+        Log::info("MusicOgg", "No sound device, music streaming not tested.");
+        return;
+    }
+    MusicInformation *mi =
+        music_manager->getMusicInformation("main_theme.music");
+    if (!mi)
+    {
+        Log::info("MusicOgg", "No music found, music streaming not tested.");
+        return;
+    }
+
+    MusicOggStream *music = new MusicOggStream(0.0f);
+    bool ok = music->load(mi->getNormalFilename());
+    assert(ok);
+    assert(music->m_sound_buffers.size() >= 2);
+
+    // The decoder starts when the music is loaded, so the ring is filled
+    // before the music is played.
+    double start = StkTime::getRealTime();
+    while (StkTime::getRealTime() - start < 1.0)
+    {
+        music->m_decoded.lock();
+        bool full = music->m_decoded.getData().m_count ==
+                    music->m_decoded.getData().m_data.size();
+        music->m_decoded.unlock();
+        if (full) break;
+        StkTime::sleep(1);
+    }
+    music->m_decoded.lock();
+    assert(music->m_decoded.getData().m_count ==
+           music->m_decoded.getData().m_data.size());
+    music->m_decoded.unlock();
+
+    ok = music->playMusic();
+    assert(ok);
+    music->setVolume(0.0f);
+    assert(music->m_free_buffers.empty());
+
+    // Simulate the sfx thread updating the music while it is playing.
+    for (int i = 0; i < 2; i++)
+    {
+        start = StkTime::getRealTime();
+        while (StkTime::getRealTime() - start < 1.5)
+        {
+            music->update();
+            StkTime::sleep(20);
+        }
+        music->pauseMusic();
+        StkTime::sleep(100);
+        music->update();
+        music->resumeMusic();
+    }
+    Log::info("MusicOgg", "%u underruns, %u buffers refilled late.",
+              music->getNumUnderruns(), music->getNumLateBuffers());
+    assert(music->getNumUnderruns() == 0);
+
+    ok = music->stopMusic();
+    assert(ok);
+    assert(music->m_decoder_thread == NULL);
+    delete music;
+}   // unitTesting
+
 #endif // HAVE_OGGVORBIS
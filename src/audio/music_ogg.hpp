@@ -22,6 +22,7 @@
 #if HAVE_OGGVORBIS
 
 #include <string>
+#include <vector>
 
 #include <ogg/ogg.h>
 // Disable warning about potential loss of precision in vorbisfile.h
@@ -39,9 +40,18 @@
 #  include <AL/al.h>
 #endif
 #include "audio/music.hpp"
+#include "utils/synchronised.hpp"
+
+#include <pthread.h>
 
 /**
   * \brief ogg files based implementation of the Music interface
+  *  Decoding is done in a separate thread, which decodes ahead into a ring
+  *  of PCM buffers. The update() function (called from the sfx thread) then
+  *  only has to hand already decoded data to OpenAL, so a slow decode can
+  *  not delay any sfx commands. Since decoding starts as soon as a file is
+  *  loaded, music that is loaded before it is played (e.g. the last lap
+  *  music) is already decoded when it starts.
   * \ingroup audio
   */
 class MusicOggStream : public Music
@@ -62,14 +72,46 @@ public:
     virtual void setVolume(float volume);
     virtual bool isPlaying();
 
+    // ------------------------------------------------------------------------
+    /** Returns how often the source ran out of data while it should have
+     *  been playing, i.e. the number of audible gaps. */
+    unsigned int getNumUnderruns() const { return m_underruns; }
+    // ------------------------------------------------------------------------
+    /** Returns how often a buffer that OpenAL had finished playing could not
+     *  be refilled immediately because the decoder was behind. */
+    unsigned int getNumLateBuffers() const { return m_late_buffers; }
+
+    static void unitTesting();
+
 protected:
     bool empty();
     bool check(const char* what);
     std::string errorString(int code);
 
 private:
+    /** The ring of decoded PCM data, shared between the sfx thread and the
+     *  decoder thread. */
+    struct DecodedBuffers
+    {
+        /** All PCM buffers of the ring. */
+        std::vector<std::vector<char> > m_data;
+        /** Index of the oldest decoded buffer. */
+        unsigned int m_first;
+        /** Number of decoded buffers that have not been used yet. */
+        unsigned int m_count;
+        /** Set to make the decoder thread exit. */
+        bool         m_quit;
+        /** Set by the decoder thread if the file could not be decoded. */
+        bool         m_error;
+    };   // DecodedBuffers
+
     bool release();
-    bool streamIntoBuffer(ALuint buffer);
+    bool decodeIntoBuffer(std::vector<char> *pcm);
+    void fillFreeBuffers();
+    bool waitForDecodedData();
+    void startDecoder();
+    void stopDecoder();
+    static void* decoderLoop(void *obj);
 
     float           m_loop_start;
     std::string     m_fileName;
@@ -80,13 +122,35 @@ private:
 
     bool            m_playing;
 
-    ALuint m_soundBuffers[2];
+    /** All OpenAL buffers used by this stream. */
+    std::vector<ALuint> m_sound_buffers;
+    /** OpenAL buffers that are not queued, waiting for decoded data. */
+    std::vector<ALuint> m_free_buffers;
     ALuint m_soundSource;
     ALenum nb_channels;
 
     bool m_pausedMusic;
 
-    //one full second of audio at 44100 samples per second
+    /** Decoded data waiting to be given to OpenAL. */
+    Synchronised<DecodedBuffers> m_decoded;
+
+    /** Signaled when a decoded buffer was used (or the decoder should
+     *  exit), so the decoder can continue. */
+    pthread_cond_t  m_cond_space;
+
+    /** Signaled by the decoder when a new buffer was decoded. */
+    pthread_cond_t  m_cond_data;
+
+    /** The decoder thread, or NULL if no decoder is running. */
+    pthread_t      *m_decoder_thread;
+
+    /** Number of times the source stopped because it ran out of data. */
+    unsigned int    m_underruns;
+
+    /** Number of processed buffers that could not be refilled in time. */
+    unsigned int    m_late_buffers;
+
+    /** Quarter of a second of stereo audio at 44100 samples per second. */
     static const int m_buffer_size = 11025*4;
 };
 
@@ -87,28 +87,10 @@ SFXManager::SFXManager()
 
     pthread_cond_init(&m_cond_request, NULL);
 
-    pthread_attr_t  attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-
-    // Should be the default, but just in case:
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-
-    m_thread_id.setAtomic(new pthread_t());
+    m_thread_id.setAtomic(NULL);
     // The thread is created even if there atm sfx are disabled
     // (since the user might enable it later).
-    int error = pthread_create(m_thread_id.getData(), &attr,
-                               &SFXManager::mainLoop, this);
-    if (error)
-    {
-        m_thread_id.lock();
-        delete m_thread_id.getData();
-        m_thread_id.unlock();
-        m_thread_id.setAtomic(0);
-        Log::error("SFXManager", "Could not create thread, error=%d.",
-                   errno);
-    }
-    pthread_attr_destroy(&attr);
+    startThread();
 
     setMasterSFXVolume( UserConfigParams::m_sfx_volume );
     m_sfx_commands.lock();
@@ -122,10 +104,7 @@ SFXManager::SFXManager()
  */
 SFXManager::~SFXManager()
 {
-    m_thread_id.lock();
-    pthread_join(*m_thread_id.getData(), NULL);
-    delete m_thread_id.getData();
-    m_thread_id.unlock();
+    joinThread();
     pthread_cond_destroy(&m_cond_request);
 
     // ---- clear m_all_sfx
@@ -277,6 +256,50 @@ void SFXManager::queueCommand(SFXCommand *command)
     m_sfx_commands.unlock();
 }   // queueCommand
 
+//----------------------------------------------------------------------------
+/** Creates the thread executing all sfx commands.
+ */
+void SFXManager::startThread()
+{
+    pthread_attr_t  attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    // Should be the default, but just in case:
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+    m_thread_id.setAtomic(new pthread_t());
+    int error = pthread_create(m_thread_id.getData(), &attr,
+                               &SFXManager::mainLoop, this);
+    if (error)
+    {
+        m_thread_id.lock();
+        delete m_thread_id.getData();
+        m_thread_id.unlock();
+        m_thread_id.setAtomic(0);
+        Log::error("SFXManager", "Could not create thread, error=%d.",
+                   errno);
+    }
+    pthread_attr_destroy(&attr);
+}   // startThread
+
+//----------------------------------------------------------------------------
+/** Waits for the sfx thread to finish after stopThread() was called. The
+ *  thread can be started again with startThread(), which is used by the
+ *  LobbyPool to fork processes while no sfx thread is running.
+ */
+void SFXManager::joinThread()
+{
+    m_thread_id.lock();
+    if (m_thread_id.getData())
+    {
+        pthread_join(*m_thread_id.getData(), NULL);
+        delete m_thread_id.getData();
+        m_thread_id.getData() = NULL;
+    }
+    m_thread_id.unlock();
+}   // joinThread
+
 //----------------------------------------------------------------------------
 /** Puts a NULL request into the queue, which will trigger the thread to
  *  exit.
@@ -247,7 +247,9 @@ public:
     }   // get
 
     // ------------------------------------------------------------------------
+    void                     startThread();
     void                     stopThread();
+    void                     joinThread();
     bool                     sfxAllowed();
     SFXBuffer*               loadSingleSfx(const XMLNode* node,
                                            const std::string &path=std::string(""),
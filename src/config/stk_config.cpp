@@ -137,10 +137,14 @@ void STKConfig::load(const std::string &filename)
     CHECK_NEG(m_replay_delta_angle,        "replay delta-angle"         );
     CHECK_NEG(m_replay_delta_pos2,         "replay delta-position"      );
     CHECK_NEG(m_replay_dt,                 "replay delta-t"             );
+    CHECK_NEG(m_ghost_lod_distance2,       "replay ghost-lod-distance"  );
+    CHECK_NEG(m_ghost_cull_distance2,      "replay ghost-cull-distance" );
     CHECK_NEG(m_smooth_angle_limit,        "physics smooth-angle-limit" );
 
     // Square distance to make distance checks cheaper (no sqrt)
     m_replay_delta_pos2 *= m_replay_delta_pos2;
+    m_ghost_lod_distance2  *= m_ghost_lod_distance2;
+    m_ghost_cull_distance2 *= m_ghost_cull_distance2;
     m_default_kart_properties->checkAllSet(filename);
 }   // load
 
@@ -170,6 +174,8 @@ void STKConfig::init_defaults()
     m_replay_delta_angle         = -100;
     m_replay_delta_pos2          = -100;
     m_replay_dt                  = -100;
+    m_ghost_lod_distance2        = -100;
+    m_ghost_cull_distance2       = -100;
     m_title_music                = NULL;
     m_enable_networking          = true;
     m_smooth_normals             = false;
@@ -351,6 +357,8 @@ void STKConfig::getAllData(const XMLNode * root)
         replay_node->get("delta-pos",   &m_replay_delta_pos2 );
         replay_node->get("delta-t",     &m_replay_dt         );
         replay_node->get("max-time",    &m_replay_max_time   );
+        replay_node->get("ghost-lod-distance",  &m_ghost_lod_distance2 );
+        replay_node->get("ghost-cull-distance", &m_ghost_cull_distance2);
 
     }
 
@@ -140,6 +140,14 @@ public:
      *  be generated. */
     float m_replay_delta_angle;
 
+    /** Square of the distance from the camera beyond which the wheels,
+     *  animations and effects of ghost karts are not updated. */
+    float m_ghost_lod_distance2;
+
+    /** Square of the distance from the camera beyond which ghost karts are
+     *  not shown. */
+    float m_ghost_cull_distance2;
+
     /** The field of view for 1, 2, 3, 4 player split screen. */
     float m_camera_fov[4];
 
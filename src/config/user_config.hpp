@@ -319,6 +319,10 @@ namespace UserConfigParams
     PARAM_PREFIX FloatUserConfigParam       m_music_volume
             PARAM_DEFAULT(  FloatUserConfigParam(0.7f, "music_volume",
             &m_audio_group, "Music volume from 0.0 to 1.0") );
+    PARAM_PREFIX IntUserConfigParam         m_music_stream_buffers
+            PARAM_DEFAULT(  IntUserConfigParam(8, "music_stream_buffers",
+            &m_audio_group, "Number of music buffers (each a quarter of a "
+                            "second) that are decoded ahead and queued.") );
 
     // ---- Race setup
     PARAM_PREFIX GroupUserConfigParam        m_race_setup_group
@@ -453,6 +457,15 @@ namespace UserConfigParams
     PARAM_PREFIX BoolUserConfigParam        m_texture_compression
         PARAM_DEFAULT(BoolUserConfigParam(true, "enable_texture_compression",
         &m_video_group, "Enable Texture Compression"));
+    PARAM_PREFIX IntUserConfigParam        m_image_decode_threads
+        PARAM_DEFAULT(IntUserConfigParam(-1, "image_decode_threads",
+        &m_video_group, "Number of threads decoding textures while loading. "
+                        "0 decodes all textures on the main thread, -1 uses "
+                        "one thread less than the number of processors."));
+    PARAM_PREFIX BoolUserConfigParam        m_cooked_meshes
+        PARAM_DEFAULT(BoolUserConfigParam(true, "cooked_meshes",
+        &m_video_group, "Cache the batched main track models in binary "
+                        "files to load them faster."));
     /** This is a bit flag: bit 0: enabled (1) or disabled(0). 
      *  Bit 1: setting done by default(0), or by user choice (2). This allows
      *  to e.g. disable h.d. textures on hd3000 as default, but still allow the
@@ -565,6 +578,11 @@ namespace UserConfigParams
             PARAM_DEFAULT(  IntUserConfigParam(16, "server_max_players",
                                        "Maximum number of players on the server.") );
 
+    PARAM_PREFIX IntUserConfigParam         m_server_kart_update_bandwidth
+            PARAM_DEFAULT(  IntUserConfigParam(2000, "server_kart_update_bandwidth",
+                                       "Maximum number of bytes per second a server sends "
+                                       "to each client for kart positions.") );
+
     PARAM_PREFIX StringListUserConfigParam         m_stun_servers
             PARAM_DEFAULT(  StringListUserConfigParam("Stun_servers", "The stun servers"
                             " that will be used to know the public address.",
@@ -761,6 +779,13 @@ namespace UserConfigParams
                                                "wasn't asked, 1: allowed, 2: "
                                                "not allowed") );
 
+    PARAM_PREFIX IntUserConfigParam        m_max_http_transfers
+            PARAM_DEFAULT(  IntUserConfigParam(4, "max_http_transfers",
+                                               "Maximum number of http "
+                                               "requests (e.g. addon icon "
+                                               "downloads) executed at the "
+                                               "same time.") );
+
     PARAM_PREFIX GroupUserConfigParam       m_hw_report_group
             PARAM_DEFAULT( GroupUserConfigParam("HWReport",
                                           "Everything related to hardware configuration.") );
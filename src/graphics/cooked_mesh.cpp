@@ -0,0 +1,737 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/cooked_mesh.hpp"
+
+#include "graphics/CBatchingMesh.hpp"
+#include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <IMeshCache.h>
+#include <ISceneManager.h>
+#include <SMesh.h>
+#include <SMeshBuffer.h>
+
+#include <assert.h>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifndef WIN32
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace CookedMesh
+{
+namespace
+{
+    /** Identifies a cooked mesh file. */
+    const char MAGIC[8] = { 'S', 'T', 'K', 'M', 'E', 'S', 'H', 0 };
+
+    /** Must be increased whenever the file format changes. */
+    const uint32_t VERSION = 1;
+
+    // ------------------------------------------------------------------------
+    /** A read-only view of a whole file. On POSIX systems the file is
+     *  mapped into memory, otherwise it is read into a buffer. */
+    class MappedFile
+    {
+    private:
+        const char        *m_data;
+        size_t             m_size;
+#ifdef WIN32
+        std::vector<char>  m_buffer;
+#endif
+    public:
+        MappedFile(const std::string &file_name)
+        {
+            m_data = NULL;
+            m_size = 0;
+#ifdef WIN32
+            FILE *f = fopen(file_name.c_str(), "rb");
+            if (!f) return;
+            fseek(f, 0, SEEK_END);
+            long size = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            if (size > 0)
+            {
+                m_buffer.resize(size);
+                if (fread(m_buffer.data(), 1, size, f) == (size_t)size)
+                {
+                    m_data = m_buffer.data();
+                    m_size = size;
+                }
+            }
+            fclose(f);
+#else
+            int fd = open(file_name.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    m_data = (const char*)p;
+                    m_size = st.st_size;
+                }
+            }
+            // The mapping stays valid after closing the file
+            close(fd);
+#endif
+        }   // MappedFile
+        // --------------------------------------------------------------------
+        ~MappedFile()
+        {
+#ifndef WIN32
+            if (m_data)
+                munmap((void*)m_data, m_size);
+#endif
+        }   // ~MappedFile
+        // --------------------------------------------------------------------
+        const char *getData() const { return m_data; }
+        // --------------------------------------------------------------------
+        size_t      getSize() const { return m_size; }
+    };   // MappedFile
+
+    // ------------------------------------------------------------------------
+    /** Reads values from a cooked file, checking that the data does not
+     *  end prematurely. */
+    class Reader
+    {
+    private:
+        const char *m_data;
+        size_t      m_size;
+        size_t      m_pos;
+    public:
+        Reader(const char *data, size_t size)
+            : m_data(data), m_size(size), m_pos(0) {}
+        // --------------------------------------------------------------------
+        /** Returns a pointer to the next 'size' bytes, or NULL if the file
+         *  is too short. */
+        const char *getBytes(size_t size)
+        {
+            if (m_size - m_pos < size) return NULL;
+            const char *p = m_data + m_pos;
+            m_pos += size;
+            return p;
+        }   // getBytes
+        // --------------------------------------------------------------------
+        template<typename T> bool get(T *value)
+        {
+            const char *p = getBytes(sizeof(T));
+            if (!p) return false;
+            memcpy((void*)value, p, sizeof(T));
+            return true;
+        }   // get
+        // --------------------------------------------------------------------
+        bool get(std::string *s)
+        {
+            uint32_t length;
+            if (!get(&length)) return false;
+            const char *p = getBytes(length);
+            if (!p) return false;
+            s->assign(p, length);
+            return true;
+        }   // get(std::string)
+    };   // Reader
+
+    // ------------------------------------------------------------------------
+    template<typename T> void put(std::vector<char> *data, const T &value)
+    {
+        const char *p = (const char*)&value;
+        data->insert(data->end(), p, p + sizeof(T));
+    }   // put
+    // ------------------------------------------------------------------------
+    void put(std::vector<char> *data, const std::string &s)
+    {
+        put(data, (uint32_t)s.size());
+        data->insert(data->end(), s.begin(), s.end());
+    }   // put(std::string)
+    // ------------------------------------------------------------------------
+    void putBox(std::vector<char> *data, const core::aabbox3df &box)
+    {
+        put(data, box.MinEdge);
+        put(data, box.MaxEdge);
+    }   // putBox
+
+    // ------------------------------------------------------------------------
+    /** Stores a material. Textures are stored by the name they were loaded
+     *  with, so that they can be loaded the same way again. */
+    void putMaterial(std::vector<char> *data, const video::SMaterial &m)
+    {
+        put(data, (uint32_t)m.MaterialType);
+        put(data, m.MaterialTypeParam);
+        put(data, m.AmbientColor.color);
+        put(data, m.DiffuseColor.color);
+        put(data, m.EmissiveColor.color);
+        put(data, m.SpecularColor.color);
+        put(data, m.Shininess);
+        put(data, m.Thickness);
+        uint32_t flags = (m.Wireframe        ? 0x001 : 0)
+                       | (m.PointCloud       ? 0x002 : 0)
+                       | (m.GouraudShading   ? 0x004 : 0)
+                       | (m.Lighting         ? 0x008 : 0)
+                       | (m.ZWriteEnable     ? 0x010 : 0)
+                       | (m.BackfaceCulling  ? 0x020 : 0)
+                       | (m.FrontfaceCulling ? 0x040 : 0)
+                       | (m.FogEnable        ? 0x080 : 0)
+                       | (m.NormalizeNormals ? 0x100 : 0)
+                       | (m.UseMipMaps       ? 0x200 : 0);
+        put(data, flags);
+        put(data, (uint8_t)m.ZBuffer);
+        put(data, (uint8_t)m.AntiAliasing);
+        put(data, (uint8_t)m.ColorMask);
+        put(data, (uint8_t)m.ColorMaterial);
+        put(data, (uint8_t)m.BlendOperation);
+        put(data, (uint8_t)m.PolygonOffsetFactor);
+        put(data, (uint8_t)m.PolygonOffsetDirection);
+
+        for (unsigned int i = 0; i < video::MATERIAL_MAX_TEXTURES; i++)
+        {
+            const video::SMaterialLayer &layer = m.TextureLayer[i];
+            std::string name;
+            if (layer.Texture)
+            {
+                core::stringc path = layer.Texture->getName().getPath();
+                name = path.c_str();
+            }
+            put(data, name);
+            put(data, (uint8_t)layer.TextureWrapU);
+            put(data, (uint8_t)layer.TextureWrapV);
+            put(data, (uint8_t)layer.BilinearFilter);
+            put(data, (uint8_t)layer.TrilinearFilter);
+            put(data, (uint8_t)layer.AnisotropicFilter);
+            put(data, (int8_t)layer.LODBias);
+            put(data, layer.getTextureMatrix());
+        }
+    }   // putMaterial
+
+    // ------------------------------------------------------------------------
+    /** Reads a material written by putMaterial, and loads its textures the
+     *  same way the b3d loader does.
+     *  \return False if the data is invalid or a texture can't be loaded.
+     */
+    bool getMaterial(Reader *reader, video::SMaterial *m)
+    {
+        uint32_t material_type, flags;
+        uint8_t z_buffer, anti_aliasing, color_mask, color_material,
+                blend_operation, offset_factor, offset_direction;
+        if (!reader->get(&material_type)             ||
+            !reader->get(&m->MaterialTypeParam)      ||
+            !reader->get(&m->AmbientColor.color)     ||
+            !reader->get(&m->DiffuseColor.color)     ||
+            !reader->get(&m->EmissiveColor.color)    ||
+            !reader->get(&m->SpecularColor.color)    ||
+            !reader->get(&m->Shininess)              ||
+            !reader->get(&m->Thickness)              ||
+            !reader->get(&flags)                     ||
+            !reader->get(&z_buffer)                  ||
+            !reader->get(&anti_aliasing)             ||
+            !reader->get(&color_mask)                ||
+            !reader->get(&color_material)            ||
+            !reader->get(&blend_operation)           ||
+            !reader->get(&offset_factor)             ||
+            !reader->get(&offset_direction)             )
+            return false;
+
+        m->MaterialType           = (video::E_MATERIAL_TYPE)material_type;
+        m->Wireframe              = (flags & 0x001) != 0;
+        m->PointCloud             = (flags & 0x002) != 0;
+        m->GouraudShading         = (flags & 0x004) != 0;
+        m->Lighting               = (flags & 0x008) != 0;
+        m->ZWriteEnable           = (flags & 0x010) != 0;
+        m->BackfaceCulling        = (flags & 0x020) != 0;
+        m->FrontfaceCulling       = (flags & 0x040) != 0;
+        m->FogEnable              = (flags & 0x080) != 0;
+        m->NormalizeNormals       = (flags & 0x100) != 0;
+        m->UseMipMaps             = (flags & 0x200) != 0;
+        m->ZBuffer                = z_buffer;
+        m->AntiAliasing           = anti_aliasing;
+        m->ColorMask              = color_mask;
+        m->ColorMaterial          = color_material;
+        m->BlendOperation         = (video::E_BLEND_OPERATION)blend_operation;
+        m->PolygonOffsetFactor    = offset_factor;
+        m->PolygonOffsetDirection = (video::E_POLYGON_OFFSET)offset_direction;
+
+        for (unsigned int i = 0; i < video::MATERIAL_MAX_TEXTURES; i++)
+        {
+            video::SMaterialLayer &layer = m->TextureLayer[i];
+            std::string name;
+            uint8_t wrap_u, wrap_v, bilinear, trilinear, anisotropic;
+            int8_t lod_bias;
+            core::matrix4 matrix;
+            if (!reader->get(&name)        || !reader->get(&wrap_u)    ||
+                !reader->get(&wrap_v)      || !reader->get(&bilinear)  ||
+                !reader->get(&trilinear)   || !reader->get(&anisotropic) ||
+                !reader->get(&lod_bias)    || !reader->get(&matrix)       )
+                return false;
+            layer.TextureWrapU      = wrap_u;
+            layer.TextureWrapV      = wrap_v;
+            layer.BilinearFilter    = bilinear != 0;
+            layer.TrilinearFilter   = trilinear != 0;
+            layer.AnisotropicFilter = anisotropic;
+            layer.LODBias           = lod_bias;
+            if (matrix != core::IdentityMatrix)
+                layer.setTextureMatrix(matrix);
+            if (name.empty())
+                continue;
+
+            video::IVideoDriver *driver = irr_driver->getVideoDriver();
+            // Like the b3d loader, always load textures with 32 bit
+            const bool previous_32_bit =
+                driver->getTextureCreationFlag(video::ETCF_ALWAYS_32_BIT);
+            driver->setTextureCreationFlag(video::ETCF_ALWAYS_32_BIT, true);
+            layer.Texture = driver->getTexture(name.c_str());
+            driver->setTextureCreationFlag(video::ETCF_ALWAYS_32_BIT,
+                                           previous_32_bit);
+            if (!layer.Texture)
+            {
+                Log::warn("CookedMesh", "Texture '%s' not found.",
+                          name.c_str());
+                return false;
+            }
+        }
+        return true;
+    }   // getMaterial
+
+    // ------------------------------------------------------------------------
+    /** Creates a mesh buffer of the given type with a copy of the vertices
+     *  and indices. */
+    template<typename T>
+    scene::IMeshBuffer *createBuffer(const char *vertices,
+                                     unsigned int vertex_count,
+                                     const char *indices,
+                                     unsigned int index_count)
+    {
+        T *buffer = new T();
+        buffer->Vertices.set_used(vertex_count);
+        memcpy((void*)buffer->Vertices.pointer(), vertices,
+               vertex_count * sizeof(buffer->Vertices[0]));
+        buffer->Indices.set_used(index_count);
+        memcpy(buffer->Indices.pointer(), indices, index_count * sizeof(u16));
+        return buffer;
+    }   // createBuffer
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Computes a hash (64 bit FNV-1a) of the content of a file.
+ *  \param file_name The file to hash.
+ *  \param hash On return the hash value.
+ *  \param size On return the size of the file.
+ *  \return False if the file can not be read.
+ */
+bool hashFile(const std::string &file_name, uint64_t *hash, uint64_t *size)
+{
+    MappedFile file(file_name);
+    if (!file.getData()) return false;
+
+    const unsigned char *p = (const unsigned char*)file.getData();
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < file.getSize(); i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    *hash = h;
+    *size = file.getSize();
+    return true;
+}   // hashFile
+
+// ----------------------------------------------------------------------------
+/** Writes a mesh to a cooked file. The file is written under a temporary
+ *  name first, so that an interrupted write never leaves a broken file.
+ *  \param mesh The mesh to write (with 16 bit indices).
+ *  \param source_hash, source_size Hash and size of the source file.
+ *  \param file_name Name of the cooked file.
+ *  \return True if the file was written.
+ */
+bool write(scene::IMesh *mesh, uint64_t source_hash, uint64_t source_size,
+           const std::string &file_name)
+{
+    std::vector<char> data;
+    data.insert(data.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    put(&data, VERSION);
+    put(&data, (uint32_t)mesh->getMeshBufferCount());
+    put(&data, source_hash);
+    put(&data, source_size);
+    putBox(&data, mesh->getBoundingBox());
+
+    for (unsigned int i = 0; i < mesh->getMeshBufferCount(); i++)
+    {
+        scene::IMeshBuffer *mb = mesh->getMeshBuffer(i);
+        if (mb->getIndexType() != video::EIT_16BIT)
+        {
+            Log::warn("CookedMesh", "Can not cook meshes with 32 bit "
+                      "indices ('%s').", file_name.c_str());
+            return false;
+        }
+        const uint32_t pitch =
+            video::getVertexPitchFromType(mb->getVertexType());
+        put(&data, (uint32_t)mb->getVertexType());
+        put(&data, pitch);
+        put(&data, (uint32_t)mb->getVertexCount());
+        put(&data, (uint32_t)mb->getIndexCount());
+        putBox(&data, mb->getBoundingBox());
+        putMaterial(&data, mb->getMaterial());
+        const char *vertices = (const char*)mb->getVertices();
+        data.insert(data.end(), vertices,
+                    vertices + mb->getVertexCount() * pitch);
+        const char *indices = (const char*)mb->getIndices();
+        data.insert(data.end(), indices,
+                    indices + mb->getIndexCount() * sizeof(u16));
+    }
+
+    std::string temp_name = file_name + ".tmp";
+    FILE *f = fopen(temp_name.c_str(), "wb");
+    if (!f)
+    {
+        Log::warn("CookedMesh", "Can not write '%s'.", temp_name.c_str());
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    // On windows rename fails if the destination exists.
+    remove(file_name.c_str());
+    if (!ok || rename(temp_name.c_str(), file_name.c_str()) != 0)
+    {
+        Log::warn("CookedMesh", "Can not write '%s'.", file_name.c_str());
+        remove(temp_name.c_str());
+        return false;
+    }
+    return true;
+}   // write
+
+// ----------------------------------------------------------------------------
+/** Reads a cooked mesh file.
+ *  \param file_name Name of the cooked file.
+ *  \param source_hash, source_size Hash and size of the source file, if
+ *         they don't match the values stored in the cooked file, the
+ *         cooked file is outdated and not used.
+ *  \return The mesh (which must be dropped by the caller), or NULL if the
+ *          file is invalid or outdated.
+ */
+scene::IMesh *read(const std::string &file_name, uint64_t source_hash,
+                   uint64_t source_size)
+{
+    MappedFile file(file_name);
+    if (!file.getData()) return NULL;
+
+    Reader reader(file.getData(), file.getSize());
+    const char *magic = reader.getBytes(sizeof(MAGIC));
+    uint32_t version, num_buffers;
+    uint64_t hash, size;
+    core::aabbox3df box;
+    if (!magic || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !reader.get(&version) || version != VERSION        ||
+        !reader.get(&num_buffers)                          ||
+        !reader.get(&hash) || hash != source_hash          ||
+        !reader.get(&size) || size != source_size          ||
+        !reader.get(&box)                                     )
+        return NULL;
+
+    scene::SMesh *mesh = new scene::SMesh();
+    mesh->BoundingBox = box;
+    for (unsigned int i = 0; i < num_buffers; i++)
+    {
+        uint32_t vertex_type, pitch, vertex_count, index_count;
+        core::aabbox3df buffer_box;
+        video::SMaterial material;
+        const char *vertices = NULL, *indices = NULL;
+        bool ok = reader.get(&vertex_type)  && reader.get(&pitch)       &&
+                  reader.get(&vertex_count) && reader.get(&index_count) &&
+                  reader.get(&buffer_box)   &&
+                  vertex_type <= video::EVT_TANGENTS                    &&
+                  pitch == video::getVertexPitchFromType(
+                                  (video::E_VERTEX_TYPE)vertex_type)    &&
+                  getMaterial(&reader, &material);
+        if (ok)
+        {
+            vertices = reader.getBytes((size_t)vertex_count * pitch);
+            indices  = reader.getBytes((size_t)index_count * sizeof(u16));
+        }
+        if (!vertices || !indices)
+        {
+            Log::warn("CookedMesh", "Invalid cooked mesh '%s'.",
+                      file_name.c_str());
+            mesh->drop();
+            return NULL;
+        }
+
+        scene::IMeshBuffer *mb;
+        switch (vertex_type)
+        {
+        case video::EVT_STANDARD:
+            mb = createBuffer<scene::SMeshBuffer>(vertices, vertex_count,
+                                                  indices, index_count);
+            break;
+        case video::EVT_2TCOORDS:
+            mb = createBuffer<scene::SMeshBufferLightMap>(vertices,
+                                                          vertex_count,
+                                                          indices,
+                                                          index_count);
+            break;
+        default:
+            mb = createBuffer<scene::SMeshBufferTangents>(vertices,
+                                                          vertex_count,
+                                                          indices,
+                                                          index_count);
+            break;
+        }   // switch vertex_type
+        mb->getMaterial() = material;
+        mb->setBoundingBox(buffer_box);
+        mesh->addMeshBuffer(mb);
+        mb->drop();
+    }   // for i < num_buffers
+    return mesh;
+}   // read
+
+// ----------------------------------------------------------------------------
+/** Loads the cooked version of a mesh file if it exists and is up to date.
+ *  \param source_file Full path of the b3d file.
+ *  \return The mesh (which must be dropped by the caller), or NULL.
+ */
+scene::IMesh *load(const std::string &source_file)
+{
+    if (StringUtils::getExtension(source_file) != "b3d")
+        return NULL;
+    std::string cooked_file = file_manager->getMeshCacheLocation(source_file);
+    if (!file_manager->fileExists(cooked_file))
+        return NULL;
+
+    uint64_t hash, size;
+    if (!hashFile(source_file, &hash, &size))
+        return NULL;
+    return read(cooked_file, hash, size);
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Loads a b3d file, combines all its mesh buffers with the same material
+ *  and writes the result to the cooked file of this mesh.
+ *  \param source_file Full path of the b3d file.
+ *  \return The combined mesh (which must be dropped by the caller), or
+ *          NULL if the mesh can not be cooked.
+ */
+scene::IMesh *cook(const std::string &source_file)
+{
+    if (StringUtils::getExtension(source_file) != "b3d")
+        return NULL;
+
+    // If the mesh is already in irrlicht's cache its material flags were
+    // already modified, so it can not be used.
+    scene::ISceneManager *sm = irr_driver->getSceneManager();
+    if (sm->getMeshCache()->isMeshLoaded(source_file.c_str()))
+        return NULL;
+
+    uint64_t hash, size;
+    if (!hashFile(source_file, &hash, &size))
+        return NULL;
+
+    scene::IAnimatedMesh *am = sm->getMesh(source_file.c_str());
+    if (!am)
+        return NULL;
+
+    scene::CBatchingMesh *mesh = new scene::CBatchingMesh();
+    mesh->addMesh(am->getMesh(0));
+    mesh->finalize();
+    // The batching mesh keeps a reference to the original mesh buffers
+    // it needs, and the mesh without material flags must not stay in
+    // irrlicht's cache.
+    irr_driver->removeMeshFromCache(am);
+
+    write(mesh, hash, size, file_manager->getMeshCacheLocation(source_file));
+    return mesh;
+}   // cook
+
+// ----------------------------------------------------------------------------
+/** Returns a mesh from its cooked file, or loads and cooks the mesh if
+ *  there is no up to date cooked file. The material flags are set the same
+ *  way IrrDriver::getMesh does.
+ *  \param source_file Full path of the b3d file.
+ *  \param was_cooked On return true if the cooked file was used.
+ *  \return The mesh (which must be dropped by the caller), or NULL if the
+ *          mesh can't be cooked (in which case it must be loaded with
+ *          IrrDriver::getMesh).
+ */
+scene::IMesh *getMesh(const std::string &source_file, bool *was_cooked)
+{
+    scene::IMesh *mesh = load(source_file);
+    *was_cooked = mesh != NULL;
+    if (!mesh)
+        mesh = cook(source_file);
+    if (mesh)
+        irr_driver->setAllMaterialFlags(mesh);
+    return mesh;
+}   // getMesh
+
+// ----------------------------------------------------------------------------
+/** Cooks all b3d files in a directory and (recursively) in all its
+ *  subdirectories, and prints the time needed to load each mesh from the
+ *  b3d file and from the cooked file. The directory is added to the
+ *  texture search path, like a track directory when loading a track.
+ *  \param dir The directory.
+ */
+void cookDirectory(const std::string &dir)
+{
+    std::set<std::string> files;
+    file_manager->listFiles(files, dir, /*make_full_path*/true);
+
+    file_manager->pushTextureSearchPath(dir + "/");
+    file_manager->pushModelSearchPath(dir + "/");
+    for (std::set<std::string>::iterator i = files.begin();
+         i != files.end(); i++)
+    {
+        std::string base = StringUtils::getBasename(*i);
+        if (base == "." || base == "..")
+            continue;
+        if (file_manager->isDirectory(*i))
+        {
+            cookDirectory(*i);
+            continue;
+        }
+        if (StringUtils::getExtension(*i) != "b3d")
+            continue;
+
+        double start = StkTime::getRealTime();
+        scene::IMesh *mesh = cook(*i);
+        double cooked = StkTime::getRealTime();
+        if (!mesh)
+        {
+            Log::warn("CookedMesh", "Could not cook '%s'.", i->c_str());
+            continue;
+        }
+        mesh->drop();
+        mesh = load(*i);
+        double loaded = StkTime::getRealTime();
+        if (!mesh)
+        {
+            Log::warn("CookedMesh", "Could not load cooked '%s'.",
+                      i->c_str());
+            continue;
+        }
+        mesh->drop();
+        Log::info("CookedMesh", "%s: loading from b3d and cooking "
+                  "%.1f ms, loading cooked mesh %.1f ms.", i->c_str(),
+                  (cooked - start)*1000.0, (loaded - cooked)*1000.0);
+    }
+    file_manager->popModelSearchPath();
+    file_manager->popTextureSearchPath();
+}   // cookDirectory
+
+// ----------------------------------------------------------------------------
+/** Writes a mesh with different vertex types and materials to a cooked
+ *  file and checks that it is read back unchanged, that an outdated
+ *  cooked file is not used, and that the cooked files of meshes in
+ *  different directories don't collide. Removes all files it created.
+ */
+void unitTesting()
+{
+    scene::SMesh *mesh = new scene::SMesh();
+
+    scene::SMeshBuffer *standard = new scene::SMeshBuffer();
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        standard->Vertices.push_back(
+            video::S3DVertex(core::vector3df((float)i, 2.0f*i, -1.0f),
+                             core::vector3df(0, 1, 0),
+                             video::SColor(255, 10*i, 20, 30),
+                             core::vector2df(0.25f*i, 1.0f)));
+    }
+    const u16 indices[6] = { 0, 1, 2, 2, 1, 3 };
+    for (unsigned int i = 0; i < 6; i++)
+        standard->Indices.push_back(indices[i]);
+    standard->Material.MaterialType    = video::EMT_TRANSPARENT_VERTEX_ALPHA;
+    standard->Material.ZWriteEnable    = false;
+    standard->Material.BackfaceCulling = false;
+    standard->Material.DiffuseColor    = video::SColor(128, 1, 2, 3);
+    standard->Material.Shininess       = 12.5f;
+    standard->Material.TextureLayer[0].TextureWrapU = video::ETC_CLAMP;
+    standard->recalculateBoundingBox();
+    mesh->addMeshBuffer(standard);
+    standard->drop();
+
+    scene::SMeshBufferLightMap *light_map = new scene::SMeshBufferLightMap();
+    for (unsigned int i = 0; i < 3; i++)
+    {
+        light_map->Vertices.push_back(
+            video::S3DVertex2TCoords(core::vector3df(5.0f, (float)i, 7.0f),
+                                     video::SColor(255, 255, 255, 255),
+                                     core::vector2df(0, 0.5f*i),
+                                     core::vector2df(0.5f*i, 0)));
+        light_map->Indices.push_back(i);
+    }
+    light_map->Material.MaterialType = video::EMT_LIGHTMAP;
+    light_map->Material.Lighting     = false;
+    light_map->recalculateBoundingBox();
+    mesh->addMeshBuffer(light_map);
+    light_map->drop();
+    mesh->recalculateBoundingBox();
+
+    std::string file_name =
+        file_manager->getMeshCacheLocation("unit-test/unit_test.b3d");
+    bool written = write(mesh, /*hash*/1234, /*size*/5678, file_name);
+    assert(written);
+
+    scene::IMesh *loaded = read(file_name, 1234, 5678);
+    assert(loaded);
+    assert(loaded->getMeshBufferCount() == mesh->getMeshBufferCount());
+    assert(loaded->getBoundingBox() == mesh->getBoundingBox());
+    for (unsigned int i = 0; i < mesh->getMeshBufferCount(); i++)
+    {
+        scene::IMeshBuffer *mb     = mesh->getMeshBuffer(i);
+        scene::IMeshBuffer *mb_new = loaded->getMeshBuffer(i);
+        assert(mb_new->getVertexType()  == mb->getVertexType());
+        assert(mb_new->getVertexCount() == mb->getVertexCount());
+        assert(mb_new->getIndexCount()  == mb->getIndexCount());
+        assert(mb_new->getBoundingBox() == mb->getBoundingBox());
+        assert(mb_new->getMaterial()    == mb->getMaterial());
+        assert(memcmp(mb_new->getVertices(), mb->getVertices(),
+                      mb->getVertexCount() *
+                      video::getVertexPitchFromType(mb->getVertexType()))==0);
+        assert(memcmp(mb_new->getIndices(), mb->getIndices(),
+                      mb->getIndexCount() * sizeof(u16)) == 0);
+    }
+    loaded->drop();
+
+    // A changed source file must not use the cooked file
+    assert(read(file_name, 1235, 5678) == NULL);
+    assert(read(file_name, 1234, 5679) == NULL);
+
+    // Meshes in different directories with the same name (e.g. two tracks
+    // in different addon directories) have different cooked files
+    std::string other_name =
+        file_manager->getMeshCacheLocation("other/unit-test/unit_test.b3d");
+    assert(other_name != file_name);
+    assert(file_manager->getMeshCacheLocation("unit-test/unit_test.b3d") ==
+           file_name);
+
+    file_manager->removeFile(file_name);
+    file_manager->removeDirectory(StringUtils::getPath(file_name));
+    file_manager->removeDirectory(StringUtils::getPath(other_name));
+    mesh->drop();
+}   // unitTesting
+
+}   // namespace CookedMesh
@@ -0,0 +1,62 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_COOKED_MESH_HPP
+#define HEADER_COOKED_MESH_HPP
+
+#include "utils/types.hpp"
+
+#include <string>
+
+namespace irr
+{
+    namespace scene { class IMesh; }
+}
+using namespace irr;
+
+/**
+  * \brief A cache for meshes that have been loaded and batched.
+  *  Loading a big b3d file and combining its mesh buffers with the same
+  *  material (see CBatchingMesh) takes the same time on every load. A
+  *  cooked mesh stores the resulting vertex and index buffers, bounding
+  *  boxes and materials (with the names of their textures) in a binary
+  *  file. When loaded, the buffers are copied from the file into new mesh
+  *  buffers without any parsing or batching. The cooked file contains a
+  *  hash of the source file, so that it is rebuilt when the source file
+  *  changes.
+  *  The materials are stored as read from the b3d file, i.e. before the
+  *  material flags of STK are applied, since those depend on the current
+  *  settings (and e.g. on the track being driven in reverse).
+  * \ingroup graphics
+  */
+namespace CookedMesh
+{
+    scene::IMesh *load(const std::string &source_file);
+    scene::IMesh *cook(const std::string &source_file);
+    scene::IMesh *getMesh(const std::string &source_file, bool *was_cooked);
+    void          cookDirectory(const std::string &dir);
+    bool          write(scene::IMesh *mesh, uint64_t source_hash,
+                        uint64_t source_size, const std::string &file_name);
+    scene::IMesh *read(const std::string &file_name, uint64_t source_hash,
+                       uint64_t source_size);
+    bool          hashFile(const std::string &file_name, uint64_t *hash,
+                           uint64_t *size);
+    void          unitTesting();
+}   // namespace CookedMesh
+
+#endif
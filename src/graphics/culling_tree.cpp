@@ -0,0 +1,552 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/culling_tree.hpp"
+
+#include "graphics/stk_animated_mesh.hpp"
+#include "graphics/stk_mesh.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <ISceneNode.h>
+#include <SViewFrustum.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  include <xmmintrin.h>
+#  define CULLING_TREE_SSE
+#endif
+
+namespace
+{
+    /** Maximum number of entries in a leaf of the tree. */
+    const unsigned int MAX_LEAF_SIZE = 4;
+
+    // ------------------------------------------------------------------------
+    /** Compares two boxes exactly (aabbox3d::operator== has a tolerance). */
+    bool isSameBox(const core::aabbox3df &a, const core::aabbox3df &b)
+    {
+        return a.MinEdge.X == b.MinEdge.X && a.MinEdge.Y == b.MinEdge.Y &&
+               a.MinEdge.Z == b.MinEdge.Z && a.MaxEdge.X == b.MaxEdge.X &&
+               a.MaxEdge.Y == b.MaxEdge.Y && a.MaxEdge.Z == b.MaxEdge.Z;
+    }   // isSameBox
+
+    // ------------------------------------------------------------------------
+    /** Helper to sort entries along one axis of the centre of their boxes. */
+    struct CompareCenter
+    {
+        unsigned int m_axis;
+        CompareCenter(unsigned int axis) : m_axis(axis) {}
+        template<typename T> bool operator()(const T &a, const T &b) const
+        {
+            return a.m_corners[m_axis][0] + a.m_corners[m_axis][7]
+                 < b.m_corners[m_axis][0] + b.m_corners[m_axis][7];
+        }
+    };   // CompareCenter
+}   // namespace
+
+// ----------------------------------------------------------------------------
+CullingTree::CullingTree()
+{
+    m_num_frusta = 0;
+}   // CullingTree
+
+// ----------------------------------------------------------------------------
+/** Sets the static nodes of the scene. The tree is built from these nodes
+ *  and all their children that are STK meshes the next time update() is
+ *  called (so that the nodes can be modified till then). The vector can
+ *  be empty, e.g. when a track is unloaded, to remove all nodes.
+ *  \param nodes The static nodes.
+ */
+void CullingTree::setNodes(const std::vector<scene::ISceneNode*> &nodes)
+{
+    clear();
+    m_pending_nodes = nodes;
+}   // setNodes
+
+// ----------------------------------------------------------------------------
+/** Removes all boxes from the tree. */
+void CullingTree::clear()
+{
+    m_entries.clear();
+    m_tree.clear();
+    m_index.clear();
+    m_cull_mask.clear();
+    m_pending_nodes.clear();
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** Adds the box of a node to the list of boxes. The tree must be rebuilt
+ *  with buildTree() afterwards.
+ *  \param key Used to identify the box in getCullMask().
+ *  \param transform Absolute transformation of the box.
+ *  \param box The box in local coordinates.
+ */
+void CullingTree::addBox(const void *key, const core::matrix4 &transform,
+                         const core::aabbox3df &box)
+{
+    Entry entry;
+    entry.m_key       = key;
+    entry.m_transform = transform;
+    entry.m_box       = box;
+    // Transform the corners the same way it is done for dynamic nodes, so
+    // that the precise test gives exactly the same result.
+    core::vector3df edges[8];
+    box.getEdges(edges);
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        transform.transformVect(edges[i]);
+        entry.m_corners[0][i] = edges[i].X;
+        entry.m_corners[1][i] = edges[i].Y;
+        entry.m_corners[2][i] = edges[i].Z;
+    }
+    m_entries.push_back(entry);
+}   // addBox
+
+// ----------------------------------------------------------------------------
+/** Adds a node and all its children that are static STK meshes.
+ *  \param node The node to add.
+ */
+void CullingTree::addNode(scene::ISceneNode *node)
+{
+    node->updateAbsolutePosition();
+    // Nodes without automatic culling are never culled, so they are not
+    // added to the tree
+    if (dynamic_cast<STKMeshCommon*>(node) &&
+        !dynamic_cast<STKAnimatedMesh*>(node) &&
+        node->getAutomaticCulling() != scene::EAC_OFF)
+    {
+        addBox(node, node->getAbsoluteTransformation(),
+               node->getBoundingBox());
+    }
+
+    const core::list<scene::ISceneNode*> &children = node->getChildren();
+    core::list<scene::ISceneNode*>::ConstIterator i = children.begin();
+    for (; i != children.end(); i++)
+        addNode(*i);
+}   // addNode
+
+// ----------------------------------------------------------------------------
+/** Builds the tree over all boxes added with addBox(). */
+void CullingTree::buildTree()
+{
+    m_tree.clear();
+    m_index.clear();
+    if (m_entries.empty())
+        return;
+    m_tree.reserve(2 * m_entries.size() / MAX_LEAF_SIZE + 1);
+    buildNode(0, (unsigned int)m_entries.size());
+    for (unsigned int i = 0; i < m_entries.size(); i++)
+        m_index[m_entries[i].m_key] = i;
+    m_cull_mask.resize(m_entries.size(), 0);
+}   // buildTree
+
+// ----------------------------------------------------------------------------
+/** Creates a tree node for the given entries, splitting them at the median
+ *  of the longest axis till only a few entries are left.
+ *  \param first Index of the first entry.
+ *  \param count Number of entries.
+ *  \return Index of the new tree node.
+ */
+int CullingTree::buildNode(unsigned int first, unsigned int count)
+{
+    TreeNode node;
+    node.m_first = first;
+    node.m_count = count;
+    node.m_left  = -1;
+    node.m_right = -1;
+    const Entry &e = m_entries[first];
+    node.m_box.reset(e.m_corners[0][0], e.m_corners[1][0], e.m_corners[2][0]);
+    for (unsigned int i = first; i < first + count; i++)
+    {
+        for (unsigned int j = 0; j < 8; j++)
+        {
+            node.m_box.addInternalPoint(m_entries[i].m_corners[0][j],
+                                        m_entries[i].m_corners[1][j],
+                                        m_entries[i].m_corners[2][j]);
+        }
+    }
+
+    int index = (int)m_tree.size();
+    m_tree.push_back(node);
+    if (count <= MAX_LEAF_SIZE)
+        return index;
+
+    core::vector3df extent = node.m_box.getExtent();
+    unsigned int axis = extent.X > extent.Y ? 0 : 1;
+    if (extent.Z > (axis == 0 ? extent.X : extent.Y))
+        axis = 2;
+    unsigned int half = count / 2;
+    std::nth_element(m_entries.begin() + first,
+                     m_entries.begin() + first + half,
+                     m_entries.begin() + first + count,
+                     CompareCenter(axis));
+
+    // m_tree can be reallocated by the recursive calls
+    int left  = buildNode(first, half);
+    int right = buildNode(first + half, count - half);
+    m_tree[index].m_left  = left;
+    m_tree[index].m_right = right;
+    m_tree[index].m_count = 0;
+    return index;
+}   // buildNode
+
+// ----------------------------------------------------------------------------
+/** Sets the frusta to test against. The bit i of all culling masks refers
+ *  to frusta[i].
+ *  \param frusta The frusta.
+ *  \param count Number of frusta, at most MAX_FRUSTA.
+ */
+void CullingTree::setFrusta(const scene::SViewFrustum * const *frusta,
+                            unsigned int count)
+{
+    assert(count <= MAX_FRUSTA);
+    m_num_frusta = count;
+    for (unsigned int f = 0; f < count; f++)
+    {
+        for (unsigned int p = 0; p < scene::SViewFrustum::VF_PLANE_COUNT; p++)
+        {
+            const core::plane3df &plane = frusta[f]->planes[p];
+            float *dest = m_planes[f * 6 + p];
+            dest[0] = plane.Normal.X;
+            dest[1] = plane.Normal.Y;
+            dest[2] = plane.Normal.Z;
+            dest[3] = plane.D;
+        }
+    }
+}   // setFrusta
+
+// ----------------------------------------------------------------------------
+/** Builds the tree if new nodes were set, and computes for each box which
+ *  of the current frusta it is culled for.
+ */
+void CullingTree::update()
+{
+    if (!m_pending_nodes.empty())
+    {
+        std::vector<scene::ISceneNode*> nodes;
+        nodes.swap(m_pending_nodes);
+        for (unsigned int i = 0; i < nodes.size(); i++)
+            addNode(nodes[i]);
+        buildTree();
+        Log::debug("CullingTree", "Added %u static nodes.",
+                   (unsigned int)m_entries.size());
+    }
+    if (m_tree.empty() || m_num_frusta == 0)
+        return;
+    traverse(0, (1 << m_num_frusta) - 1, 0);
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Decides for a subtree which frusta it is completely inside or outside
+ *  of, and tests the entries of leaves against the remaining frusta.
+ *  \param index Index of the tree node.
+ *  \param undecided The frusta that the subtree still has to be tested
+ *         against.
+ *  \param culled The frusta that the whole subtree is culled for.
+ */
+void CullingTree::traverse(int index, unsigned int undecided,
+                           unsigned int culled)
+{
+    const TreeNode &node = m_tree[index];
+    const core::vector3df center = node.m_box.getCenter();
+    const core::vector3df extent = node.m_box.getExtent() * 0.5f;
+
+    for (unsigned int f = 0; f < m_num_frusta; f++)
+    {
+        if (!(undecided & (1 << f)))
+            continue;
+        bool inside = true;
+        for (unsigned int p = 0; p < 6; p++)
+        {
+            const float *plane = m_planes[f * 6 + p];
+            float d = plane[0]*center.X + plane[1]*center.Y
+                    + plane[2]*center.Z + plane[3];
+            float r = fabsf(plane[0])*extent.X + fabsf(plane[1])*extent.Y
+                    + fabsf(plane[2])*extent.Z;
+            // The precise test uses the corners of each node, which are
+            // inside of this box. Boxes that are not clearly inside or
+            // outside are left to the precise test to avoid any difference
+            // caused by rounding.
+            float margin = 1e-4f * (fabsf(d) + fabsf(plane[3]) + r) + 1e-3f;
+            if (d - r > margin)
+            {
+                // All corners in front of the plane: culled
+                culled    |=  (1 << f);
+                undecided &= ~(1 << f);
+                inside     = false;
+                break;
+            }
+            if (d + r > -margin)
+                inside = false;
+        }
+        if (inside)
+            undecided &= ~(1 << f);
+    }
+
+    if (node.m_left < 0)
+    {
+        for (unsigned int i = node.m_first; i < node.m_first+node.m_count; i++)
+        {
+            m_cull_mask[i] = culled;
+            if (undecided)
+                m_cull_mask[i] |= cullCorners(m_entries[i].m_corners,
+                                              undecided);
+        }
+        return;
+    }
+    traverse(node.m_left,  undecided, culled);
+    traverse(node.m_right, undecided, culled);
+}   // traverse
+
+// ----------------------------------------------------------------------------
+/** Tests the corners of a box against some of the frusta. A box is culled
+ *  for a frustum if all its corners are in front of one of its planes,
+ *  the same as the test irrlicht's plane3d::classifyPointRelation does.
+ *  \param corners The x, y and z values of the 8 corners.
+ *  \param frusta Bit mask of the frusta to test.
+ *  \return Bit mask of the frusta the box is culled for.
+ */
+unsigned int CullingTree::cullCorners(const float corners[3][8],
+                                      unsigned int frusta) const
+{
+    unsigned int culled = 0;
+#ifdef CULLING_TREE_SSE
+    const __m128 x0 = _mm_loadu_ps(corners[0]);
+    const __m128 x1 = _mm_loadu_ps(corners[0] + 4);
+    const __m128 y0 = _mm_loadu_ps(corners[1]);
+    const __m128 y1 = _mm_loadu_ps(corners[1] + 4);
+    const __m128 z0 = _mm_loadu_ps(corners[2]);
+    const __m128 z1 = _mm_loadu_ps(corners[2] + 4);
+    const __m128 eps = _mm_set1_ps(core::ROUNDING_ERROR_f32);
+#endif
+    for (unsigned int f = 0; f < m_num_frusta; f++)
+    {
+        if (!(frusta & (1 << f)))
+            continue;
+        for (unsigned int p = 0; p < 6; p++)
+        {
+            const float *plane = m_planes[f * 6 + p];
+#ifdef CULLING_TREE_SSE
+            // Same order of operations as in vector3d::dotProduct
+            const __m128 nx = _mm_set1_ps(plane[0]);
+            const __m128 ny = _mm_set1_ps(plane[1]);
+            const __m128 nz = _mm_set1_ps(plane[2]);
+            const __m128 d  = _mm_set1_ps(plane[3]);
+            __m128 d0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x0),
+                                   _mm_mul_ps(ny, y0)), _mm_mul_ps(nz, z0)), d);
+            __m128 d1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x1),
+                                   _mm_mul_ps(ny, y1)), _mm_mul_ps(nz, z1)), d);
+            bool in_front =
+                (_mm_movemask_ps(_mm_cmpgt_ps(d0, eps)) &
+                 _mm_movemask_ps(_mm_cmpgt_ps(d1, eps))) == 0xf;
+#else
+            bool in_front = true;
+            for (unsigned int i = 0; i < 8 && in_front; i++)
+            {
+                float d = plane[0]*corners[0][i] + plane[1]*corners[1][i]
+                        + plane[2]*corners[2][i] + plane[3];
+                in_front = d > core::ROUNDING_ERROR_f32;
+            }
+#endif
+            if (in_front)
+            {
+                culled |= 1 << f;
+                break;
+            }
+        }
+    }
+    return culled;
+}   // cullCorners
+
+// ----------------------------------------------------------------------------
+/** Returns the frusta a static box is culled for. If the node has moved
+ *  since the tree was built, or was not added to the tree, false is
+ *  returned and the caller must use cullEdges().
+ *  \param key The key used in addBox.
+ *  \param transform Current absolute transformation of the node.
+ *  \param box Current bounding box of the node.
+ *  \param mask On return the bit mask of frusta the box is culled for.
+ */
+bool CullingTree::getCullMask(const void *key, const core::matrix4 &transform,
+                              const core::aabbox3df &box,
+                              unsigned int *mask) const
+{
+    std::unordered_map<const void*, unsigned int>::const_iterator i =
+        m_index.find(key);
+    if (i == m_index.end())
+        return false;
+    const Entry &entry = m_entries[i->second];
+    if (memcmp(entry.m_transform.pointer(), transform.pointer(),
+               16 * sizeof(float)) != 0 || !isSameBox(entry.m_box, box))
+        return false;
+    *mask = m_cull_mask[i->second];
+    return true;
+}   // getCullMask
+
+// ----------------------------------------------------------------------------
+/** Tests the transformed corners of a dynamic box against all frusta.
+ *  \param edges The corners in world space.
+ *  \return Bit mask of the frusta the box is culled for.
+ */
+unsigned int CullingTree::cullEdges(const core::vector3df edges[8]) const
+{
+    float corners[3][8];
+    for (unsigned int i = 0; i < 8; i++)
+    {
+        corners[0][i] = edges[i].X;
+        corners[1][i] = edges[i].Y;
+        corners[2][i] = edges[i].Z;
+    }
+    return cullCorners(corners, (1 << m_num_frusta) - 1);
+}   // cullEdges
+
+// ============================================================================
+/** Compares the culling results of the tree with testing each box against
+ *  each plane using irrlicht's functions, for random boxes and frusta
+ *  similar to the ones used in a race. Only uses the CPU.
+ */
+void CullingTree::unitTesting()
+{
+    srand(1234);
+    const unsigned int num_boxes = 4000;
+    std::vector<core::matrix4> transforms(num_boxes);
+    std::vector<core::aabbox3df> boxes(num_boxes);
+    for (unsigned int i = 0; i < num_boxes; i++)
+    {
+        core::vector3df pos(rand() % 2000 - 1000.0f, rand() % 100 - 50.0f,
+                            rand() % 2000 - 1000.0f);
+        transforms[i].setRotationDegrees(
+            core::vector3df(0, (float)(rand() % 360), (float)(rand() % 30)));
+        transforms[i].setTranslation(pos);
+        core::vector3df size((rand() % 200 + 1) * 0.1f,
+                             (rand() % 100 + 1) * 0.1f,
+                             (rand() % 200 + 1) * 0.1f);
+        boxes[i] = core::aabbox3df(-size, size);
+    }
+
+    CullingTree tree;
+    for (unsigned int i = 0; i < num_boxes; i++)
+        tree.addBox(&boxes[i], transforms[i], boxes[i]);
+    tree.buildTree();
+    assert(tree.getNumBoxes() == num_boxes);
+
+    double tree_time = 0, precise_time = 0;
+    for (unsigned int frame = 0; frame < 20; frame++)
+    {
+        // A perspective camera, four orthographic shadow cascades around
+        // it, and an orthographic RSM camera covering everything.
+        core::vector3df eye(rand() % 1600 - 800.0f, 20.0f,
+                            rand() % 1600 - 800.0f);
+        core::vector3df target = eye + core::vector3df(rand() % 200 - 100.0f,
+                                                       -5.0f,
+                                                       rand() % 200 - 100.0f);
+        core::matrix4 view, projection;
+        view.buildCameraLookAtMatrixLH(eye, target, core::vector3df(0, 1, 0));
+        projection.buildProjectionMatrixPerspectiveFovLH(1.0f, 1.6f, 1.0f,
+                                                         300.0f);
+        scene::SViewFrustum frusta[6];
+        frusta[0].setFrom(projection * view);
+        core::vector3df sun_dir(0.3f, -1.0f, 0.2f);
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            float size = 10.0f * (float)(1 << (2 * i));
+            core::matrix4 sun_view, sun_projection;
+            sun_view.buildCameraLookAtMatrixLH(eye - sun_dir * 200.0f, eye,
+                                               core::vector3df(0, 0, 1));
+            sun_projection.buildProjectionMatrixOrthoLH(size, size, 1.0f,
+                                                        400.0f);
+            frusta[i + 1].setFrom(sun_projection * sun_view);
+        }
+        core::matrix4 rsm_view, rsm_projection;
+        rsm_view.buildCameraLookAtMatrixLH(core::vector3df(0, 500, 0),
+                                           core::vector3df(0, 0, 0),
+                                           core::vector3df(0, 0, 1));
+        rsm_projection.buildProjectionMatrixOrthoLH(1500, 1500, 1, 1000);
+        frusta[5].setFrom(rsm_projection * rsm_view);
+
+        const scene::SViewFrustum *frusta_ptr[6];
+        for (unsigned int i = 0; i < 6; i++)
+            frusta_ptr[i] = &frusta[i];
+        tree.setFrusta(frusta_ptr, 6);
+        double start = StkTime::getRealTime();
+        tree.update();
+        tree_time += StkTime::getRealTime() - start;
+
+        // The test used in the scene manager before
+        std::vector<unsigned int> expected(num_boxes, 0);
+        start = StkTime::getRealTime();
+        for (unsigned int i = 0; i < num_boxes; i++)
+        {
+            core::vector3df edges[8];
+            boxes[i].getEdges(edges);
+            for (unsigned int j = 0; j < 8; j++)
+                transforms[i].transformVect(edges[j]);
+            for (unsigned int f = 0; f < 6; f++)
+            {
+                for (unsigned int p = 0; p < 6; p++)
+                {
+                    bool in_front = true;
+                    for (unsigned int j = 0; j < 8 && in_front; j++)
+                    {
+                        in_front = frusta[f].planes[p]
+                                 .classifyPointRelation(edges[j])
+                                 == core::ISREL3D_FRONT;
+                    }
+                    if (in_front)
+                    {
+                        expected[i] |= 1 << f;
+                        break;
+                    }
+                }
+            }
+        }
+        precise_time += StkTime::getRealTime() - start;
+
+        for (unsigned int i = 0; i < num_boxes; i++)
+        {
+            unsigned int mask = 0;
+            bool found = tree.getCullMask(&boxes[i], transforms[i], boxes[i],
+                                          &mask);
+            assert(found);
+            assert(mask == expected[i]);
+
+            core::vector3df edges[8];
+            boxes[i].getEdges(edges);
+            for (unsigned int j = 0; j < 8; j++)
+                transforms[i].transformVect(edges[j]);
+            assert(tree.cullEdges(edges) == expected[i]);
+        }
+    }
+
+    // A moved box is not taken from the tree
+    unsigned int mask;
+    core::matrix4 moved = transforms[0];
+    moved.setTranslation(moved.getTranslation() + core::vector3df(0, 1, 0));
+    assert(!tree.getCullMask(&boxes[0], moved, boxes[0], &mask));
+    assert(!tree.getCullMask(&moved, transforms[0], boxes[0], &mask));
+
+    Log::info("CullingTree", "%u boxes against 6 frusta: %f ms with the "
+              "tree, %f ms testing each box.", num_boxes,
+              tree_time * 1000.0 / 20, precise_time * 1000.0 / 20);
+}   // unitTesting
@@ -0,0 +1,123 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_CULLING_TREE_HPP
+#define HEADER_CULLING_TREE_HPP
+
+#include "utils/no_copy.hpp"
+
+#include <aabbox3d.h>
+#include <matrix4.h>
+#include <vector3d.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace irr
+{
+    namespace scene { class ISceneNode; struct SViewFrustum; }
+}
+using namespace irr;
+
+/**
+  * \brief Frustum culling of the static scene nodes of a track.
+  *  The transformed bounding boxes of all static nodes are stored in a
+  *  bounding volume hierarchy, which is traversed once per frame for all
+  *  frusta (camera, shadow cascades, RSM). Whole subtrees that are
+  *  completely inside or outside of a frustum are decided without looking
+  *  at the single nodes, all other nodes are tested with the same precise
+  *  test that is used for dynamic nodes (see cullEdges()). The result for
+  *  each node is exactly the same as testing each node on its own.
+  *  A node that has moved since the tree was built is detected in
+  *  getCullMask(), and must then be tested with cullEdges().
+  * \ingroup graphics
+  */
+class CullingTree : public NoCopy
+{
+public:
+    /** Maximum number of frusta that can be tested at the same time. */
+    static const unsigned int MAX_FRUSTA = 8;
+
+private:
+    /** A box of a static node, with its corners in world space. */
+    struct Entry
+    {
+        const void          *m_key;
+        core::matrix4        m_transform;
+        core::aabbox3df      m_box;
+        /** The 8 transformed corners, all x values first, then all y
+         *  and all z values. */
+        float                m_corners[3][8];
+    };   // Entry
+
+    /** A node of the tree. Leaves have no children, and contain the
+     *  entries m_first to m_first+m_count-1. */
+    struct TreeNode
+    {
+        core::aabbox3df m_box;
+        unsigned int    m_first;
+        unsigned int    m_count;
+        int             m_left;
+        int             m_right;
+    };   // TreeNode
+
+    std::vector<Entry>    m_entries;
+    std::vector<TreeNode> m_tree;
+
+    /** Index of the entry of each key. */
+    std::unordered_map<const void*, unsigned int> m_index;
+
+    /** The frusta each entry is culled for, computed in update(). */
+    std::vector<unsigned int> m_cull_mask;
+
+    /** Static nodes set with setNodes(), the tree is built from them when
+     *  update() is called next. */
+    std::vector<scene::ISceneNode*> m_pending_nodes;
+
+    /** The planes of all frusta: normal x, y, z and distance. */
+    float        m_planes[MAX_FRUSTA * 6][4];
+    unsigned int m_num_frusta;
+
+    int  buildNode(unsigned int first, unsigned int count);
+    void traverse(int index, unsigned int undecided, unsigned int culled);
+    unsigned int cullCorners(const float corners[3][8],
+                             unsigned int frusta) const;
+    void addNode(scene::ISceneNode *node);
+
+public:
+                 CullingTree();
+    void         setNodes(const std::vector<scene::ISceneNode*> &nodes);
+    void         clear();
+    void         addBox(const void *key, const core::matrix4 &transform,
+                        const core::aabbox3df &box);
+    void         buildTree();
+    void         setFrusta(const scene::SViewFrustum * const *frusta,
+                           unsigned int count);
+    void         update();
+    bool         getCullMask(const void *key, const core::matrix4 &transform,
+                             const core::aabbox3df &box,
+                             unsigned int *mask) const;
+    unsigned int cullEdges(const core::vector3df edges[8]) const;
+    static void  unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of boxes in the tree. */
+    unsigned int getNumBoxes() const { return (unsigned int)m_entries.size(); }
+};   // CullingTree
+
+#endif
@@ -0,0 +1,408 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/image_decoder.hpp"
+
+#include "config/hardware_stats.hpp"
+#include "config/user_config.hpp"
+#include "graphics/image_kernels.hpp"
+#include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+#include "utils/vs.hpp"
+
+#include <IImage.h>
+#include <IReadFile.h>
+#include <IVideoDriver.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+// ----------------------------------------------------------------------------
+ImageDecoder::ImageDecoder()
+{
+    m_state.lock();
+    m_state.getData().m_driver          = NULL;
+    m_state.getData().m_convert_to_argb = false;
+    m_state.getData().m_quit            = false;
+    m_state.unlock();
+    pthread_cond_init(&m_cond_request, NULL);
+    pthread_cond_init(&m_cond_ready,   NULL);
+    m_num_decoded = 0;
+}   // ImageDecoder
+
+// ----------------------------------------------------------------------------
+ImageDecoder::~ImageDecoder()
+{
+    stopThreads();
+    pthread_cond_destroy(&m_cond_request);
+    pthread_cond_destroy(&m_cond_ready);
+}   // ~ImageDecoder
+
+// ----------------------------------------------------------------------------
+/** Drops all decoded images and stops all worker threads, e.g. before the
+ *  process is forked (see LobbyPool). The threads are started again the
+ *  next time images are queued.
+ */
+void ImageDecoder::stopThreads()
+{
+    clear();
+    m_state.lock();
+    m_state.getData().m_quit = true;
+    pthread_cond_broadcast(&m_cond_request);
+    m_state.unlock();
+    for (unsigned int i = 0; i < m_threads.size(); i++)
+        pthread_join(m_threads[i], NULL);
+    m_threads.clear();
+    m_state.getData().m_quit = false;
+}   // stopThreads
+
+// ----------------------------------------------------------------------------
+/** Starts the worker threads.
+ *  \param num_threads Number of threads to start.
+ */
+void ImageDecoder::startThreads(unsigned int num_threads)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        pthread_t thread;
+        int error = pthread_create(&thread, &attr, &ImageDecoder::mainLoop,
+                                   this);
+        if (error)
+        {
+            Log::error("ImageDecoder", "Could not create thread, error=%d.",
+                       errno);
+            break;
+        }
+        m_threads.push_back(thread);
+    }
+    pthread_attr_destroy(&attr);
+}   // startThreads
+
+// ----------------------------------------------------------------------------
+/** Queues images to be decoded by the worker threads. Only PNG and JPG
+ *  files are handled, and files for which a texture already exists are
+ *  ignored. The threads are started the first time this is called. If
+ *  image decoding threads are disabled in the user config, this function
+ *  does nothing and all images are loaded on the main thread.
+ *  \param files Names of the image files.
+ */
+void ImageDecoder::queueImages(const std::vector<std::string> &files)
+{
+    if (m_threads.empty())
+    {
+        int num_threads = UserConfigParams::m_image_decode_threads;
+        if (num_threads < 0)
+            num_threads = HardwareStats::getNumProcessors() - 1;
+        if (num_threads <= 0)
+            return;
+        startThreads(num_threads);
+        if (m_threads.empty())
+            return;
+    }
+
+    video::IVideoDriver *driver = irr_driver->getVideoDriver();
+    io::IFileSystem *file_system = file_manager->getFileSystem();
+
+    m_state.lock();
+    DecoderState &state = m_state.getData();
+    state.m_driver = driver;
+    // The GPU textures use 32 bit colours, unless 16 bit textures are
+    // requested, see COpenGLTexture::getBestColorFormat
+    state.m_convert_to_argb =
+        !driver->getTextureCreationFlag(video::ETCF_ALWAYS_16_BIT)     &&
+        !driver->getTextureCreationFlag(video::ETCF_OPTIMIZED_FOR_SPEED) &&
+        !driver->getTextureCreationFlag(video::ETCF_NO_ALPHA_CHANNEL);
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        std::string ext = StringUtils::toLowerCase(
+                                        StringUtils::getExtension(files[i]));
+        if (ext != "png" && ext != "jpg" && ext != "jpeg")
+            continue;
+
+        // Use the same name as irrlicht's texture cache
+        std::string name = file_system->getAbsolutePath(files[i].c_str())
+                                                                    .c_str();
+        if (state.m_pending.find(name) != state.m_pending.end() ||
+            state.m_ready.find(name)   != state.m_ready.end()   ||
+            driver->findTexture(name.c_str()))
+            continue;
+        state.m_queue.push_back(name);
+        state.m_pending.insert(name);
+    }
+    pthread_cond_broadcast(&m_cond_request);
+    m_state.unlock();
+}   // queueImages
+
+// ----------------------------------------------------------------------------
+/** Returns the decoded image for a file that was queued before, or NULL if
+ *  the file was not queued or could not be decoded. If the image is still
+ *  being decoded, this function waits for it. If no thread has started
+ *  decoding it yet, it is decoded on the calling thread. The caller must
+ *  drop the image.
+ *  \param file_name Name of the image file.
+ */
+video::IImage *ImageDecoder::takeImage(const std::string &file_name)
+{
+    if (m_threads.empty()) return NULL;
+
+    std::string name = file_manager->getFileSystem()
+                     ->getAbsolutePath(file_name.c_str()).c_str();
+
+    m_state.lock();
+    DecoderState &state = m_state.getData();
+    video::IImage *image = NULL;
+    while (true)
+    {
+        std::map<std::string, video::IImage*>::iterator ready =
+            state.m_ready.find(name);
+        if (ready != state.m_ready.end())
+        {
+            image = ready->second;
+            state.m_ready.erase(ready);
+            break;
+        }
+        if (state.m_pending.find(name) == state.m_pending.end())
+            break;
+
+        std::deque<std::string>::iterator queued =
+            std::find(state.m_queue.begin(), state.m_queue.end(), name);
+        if (queued != state.m_queue.end())
+        {
+            // No need to wait for a worker thread
+            state.m_queue.erase(queued);
+            video::IVideoDriver *driver = state.m_driver;
+            bool convert_to_argb        = state.m_convert_to_argb;
+            m_state.unlock();
+            image = decodeImage(driver, name, convert_to_argb);
+            m_state.lock();
+            state.m_pending.erase(name);
+            break;
+        }
+        // The 'while' is necessary because of spurious wakeups
+        pthread_cond_wait(&m_cond_ready, m_state.getMutex());
+    }
+    m_state.unlock();
+    return image;
+}   // takeImage
+
+// ----------------------------------------------------------------------------
+/** Removes all images that have not been decoded yet from the queue, waits
+ *  for the images that are currently decoded, and frees all decoded images
+ *  that were not used.
+ */
+void ImageDecoder::clear()
+{
+    if (m_threads.empty()) return;
+
+    m_state.lock();
+    DecoderState &state = m_state.getData();
+    for (unsigned int i = 0; i < state.m_queue.size(); i++)
+        state.m_pending.erase(state.m_queue[i]);
+    state.m_queue.clear();
+    while (!state.m_pending.empty())
+        pthread_cond_wait(&m_cond_ready, m_state.getMutex());
+
+    std::map<std::string, video::IImage*>::iterator i;
+    for (i = state.m_ready.begin(); i != state.m_ready.end(); i++)
+    {
+        if (i->second)
+            i->second->drop();
+    }
+    state.m_ready.clear();
+    state.m_driver = NULL;
+    if (m_num_decoded > 0)
+    {
+        Log::debug("ImageDecoder", "%u images decoded by %u threads.",
+                   m_num_decoded, (unsigned int)m_threads.size());
+    }
+    m_num_decoded = 0;
+    m_state.unlock();
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** The main loop of each worker thread: waits for queued images and
+ *  decodes them.
+ *  \param obj Pointer to the ImageDecoder.
+ */
+void *ImageDecoder::mainLoop(void *obj)
+{
+    VS::setThreadName("ImageDecoder");
+    ImageDecoder *me = (ImageDecoder*)obj;
+
+    me->m_state.lock();
+    DecoderState &state = me->m_state.getData();
+    while (true)
+    {
+        // The 'while' is necessary because of spurious wakeups
+        while (!state.m_quit && state.m_queue.empty())
+            pthread_cond_wait(&me->m_cond_request, me->m_state.getMutex());
+        if (state.m_quit) break;
+
+        std::string name = state.m_queue.front();
+        state.m_queue.pop_front();
+        video::IVideoDriver *driver = state.m_driver;
+        bool convert_to_argb        = state.m_convert_to_argb;
+        me->m_state.unlock();
+
+        video::IImage *image = decodeImage(driver, name, convert_to_argb);
+
+        me->m_state.lock();
+        state.m_pending.erase(name);
+        state.m_ready[name] = image;
+        me->m_num_decoded++;
+        pthread_cond_broadcast(&me->m_cond_ready);
+    }
+    me->m_state.unlock();
+    return NULL;
+}   // mainLoop
+
+// ----------------------------------------------------------------------------
+/** Reads and decodes one image file. The file is read without using
+ *  irrlicht's file system (which is not thread safe), and the image is
+ *  then decoded by the image loaders of the driver.
+ *  \param driver The video driver.
+ *  \param file_name Absolute name of the file.
+ *  \param convert_to_argb True if 24 bit images should be converted to
+ *         A8R8G8B8 (which avoids the conversion when creating the texture).
+ */
+video::IImage *ImageDecoder::decodeImage(video::IVideoDriver *driver,
+                                         const std::string &file_name,
+                                         bool convert_to_argb)
+{
+    FILE *f = fopen(file_name.c_str(), "rb");
+    if (!f) return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size <= 0)
+    {
+        fclose(f);
+        return NULL;
+    }
+    char *data = new char[size];
+    size_t n = fread(data, 1, size, f);
+    fclose(f);
+    if (n != (size_t)size)
+    {
+        delete [] data;
+        return NULL;
+    }
+
+    io::IReadFile *file = file_manager->getFileSystem()
+        ->createMemoryReadFile(data, size, file_name.c_str(),
+                               /*deleteMemoryWhenDropped*/true);
+    video::IImage *image = driver->createImageFromFile(file);
+    file->drop();
+
+    if (image && convert_to_argb &&
+        image->getColorFormat() == video::ECF_R8G8B8)
+    {
+        video::IImage *argb = driver->createImage(video::ECF_A8R8G8B8,
+                                                  image->getDimension());
+        const uint8_t *rgb = (const uint8_t*)image->lock();
+        uint8_t *pixels    = (uint8_t*)argb->lock();
+        const core::dimension2du &size = image->getDimension();
+        for (unsigned int y = 0; y < size.Height; y++)
+        {
+            ImageKernels::convertRGBToARGB(rgb + y*image->getPitch(),
+                                (uint32_t*)(pixels + y*argb->getPitch()),
+                                size.Width);
+        }
+        argb->unlock();
+        image->unlock();
+        image->drop();
+        image = argb;
+    }
+    return image;
+}   // decodeImage
+
+// ============================================================================
+/** Decodes (some of) the textures of STK, once on the main thread and once
+ *  with the decoder, checks that the images are identical and prints the
+ *  decode throughput. This only needs the CPU, so it also works with the
+ *  null driver (--no-graphics).
+ */
+void ImageDecoder::unitTesting()
+{
+    std::string dir = file_manager->getAsset(FileManager::TEXTURE, "");
+    std::set<std::string> all_files;
+    file_manager->listFiles(all_files, dir, /*make_full_path*/true);
+    std::vector<std::string> files;
+    for (std::set<std::string>::iterator i = all_files.begin();
+         i != all_files.end() && files.size() < 64; i++)
+    {
+        std::string ext = StringUtils::getExtension(*i);
+        if (ext == "png" || ext == "jpg")
+            files.push_back(*i);
+    }
+
+    video::IVideoDriver *driver = irr_driver->getVideoDriver();
+    std::vector<video::IImage*> reference;
+    double start = StkTime::getRealTime();
+    for (unsigned int i = 0; i < files.size(); i++)
+        reference.push_back(driver->createImageFromFile(files[i].c_str()));
+    double serial_time = StkTime::getRealTime() - start;
+
+    // Always test with threads, even if they are disabled in the config
+    int saved_threads = UserConfigParams::m_image_decode_threads;
+    int num_threads   = saved_threads;
+    if (num_threads < 0)
+        num_threads = HardwareStats::getNumProcessors() - 1;
+    UserConfigParams::m_image_decode_threads = std::max(num_threads, 1);
+    ImageDecoder decoder;
+    // Start the threads before measuring the time
+    decoder.queueImages(std::vector<std::string>());
+    start = StkTime::getRealTime();
+    decoder.queueImages(files);
+    std::vector<video::IImage*> decoded;
+    for (unsigned int i = 0; i < files.size(); i++)
+        decoded.push_back(decoder.takeImage(files[i]));
+    double decoder_time = StkTime::getRealTime() - start;
+    UserConfigParams::m_image_decode_threads = saved_threads;
+
+    for (unsigned int i = 0; i < files.size(); i++)
+    {
+        assert((reference[i] == NULL) == (decoded[i] == NULL));
+        if (!reference[i]) continue;
+        core::dimension2du size = reference[i]->getDimension();
+        assert(decoded[i]->getDimension() == size);
+        for (unsigned int y = 0; y < size.Height; y++)
+        {
+            for (unsigned int x = 0; x < size.Width; x++)
+            {
+                assert(reference[i]->getPixel(x, y) ==
+                       decoded[i]->getPixel(x, y));
+            }
+        }
+        reference[i]->drop();
+        decoded[i]->drop();
+    }
+    decoder.clear();
+
+    Log::info("ImageDecoder", "%u images: %f s on the main thread, "
+              "%f s with %u threads.", (unsigned int)files.size(),
+              serial_time, decoder_time, decoder.getNumThreads());
+}   // unitTesting
@@ -0,0 +1,111 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_IMAGE_DECODER_HPP
+#define HEADER_IMAGE_DECODER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/synchronised.hpp"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+namespace irr
+{
+    namespace video { class IImage; class IVideoDriver; }
+}
+using namespace irr;
+
+/**
+  * \brief A pool of threads that decode PNG and JPG images in advance.
+  *  When a materials file is loaded, all textures it needs are queued with
+  *  queueImages(). The worker threads read and decode the files and
+  *  convert them into the format of the GPU texture, while the main thread
+  *  creates the materials. The main thread then only has to upload the
+  *  image when the texture is actually requested (see takeImage()).
+  *  The decoder can also be used without a GPU (e.g. with the null
+  *  driver), in which case the decoded images are used directly.
+  * \ingroup graphics
+  */
+class ImageDecoder : public NoCopy
+{
+private:
+    /** The state shared between the main thread and the worker threads. */
+    struct DecoderState
+    {
+        /** Absolute file names of images still to be decoded. */
+        std::deque<std::string> m_queue;
+
+        /** All queued images that are not yet in m_ready, i.e. the
+         *  images in m_queue and the ones currently decoded. */
+        std::set<std::string> m_pending;
+
+        /** Decoded images (NULL if an image could not be decoded). */
+        std::map<std::string, video::IImage*> m_ready;
+
+        /** The driver used to decode the images. */
+        video::IVideoDriver *m_driver;
+
+        /** True if 24 bit images should be converted to 32 bit. */
+        bool m_convert_to_argb;
+
+        /** Set to tell all worker threads to exit. */
+        bool m_quit;
+    };   // DecoderState
+
+    Synchronised<DecoderState> m_state;
+
+    /** Signaled when new images are queued (or the threads should quit). */
+    pthread_cond_t m_cond_request;
+
+    /** Signaled when an image was decoded. */
+    pthread_cond_t m_cond_ready;
+
+    /** All worker threads. */
+    std::vector<pthread_t> m_threads;
+
+    /** Number of images decoded by the worker threads. */
+    unsigned int m_num_decoded;
+
+    void startThreads(unsigned int num_threads);
+    static void *mainLoop(void *obj);
+    static video::IImage *decodeImage(video::IVideoDriver *driver,
+                                      const std::string &file_name,
+                                      bool convert_to_argb);
+
+public:
+                  ImageDecoder();
+                 ~ImageDecoder();
+    void          queueImages(const std::vector<std::string> &files);
+    video::IImage *takeImage(const std::string &file_name);
+    void          clear();
+    void          stopThreads();
+    static void   unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of worker threads (0 if images are decoded on
+     *  the main thread). */
+    unsigned int getNumThreads() const { return (unsigned int)m_threads.size(); }
+};   // ImageDecoder
+
+#endif
@@ -0,0 +1,251 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "graphics/image_kernels.hpp"
+
+#include <assert.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define IMAGE_KERNELS_SSE2
+#endif
+
+namespace ImageKernels
+{
+namespace
+{
+    // ------------------------------------------------------------------------
+    /** Computes x/255 for 0 <= x <= 255*255 without a division, the result
+     *  is identical to the integer division. */
+    inline uint32_t div255(uint32_t x)
+    {
+        return (x + 1 + (x >> 8)) >> 8;
+    }   // div255
+
+    // ------------------------------------------------------------------------
+    /** Table with the results of 255*c/a for all alpha and colour values,
+     *  masked to 8 bits the same way SColor::set does. Computed once on
+     *  first use, there is no fast way to divide bytes by a variable. */
+    struct DivideTable
+    {
+        uint8_t m_value[256][256];
+        DivideTable()
+        {
+            for (unsigned int c = 0; c < 256; c++)
+                m_value[0][c] = (uint8_t)c;
+            for (unsigned int a = 1; a < 256; a++)
+            {
+                for (unsigned int c = 0; c < 256; c++)
+                    m_value[a][c] = (uint8_t)((255 * c / a) & 0xff);
+            }
+        }   // DivideTable
+    };   // DivideTable
+
+    // ------------------------------------------------------------------------
+    const DivideTable& getDivideTable()
+    {
+        static DivideTable table;
+        return table;
+    }   // getDivideTable
+
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Multiplies the colour channels of each pixel with its alpha value, i.e.
+ *  c = a*c/255 (rounded down).
+ *  \param pixels The A8R8G8B8 pixels to modify.
+ *  \param count Number of pixels.
+ */
+void premultiplyAlpha(uint32_t *pixels, unsigned int count)
+{
+    unsigned int i = 0;
+#ifdef IMAGE_KERNELS_SSE2
+    const __m128i zero       = _mm_setzero_si128();
+    const __m128i one        = _mm_set1_epi16(1);
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i argb = _mm_loadu_si128((const __m128i*)(pixels + i));
+        // Two pixels per register, one 16-bit lane per channel
+        __m128i lo = _mm_unpacklo_epi8(argb, zero);
+        __m128i hi = _mm_unpackhi_epi8(argb, zero);
+        __m128i alpha_lo = _mm_shufflehi_epi16(
+            _mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)),
+                                    _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i alpha_hi = _mm_shufflehi_epi16(
+            _mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)),
+                                    _MM_SHUFFLE(3, 3, 3, 3));
+        lo = _mm_mullo_epi16(lo, alpha_lo);
+        hi = _mm_mullo_epi16(hi, alpha_hi);
+        // Exact division by 255, see div255
+        lo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(lo, one),
+                                          _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(hi, one),
+                                          _mm_srli_epi16(hi, 8)), 8);
+        __m128i result = _mm_packus_epi16(lo, hi);
+        // Keep the original alpha values
+        result = _mm_or_si128(_mm_andnot_si128(alpha_mask, result),
+                              _mm_and_si128(alpha_mask, argb));
+        _mm_storeu_si128((__m128i*)(pixels + i), result);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        uint32_t col   = pixels[i];
+        uint32_t alpha = col >> 24;
+        uint32_t red   = div255(alpha * ((col >> 16) & 0xff));
+        uint32_t green = div255(alpha * ((col >>  8) & 0xff));
+        uint32_t blue  = div255(alpha * ( col        & 0xff));
+        pixels[i] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+}   // premultiplyAlpha
+
+// ----------------------------------------------------------------------------
+/** Divides the colour channels of each pixel by its alpha value, i.e.
+ *  c = 255*c/a. Pixels with an alpha of 0 are not modified, and results
+ *  bigger than 255 wrap around like they do with SColor::set.
+ *  \param pixels The A8R8G8B8 pixels to modify.
+ *  \param count Number of pixels.
+ */
+void dividePremultipliedAlpha(uint32_t *pixels, unsigned int count)
+{
+    const DivideTable &table = getDivideTable();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t col = pixels[i];
+        const uint8_t *row = table.m_value[col >> 24];
+        pixels[i] = (col & 0xff000000)
+                  | (row[(col >> 16) & 0xff] << 16)
+                  | (row[(col >>  8) & 0xff] <<  8)
+                  |  row[ col        & 0xff];
+    }
+}   // dividePremultipliedAlpha
+
+// ----------------------------------------------------------------------------
+/** Replaces the alpha value of each pixel with the red value of the
+ *  corresponding pixel of a mask.
+ *  \param pixels The A8R8G8B8 pixels to modify.
+ *  \param mask The A8R8G8B8 pixels of the mask.
+ *  \param count Number of pixels.
+ */
+void copyRedToAlpha(uint32_t *pixels, const uint32_t *mask,
+                    unsigned int count)
+{
+    unsigned int i = 0;
+#ifdef IMAGE_KERNELS_SSE2
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i col = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128i red = _mm_loadu_si128((const __m128i*)(mask + i));
+        col = _mm_or_si128(_mm_andnot_si128(alpha_mask, col),
+                           _mm_and_si128(alpha_mask, _mm_slli_epi32(red, 8)));
+        _mm_storeu_si128((__m128i*)(pixels + i), col);
+    }
+#endif
+    for (; i < count; i++)
+        pixels[i] = (pixels[i] & 0x00ffffff) | ((mask[i] & 0x00ff0000) << 8);
+}   // copyRedToAlpha
+
+// ----------------------------------------------------------------------------
+/** Converts R8G8B8 pixels (3 bytes, red first) into opaque A8R8G8B8 pixels,
+ *  like irrlicht's CColorConverter does. This has no SSE2 version, since
+ *  SSE2 can't shuffle bytes, but it avoids the blit of IImage::copyTo.
+ *  \param rgb The R8G8B8 pixels.
+ *  \param pixels The A8R8G8B8 pixels to write.
+ *  \param count Number of pixels.
+ */
+void convertRGBToARGB(const uint8_t *rgb, uint32_t *pixels,
+                      unsigned int count)
+{
+    for (unsigned int i = 0; i < count; i++, rgb += 3)
+        pixels[i] = 0xff000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+}   // convertRGBToARGB
+
+// ============================================================================
+/** Compares all kernels with the straightforward per-channel computation
+ *  for all combinations of alpha and colour values.
+ */
+void unitTesting()
+{
+    // All alpha/colour combinations, plus a few pixels so that the scalar
+    // code handling the end of the array is used as well.
+    const unsigned int count = 256*256 + 3;
+    std::vector<uint32_t> input(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t a = (i >> 8) & 0xff, c = i & 0xff;
+        input[i] = (a << 24) | (c << 16) | ((255 - c) << 8) | ((c * 7) & 0xff);
+    }
+
+    std::vector<uint32_t> pixels = input;
+    premultiplyAlpha(pixels.data(), count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t a = input[i] >> 24;
+        uint32_t expected = (a << 24);
+        for (unsigned int shift = 0; shift < 24; shift += 8)
+            expected |= (a * ((input[i] >> shift) & 0xff) / 255) << shift;
+        assert(pixels[i] == expected);
+    }
+
+    pixels = input;
+    dividePremultipliedAlpha(pixels.data(), count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t a = input[i] >> 24;
+        uint32_t expected = input[i];
+        if (a)
+        {
+            expected = (a << 24);
+            for (unsigned int shift = 0; shift < 24; shift += 8)
+            {
+                uint32_t c = (255 * ((input[i] >> shift) & 0xff) / a) & 0xff;
+                expected |= c << shift;
+            }
+        }
+        assert(pixels[i] == expected);
+    }
+
+    pixels = input;
+    std::vector<uint32_t> mask(count);
+    for (unsigned int i = 0; i < count; i++)
+        mask[i] = input[count - 1 - i];
+    copyRedToAlpha(pixels.data(), mask.data(), count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t expected = (input[i] & 0x00ffffff)
+                          | (((mask[i] >> 16) & 0xff) << 24);
+        assert(pixels[i] == expected);
+    }
+
+    std::vector<uint8_t> rgb(3 * count);
+    for (unsigned int i = 0; i < 3 * count; i++)
+        rgb[i] = (uint8_t)(i * 13);
+    convertRGBToARGB(rgb.data(), pixels.data(), count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t expected = 0xff000000 | (rgb[3 * i    ] << 16)
+                          | (rgb[3 * i + 1] << 8) | rgb[3 * i + 2];
+        assert(pixels[i] == expected);
+    }
+}   // unitTesting
+
+}   // ImageKernels
@@ -0,0 +1,43 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_IMAGE_KERNELS_HPP
+#define HEADER_IMAGE_KERNELS_HPP
+
+#include "utils/types.hpp"
+
+/**
+  * \brief Per-pixel operations on A8R8G8B8 images.
+  *  All functions work on an array of 32-bit pixels in the layout used by
+  *  irrlicht's SColor (alpha in the highest byte, blue in the lowest). They
+  *  give exactly the same result as the getPixel/setPixel loops they
+  *  replace, but use SSE2 if it is available at compile time.
+  * \ingroup graphics
+  */
+namespace ImageKernels
+{
+    void premultiplyAlpha(uint32_t *pixels, unsigned int count);
+    void dividePremultipliedAlpha(uint32_t *pixels, unsigned int count);
+    void copyRedToAlpha(uint32_t *pixels, const uint32_t *mask,
+                        unsigned int count);
+    void convertRGBToARGB(const uint8_t *rgb, uint32_t *pixels,
+                          unsigned int count);
+    void unitTesting();
+}   // ImageKernels
+
+#endif
@@ -24,7 +24,10 @@
 #include "graphics/central_settings.hpp"
 #include "graphics/glwrap.hpp"
 #include "graphics/2dutils.hpp"
+#include "graphics/culling_tree.hpp"
 #include "graphics/graphics_restrictions.hpp"
+#include "graphics/image_decoder.hpp"
+#include "graphics/image_kernels.hpp"
 #include "graphics/light.hpp"
 #include "graphics/material_manager.hpp"
 #include "graphics/particle_kind_manager.hpp"
@@ -129,6 +132,8 @@ IrrDriver::IrrDriver()
     m_rtts                = NULL;
     m_post_processing     = NULL;
     m_wind                = new Wind();
+    m_image_decoder       = new ImageDecoder();
+    m_culling_tree        = new CullingTree();
     m_skybox              = NULL;
     m_spherical_harmonics = NULL;
 
@@ -158,6 +163,10 @@ IrrDriver::~IrrDriver()
         // check if we createad the OpenGL device by calling initDevice()
         m_post_processing->drop();
     }
+    delete m_image_decoder;
+    m_image_decoder = NULL;
+    delete m_culling_tree;
+    m_culling_tree = NULL;
     assert(m_device != NULL);
 
     m_device->drop();
@@ -1627,7 +1636,20 @@ video::ITexture *IrrDriver::getTexture(const std::string &filename,
     if(!is_premul && !is_prediv)
     {
         if (!complain_if_not_found) m_device->getLogger()->setLogLevel(ELL_NONE);
-        out = m_video_driver->getTexture(filename.c_str());
+        // If the image was already decoded in the background, only the
+        // texture needs to be created.
+        video::IImage *img = m_image_decoder->takeImage(filename);
+        if (img)
+        {
+            io::path name = m_device->getFileSystem()
+                          ->getAbsolutePath(filename.c_str());
+            out = m_video_driver->findTexture(name);
+            if (!out)
+                out = m_video_driver->addTexture(name, img, NULL);
+            img->drop();
+        }
+        else
+            out = m_video_driver->getTexture(filename.c_str());
         if (!complain_if_not_found) m_device->getLogger()->setLogLevel(ELL_WARNING);
     }
     else
@@ -1645,19 +1667,8 @@ video::ITexture *IrrDriver::getTexture(const std::string &filename,
             img->lock())
         {
             core::dimension2d<u32> dim = img->getDimension();
-            for(unsigned int x = 0; x < dim.Width; x++)
-            {
-                for(unsigned int y = 0; y < dim.Height; y++)
-                {
-                    video::SColor col = img->getPixel(x, y);
-                    unsigned int alpha = col.getAlpha();
-                    unsigned int red   = alpha * col.getRed()   / 255;
-                    unsigned int blue  = alpha * col.getBlue()  / 255;
-                    unsigned int green = alpha * col.getGreen() / 255;
-                    col.set(alpha, red, green, blue);
-                    img->setPixel(x, y, col, false);
-                }   // for y
-            }   // for x
+            ImageKernels::premultiplyAlpha((uint32_t*)img->lock(),
+                                           dim.Width * dim.Height);
             img->unlock();
         }   // if png and ColorFOrmat and lock
         // Other formats can be premul, but the tasks can be non premul
@@ -1667,22 +1678,9 @@ video::ITexture *IrrDriver::getTexture(const std::string &filename,
             img->lock())
         {
             core::dimension2d<u32> dim = img->getDimension();
-            for(unsigned int  x = 0; x < dim.Width; x++)
-            {
-                for(unsigned int y = 0; y < dim.Height; y++)
-                {
-                    video::SColor col = img->getPixel(x, y);
-                    unsigned int alpha = col.getAlpha();
-                    // Avoid divide by zero
-                    if (alpha) {
-                        unsigned int red   = 255 * col.getRed() / alpha ;
-                        unsigned int blue  = 255 * col.getBlue() / alpha;
-                        unsigned int green = 255 * col.getGreen() / alpha;
-                        col.set(alpha, red, green, blue);
-                        img->setPixel(x, y, col, false);
-                    }
-                }   // for y
-            }   // for x
+            // Pixels with alpha 0 are left unchanged (avoid divide by zero)
+            ImageKernels::dividePremultipliedAlpha((uint32_t*)img->lock(),
+                                                   dim.Width * dim.Height);
             img->unlock();
         }   // if premul && color format && lock
         out = m_video_driver->addTexture(filename.c_str(), img, NULL);
@@ -1791,16 +1789,27 @@ video::ITexture* IrrDriver::applyMask(video::ITexture* texture,
     if (img->lock() && mask->lock())
     {
         core::dimension2d<u32> dim = img->getDimension();
-        for (unsigned int x = 0; x < dim.Width; x++)
+        if (img->getColorFormat()  == video::ECF_A8R8G8B8 &&
+            mask->getColorFormat() == video::ECF_A8R8G8B8 &&
+            mask->getDimension()   == dim)
+        {
+            ImageKernels::copyRedToAlpha((uint32_t*)img->lock(),
+                                         (const uint32_t*)mask->lock(),
+                                         dim.Width * dim.Height);
+        }
+        else
         {
-            for (unsigned int y = 0; y < dim.Height; y++)
+            for (unsigned int x = 0; x < dim.Width; x++)
             {
-                video::SColor col = img->getPixel(x, y);
-                video::SColor alpha = mask->getPixel(x, y);
-                col.setAlpha( alpha.getRed() );
-                img->setPixel(x, y, col, false);
-            }   // for y
-        }   // for x
+                for (unsigned int y = 0; y < dim.Height; y++)
+                {
+                    video::SColor col = img->getPixel(x, y);
+                    video::SColor alpha = mask->getPixel(x, y);
+                    col.setAlpha( alpha.getRed() );
+                    img->setPixel(x, y, col, false);
+                }   // for y
+            }   // for x
+        }
 
         mask->unlock();
         img->unlock();
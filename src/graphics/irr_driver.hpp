@@ -57,7 +57,9 @@ using namespace irr;
 
 class RTT;
 class RenderInfo;
+class CullingTree;
 class FrameBuffer;
+class ImageDecoder;
 class ShadowImportanceProvider;
 class AbstractKart;
 class Camera;
@@ -202,6 +204,10 @@ private:
 
     /** Wind. */
     Wind                 *m_wind;
+    /** Decodes textures in separate threads while loading. */
+    ImageDecoder         *m_image_decoder;
+    /** Culls the static nodes of the track. */
+    CullingTree          *m_culling_tree;
     /** RTTs. */
     RTT                *m_rtts;
     core::vector2df    m_current_screen_size;
@@ -530,6 +536,12 @@ public:
     inline PostProcessing* getPostProcessing()  {return m_post_processing;}
     // ------------------------------------------------------------------------
     inline core::vector3df getWind()  {return m_wind->getWind();}
+    // ------------------------------------------------------------------------
+    /** Returns the decoder used to decode textures in advance. */
+    ImageDecoder *getImageDecoder() { return m_image_decoder; }
+    // ------------------------------------------------------------------------
+    /** Returns the tree used to cull the static nodes of the track. */
+    CullingTree *getCullingTree() { return m_culling_tree; }
     // -----------------------------------------------------------------------
     /** Returns a pointer to the skybox. */
     inline Skybox *getSkybox()  {return m_skybox;}
@@ -23,6 +23,8 @@
 #include <sstream>
 
 #include "config/user_config.hpp"
+#include "graphics/image_decoder.hpp"
+#include "graphics/irr_driver.hpp"
 #include "graphics/material.hpp"
 #include "graphics/shaders.hpp"
 #include "io/file_manager.hpp"
@@ -31,6 +33,7 @@
 #include "modes/world.hpp"
 #include "tracks/track.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 
 #include <ITexture.h>
 #include <SMaterial.h>
@@ -43,6 +46,7 @@ MaterialManager::MaterialManager()
     /* Create list - and default material zero */
 
     m_materials.reserve(256);
+    m_shared_material_index = 0;
     // We can't call init/loadMaterial here, since the global variable
     // material_manager has not yet been initialised, and
     // material_manager is used in the Material constructor.
@@ -60,6 +64,8 @@ MaterialManager::~MaterialManager()
         delete m_materials[i];
     }
     m_materials.clear();
+    m_materials_by_name.clear();
+    m_materials_by_path.clear();
 
     for (std::map<video::E_MATERIAL_TYPE, Material*> ::iterator it =
          m_default_materials.begin(); it != m_default_materials.end(); it++)
@@ -69,6 +75,65 @@ MaterialManager::~MaterialManager()
     m_default_materials.clear();
 }   // ~MaterialManager
 
+//-----------------------------------------------------------------------------
+/** Appends a material to the list of all materials and adds it to the
+ *  name and path indices.
+ *  \param m The material to add.
+ */
+void MaterialManager::addMaterial(Material *m)
+{
+    m_materials.push_back(m);
+    m_materials_by_name[m->getTexFname()].push_back(m);
+    if(!m->getTexFullPath().empty())
+        m_materials_by_path[m->getTexFullPath()].push_back(m);
+}   // addMaterial
+
+//-----------------------------------------------------------------------------
+/** Removes the last material from the list of all materials and the
+ *  indices, and deletes it. Since materials are only ever removed in
+ *  reverse order, the material is always the last entry for its name and
+ *  path in the indices.
+ */
+void MaterialManager::removeLastMaterial()
+{
+    Material *m = m_materials.back();
+
+    std::vector<Material*> &same_name = m_materials_by_name[m->getTexFname()];
+    assert(same_name.back()==m);
+    same_name.pop_back();
+    if(same_name.empty())
+        m_materials_by_name.erase(m->getTexFname());
+
+    if(!m->getTexFullPath().empty())
+    {
+        std::vector<Material*> &same_path =
+            m_materials_by_path[m->getTexFullPath()];
+        assert(same_path.back()==m);
+        same_path.pop_back();
+        if(same_path.empty())
+            m_materials_by_path.erase(m->getTexFullPath());
+    }
+
+    m_materials.pop_back();
+    delete m;
+}   // removeLastMaterial
+
+//-----------------------------------------------------------------------------
+/** Returns the most recently added material for the given key in one of
+ *  the indices, or NULL if there is no such material.
+ *  \param index Either m_materials_by_name or m_materials_by_path.
+ *  \param key The texture name or full path to search for.
+ */
+Material* MaterialManager::findMaterial(const std::unordered_map<std::string,
+                                              std::vector<Material*> > &index,
+                                        const std::string &key) const
+{
+    std::unordered_map<std::string, std::vector<Material*> >::const_iterator
+        i = index.find(key);
+    if(i==index.end()) return NULL;
+    return i->second.back();
+}   // findMaterial
+
 //-----------------------------------------------------------------------------
 
 Material* MaterialManager::getMaterialFor(video::ITexture* t,
@@ -86,29 +151,21 @@ Material* MaterialManager::getMaterialFor(video::ITexture* t,
         return getDefaultMaterial(material_type);
 
     core::stringc img_path = core::stringc(t->getName());
-    const std::string image = StringUtils::getBasename(img_path.c_str());
+    Material *m;
+    // The indices return the last added material, so that temporary
+    // (track) textures are found first
     if (!img_path.empty() && (img_path.findFirst('/') != -1 || img_path.findFirst('\\') != -1))
     {
-        // Search backward so that temporary (track) textures are found first
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFullPath() == img_path.c_str())
-            {
-                return m_materials[i];
-            }
-        }
+        m = findMaterial(m_materials_by_path, img_path.c_str());
     }
     else
     {
-        for (int i = (int)m_materials.size() - 1; i >= 0; i--)
-        {
-            if (m_materials[i]->getTexFname() == image)
-            {
-                return m_materials[i];
-            }
-        }   // for i
+        const std::string image = StringUtils::getBasename(img_path.c_str());
+        m = findMaterial(m_materials_by_name, image);
     }
 
+    if (m)
+        return m;
     return getDefaultMaterial(material_type);
 }
 
@@ -174,15 +231,9 @@ void MaterialManager::adjustForFog(video::ITexture* t,
                                    bool use_fog) const
 {
     const std::string image = StringUtils::getBasename(core::stringc(t->getName()).c_str());
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if (m_materials[i]->getTexFname()==image)
-        {
-            m_materials[i]->adjustForFog(parent, &(mb->getMaterial()), use_fog);
-            return;
-        }
-    }   // for i
+    Material *m = findMaterial(m_materials_by_name, image);
+    if (m)
+        m->adjustForFog(parent, &(mb->getMaterial()), use_fog);
 }   // adjustForFog
 
 //-----------------------------------------------------------------------------
@@ -207,7 +258,7 @@ void MaterialManager::setAllUntexturedMaterialFlags(scene::IMeshBuffer *mb)
 //-----------------------------------------------------------------------------
 int MaterialManager::addEntity(Material *m)
 {
-    m_materials.push_back(m);
+    addMaterial(m);
     return (int)m_materials.size()-1;
 }
 
@@ -267,6 +318,24 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
                                        const std::string& filename,
                                        bool deprecated)
 {
+    // Let the image decoder decode all textures in the background, while
+    // the materials are created (which loads the textures).
+    std::vector<std::string> textures;
+    for(unsigned int i=0; i<root->getNumNodes(); i++)
+    {
+        const XMLNode *node = root->getNode(i);
+        std::string name;
+        bool dont_load = false;
+        if(!node || !node->get("name", &name)) continue;
+        node->get("dont-load", &dont_load);
+        if(dont_load) continue;
+        std::string full_path = file_manager->searchTexture(name);
+        if(full_path.size()>0)
+            textures.push_back(full_path);
+    }
+    ImageDecoder *image_decoder = irr_driver->getImageDecoder();
+    image_decoder->queueImages(textures);
+
     for(unsigned int i=0; i<root->getNumNodes(); i++)
     {
         const XMLNode *node = root->getNode(i);
@@ -278,7 +347,7 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
         }
         try
         {
-            m_materials.push_back(new Material(node, deprecated));
+            addMaterial(new Material(node, deprecated));
         }
         catch(std::exception& e)
         {
@@ -286,6 +355,8 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
             Log::warn("MaterialManager", e.what(), filename.c_str());
         }
     }   // for i<xml->getNumNodes)(
+    // Free all images that were not used
+    image_decoder->clear();
     return true;
 }   // pushTempMaterial
 
@@ -293,11 +364,10 @@ bool MaterialManager::pushTempMaterial(const XMLNode *root,
 //-----------------------------------------------------------------------------
 void MaterialManager::popTempMaterial()
 {
-    for(int i=(int)m_materials.size()-1; i>=this->m_shared_material_index; i--)
+    while((int)m_materials.size() > m_shared_material_index)
     {
-        delete m_materials[i];
-        m_materials.pop_back();
-    }   // for i6
+        removeLastMaterial();
+    }
 }   // popTempMaterial
 
 //-----------------------------------------------------------------------------
@@ -338,15 +408,14 @@ Material *MaterialManager::getMaterial(const std::string& fname,
     else
         basename = fname;
         
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
-    {
-        if(m_materials[i]->getTexFname()==basename) return m_materials[i];
-    }
+    // The index returns the last added material, so that temporary (track)
+    // textures are found first
+    Material *m = findMaterial(m_materials_by_name, basename);
+    if(m) return m;
 
     // Add the new material
-    Material* m = new Material(fname, is_full_path, complain_if_not_found);
-    m_materials.push_back(m);
+    m = new Material(fname, is_full_path, complain_if_not_found);
+    addMaterial(m);
     if(make_permanent)
     {
         assert(m_shared_material_index==(int)m_materials.size()-1);
@@ -368,11 +437,54 @@ void MaterialManager::makeMaterialsPermanent()
 bool MaterialManager::hasMaterial(const std::string& fname)
 {
     std::string basename=StringUtils::getBasename(fname);
-
-    // Search backward so that temporary (track) textures are found first
-    for(int i = (int)m_materials.size()-1; i>=0; i-- )
+    return findMaterial(m_materials_by_name, basename)!=NULL;
+}   // hasMaterial
+
+// ============================================================================
+/** Unit testing function. Checks that temporary materials hide shared
+ *  materials with the same name, and times the lookups for a synthetic
+ *  track with 5000 materials (one lookup per material, as happens when the
+ *  mesh buffers of a track are converted).
+ */
+void MaterialManager::unitTesting()
+{
+    MaterialManager mm;
+    Material *shared = new Material("unit_test_shared.png",
+                                    /*is_full_path*/false,
+                                    /*complain_if_not_found*/false,
+                                    /*load_texture*/false);
+    mm.addEntity(shared);
+    mm.makeMaterialsPermanent();
+    assert(mm.getMaterial("unit_test_shared.png")==shared);
+    assert(mm.hasMaterial("some/dir/unit_test_shared.png"));
+
+    const int num_materials = 5000;
+    std::vector<std::string> names;
+    for(int i=0; i<num_materials; i++)
+        names.push_back(StringUtils::insertValues("unit_test_%d.png", i));
+
+    double start = StkTime::getRealTime();
+    for(int i=0; i<num_materials; i++)
+        mm.addEntity(new Material(names[i], false, false, false));
+    Material *temp = new Material("unit_test_shared.png", false, false, false);
+    mm.addEntity(temp);
+    double loaded = StkTime::getRealTime();
+
+    for(int i=0; i<num_materials; i++)
     {
-        if(m_materials[i]->getTexFname()==basename) return true;
+        Material *m = mm.getMaterial(names[i], false, false, false);
+        assert(m && m->getTexFname()==names[i]);
     }
-    return false;
-}
+    double looked_up = StkTime::getRealTime();
+    Log::info("MaterialManager", "%d materials: adding took %f s, "
+              "looking up all took %f s.", num_materials,
+              loaded-start, looked_up-loaded);
+
+    // The track material hides the shared one until it is popped.
+    assert(mm.getMaterial("unit_test_shared.png")==temp);
+    mm.popTempMaterial();
+    assert(mm.getMaterial("unit_test_shared.png")==shared);
+    assert(!mm.hasMaterial("unit_test_0.png"));
+    assert(mm.m_materials.size()==1);
+    assert(mm.m_materials_by_name.size()==1);
+}   // unitTesting
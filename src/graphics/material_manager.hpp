@@ -33,6 +33,7 @@ using namespace irr;
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 class Material;
 class XMLReader;
@@ -50,6 +51,22 @@ private:
 
     std::vector<Material*> m_materials;
 
+    /** Maps the texture name of a material to all materials in
+     *  m_materials with this name, in the order in which they were added.
+     *  The last entry is the one that is used, so that temporary (track)
+     *  materials hide shared materials with the same name. */
+    std::unordered_map<std::string, std::vector<Material*> > m_materials_by_name;
+
+    /** Same as m_materials_by_name, but indexed by the full path of the
+     *  texture of a material. */
+    std::unordered_map<std::string, std::vector<Material*> > m_materials_by_path;
+
+    void      addMaterial(Material *m);
+    void      removeLastMaterial();
+    Material* findMaterial(const std::unordered_map<std::string,
+                                  std::vector<Material*> > &index,
+                           const std::string &key) const;
+
     std::map<video::E_MATERIAL_TYPE, Material*> m_default_materials;
     Material* getDefaultMaterial(video::E_MATERIAL_TYPE material_type);
 
@@ -84,6 +101,8 @@ public:
     bool      hasMaterial(const std::string& fname);
 
     Material* getLatestMaterial() { return m_materials[m_materials.size()-1]; }
+
+    static void unitTesting();
 };   // MaterialManager
 
 extern MaterialManager *material_manager;
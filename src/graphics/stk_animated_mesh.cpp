@@ -28,13 +28,21 @@
 #include "tracks/track.hpp"
 #include "utils/profiler.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/time.hpp"
 
+#include "../lib/irrlicht/source/Irrlicht/CSkinnedMesh.h"
 #include <IMaterialRenderer.h>
 #include <ISceneManager.h>
 #include <ISkinnedMesh.h>
 
+#include <algorithm>
+#include <assert.h>
+#include <set>
+
 using namespace irr;
 
+std::vector<STKAnimatedMesh*> STKAnimatedMesh::m_skinning_queue;
+
 STKAnimatedMesh::STKAnimatedMesh(irr::scene::IAnimatedMesh* mesh, irr::scene::ISceneNode* parent,
 irr::scene::ISceneManager* mgr, s32 id, const std::string& debug_name,
 const core::vector3df& position,
@@ -46,6 +54,7 @@ const core::vector3df& scale, RenderInfo* render_info, bool all_parts_colorized)
     isMaterialInitialized = false;
     m_mesh_render_info = render_info;
     m_all_parts_colorized = all_parts_colorized;
+    m_skinning_queued = false;
 #ifdef DEBUG
     m_debug_name = debug_name;
 #endif
@@ -53,6 +62,11 @@ const core::vector3df& scale, RenderInfo* render_info, bool all_parts_colorized)
 
 STKAnimatedMesh::~STKAnimatedMesh()
 {
+    if (m_skinning_queued)
+    {
+        m_skinning_queue.erase(std::find(m_skinning_queue.begin(),
+                                         m_skinning_queue.end(), this));
+    }
     cleanGLMeshes();
 }
 
@@ -85,6 +99,75 @@ void STKAnimatedMesh::setMesh(scene::IAnimatedMesh* mesh)
     CAnimatedMeshSceneNode::setMesh(mesh);
 }
 
+// ----------------------------------------------------------------------------
+/** Advances the animation. Unlike CAnimatedMeshSceneNode::OnAnimate this
+ *  does not skin the mesh immediately (which would be done one node after
+ *  the other while the scene graph is traversed). Instead the node is queued
+ *  and all queued meshes are skinned together in skinQueuedMeshes(). Nodes
+ *  that read or control their joints are skinned immediately, since their
+ *  joint nodes have to be up to date when the children are animated.
+ *  \param time_ms Current time in milliseconds.
+ */
+void STKAnimatedMesh::OnAnimate(u32 time_ms)
+{
+    if (!Mesh || Mesh->getMeshType() != scene::EAMT_SKINNED ||
+        JointMode != scene::EJUOR_NONE)
+    {
+        CAnimatedMeshSceneNode::OnAnimate(time_ms);
+        return;
+    }
+
+    if (LastTimeMs == 0)    // first frame
+        LastTimeMs = time_ms;
+    buildFrameNr(time_ms - LastTimeMs);
+    LastTimeMs = time_ms;
+
+    if (!m_skinning_queued)
+    {
+        m_skinning_queued = true;
+        m_skinning_queue.push_back(this);
+    }
+    IAnimatedMeshSceneNode::OnAnimate(time_ms);
+}   // OnAnimate
+
+// ----------------------------------------------------------------------------
+/** Skins the meshes of all nodes queued in OnAnimate and updates their
+ *  bounding boxes. Each skinned mesh only depends on its own joints, so
+ *  different meshes are skinned in parallel (if STK is compiled with
+ *  OpenMP). A mesh that is shared between several nodes is only skinned
+ *  once per frame here; if the nodes are at different frames the mesh is
+ *  skinned again for each of them when it is drawn, as before.
+ */
+void STKAnimatedMesh::skinQueuedMeshes()
+{
+    if (m_skinning_queue.empty())
+        return;
+
+    PROFILER_PUSH_CPU_MARKER("Skinning", 0xFF, 0x80, 0x00);
+    std::vector<STKAnimatedMesh*> unique_nodes;
+    std::set<scene::IAnimatedMesh*> meshes;
+    for (unsigned int i = 0; i < m_skinning_queue.size(); i++)
+    {
+        if (meshes.insert(m_skinning_queue[i]->Mesh).second)
+            unique_nodes.push_back(m_skinning_queue[i]);
+    }
+
+    // Only touches the mesh of each node, which is different for each node
+    int count = (int)unique_nodes.size();
+#pragma omp parallel for
+    for (int i = 0; i < count; i++)
+        unique_nodes[i]->getMeshForCurrentFrame();
+
+    for (unsigned int i = 0; i < m_skinning_queue.size(); i++)
+    {
+        STKAnimatedMesh *node = m_skinning_queue[i];
+        node->Box = node->getMeshForCurrentFrame()->getBoundingBox();
+        node->m_skinning_queued = false;
+    }
+    m_skinning_queue.clear();
+    PROFILER_POP_CPU_MARKER();
+}   // skinQueuedMeshes
+
 void STKAnimatedMesh::updateNoGL()
 {
     scene::IMesh* m = getMeshForCurrentFrame();
@@ -252,3 +335,156 @@ void STKAnimatedMesh::render()
     updateNoGL();
     updateGL();
 }
+
+// ----------------------------------------------------------------------------
+/** Skins 32 copies of a synthetic kart mesh the same way a race with 32
+ *  animated karts does, compares the result with the straightforward sum of
+ *  the weighted joint transforms, and prints the time needed per frame.
+ *  Only the CPU is used, so this works with the null driver as well.
+ */
+void STKAnimatedMesh::unitTesting()
+{
+    scene::ISceneManager *sm = irr_driver->getSceneManager();
+    scene::CSkinnedMesh *mesh =
+        static_cast<scene::CSkinnedMesh*>(sm->createSkinnedMesh());
+
+    // A chain of joints, each one bending a bit further
+    const unsigned int num_joints = 16;
+    std::vector<scene::ISkinnedMesh::SJoint*> joints;
+    for (unsigned int i = 0; i < num_joints; i++)
+    {
+        scene::ISkinnedMesh::SJoint *joint =
+            mesh->addJoint(i == 0 ? NULL : joints.back());
+        joint->LocalMatrix.setTranslation(core::vector3df(0, i ? 0.25f : 0, 0));
+        for (unsigned int k = 0; k < 2; k++)
+        {
+            scene::ISkinnedMesh::SRotationKey *key =
+                mesh->addRotationKey(joint);
+            key->frame    = k * 30.0f;
+            key->rotation.fromAngleAxis(k * 0.1f * (i % 3 + 1),
+                                        core::vector3df(i % 2, 1, 0.5f));
+            scene::ISkinnedMesh::SPositionKey *pos =
+                mesh->addPositionKey(joint);
+            pos->frame    = k * 30.0f;
+            pos->position = core::vector3df(0.01f * k, i ? 0.25f : 0, 0);
+        }
+        joints.push_back(joint);
+    }
+
+    // Two buffers with about the number of vertices of a kart, each vertex
+    // influenced by one to three neighbouring joints
+    const unsigned int num_vertices = 2000;
+    for (unsigned int b = 0; b < 2; b++)
+    {
+        scene::SSkinMeshBuffer *buffer = mesh->addMeshBuffer();
+        for (unsigned int v = 0; v < num_vertices; v++)
+        {
+            float angle = v * 0.37f + b;
+            float height = (float)v / num_vertices * 0.25f * num_joints;
+            video::S3DVertex vertex(cosf(angle), height, sinf(angle),
+                                    cosf(angle), 0, sinf(angle),
+                                    video::SColor(255, 255, 255, 255),
+                                    0, 0);
+            buffer->Vertices_Standard.push_back(vertex);
+            unsigned int first = std::min((unsigned int)(height * 4),
+                                          num_joints - 1);
+            unsigned int n = std::min(v % 3 + 1, num_joints - first);
+            for (unsigned int k = 0; k < n; k++)
+            {
+                scene::ISkinnedMesh::SWeight *weight =
+                    mesh->addWeight(joints[first + k]);
+                weight->buffer_id = b;
+                weight->vertex_id = v;
+                weight->strength  = 1.0f / n;
+            }
+        }
+    }
+    mesh->finalize();
+
+    // The bind pose, before any skinning happens
+    std::vector<core::vector3df> static_pos, static_normal;
+    for (unsigned int b = 0; b < 2; b++)
+    {
+        for (unsigned int v = 0; v < num_vertices; v++)
+        {
+            static_pos.push_back(mesh->getMeshBuffer(b)->getPosition(v));
+            static_normal.push_back(mesh->getMeshBuffer(b)->getNormal(v));
+        }
+    }
+
+    const unsigned int num_karts = 32;
+    std::vector<STKAnimatedMesh*> nodes;
+    for (unsigned int i = 0; i < num_karts; i++)
+    {
+        scene::CSkinnedMesh *copy = mesh->clone();
+        STKAnimatedMesh *node =
+            new STKAnimatedMesh(copy, sm->getRootSceneNode(), sm, -1,
+                                "skinning-test");
+        copy->drop();
+        node->drop();
+        node->setFrameLoop(0, 30);
+        node->setAnimationSpeed(20.0f + i);
+        node->setCurrentFrame((float)i);
+        if (i % 4 == 3)
+            node->setAnimationStrength(0.5f);
+        nodes.push_back(node);
+    }
+
+    const unsigned int num_frames = 100;
+    double start = StkTime::getRealTime();
+    for (unsigned int frame = 0; frame < num_frames; frame++)
+    {
+        for (unsigned int i = 0; i < num_karts; i++)
+            nodes[i]->OnAnimate(1000 + frame * 16);
+        skinQueuedMeshes();
+    }
+    double skin_time = StkTime::getRealTime() - start;
+    assert(m_skinning_queue.empty());
+
+    for (unsigned int i = 0; i < num_karts; i++)
+    {
+        scene::CSkinnedMesh *copy =
+            static_cast<scene::CSkinnedMesh*>(nodes[i]->getMesh());
+        assert(copy->getSkinnedVertexCount() == 2 * num_vertices);
+        float strength = nodes[i]->getAnimationStrength();
+        std::vector<core::vector3df> pos(static_pos.size(),
+                                         core::vector3df(0, 0, 0));
+        std::vector<core::vector3df> normal = pos;
+        for (unsigned int j = 0; j < num_joints; j++)
+        {
+            const scene::ISkinnedMesh::SJoint *joint =
+                copy->getAllJoints()[j];
+            core::matrix4 m;
+            m.setbyproduct(joint->GlobalAnimatedMatrix,
+                           joint->GlobalInversedMatrix);
+            for (unsigned int k = 0; k < joint->Weights.size(); k++)
+            {
+                const scene::ISkinnedMesh::SWeight &w = joint->Weights[k];
+                unsigned int index = w.buffer_id * num_vertices + w.vertex_id;
+                core::vector3df p, n;
+                m.transformVect(p, static_pos[index]);
+                m.rotateVect(n, static_normal[index]);
+                p = core::lerp(static_pos[index], p, strength);
+                n = core::lerp(static_normal[index], n, strength);
+                pos[index]    += p * w.strength;
+                normal[index] += n * w.strength;
+            }
+        }
+        for (unsigned int b = 0; b < 2; b++)
+        {
+            for (unsigned int v = 0; v < num_vertices; v++)
+            {
+                unsigned int index = b * num_vertices + v;
+                const scene::IMeshBuffer *mb = copy->getMeshBuffer(b);
+                assert(mb->getPosition(v).equals(pos[index], 0.001f));
+                assert(mb->getNormal(v).equals(normal[index], 0.001f));
+            }
+        }
+        nodes[i]->remove();
+    }
+    mesh->drop();
+
+    Log::info("STKAnimatedMesh", "Skinning %u karts with %u vertices each: "
+              "%f ms per frame.", num_karts, 2 * num_vertices,
+              skin_time * 1000.0 / num_frames);
+}   // unitTesting
@@ -25,6 +25,8 @@
 #include <IAnimatedMesh.h>
 #include <irrTypes.h>
 
+#include <vector>
+
 class RenderInfo;
 
 class STKAnimatedMesh : public irr::scene::CAnimatedMeshSceneNode, public STKMeshCommon
@@ -47,11 +49,21 @@ public:
   ~STKAnimatedMesh();
 
   virtual void render();
+  virtual void OnAnimate(irr::u32 time_ms);
   virtual void setMesh(irr::scene::IAnimatedMesh* mesh);
   virtual bool glow() const { return false; }
+  static void skinQueuedMeshes();
+  static void unitTesting();
 private:
     RenderInfo* m_mesh_render_info;
     bool m_all_parts_colorized;
+
+    /** True if this node is in m_skinning_queue. */
+    bool m_skinning_queued;
+
+    /** Nodes whose skinned mesh still has to be updated for the current
+     *  frame, see OnAnimate(). */
+    static std::vector<STKAnimatedMesh*> m_skinning_queue;
 };
 
 #endif // STKANIMATEDMESH_HPP
@@ -19,6 +19,7 @@
 
 #include "graphics/callbacks.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/culling_tree.hpp"
 #include "graphics/glwrap.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/lod_node.hpp"
@@ -235,6 +236,16 @@ static void addEdge(const core::vector3df &P0, const core::vector3df &P1)
     BoundingBoxes.push_back(P1.Z);
 }
 
+/** The frusta that are culled against in handleSTKCommon, in the order
+ *  they are passed to the culling tree. */
+enum CullingFrustum
+{
+    CULL_CAMERA = 0,
+    CULL_SHADOW_CASCADE_0 = 1,
+    CULL_RSM = 5,
+    CULL_COUNT = 6
+};
+
 static
 bool isCulledPrecise(const scene::ICameraSceneNode *cam, const scene::ISceneNode *node)
 {
@@ -257,7 +268,6 @@ bool isCulledPrecise(const scene::ICameraSceneNode *cam, const scene::ISceneNode
 
 static void
 handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *ImmediateDraw,
-    const scene::ICameraSceneNode *cam, scene::ICameraSceneNode *shadowcam[4], const scene::ICameraSceneNode *rsmcam,
     bool &culledforcam, bool culledforshadowcam[4], bool &culledforrsm, bool drawRSM)
 {
     STKMeshCommon *node = dynamic_cast<STKMeshCommon*>(Node);
@@ -269,10 +279,23 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
 
     const core::matrix4 &trans = Node->getAbsoluteTransformation();
 
+    // Static track nodes were already culled in the culling tree. Nodes
+    // without automatic culling (e.g. karts) are never culled.
+    CullingTree *culling_tree = irr_driver->getCullingTree();
+    unsigned int culled = 0;
+    bool auto_culling = Node->getAutomaticCulling() != scene::EAC_OFF;
+    bool is_static    = auto_culling &&
+                        culling_tree->getCullMask(Node, trans,
+                                                  Node->getBoundingBox(),
+                                                  &culled);
+
     core::vector3df edges[8];
-    Node->getBoundingBox().getEdges(edges);
-    for (unsigned i = 0; i < 8; i++)
-        trans.transformVect(edges[i]);
+    if ((auto_culling && !is_static) || irr_driver->getBoundingBoxesViz())
+    {
+        Node->getBoundingBox().getEdges(edges);
+        for (unsigned i = 0; i < 8; i++)
+            trans.transformVect(edges[i]);
+    }
 
     /* From irrlicht
        /3--------/7
@@ -307,10 +330,13 @@ handleSTKCommon(scene::ISceneNode *Node, std::vector<scene::ISceneNode *> *Immed
         return;
     }
 
-    culledforcam = culledforcam || isCulledPrecise(cam, Node);
-    culledforrsm = culledforrsm || isCulledPrecise(rsmcam, Node);
+    if (auto_culling && !is_static)
+        culled = culling_tree->cullEdges(edges);
+    culledforcam = culledforcam || (culled & (1 << CULL_CAMERA)) != 0;
+    culledforrsm = culledforrsm || (culled & (1 << CULL_RSM)) != 0;
     for (unsigned i = 0; i < 4; i++)
-        culledforshadowcam[i] = culledforshadowcam[i] || isCulledPrecise(shadowcam[i], Node);
+        culledforshadowcam[i] = culledforshadowcam[i] ||
+                                (culled & (1 << (CULL_SHADOW_CASCADE_0 + i))) != 0;
 
     // Transparent
 
@@ -573,7 +599,7 @@ parseSceneManager(core::list<scene::ISceneNode*> &List, std::vector<scene::IScen
         bool newculledforrsm = culledforrsm;
         bool newculledforshadowcam[4] = { culledforshadowcam[0], culledforshadowcam[1], culledforshadowcam[2], culledforshadowcam[3] };
 
-        handleSTKCommon(*I, ImmediateDraw, cam, shadow_cam, rsmcam, newculledforcam, newculledforshadowcam, newculledforrsm, drawRSM);
+        handleSTKCommon(*I, ImmediateDraw, newculledforcam, newculledforshadowcam, newculledforrsm, drawRSM);
 
         parseSceneManager(const_cast<core::list<scene::ISceneNode*>& >((*I)->getChildren()), ImmediateDraw, cam, shadow_cam, rsmcam, newculledforcam, newculledforshadowcam, newculledforrsm, drawRSM);
     }
@@ -639,6 +665,17 @@ PROFILER_PUSH_CPU_MARKER("- culling", 0xFF, 0xFF, 0x0);
     for (scene::ISceneNode *child : List)
         FixBoundingBoxes(child);
 
+    const scene::SViewFrustum *frusta[CULL_COUNT];
+    frusta[CULL_CAMERA] = camnode->getViewFrustum();
+    for (unsigned i = 0; i < 4; i++)
+    {
+        scene::ICameraSceneNode *shadow_cam = getShadowMatrices()->getShadowCamNodes()[i];
+        frusta[CULL_SHADOW_CASCADE_0 + i] = shadow_cam ? shadow_cam->getViewFrustum() : frusta[CULL_CAMERA];
+    }
+    frusta[CULL_RSM] = getShadowMatrices()->getSunCam()->getViewFrustum();
+    m_culling_tree->setFrusta(frusta, CULL_COUNT);
+    m_culling_tree->update();
+
     bool cam = false, rsmcam = false;
     bool shadowcam[4] = { false, false, false, false };
     parseSceneManager(List, ImmediateDrawList::getInstance(), camnode, 
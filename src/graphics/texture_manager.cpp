@@ -94,11 +94,24 @@ void compressTexture(irr::video::ITexture *tex, bool srgb, bool premul_alpha)
 
     if (premul_alpha)
     {
+        // There are only 256 different alpha values, so compute the
+        // (expensive) gamma corrected factors only once
+        static float alpha_factor[256];
+        static bool  alpha_factor_initialised = false;
+        if (!alpha_factor_initialised)
+        {
+            for (unsigned i = 0; i < 256; i++)
+            {
+                float alpha = (float)i;
+                if (alpha > 0.)
+                    alpha = pow(alpha / 255.f, 1.f / 2.2f);
+                alpha_factor[i] = alpha;
+            }
+            alpha_factor_initialised = true;
+        }
         for (unsigned i = 0; i < w * h; i++)
         {
-            float alpha = data[4 * i + 3];
-            if (alpha > 0.)
-                alpha = pow(alpha / 255.f, 1.f / 2.2f);
+            float alpha = alpha_factor[data[4 * i + 3]];
             data[4 * i] = (unsigned char)(data[4 * i] * alpha);
             data[4 * i + 1] = (unsigned char)(data[4 * i + 1] * alpha);
             data[4 * i + 2] = (unsigned char)(data[4 * i + 2] * alpha);
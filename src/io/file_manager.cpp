@@ -28,9 +28,12 @@
 #include "utils/command_line.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/types.hpp"
 
 #include <irrlicht.h>
 
+#include <algorithm>
+#include <assert.h>
 #include <stdio.h>
 #include <stdexcept>
 #include <sstream>
@@ -115,6 +118,8 @@ FileManager* file_manager = 0;
  */
 FileManager::FileManager()
 {
+    m_num_directory_reads = 0;
+    m_num_exist_calls     = 0;
     m_subdir_name.resize(ASSET_COUNT);
     m_subdir_name[CHALLENGE  ] = "challenges";
     m_subdir_name[GFX        ] = "gfx";
@@ -216,6 +221,7 @@ FileManager::FileManager()
     checkAndCreateScreenshotDir();
     checkAndCreateReplayDir();
     checkAndCreateCachedTexturesDir();
+    checkAndCreateCachedMeshesDir();
     checkAndCreateGPDir();
 
     redirectOutput();
@@ -542,6 +548,7 @@ void FileManager::popTextureSearchPath()
         std::string dir = m_texture_search_path.back();
         m_texture_search_path.pop_back();
         m_file_system->removeFileArchive(createAbsoluteFilename(dir));
+        removeDirectoryIndex(dir);
     }
 }   // popTextureSearchPath
 
@@ -565,9 +572,11 @@ void FileManager::popMusicSearchPath()
 {
     if(!m_music_search_path.empty())
     {
+        std::string dir = m_music_search_path.back();
         m_music_search_path.pop_back();
+        removeDirectoryIndex(dir);
     }
-}
+}   // popMusicSearchPath
 
 //-----------------------------------------------------------------------------
 /** Tries to find the specified file in any of the given search paths.
@@ -586,19 +595,257 @@ bool FileManager::findFile(std::string& full_path,
         i != search_path.rend(); ++i)
     {
         full_path = *i + file_name;
-        if(m_file_system->existFile(full_path.c_str())) return true;
+        if(fileExistsIndexed(full_path)) return true;
     }
     full_path="";
     return false;
 }   // findFile
 
+//-----------------------------------------------------------------------------
+/** Returns true if the given file exists. The content of the directory of
+ *  the file is read once and cached in m_directory_index, so that
+ *  searching files in the same directories again (e.g. all textures of a
+ *  track in all texture search paths) does not need any system calls.
+ *  This must only be used for directories whose content is not changed by
+ *  STK while it is running (or clearDirectoryIndex() must be called).
+ *  \param path Full path of the file to test.
+ */
+bool FileManager::fileExistsIndexed(const std::string &path) const
+{
+#ifdef ANDROID
+    // Assets are read from the apk, there is no directory to list.
+    return m_file_system->existFile(path.c_str());
+#else
+#  ifdef WIN32
+    std::string::size_type slash = path.find_last_of("/\\");
+#  else
+    std::string::size_type slash = path.find_last_of('/');
+#  endif
+    if(slash==std::string::npos || slash+1==path.size())
+        return m_file_system->existFile(path.c_str());
+
+    std::string dir  = path.substr(0, slash+1);
+    std::string name = path.substr(slash+1);
+
+    m_directory_index.lock();
+    std::map<std::string, DirectoryIndex> &all = m_directory_index.getData();
+    std::map<std::string, DirectoryIndex>::iterator i = all.find(dir);
+    if(i==all.end())
+    {
+        i = all.insert(std::make_pair(dir, DirectoryIndex())).first;
+        readDirectoryIndex(dir, &i->second);
+    }
+    const DirectoryIndex &index = i->second;
+    bool valid  = index.m_valid;
+    bool exists = false;
+    if(valid)
+    {
+        if(index.m_fold_case)
+            name = StringUtils::toLowerCase(name);
+        exists = index.m_files.find(name)!=index.m_files.end();
+    }
+    else
+        m_num_exist_calls++;
+    m_directory_index.unlock();
+
+    if(!valid)
+        return m_file_system->existFile(path.c_str());
+    return exists;
+#endif
+}   // fileExistsIndexed
+
+//-----------------------------------------------------------------------------
+/** Reads the names of all files in the given directory.
+ *  \param dir The directory to read.
+ *  \param index On return contains all file names, and is marked as not
+ *         valid if the directory could not be read.
+ */
+void FileManager::readDirectoryIndex(const std::string &dir,
+                                     DirectoryIndex *index) const
+{
+    index->m_files.clear();
+    index->m_valid     = false;
+    index->m_fold_case = false;
+    m_num_directory_reads++;
+#if defined(WIN32)
+    index->m_fold_case = true;
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA((dir+"*").c_str(), &data);
+    if(h==INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        index->m_files.insert(StringUtils::toLowerCase(data.cFileName));
+    } while(FindNextFileA(h, &data));
+    FindClose(h);
+#elif !defined(ANDROID)
+#  ifdef __APPLE__
+    // HFS+ and APFS volumes are usually case insensitive, but can be
+    // formatted case sensitive. If it can't be determined, the directory
+    // is not indexed, so that the file system decides.
+    long case_sensitive = pathconf(dir.c_str(), _PC_CASE_SENSITIVE);
+    if(case_sensitive<0)
+        return;
+    index->m_fold_case = case_sensitive==0;
+#  endif
+    DIR *d = opendir(dir.c_str());
+    if(!d)
+        return;
+    while(struct dirent *entry = readdir(d))
+    {
+        if(index->m_fold_case)
+            index->m_files.insert(StringUtils::toLowerCase(entry->d_name));
+        else
+            index->m_files.insert(entry->d_name);
+    }
+    closedir(d);
+#endif
+    index->m_valid = true;
+}   // readDirectoryIndex
+
+//-----------------------------------------------------------------------------
+/** Removes the cached content of a directory and its subdirectories, unless
+ *  the directory is still part of a search path. Called when a search path
+ *  is popped.
+ *  \param dir The directory that is not searched anymore.
+ */
+void FileManager::removeDirectoryIndex(const std::string &dir)
+{
+    if(std::find(m_texture_search_path.begin(), m_texture_search_path.end(),
+                 dir) != m_texture_search_path.end() ||
+       std::find(m_music_search_path.begin(), m_music_search_path.end(),
+                 dir) != m_music_search_path.end())
+        return;
+
+    m_directory_index.lock();
+    std::map<std::string, DirectoryIndex> &all = m_directory_index.getData();
+    std::map<std::string, DirectoryIndex>::iterator i = all.lower_bound(dir);
+    while(i!=all.end() && i->first.compare(0, dir.size(), dir)==0)
+        all.erase(i++);
+    m_directory_index.unlock();
+}   // removeDirectoryIndex
+
+//-----------------------------------------------------------------------------
+/** Discards the cached content of all directories. This must be called
+ *  whenever files are added to or removed from any asset directory, e.g.
+ *  when an addon is installed or removed.
+ */
+void FileManager::clearDirectoryIndex()
+{
+    m_directory_index.lock();
+    m_directory_index.getData().clear();
+    m_directory_index.unlock();
+}   // clearDirectoryIndex
+
+//-----------------------------------------------------------------------------
+/** Searches files in three directories with and without the directory
+ *  index, checks that both give the same results, and compares the number
+ *  of system calls. Also checks that the index is invalidated by
+ *  clearDirectoryIndex() and when a search path is popped.
+ */
+void FileManager::unitTesting()
+{
+    FileManager *fm = file_manager;
+    const std::string base = fm->getUserConfigFile("file-index-test/");
+    std::vector<std::string> search_path;
+    for(unsigned int d=0; d<3; d++)
+    {
+        search_path.push_back(base + StringUtils::insertValues("%d/", d));
+        if(!fm->checkAndCreateDirectoryP(search_path.back()))
+        {
+            Log::warn("FileManager", "Can't create '%s', test skipped.",
+                      search_path.back().c_str());
+            return;
+        }
+    }
+
+    // 100 files in each directory, and searches for all of them, for
+    // some with a different case and for some that don't exist.
+    const unsigned int NUM_FILES = 300;
+    std::vector<std::string> names;
+    for(unsigned int i=0; i<NUM_FILES; i++)
+    {
+        std::string name = StringUtils::insertValues("texture_%d.png", i);
+        FILE *f = fopen((search_path[i/100]+name).c_str(), "w");
+        assert(f);
+        fclose(f);
+        names.push_back(name);
+    }
+    for(unsigned int i=0; i<NUM_FILES; i+=10)
+        names.push_back(StringUtils::insertValues("Texture_%d.PNG", i));
+    for(unsigned int i=0; i<50; i++)
+        names.push_back(StringUtils::insertValues("missing_%d.png", i));
+
+    // Before: one existFile call for each directory until the file is found
+    fm->clearDirectoryIndex();
+    unsigned int num_exist_before = 0;
+    std::vector<bool> found(names.size());
+    for(unsigned int n=0; n<names.size(); n++)
+    {
+        found[n] = false;
+        for(int i=(int)search_path.size()-1; i>=0 && !found[n]; i--)
+        {
+            num_exist_before++;
+            found[n] = fm->m_file_system->existFile((search_path[i]
+                                                     +names[n]).c_str());
+        }
+    }
+
+    // After: one read of each directory
+    unsigned int start_reads = fm->m_num_directory_reads;
+    unsigned int start_exist = fm->m_num_exist_calls;
+    for(unsigned int n=0; n<names.size(); n++)
+    {
+        std::string full_path;
+        bool result = fm->findFile(full_path, names[n], search_path);
+        assert(result==found[n]);
+        assert(n>=NUM_FILES || full_path==search_path[n/100]+names[n]);
+    }
+    unsigned int num_reads = fm->m_num_directory_reads - start_reads;
+    unsigned int num_exist = fm->m_num_exist_calls     - start_exist;
+    assert(num_reads==search_path.size() && num_exist==0);
+    Log::info("FileManager", "%d searches in %d directories: %d file system "
+              "calls before, %d directory reads and %d calls with the index.",
+              (int)names.size(), (int)search_path.size(), num_exist_before,
+              num_reads, num_exist);
+
+    // A new file is only found after the index is cleared
+    std::string full_path;
+    std::string new_file = search_path[0] + "new.png";
+    FILE *f = fopen(new_file.c_str(), "w");
+    assert(f);
+    fclose(f);
+    assert(!fm->findFile(full_path, "new.png", search_path));
+    fm->clearDirectoryIndex();
+    assert(fm->findFile(full_path, "new.png", search_path));
+    fm->removeFile(new_file);
+
+    // Popping a texture search path drops the index of that directory
+    fm->pushTextureSearchPath(search_path[1]);
+    assert(fm->searchTexture("new.png")=="");
+    f = fopen((search_path[1] + "new.png").c_str(), "w");
+    assert(f);
+    fclose(f);
+    assert(fm->searchTexture("new.png")=="");
+    fm->popTextureSearchPath();
+    fm->pushTextureSearchPath(search_path[1]);
+    assert(fm->searchTexture("new.png")==search_path[1]+"new.png");
+    fm->popTextureSearchPath();
+    fm->removeFile(search_path[1] + "new.png");
+
+    for(unsigned int d=0; d<search_path.size(); d++)
+        fm->removeDirectory(search_path[d]);
+    fm->removeDirectory(base);
+    fm->clearDirectoryIndex();
+}   // unitTesting
+
 //-----------------------------------------------------------------------------
 std::string FileManager::getAssetChecked(FileManager::AssetType type,
                                          const std::string& name,
                                          bool abort_on_error) const
 {
     std::string path = m_subdir_name[type]+name;
-    if(fileExists(path))
+    if(fileExistsIndexed(path))
         return path;
 
     if(abort_on_error)
@@ -971,6 +1218,31 @@ void FileManager::checkAndCreateCachedTexturesDir()
 
 }   // checkAndCreateCachedTexturesDir
 
+// ----------------------------------------------------------------------------
+/** Creates the directories for cooked meshes (see CookedMesh). This will set
+ *  m_cached_meshes_dir with the appropriate path.
+ */
+void FileManager::checkAndCreateCachedMeshesDir()
+{
+#if defined(WIN32) || defined(__CYGWIN__)
+    m_cached_meshes_dir = m_user_config_dir + "cached-meshes/";
+#elif defined(__APPLE__)
+    m_cached_meshes_dir = getenv("HOME");
+    m_cached_meshes_dir += "/Library/Application Support/SuperTuxKart/CachedMeshes/";
+#else
+    m_cached_meshes_dir = checkAndCreateLinuxDir("XDG_CACHE_HOME", "supertuxkart", ".cache/", ".");
+    m_cached_meshes_dir += "cached-meshes/";
+#endif
+
+    if (!checkAndCreateDirectory(m_cached_meshes_dir))
+    {
+        Log::error("FileManager", "Can not create cached meshes directory '%s', "
+            "falling back to '.'.", m_cached_meshes_dir.c_str());
+        m_cached_meshes_dir = ".";
+    }
+
+}   // checkAndCreateCachedMeshesDir
+
 // ----------------------------------------------------------------------------
 /** Creates the directories for user-defined grand prix. This will set m_gp_dir
  *  with the appropriate path.
@@ -1157,6 +1429,41 @@ std::string FileManager::getTextureCacheLocation(const std::string& filename)
     return cached_file;
 }   // getTextureCacheLocation
 
+//-----------------------------------------------------------------------------
+/** Returns the name of the cooked version of a mesh file (see CookedMesh).
+ *  The cooked files of all meshes in one directory are stored in their own
+ *  cache directory. Its name is the name of the mesh directory plus a hash
+ *  of its full path, so meshes with the same name in different tracks or
+ *  karts (even in directories with the same name) do not overwrite each
+ *  other.
+ *  \param filename Full path of the mesh file.
+ */
+std::string FileManager::getMeshCacheLocation(const std::string& filename)
+{
+    std::string file = StringUtils::getBasename(filename);
+
+    std::string parent_dir = StringUtils::getPath(filename);
+    if (StringUtils::hasSuffix(parent_dir, "/"))
+        parent_dir = parent_dir.substr(0, parent_dir.size() - 1);
+
+    // 32 bit FNV-1a hash of the full path of the directory
+    uint32_t hash = 2166136261u;
+    for (unsigned int i = 0; i < parent_dir.size(); i++)
+    {
+        hash ^= (unsigned char)parent_dir[i];
+        hash *= 16777619u;
+    }
+    char hash_string[9];
+    sprintf(hash_string, "%08x", hash);
+
+    std::string cached_file = m_cached_meshes_dir
+                            + StringUtils::getBasename(parent_dir) + "-"
+                            + hash_string + "/";
+    checkAndCreateDirectoryP(cached_file);
+    cached_file += file + ".cooked";
+    return cached_file;
+}   // getMeshCacheLocation
+
 //-----------------------------------------------------------------------------
 /** Returns the directory for addon files. */
 const std::string &FileManager::getAddonsDir() const
@@ -1390,3 +1697,16 @@ bool FileManager::fileIsNewer(const std::string& f1, const std::string& f2) cons
     return stat1.st_mtime > stat2.st_mtime;
 }   // fileIsNewer
 
+// ----------------------------------------------------------------------------
+/** Returns the modification time of a file, or 0 if the file does not
+ *  exist.
+ *  \param name Full path of the file.
+ */
+time_t FileManager::getFileModificationTime(const std::string &name) const
+{
+    struct stat s;
+    if (stat(name.c_str(), &s) != 0)
+        return 0;
+    return s.st_mtime;
+}   // getFileModificationTime
+
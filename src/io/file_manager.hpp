@@ -25,9 +25,12 @@
  * Contains generic utility classes for file I/O (especially XML handling).
  */
 
+#include <ctime>
+#include <map>
 #include <string>
 #include <vector>
 #include <set>
+#include <unordered_set>
 
 #include <irrString.h>
 #include <IFileSystem.h>
@@ -36,6 +39,7 @@ using namespace irr;
 
 #include "io/xml_node.hpp"
 #include "utils/no_copy.hpp"
+#include "utils/synchronised.hpp"
 
 /**
   * \brief class handling files and paths
@@ -81,6 +85,9 @@ private:
     /** Directory where resized textures are cached. */
     std::string       m_cached_textures_dir;
 
+    /** Directory where cooked meshes are cached. */
+    std::string       m_cached_meshes_dir;
+
     /** Directory where user-defined grand prix are stored. */
     std::string       m_gp_dir;
 
@@ -88,20 +95,51 @@ private:
                       m_texture_search_path,
                       m_model_search_path,
                       m_music_search_path;
+
+    /** The list of all files in a directory that is searched for assets. */
+    struct DirectoryIndex
+    {
+        /** False if the directory could not be read, in which case the
+         *  file system is asked directly. */
+        bool                            m_valid;
+        /** True if the file system of this directory ignores the case of
+         *  names, in which case all names are stored in lower case. */
+        bool                            m_fold_case;
+        /** Names of all files and directories in this directory. */
+        std::unordered_set<std::string> m_files;
+    };   // DirectoryIndex
+
+    /** Caches the content of all directories in which assets are searched
+     *  (search paths and asset directories), so that searching a file in
+     *  several directories does not need a system call for each of them.
+     *  Indexed by directory name (including the trailing '/'). */
+    mutable Synchronised<std::map<std::string, DirectoryIndex> >
+                      m_directory_index;
+
+    /** Number of directories read and of files tested directly (because
+     *  their directory could not be read) for m_directory_index. Protected
+     *  by the m_directory_index mutex, used by the unit test. */
+    mutable unsigned int m_num_directory_reads;
+    mutable unsigned int m_num_exist_calls;
+
     bool              findFile(std::string& full_path,
                                const std::string& fname,
                                const std::vector<std::string>& search_path)
                                const;
+    bool              fileExistsIndexed(const std::string &path) const;
+    void              readDirectoryIndex(const std::string &dir,
+                                         DirectoryIndex *index) const;
+    void              removeDirectoryIndex(const std::string &dir);
     void              makePath(std::string& path, const std::string& dir,
                                const std::string& fname) const;
     bool              checkAndCreateDirectory(const std::string &path);
     io::path          createAbsoluteFilename(const std::string &f);
     void              checkAndCreateConfigDir();
-    bool              isDirectory(const std::string &path) const;
     void              checkAndCreateAddonsDir();
     void              checkAndCreateScreenshotDir();
     void              checkAndCreateReplayDir();
     void              checkAndCreateCachedTexturesDir();
+    void              checkAndCreateCachedMeshesDir();
     void              checkAndCreateGPDir();
     void              discoverPaths();
 #if !defined(WIN32) && !defined(__CYGWIN__) && !defined(__APPLE__)
@@ -126,6 +164,8 @@ public:
     std::string       getCachedTexturesDir() const;
     std::string       getGPDir() const;
     std::string       getTextureCacheLocation(const std::string& filename);
+    std::string       getMeshCacheLocation(const std::string& filename);
+    bool              isDirectory(const std::string &path) const;
     bool              checkAndCreateDirectoryP(const std::string &path);
     const std::string &getAddonsDir() const;
     std::string        getAddonsFile(const std::string &name);
@@ -170,9 +210,12 @@ public:
     void       popTextureSearchPath();
     void       popModelSearchPath();
     void       popMusicSearchPath();
+    void       clearDirectoryIndex();
+    static void unitTesting();
     void       redirectOutput();
 
     bool       fileIsNewer(const std::string& f1, const std::string& f2) const;
+    time_t     getFileModificationTime(const std::string &name) const;
 
     // ------------------------------------------------------------------------
     /** Returns the irrlicht file system. */
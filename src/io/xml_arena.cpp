@@ -0,0 +1,210 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "io/xml_arena.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    /** Size of the first block of a document. Most XML files in STK are
+     *  small, bigger documents get bigger blocks. */
+    const size_t FIRST_BLOCK_SIZE = 4*1024;
+    /** Maximum size of a block (unless a single allocation is bigger). */
+    const size_t MAX_BLOCK_SIZE   = 256*1024;
+    /** Alignment of all allocations. */
+    const size_t ALIGNMENT        = sizeof(void*) > sizeof(double)
+                                  ? sizeof(void*) : sizeof(double);
+}   // namespace
+
+// ----------------------------------------------------------------------------
+XMLArena::XMLArena(const std::string &file_name)
+{
+    m_file_name       = file_name;
+    m_current         = NULL;
+    m_available       = 0;
+    m_next_block_size = FIRST_BLOCK_SIZE;
+    m_allocated_bytes = 0;
+}   // XMLArena
+
+// ----------------------------------------------------------------------------
+XMLArena::~XMLArena()
+{
+    for(unsigned int i=0; i<m_blocks.size(); i++)
+        delete [] m_blocks[i];
+    m_blocks.clear();
+}   // ~XMLArena
+
+// ----------------------------------------------------------------------------
+/** Allocates a new block of at least the given size and makes it the
+ *  current block.
+ *  \param size Minimum number of bytes needed.
+ */
+char *XMLArena::allocateBlock(size_t size)
+{
+    size_t block_size = std::max(size, m_next_block_size);
+    char *block = new char[block_size];
+    m_blocks.push_back(block);
+    m_allocated_bytes += block_size;
+    m_current   = block;
+    m_available = block_size;
+    if(m_next_block_size < MAX_BLOCK_SIZE)
+        m_next_block_size *= 2;
+    return block;
+}   // allocateBlock
+
+// ----------------------------------------------------------------------------
+/** Returns size bytes of memory, aligned so that any of the data structures
+ *  of a document can be stored. The memory is freed when the arena is
+ *  deleted.
+ *  \param size Number of bytes to allocate.
+ */
+void *XMLArena::allocate(size_t size)
+{
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if(size > m_available)
+        allocateBlock(size);
+    void *p      = m_current;
+    m_current   += size;
+    m_available -= size;
+    return p;
+}   // allocate
+
+// ----------------------------------------------------------------------------
+/** Returns the id of a name, adding it if it was not seen before. The name
+ *  is converted to a narrow string the same way core::stringc does it.
+ *  \param name The wide name to intern.
+ */
+uint32_t XMLArena::intern(const wchar_t *name)
+{
+    m_name_buffer.clear();
+    for(const wchar_t *p=name; *p; p++)
+        m_name_buffer.push_back((char)*p);
+
+    std::unordered_map<std::string, uint32_t>::const_iterator i =
+        m_name_ids.find(m_name_buffer);
+    if(i!=m_name_ids.end())
+        return i->second;
+
+    uint32_t id = (uint32_t)m_names.size();
+    m_names.push_back(m_name_buffer);
+    m_name_ids[m_name_buffer] = id;
+    return id;
+}   // intern
+
+// ----------------------------------------------------------------------------
+/** Returns the id of the given name, or -1 if this name does not appear
+ *  anywhere in the document.
+ *  \param name The name to look up.
+ */
+int XMLArena::findName(const std::string &name) const
+{
+    std::unordered_map<std::string, uint32_t>::const_iterator i =
+        m_name_ids.find(name);
+    return i==m_name_ids.end() ? -1 : (int)i->second;
+}   // findName
+
+// ----------------------------------------------------------------------------
+/** Stores a wide attribute value as UTF-8 in the arena. Each wchar_t is
+ *  encoded on its own (surrogates are not combined), so toWide() returns
+ *  exactly the original string for all values up to 0x1FFFFF.
+ *  \param value The value to store.
+ *  \param attribute The attribute whose value and length is set.
+ */
+void XMLArena::storeValue(const wchar_t *value, Attribute *attribute)
+{
+    size_t length   = 0;
+    bool   is_ascii = true;
+    for(const wchar_t *p=value; *p; p++)
+    {
+        uint32_t c = (uint32_t)*p;
+        if     (c < 0x80)    length += 1;
+        else if(c < 0x800)   length += 2;
+        else if(c < 0x10000) length += 3;
+        else                 length += 4;
+        if(c >= 0x80) is_ascii = false;
+    }
+
+    char *out = static_cast<char*>(allocate(length+1));
+    attribute->m_value    = out;
+    attribute->m_length   = (uint32_t)length;
+    attribute->m_is_ascii = is_ascii ? 1 : 0;
+
+    for(const wchar_t *p=value; *p; p++)
+    {
+        uint32_t c = (uint32_t)*p;
+        if(c < 0x80)
+        {
+            *out++ = (char)c;
+        }
+        else if(c < 0x800)
+        {
+            *out++ = (char)(0xC0 |  (c >> 6));
+            *out++ = (char)(0x80 |  (c        & 0x3F));
+        }
+        else if(c < 0x10000)
+        {
+            *out++ = (char)(0xE0 |  (c >> 12));
+            *out++ = (char)(0x80 | ((c >>  6) & 0x3F));
+            *out++ = (char)(0x80 |  (c        & 0x3F));
+        }
+        else
+        {
+            *out++ = (char)(0xF0 | ((c >> 18) & 0x07));
+            *out++ = (char)(0x80 | ((c >> 12) & 0x3F));
+            *out++ = (char)(0x80 | ((c >>  6) & 0x3F));
+            *out++ = (char)(0x80 |  (c        & 0x3F));
+        }
+    }
+    *out = 0;
+}   // storeValue
+
+// ----------------------------------------------------------------------------
+/** Converts the UTF-8 value of an attribute back into the wide string it
+ *  was created from.
+ *  \param attribute The attribute to convert.
+ */
+core::stringw XMLArena::toWide(const Attribute &attribute)
+{
+    core::stringw result;
+    result.reserve(attribute.m_length+1);
+    const unsigned char *p   = (const unsigned char*)attribute.m_value;
+    const unsigned char *end = p + attribute.m_length;
+    while(p<end)
+    {
+        uint32_t c = *p++;
+        if(c >= 0xF0)
+        {
+            c = ((c & 0x07) << 18) | ((p[0] & 0x3F) << 12)
+              | ((p[1] & 0x3F) << 6) |  (p[2] & 0x3F);
+            p += 3;
+        }
+        else if(c >= 0xE0)
+        {
+            c = ((c & 0x0F) << 12) | ((p[0] & 0x3F) << 6) | (p[1] & 0x3F);
+            p += 2;
+        }
+        else if(c >= 0xC0)
+        {
+            c = ((c & 0x1F) << 6) | (p[0] & 0x3F);
+            p += 1;
+        }
+        result.append((wchar_t)c);
+    }
+    return result;
+}   // toWide
@@ -0,0 +1,126 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_XML_ARENA_HPP
+#define HEADER_XML_ARENA_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <irrString.h>
+using namespace irr;
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+class XMLNode;
+
+/**
+  * \brief Storage shared by all XMLNodes of one XML document.
+  *  All nodes, attribute arrays and attribute values of a document are
+  *  allocated from a small number of memory blocks, which are all freed
+  *  together when the root node is deleted. Element and attribute names
+  *  are interned into integer ids, so that looking up an attribute only
+  *  compares integers. Values are stored as 0-terminated UTF-8 strings
+  *  and only parsed when a get() function asks for them.
+  * \ingroup io
+  */
+class XMLArena : public NoCopy
+{
+public:
+    /** One attribute of a node. The value points into the arena. */
+    struct Attribute
+    {
+        /** The 0-terminated UTF-8 encoded value. */
+        const char *m_value;
+        /** Id of the interned attribute name. */
+        uint32_t    m_name;
+        /** Length of the value in bytes (without the terminating 0). */
+        uint32_t    m_length : 31;
+        /** True if the value only contains 7-bit characters, in which
+         *  case no conversion is necessary to get a narrow string. */
+        uint32_t    m_is_ascii : 1;
+    };   // Attribute
+
+private:
+    /** All memory blocks allocated. */
+    std::vector<char*>       m_blocks;
+
+    /** Next free byte in the current block. */
+    char                    *m_current;
+
+    /** Number of bytes still available in the current block. */
+    size_t                   m_available;
+
+    /** Size of the next block to allocate, grows with the document. */
+    size_t                   m_next_block_size;
+
+    /** Total number of bytes allocated in all blocks. */
+    size_t                   m_allocated_bytes;
+
+    /** All interned names, the index is the id of the name. */
+    std::vector<std::string> m_names;
+
+    /** Maps a name to its id. */
+    std::unordered_map<std::string, uint32_t> m_name_ids;
+
+    /** Temporary buffer used to convert wide names while interning. */
+    std::string              m_name_buffer;
+
+    /** Temporary stack of child nodes while a document is read. */
+    std::vector<XMLNode*>    m_node_stack;
+
+    /** Name of the file this document was read from. */
+    std::string              m_file_name;
+
+    char *allocateBlock(size_t size);
+
+public:
+                XMLArena(const std::string &file_name);
+               ~XMLArena();
+    void       *allocate(size_t size);
+    uint32_t    intern(const wchar_t *name);
+    int         findName(const std::string &name) const;
+    void        storeValue(const wchar_t *value, Attribute *attribute);
+    static core::stringw toWide(const Attribute &attribute);
+
+    // ------------------------------------------------------------------------
+    /** Allocates an uninitialised array of n elements of type T. */
+    template<typename T> T* allocateArray(unsigned int n)
+    {
+        return static_cast<T*>(allocate(n*sizeof(T)));
+    }   // allocateArray
+    // ------------------------------------------------------------------------
+    /** Returns the name with the given id. */
+    const std::string& getName(uint32_t id) const { return m_names[id]; }
+    // ------------------------------------------------------------------------
+    /** Returns the name of the file the document was read from. */
+    const std::string& getFileName() const { return m_file_name; }
+    // ------------------------------------------------------------------------
+    /** Sets the name of the file the document was read from. */
+    void setFileName(const std::string &name) { m_file_name = name; }
+    // ------------------------------------------------------------------------
+    /** Returns the stack used to collect child nodes while reading. */
+    std::vector<XMLNode*>& getNodeStack() { return m_node_stack; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of bytes allocated for this document. */
+    size_t getAllocatedBytes() const { return m_allocated_bytes; }
+};   // XMLArena
+
+#endif
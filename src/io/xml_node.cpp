@@ -22,28 +22,63 @@
 #include "utils/interpolation_array.hpp"
 #include "utils/vec3.hpp"
 
+#include <algorithm>
+#include <assert.h>
+#include <new>
 #include <stdexcept>
+#include <string.h>
 
 XMLNode::XMLNode(io::IXMLReader *xml)
 {
-    m_file_name = "[unknown]";
+    m_arena          = new XMLArena("[unknown]");
+    m_owns_arena     = true;
+    m_attributes     = NULL;
+    m_nodes          = NULL;
+    m_name           = 0;
+    m_num_attributes = 0;
+    m_num_nodes      = 0;
 
     while(xml->getNodeType()!=io::EXN_ELEMENT && xml->read());
     readXML(xml);
 }   // XMLNode
 
+// ----------------------------------------------------------------------------
+/** Creates a sub node. The node and all its data is allocated in the
+ *  arena of the document it belongs to.
+ *  \param arena The arena of the document.
+ *  \param xml The XML reader, positioned at the start of this element.
+ */
+XMLNode::XMLNode(XMLArena *arena, io::IXMLReader *xml)
+{
+    m_arena          = arena;
+    m_owns_arena     = false;
+    m_attributes     = NULL;
+    m_nodes          = NULL;
+    m_name           = 0;
+    m_num_attributes = 0;
+    m_num_nodes      = 0;
+    readXML(xml);
+}   // XMLNode
+
 // ----------------------------------------------------------------------------
 /** Reads a XML file and convert it into a XMLNode tree.
  *  \param filename Name of the XML file to read.
  */
 XMLNode::XMLNode(const std::string &filename)
 {
-    m_file_name = filename;
+    m_arena          = new XMLArena(filename);
+    m_owns_arena     = true;
+    m_attributes     = NULL;
+    m_nodes          = NULL;
+    m_name           = 0;
+    m_num_attributes = 0;
+    m_num_nodes      = 0;
 
     io::IXMLReader *xml = file_manager->createXMLReader(filename);
     
     if (xml == NULL)
     {
+        delete m_arena;
         throw std::runtime_error("Cannot find file "+filename);
     }
 
@@ -75,14 +110,17 @@ XMLNode::XMLNode(const std::string &filename)
 }   // XMLNode
 
 // ----------------------------------------------------------------------------
-/** Destructor. */
+/** Destructor. Sub nodes live in the arena, so only their destructors are
+ *  called, the memory is freed when the root deletes the arena. */
 XMLNode::~XMLNode()
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
-        delete m_nodes[i];
+        m_nodes[i]->~XMLNode();
     }
-    m_nodes.clear();
+    m_num_nodes = 0;
+    if(m_owns_arena)
+        delete m_arena;
 }   // ~XMLNode
 
 // ----------------------------------------------------------------------------
@@ -91,34 +129,53 @@ XMLNode::~XMLNode()
  */
 void XMLNode::readXML(io::IXMLReader *xml)
 {
-    m_name = std::string(core::stringc(xml->getNodeName()).c_str());
+    m_name = m_arena->intern(xml->getNodeName());
 
-    for(unsigned int i=0; i<xml->getAttributeCount(); i++)
+    // In case of more than one root element the attributes of all root
+    // elements are kept, later ones taking precedence (see getAttribute).
+    unsigned int old_count = m_num_attributes;
+    unsigned int count     = old_count + xml->getAttributeCount();
+    if(count>old_count)
     {
-        std::string   name  = core::stringc(xml->getAttributeName(i)).c_str();
-        core::stringw value = xml->getAttributeValue(i);
-        m_attributes[name] = value;
-    }   // for i
+        XMLArena::Attribute *all =
+            m_arena->allocateArray<XMLArena::Attribute>(count);
+        for(unsigned int i=0; i<old_count; i++)
+            all[i] = m_attributes[i];
+        for(unsigned int i=old_count; i<count; i++)
+        {
+            all[i].m_name = m_arena->intern(xml->getAttributeName(i-old_count));
+            m_arena->storeValue(xml->getAttributeValue(i-old_count), &all[i]);
+        }   // for i
+        m_attributes     = all;
+        m_num_attributes = count;
+    }
 
     // If no children, we are done
     if(xml->isEmptyElement())
         return;
 
+    // Collect all children on the arena's node stack (which is shared with
+    // the recursive calls), and copy them to the arena once they are known.
+    std::vector<XMLNode*> &stack = m_arena->getNodeStack();
+    size_t first = stack.size();
+    stack.insert(stack.end(), m_nodes, m_nodes+m_num_nodes);
+
     /** Read all children elements. */
-    while(xml->read())
+    bool end_found = false;
+    while(!end_found && xml->read())
     {
         switch (xml->getNodeType())
         {
         case io::EXN_ELEMENT:
             {
-                XMLNode* n = new XMLNode(xml);
-                n->m_file_name = m_file_name;
-                m_nodes.push_back(n);
+                void *p = m_arena->allocate(sizeof(XMLNode));
+                XMLNode* n = new(p) XMLNode(m_arena, xml);
+                m_arena->getNodeStack().push_back(n);
                 break;
             }
         case io::EXN_ELEMENT_END:
             // End of this element found.
-            return;
+            end_found = true;
             break;
         case io::EXN_UNKNOWN:            break;
         case io::EXN_COMMENT:            break;
@@ -126,6 +183,11 @@ void XMLNode::readXML(io::IXMLReader *xml)
         default:                         break;
         }   // switch
     }   // while
+
+    m_num_nodes = (uint32_t)(stack.size() - first);
+    m_nodes     = m_arena->allocateArray<XMLNode*>(m_num_nodes);
+    std::copy(stack.begin()+first, stack.end(), m_nodes);
+    stack.resize(first);
 }   // readXML
 
 // ----------------------------------------------------------------------------
@@ -143,9 +205,12 @@ const XMLNode *XMLNode::getNode(unsigned int i) const
  */
 const XMLNode *XMLNode::getNode(const std::string &s) const
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    if(m_num_nodes==0) return NULL;
+    int name = m_arena->findName(s);
+    if(name<0) return NULL;
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
-        if(m_nodes[i]->getName()==s) return m_nodes[i];
+        if(m_nodes[i]->m_name==(uint32_t)name) return m_nodes[i];
     }
     return NULL;
 }   // getNode
@@ -157,15 +222,53 @@ const XMLNode *XMLNode::getNode(const std::string &s) const
  */
 const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) const
 {
-    for(unsigned int i=0; i<m_nodes.size(); i++)
+    if(m_num_nodes==0) return;
+    int name = m_arena->findName(s);
+    if(name<0) return;
+    for(unsigned int i=0; i<m_num_nodes; i++)
     {
-        if(m_nodes[i]->getName()==s)
+        if(m_nodes[i]->m_name==(uint32_t)name)
         {
             out.push_back(m_nodes[i]);
         }
     }
 }   // getNode
 
+// ----------------------------------------------------------------------------
+/** Returns the attribute with the given name, or NULL if it is not defined.
+ *  If an attribute is defined more than once, the last definition is used.
+ *  \param name Name of the attribute.
+ */
+const XMLArena::Attribute *XMLNode::getAttribute(const std::string &name) const
+{
+    if(m_num_attributes==0) return NULL;
+    int id = m_arena->findName(name);
+    if(id<0) return NULL;
+    for(int i=(int)m_num_attributes-1; i>=0; i--)
+    {
+        if(m_attributes[i].m_name==(uint32_t)id) return &m_attributes[i];
+    }
+    return NULL;
+}   // getAttribute
+
+// ----------------------------------------------------------------------------
+/** Returns the value of an attribute as a 0-terminated narrow string, or
+ *  NULL if the attribute is not defined. Values that only contain 7-bit
+ *  characters are returned directly from the arena without copying, all
+ *  others are converted (like core::stringc does) into buffer.
+ *  \param attribute Name of the attribute.
+ *  \param buffer Buffer used in case that a conversion is necessary.
+ */
+const char *XMLNode::getString(const std::string &attribute,
+                               std::string *buffer) const
+{
+    const XMLArena::Attribute *a = getAttribute(attribute);
+    if(!a) return NULL;
+    if(a->m_is_ascii) return a->m_value;
+    *buffer = core::stringc(XMLArena::toWide(*a)).c_str();
+    return buffer->c_str();
+}   // getString
+
 // ----------------------------------------------------------------------------
 /** If 'attribute' was defined, set 'value' to the value of the
 *   attribute and return 1, otherwise return 0 and do not change value.
@@ -174,31 +277,27 @@ const void XMLNode::getNodes(const std::string &s, std::vector<XMLNode*>& out) c
 */
 int XMLNode::get(const std::string &attribute, std::string *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value=core::stringc(o->second).c_str();
+    const XMLArena::Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    if(a->m_is_ascii)
+        value->assign(a->m_value, a->m_length);
+    else
+        *value = core::stringc(XMLArena::toWide(*a)).c_str();
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, core::stringw *value) const
 {
-    if(m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if(o==m_attributes.end()) return 0;
-    *value = o->second;
+    const XMLArena::Attribute *a = getAttribute(attribute);
+    if(!a) return 0;
+    *value = XMLArena::toWide(*a);
     return 1;
 }   // get
 // ----------------------------------------------------------------------------
 int XMLNode::getAndDecode(const std::string &attribute, core::stringw *value) const
 {
-    if (m_attributes.empty()) return 0;
-    std::map<std::string, core::stringw>::const_iterator o;
-    o = m_attributes.find(attribute);
-    if (o == m_attributes.end()) return 0;
-    std::string raw_value = core::stringc(o->second).c_str();
+    std::string raw_value;
+    if(!get(attribute, &raw_value)) return 0;
     *value = StringUtils::xmlDecode(raw_value);
     return 1;
 }   // get
@@ -235,7 +334,7 @@ int XMLNode::get(const std::string &attribute, Vec3 *value) const
     if (v.size() != 3)
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    s.c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -252,7 +351,7 @@ int XMLNode::get(const std::string &attribute, Vec3 *value) const
     else
     {
         Log::warn("[XMLNode]", "WARNING: Expected 3 floating-point values, but found '%s' in file %s",
-                    s.c_str(), m_file_name.c_str());
+                    s.c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -311,13 +410,14 @@ int XMLNode::get(const std::string &attribute, video::SColorf *color) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, int32_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    std::string buffer;
+    const char *s = getString(attribute, &buffer);
+    if(!s) return 0;
 
     if (!StringUtils::parseString<int>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s, attribute.c_str(), getName().c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -327,13 +427,14 @@ int XMLNode::get(const std::string &attribute, int32_t *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, int64_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    std::string buffer;
+    const char *s = getString(attribute, &buffer);
+    if(!s) return 0;
 
     if (!StringUtils::parseString<int64_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s, attribute.c_str(), getName().c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -344,13 +445,14 @@ int XMLNode::get(const std::string &attribute, int64_t *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, uint16_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    std::string buffer;
+    const char *s = getString(attribute, &buffer);
+    if(!s) return 0;
 
     if (!StringUtils::parseString<uint16_t>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s, attribute.c_str(), getName().c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -360,13 +462,14 @@ int XMLNode::get(const std::string &attribute, uint16_t *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, uint32_t *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    std::string buffer;
+    const char *s = getString(attribute, &buffer);
+    if(!s) return 0;
 
     if (!StringUtils::parseString<unsigned int>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected uint but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s, attribute.c_str(), getName().c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -376,13 +479,14 @@ int XMLNode::get(const std::string &attribute, uint32_t *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, float *value) const
 {
-    std::string s;
-    if(!get(attribute, &s)) return 0;
+    std::string buffer;
+    const char *s = getString(attribute, &buffer);
+    if(!s) return 0;
 
     if (!StringUtils::parseString<float>(s, value))
     {
         Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                    s.c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                    s, attribute.c_str(), getName().c_str(), m_arena->getFileName().c_str());
         return 0;
     }
 
@@ -392,12 +496,13 @@ int XMLNode::get(const std::string &attribute, float *value) const
 // ----------------------------------------------------------------------------
 int XMLNode::get(const std::string &attribute, bool *value) const
 {
-    std::string s;
+    std::string buffer;
 
     // FIXME: for some reason, missing attributes don't trigger that if???
-    if(!get(attribute, &s)) return 0;
+    const char *s = getString(attribute, &buffer);
+    if(!s) return 0;
     *value = s[0]=='T' || s[0]=='t' || s[0]=='Y' || s[0]=='y' ||
-             s=="#t"   || s   =="#T" || s=="1";
+             strcmp(s, "#t")==0 || strcmp(s, "#T")==0 || strcmp(s, "1")==0;
     return 1;
 }   // get(bool)
 
@@ -441,7 +546,7 @@ int XMLNode::get(const std::string &attribute,
         if (!StringUtils::parseString<float>(v[i], &curr))
         {
             Log::warn("[XMLNode]", "WARNING: Expected float but found '%s' for attribute '%s' of node '%s' in file %s",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str(), m_file_name.c_str());
+                        v[i].c_str(), attribute.c_str(), getName().c_str(), m_arena->getFileName().c_str());
             return 0;
         }
 
@@ -472,7 +577,7 @@ int XMLNode::get(const std::string &attribute, std::vector<int> *value) const
         if (!StringUtils::parseString<int>(v[i], &val))
         {
             Log::warn("[XMLNode]", "WARNING: Expected int but found '%s' for attribute '%s' of node '%s'",
-                        v[i].c_str(), attribute.c_str(), m_name.c_str());
+                        v[i].c_str(), attribute.c_str(), getName().c_str());
             return 0;
         }
 
@@ -625,9 +730,69 @@ int XMLNode::getHPR(Vec3 *value) const
 
 bool XMLNode::hasChildNamed(const char* name) const
 {
-    for (unsigned int i = 0; i < m_nodes.size(); i++)
-    {
-        if (m_nodes[i]->getName() == name) return true;
-    }
-    return false;
-}
+    return getNode(name)!=NULL;
+}   // hasChildNamed
+
+// ============================================================================
+/** Unit testing function.
+ */
+void XMLNode::unitTesting()
+{
+    std::string s =
+        "<?xml version=\"1.0\"?>"
+        "<root name=\"main\" i=\"-12\" f=\"1.5\" b=\"Y\" u=\"\xE9t\xE9\">"
+        "  <child xyz=\"1 2 3\" i=\"7\"/>"
+        "  <other list=\"1 2 3 4\" bad=\"1x\"/>"
+        "  <child i=\"8\">"
+        "    <grandchild name=\"a\"/>"
+        "  </child>"
+        "</root>";
+
+    XMLNode *root = file_manager->createXMLTreeFromString(s);
+    assert(root);
+    assert(root->getName()=="root");
+    assert(root->getNumNodes()==3);
+
+    std::string name;
+    assert(root->get("name", &name)==1 && name=="main");
+    assert(root->get("unknown", &name)==0 && name=="main");
+
+    int i = 0;
+    float f = 0;
+    bool b = false;
+    assert(root->get("i", &i)==1 && i==-12);
+    assert(root->get("f", &f)==1 && f==1.5f);
+    assert(root->get("b", &b)==1 && b);
+
+    // Non-ASCII values must be returned unchanged as wide string, and
+    // converted the same way core::stringc does as narrow string.
+    core::stringw w;
+    assert(root->get("u", &w)==1);
+    assert(w.size()==3 && w[0]==0xE9 && w[1]==L't' && w[2]==0xE9);
+    assert(root->get("u", &name)==1 && name=="\xE9t\xE9");
+
+    const XMLNode *child = root->getNode("child");
+    assert(child && child==root->getNode(0));
+    assert(child->get("i", &i)==1 && i==7);
+    core::vector3df xyz;
+    assert(child->get("xyz", &xyz)==1 && xyz==core::vector3df(1, 2, 3));
+    // An attribute name that exists in the document, but not in this node
+    assert(child->get("name", &name)==0);
+
+    std::vector<XMLNode*> children;
+    root->getNodes("child", children);
+    assert(children.size()==2);
+    assert(children[1]->get("i", &i)==1 && i==8);
+    assert(children[1]->getNumNodes()==1);
+    assert(children[1]->getNode(0)->getName()=="grandchild");
+    assert(!root->getNode("grandchild"));
+    assert(root->hasChildNamed("other"));
+    assert(!root->hasChildNamed("something"));
+
+    std::vector<int> list;
+    assert(root->getNode("other")->get("list", &list)==4);
+    assert(list[3]==4);
+    assert(root->getNode("other")->get("bad", &i)==0);
+
+    delete root;
+}   // unitTesting
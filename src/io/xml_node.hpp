@@ -31,6 +31,7 @@
 #include <path.h>
 using namespace irr;
 
+#include "io/xml_arena.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/time.hpp"
@@ -46,16 +47,27 @@ class Vec3;
 class XMLNode : public NoCopy
 {
 private:
-    /** Name of this element. */
-    std::string                          m_name;
-    /** List of all attributes. */
-    std::map<std::string, core::stringw> m_attributes;
-    /** List of all sub nodes. */
-    std::vector<XMLNode *>               m_nodes;
+    /** Storage shared by all nodes of this document. */
+    XMLArena                *m_arena;
+    /** All attributes of this node, allocated in the arena. */
+    XMLArena::Attribute     *m_attributes;
+    /** List of all sub nodes, allocated in the arena. */
+    XMLNode                **m_nodes;
+    /** Interned name of this element. */
+    uint32_t                 m_name;
+    /** Number of attributes. */
+    uint32_t                 m_num_attributes;
+    /** Number of sub nodes. */
+    uint32_t                 m_num_nodes;
+    /** True if this node is the root of the document and so owns
+     *  the arena. */
+    bool                     m_owns_arena;
 
+         XMLNode(XMLArena *arena, io::IXMLReader *xml);
     void readXML(io::IXMLReader *xml);
-
-    std::string                          m_file_name;
+    const XMLArena::Attribute *getAttribute(const std::string &name) const;
+    const char *getString(const std::string &attribute,
+                          std::string *buffer) const;
 
 public:
          LEAK_CHECK();
@@ -66,11 +78,11 @@ public:
 
         ~XMLNode();
 
-    const std::string &getName() const {return m_name; }
+    const std::string &getName() const {return m_arena->getName(m_name); }
     const XMLNode     *getNode(const std::string &name) const;
     const void         getNodes(const std::string &s, std::vector<XMLNode*>& out) const;
     const XMLNode     *getNode(unsigned int i) const;
-    unsigned int       getNumNodes() const {return (unsigned int) m_nodes.size(); }
+    unsigned int       getNumNodes() const {return m_num_nodes; }
     int get(const std::string &attribute, std::string *value) const;
     int get(const std::string &attribute, core::stringw *value) const;
     int getAndDecode(const std::string &attribute, core::stringw *value) const;
@@ -97,6 +109,11 @@ public:
 
     bool hasChildNamed(const char* name) const;
 
+    /** Returns the number of bytes allocated for the whole document. */
+    size_t getAllocatedBytes() const { return m_arena->getAllocatedBytes(); }
+
+    static void unitTesting();
+
     /** Handy functions to test the bit pattern returned by get(vector3df*).*/
     static bool hasX(int b) { return (b&1)==1; }
     static bool hasY(int b) { return (b&2)==2; }
@@ -29,24 +29,11 @@ GhostController::GhostController(AbstractKart *kart)
 //-----------------------------------------------------------------------------
 void GhostController::reset()
 {
-    m_current_index = 0;
-    m_current_time = 0.0f;
 }   // reset
 
 //-----------------------------------------------------------------------------
 void GhostController::update(float dt)
 {
-    m_current_time = World::getWorld()->getTime();
-    // Find (if necessary) the next index to use
-    if (m_current_time != 0.0f)
-    {
-        while (m_current_index + 1 < m_all_times.size() &&
-               m_current_time >= m_all_times[m_current_index + 1])
-        {
-            m_current_index++;
-        }
-    }
-
     // Watching replay use only
     for(unsigned int i=0; i<Camera::getNumCameras(); i++)
     {
@@ -68,18 +55,6 @@ void GhostController::update(float dt)
 
 }   // update
 
-//-----------------------------------------------------------------------------
-void GhostController::addReplayTime(float time)
-{
-    // FIXME: for now avoid that transforms for the same time are set
-    // twice (to avoid division by zero in update). This should be
-    // done when saving in replay
-    if (m_all_times.size() > 0 && m_all_times.back() == time)
-        return;
-    m_all_times.push_back(time);
-
-}   // addReplayTime
-
 //-----------------------------------------------------------------------------
 void GhostController::action(PlayerAction action, int value)
 {
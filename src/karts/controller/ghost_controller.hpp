@@ -22,24 +22,13 @@
 #include "karts/controller/controller.hpp"
 #include "states_screens/state_manager.hpp"
 
-#include <vector>
-
-/** A class for Ghost controller.
+/** A class for Ghost controller. The ghost karts are moved by their
+ *  replay data (see GhostKart and GhostTimeline), the controller only
+ *  handles the camera when watching a replay.
  * \ingroup controller
  */
 class GhostController : public Controller
 {
-private:
-    /** Pointer to the last index in m_all_times that is smaller than
-     *  the current world time. */
-    unsigned int m_current_index;
-
-    /** The current world time. */
-    float m_current_time;
-
-    /** The list of the times at which the events of kart were reached. */
-    std::vector<float> m_all_times;
-
 public:
              GhostController(AbstractKart *kart);
     virtual ~GhostController() {};
@@ -58,20 +47,6 @@ public:
     virtual void action(PlayerAction action, int value) OVERRIDE;
     virtual void skidBonusTriggered() {};
     virtual void newLap(int lap) {};
-    void         addReplayTime(float time);
-    // ------------------------------------------------------------------------
-    bool         isReplayEnd() const
-                         { return m_current_index + 1 >= m_all_times.size(); }
-    // ------------------------------------------------------------------------
-    float        getReplayDelta() const
-    {
-        assert(m_current_index < m_all_times.size());
-        return ((m_current_time - m_all_times[m_current_index]) /
-            (m_all_times[m_current_index + 1] - m_all_times[m_current_index]));
-    }
-    // ------------------------------------------------------------------------
-    unsigned int getCurrentReplayIndex() const
-                                                   { return m_current_index; }
     // ------------------------------------------------------------------------
 };   // GhostController
 
@@ -17,6 +17,8 @@
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "karts/ghost_kart.hpp"
+#include "config/stk_config.hpp"
+#include "graphics/camera.hpp"
 #include "karts/controller/ghost_controller.hpp"
 #include "karts/kart_gfx.hpp"
 #include "karts/kart_model.hpp"
@@ -25,11 +27,13 @@
 #include "LinearMath/btQuaternion.h"
 
 GhostKart::GhostKart(const std::string& ident, unsigned int world_kart_id,
-                     int position)
+                     int position, GhostTimeline *timeline)
           : Kart(ident, world_kart_id,
                  position, btTransform(btQuaternion(0, 0, 0, 1)),
                  PLAYER_DIFFICULTY_NORMAL, RenderInfo::KRT_TRANSPARENT)
 {
+    m_timeline = timeline;
+    m_ghost_id = timeline->addGhost();
 }   // GhostKart
 
 // ----------------------------------------------------------------------------
@@ -47,10 +51,9 @@ void GhostKart::addReplayEvent(float time,
                                const ReplayBase::PhysicInfo &pi,
                                const ReplayBase::KartReplayEvent &kre)
 {
-    GhostController* gc = dynamic_cast<GhostController*>(getController());
-    gc->addReplayTime(time);
+    if (!m_timeline->addTransform(m_ghost_id, time, trans))
+        return;
 
-    m_all_transform.push_back(trans);
     m_all_physic_info.push_back(pi);
     m_all_replay_events.push_back(kre);
 
@@ -67,7 +70,27 @@ void GhostKart::addReplayEvent(float time,
 }   // addReplayEvent
 
 // ----------------------------------------------------------------------------
-/** Updates the current event of the ghost kart using interpolation
+/** Returns the square of the distance to the nearest camera. */
+float GhostKart::getDistanceToCamera2() const
+{
+    if (Camera::getNumCameras() == 0)
+        return 0.0f;
+    float distance2 = -1.0f;
+    for (unsigned int i = 0; i < Camera::getNumCameras(); i++)
+    {
+        Vec3 xyz = Camera::getCamera(i)->getCameraSceneNode()->getPosition();
+        float d2 = (xyz - getXYZ()).length2();
+        if (distance2 < 0 || d2 < distance2)
+            distance2 = d2;
+    }
+    return distance2;
+}   // getDistanceToCamera2
+
+// ----------------------------------------------------------------------------
+/** Updates the ghost kart from the transform the GhostTimeline interpolated
+ *  for the current time (see ReplayPlay::update). If the kart is far away
+ *  from all cameras, the wheels, animations and effects are not updated,
+ *  or the kart is not shown at all.
  *  \param dt Time step size.
  */
 void GhostKart::update(float dt)
@@ -76,43 +99,45 @@ void GhostKart::update(float dt)
     if (gc == NULL) return;
 
     gc->update(dt);
-    if (gc->isReplayEnd())
+    if (isReplayEnd())
     {
         m_node->setVisible(false);
         getKartGFX()->setGFXInvisible();
         return;
     }
 
-    const unsigned int idx = gc->getCurrentReplayIndex();
-    if (!race_manager->isWatchingReplay())
-    {
-        if (idx == 0)
-        {
-            m_node->setVisible(false);
-        }
-        if (idx == 1)
-        {
-            // Start showing the ghost when it start racing
-            m_node->setVisible(true);
-        }
-    }
-
-    const float rd         = gc->getReplayDelta();
-    assert(idx < m_all_transform.size());
+    const unsigned int idx = m_timeline->getIndex(m_ghost_id);
+    setXYZ(m_timeline->getXYZ(m_ghost_id));
+    setRotation(m_timeline->getRotation(m_ghost_id));
+    Moveable::updatePosition();
 
-    setXYZ((1- rd)*m_all_transform[idx    ].getOrigin()
-           +  rd  *m_all_transform[idx + 1].getOrigin() );
+    Vec3 front(0, 0, getKartLength()*0.5f);
+    m_xyz_front = getTrans()(front);
 
-    const btQuaternion q = m_all_transform[idx].getRotation()
-        .slerp(m_all_transform[idx + 1].getRotation(), rd);
-    setRotation(q);
+    // Start showing the ghost when it start racing
+    const bool started = race_manager->isWatchingReplay() || idx > 0;
+    const float distance2 = getDistanceToCamera2();
+    if (!started || distance2 > stk_config->m_ghost_cull_distance2)
+    {
+        m_node->setVisible(false);
+        getKartGFX()->setGFXFromReplay(0, false, 0, false);
+        getKartGFX()->setGFXInvisible();
+        return;
+    }
+    m_node->setVisible(true);
 
     Vec3 center_shift(0, 0, 0);
     center_shift.setY(m_graphical_y_offset);
     center_shift = getTrans().getBasis() * center_shift;
 
     Moveable::updateGraphics(dt, center_shift, btQuaternion(0, 0, 0, 1));
-    Moveable::updatePosition();
+
+    if (distance2 > stk_config->m_ghost_lod_distance2)
+    {
+        getKartGFX()->setGFXFromReplay(0, false, 0, false);
+        return;
+    }
+
     getKartModel()->update(dt, dt*(m_all_physic_info[idx].m_speed),
         m_all_physic_info[idx].m_steer, m_all_physic_info[idx].m_speed,
         /*lean*/0.0f, idx);
@@ -123,9 +148,6 @@ void GhostKart::update(float dt)
         m_all_replay_events[idx].m_red_skidding);
     getKartGFX()->update(dt);
 
-    Vec3 front(0, 0, getKartLength()*0.5f);
-    m_xyz_front = getTrans()(front);
-
     if (m_all_replay_events[idx].m_jumping && !m_is_jumping)
     {
         m_is_jumping = true;
@@ -143,9 +165,7 @@ void GhostKart::update(float dt)
 /** Returns the speed of the kart in meters/second. */
 float GhostKart::getSpeed() const
 {
-    const GhostController* gc =
-        dynamic_cast<const GhostController*>(getController());
-
-    assert(gc->getCurrentReplayIndex() < m_all_physic_info.size());
-    return m_all_physic_info[gc->getCurrentReplayIndex()].m_speed;
+    const unsigned int idx = m_timeline->getIndex(m_ghost_id);
+    assert(idx < m_all_physic_info.size());
+    return m_all_physic_info[idx].m_speed;
 }   // getSpeed
@@ -20,6 +20,7 @@
 #define HEADER_GHOST_KART_HPP
 
 #include "karts/kart.hpp"
+#include "replay/ghost_timeline.hpp"
 #include "replay/replay_base.hpp"
 
 #include "LinearMath/btTransform.h"
@@ -28,24 +29,31 @@
 
 /** \defgroup karts */
 
-/** A ghost kart. It does not have a phsyics representation. It gets two
- *  transforms from the replay objects at two consecutive time steps,
- *  and will interpolate between those positions depending on the current
- *  time
+/** A ghost kart. It does not have a phsyics representation. Its transforms
+ *  are stored in the GhostTimeline of the replay, which interpolates the
+ *  transforms of all ghost karts for the current time at once. Ghost karts
+ *  far away from all cameras are shown with less details or not at all.
  */
 class GhostKart : public Kart
 {
 private:
-    /** The transforms to assume at the corresponding time in m_all_times. */
-    std::vector<btTransform>                 m_all_transform;
+    /** The timeline with the transforms of this kart. */
+    GhostTimeline                           *m_timeline;
 
+    /** Index of this kart in the timeline. */
+    unsigned int                             m_ghost_id;
+
+    /** The physics info for each transform in the timeline. */
     std::vector<ReplayBase::PhysicInfo>      m_all_physic_info;
 
     std::vector<ReplayBase::KartReplayEvent> m_all_replay_events;
 
+    float         getDistanceToCamera2() const;
+
 public:
                   GhostKart(const std::string& ident,
-                            unsigned int world_kart_id, int position);
+                            unsigned int world_kart_id, int position,
+                            GhostTimeline *timeline);
     virtual void  update (float dt);
     virtual void  reset();
     // ------------------------------------------------------------------------
@@ -75,6 +83,10 @@ public:
     /** Returns the speed of the kart in meters/second. */
     virtual float getSpeed() const;
     // ------------------------------------------------------------------------
+    /** True if the replay of this kart has ended. */
+    bool          isReplayEnd() const
+                                { return m_timeline->isFinished(m_ghost_id); }
+    // ------------------------------------------------------------------------
     virtual void  kartIsInRestNow() {};
     // ------------------------------------------------------------------------
 
@@ -199,3 +199,30 @@ void Moveable::setTrans(const btTransform &t)
     if(m_motion_state)
         m_motion_state->setWorldTransform(t);
 }   // setTrans
+
+//-----------------------------------------------------------------------------
+/** Saves the transform and velocities of the physics body.
+ *  \param state On return contains the state.
+ */
+void Moveable::saveState(State *state) const
+{
+    state->m_transform        = m_body->getWorldTransform();
+    state->m_velocity         = m_body->getLinearVelocity();
+    state->m_angular_velocity = m_body->getAngularVelocity();
+}   // saveState
+
+//-----------------------------------------------------------------------------
+/** Restores a state saved with saveState, and updates the graphical
+ *  transform, the local velocity and heading, pitch and roll.
+ *  \param state The state to restore.
+ */
+void Moveable::restoreState(const State &state)
+{
+    m_body->setCenterOfMassTransform(state.m_transform);
+    m_body->setLinearVelocity(state.m_velocity);
+    m_body->setAngularVelocity(state.m_angular_velocity);
+    m_body->activate();
+    setTrans(state.m_transform);
+    m_velocityLC = state.m_velocity*m_transform.getBasis();
+    updatePosition();
+}   // restoreState
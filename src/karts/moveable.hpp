@@ -39,6 +39,16 @@ class Material;
   */
 class Moveable: public NoCopy
 {
+public:
+    /** The physical state of a moveable, which can be saved and restored
+     *  (e.g. to re-simulate it after a correction from the server). */
+    struct State
+    {
+        btTransform m_transform;
+        btVector3   m_velocity;
+        btVector3   m_angular_velocity;
+    };   // State
+
 private:
     btVector3              m_velocityLC;      /**<Velocity in kart coordinates. */
     btTransform            m_transform;
@@ -111,6 +121,8 @@ public:
                  &getTrans() const {return m_transform;}
     void          setTrans(const btTransform& t);
     void          updatePosition();
+    void          saveState(State *state) const;
+    void          restoreState(const State &state);
 }
 ;   // class Moveable
 
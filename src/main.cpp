@@ -142,7 +142,9 @@
 #include "achievements/achievements_manager.hpp"
 #include "addons/addons_manager.hpp"
 #include "addons/news_manager.hpp"
+#include "animations/ipo.hpp"
 #include "audio/music_manager.hpp"
+#include "audio/music_ogg.hpp"
 #include "audio/sfx_manager.hpp"
 #include "challenges/unlock_manager.hpp"
 #include "config/hardware_stats.hpp"
@@ -154,11 +156,16 @@
 #include "graphics/camera.hpp"
 #include "graphics/camera_debug.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/cooked_mesh.hpp"
+#include "graphics/culling_tree.hpp"
 #include "graphics/graphics_restrictions.hpp"
+#include "graphics/image_decoder.hpp"
+#include "graphics/image_kernels.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/material_manager.hpp"
 #include "graphics/particle_kind_manager.hpp"
 #include "graphics/referee.hpp"
+#include "graphics/stk_animated_mesh.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/event_handler.hpp"
 #include "guiengine/dialog_queue.hpp"
@@ -167,6 +174,7 @@
 #include "input/keyboard_device.hpp"
 #include "input/wiimote_manager.hpp"
 #include "io/file_manager.hpp"
+#include "io/xml_node.hpp"
 #include "items/attachment_manager.hpp"
 #include "items/item_manager.hpp"
 #include "items/projectile_manager.hpp"
@@ -177,18 +185,30 @@
 #include "modes/cutscene_world.hpp"
 #include "modes/demo_world.hpp"
 #include "modes/profile_world.hpp"
+#include "network/bit_stream.hpp"
+#include "network/buffer_pool.hpp"
+#include "network/input_buffer.hpp"
+#include "network/interest_manager.hpp"
+#include "network/lobby_pool.hpp"
+#include "network/network_clock.hpp"
 #include "network/network_config.hpp"
+#include "network/network_stats.hpp"
 #include "network/network_string.hpp"
+#include "network/prediction_buffer.hpp"
 #include "network/servers_manager.hpp"
 #include "network/stk_host.hpp"
 #include "online/profile_manager.hpp"
 #include "online/request_manager.hpp"
+#include "race/batch_runner.hpp"
 #include "race/grand_prix_manager.hpp"
 #include "race/highscore_manager.hpp"
 #include "race/history.hpp"
 #include "race/race_manager.hpp"
+#include "replay/ghost_timeline.hpp"
+#include "replay/replay_catalog.hpp"
 #include "replay/replay_play.hpp"
 #include "replay/replay_recorder.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "states_screens/main_menu_screen.hpp"
 #include "states_screens/register_screen.hpp"
 #include "states_screens/state_manager.hpp"
@@ -197,9 +217,11 @@
 #include "tracks/battle_graph.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
+#include "tracks/track_object_manager.hpp"
 #include "utils/command_line.hpp"
 #include "utils/constants.hpp"
 #include "utils/crash_reporting.hpp"
+#include "utils/frame_stats.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/log.hpp"
 #include "utils/translation.hpp"
@@ -522,10 +544,20 @@ void cmdLineHelp()
     "  -v,  --version          Show version of SuperTuxKart.\n"
     "       --trackdir=DIR     A directory from which additional tracks are "
                               "loaded.\n"
+    "       --cook-meshes=DIR  Write the cooked files of all models in DIR\n"
+    "                          (and its subdirectories), then exit.\n"
     "       --profile-laps=n   Enable automatic driven profile mode for n "
                               "laps.\n"
     "       --profile-time=n   Enable automatic driven profile mode for n "
                               "seconds.\n"
+    "       --profile-stats=FILE Write frame time histograms of the profile\n"
+    "                          run as JSON to FILE (default: profile.json in\n"
+    "                          the config directory).\n"
+    "       --check-prediction Re-simulate the first kart of a profile run\n"
+    "                          regularly like a network client does, and\n"
+    "                          report the difference to the recorded race.\n"
+    "       --batch=FILE       Run all races of the run matrix in FILE and\n"
+    "                          write the results to a CSV file.\n"
     "       --no-graphics      Do not display the actual race.\n"
     "       --demo-mode=t      Enables demo mode after t seconds idle time in "
                                "main menu.\n"
@@ -547,6 +579,14 @@ void cmdLineHelp()
     "       --password=s       Automatically log in (set the password).\n"
     "       --port=n           Port number to use.\n"
     "       --max-players=n    Maximum number of clients (server only).\n"
+    "       --network-stats=file Write the network statistics as JSON to\n"
+    "                          the file every second.\n"
+    "       --lobbies=n        Run n LAN servers (or n races, e.g. with\n"
+    "                          --profile-laps) at the same time in forked\n"
+    "                          processes, sharing the loaded data. With\n"
+    "                          --batch the races are distributed between\n"
+    "                          n processes.\n"
+    "                          Needs --no-graphics.\n"
     "       --no-console       Does not write messages in the console but to\n"
     "                          stdout.log.\n"
     "       --console          Write messages in the console and files\n"
@@ -940,8 +980,26 @@ int handleCmdLine()
     // Networking command lines
     NetworkConfig::get()->
         setMaxPlayers(UserConfigParams::m_server_max_players);
+    int num_lobbies = 1;
+    if(CommandLine::has("--lobbies", &n))
+        num_lobbies = n;
+    if(num_lobbies > 1 && !ProfileWorld::isNoGraphics())
+    {
+        Log::error("main", "Several lobbies are only supported with "
+                           "--no-graphics.");
+        num_lobbies = 1;
+    }
+    // Set before a host (and its thread writing the stats) is created
+    if(CommandLine::has("--network-stats", &s))
+        NetworkStats::get()->setFileName(s);
     if(CommandLine::has("--server", &s))
     {
+        if(num_lobbies > 1)
+        {
+            Log::error("main", "Several lobbies are only supported for "
+                               "LAN servers.");
+            num_lobbies = 1;
+        }
         NetworkConfig::get()->setServerName(core::stringw(s.c_str()));
         NetworkConfig::get()->setIsServer(true);
         NetworkConfig::get()->setIsWAN();
@@ -950,6 +1008,13 @@ int handleCmdLine()
     }
     if (CommandLine::has("--lan-server", &s))
     {
+        // Each lobby continues here with its own network host.
+        if(num_lobbies > 1)
+        {
+            LobbyPool::start(num_lobbies);
+            num_lobbies = 1;
+        }
+        s = LobbyPool::getLobbyName(s);
         NetworkConfig::get()->setServerName(core::stringw(s.c_str()));
         NetworkConfig::get()->setIsServer(true);
         NetworkConfig::get()->setIsLAN();
@@ -1170,6 +1235,20 @@ int handleCmdLine()
         race_manager->setNumLaps(999999); // profile end depends on time
     }   // --profile-time
 
+    if(CommandLine::has("--profile-stats", &s))
+        ProfileWorld::setStatsFile(s);
+
+    if(CommandLine::has("--check-prediction"))
+        ProfileWorld::enablePredictionCheck();
+
+    if(CommandLine::has("--batch", &s))
+    {
+        // Must be done before the lobbies are started, so that only one
+        // process writes the header of the result file.
+        if(!BatchRunner::load(s))
+            return 0;
+    }   // --batch
+
     if(CommandLine::has("--history",  &n))
     {
         history->doReplayHistory( (History::HistoryReplayMode)n);
@@ -1235,6 +1314,18 @@ int handleCmdLine()
         UserConfigParams::m_music = false;// and music when profiling
     }
 
+    // Run several races at the same time (e.g. --profile-laps races as a
+    // soak test), each lobby continues from here. A single profile race is
+    // loaded before the lobbies are started, so that all lobbies share its
+    // track (including collision meshes and drivelines) and karts.
+    if(num_lobbies > 1)
+    {
+        if(ProfileWorld::isProfileMode() && !BatchRunner::isBatchMode())
+            LobbyPool::startAfterLoading(num_lobbies);
+        else
+            LobbyPool::start(num_lobbies);
+    }
+
     if (try_login)
     {
         irr::core::stringw s;
@@ -1324,6 +1415,7 @@ void initRest()
     history                 = new History              ();
     ReplayPlay::create();
     ReplayRecorder::create();
+    ReplayCatalog::create();
     material_manager        = new MaterialManager      ();
     track_manager           = new TrackManager         ();
     kart_properties_manager = new KartPropertiesManager();
@@ -1554,6 +1646,13 @@ int main(int argc, char *argv[] )
             exit(0);
         }
 
+        std::string cook_dir;
+        if(CommandLine::has("--cook-meshes", &cook_dir))
+        {
+            CookedMesh::cookDirectory(cook_dir);
+            exit(0);
+        }
+
         if (!ProfileWorld::isNoGraphics() &&
             GraphicsRestrictions::isDisabled(GraphicsRestrictions::GR_DRIVER_RECENT_ENOUGH))
         {
@@ -1676,11 +1775,25 @@ int main(int argc, char *argv[] )
             // Profiling
             // =========
             race_manager->setMajorMode (RaceManager::MAJOR_MODE_SINGLE);
-            race_manager->setupPlayerKartInfo();
-            race_manager->startNew(false);
+            if(BatchRunner::isBatchMode())
+            {
+                // Runs all races, and then aborts the main loop
+                BatchRunner::run();
+            }
+            else
+            {
+                race_manager->setupPlayerKartInfo();
+                race_manager->startNew(false);
+                // Each lobby continues here with the loaded race
+                LobbyPool::startPending();
+            }
         }
         main_loop->run();
 
+        // A lobby does not do the normal shutdown
+        if(LobbyPool::isLobby())
+            LobbyPool::exitLobby(0);
+
     }  // try
     catch (std::exception &e)
     {
@@ -1766,6 +1879,7 @@ static void cleanSuperTuxKart()
     if(history)                 delete history;
     ReplayPlay::destroy();
     ReplayRecorder::destroy();
+    ReplayCatalog::destroy();
     delete ParticleKindManager::get();
     PlayerManager::destroy();
     if(unlock_manager)          delete unlock_manager;
@@ -1846,8 +1960,56 @@ void runUnitTests()
     Log::info("UnitTest", "=====================");
     Log::info("UnitTest", "GraphicsRestrictions");
     GraphicsRestrictions::unitTesting();
+    Log::info("UnitTest", "ImageKernels");
+    ImageKernels::unitTesting();
+    Log::info("UnitTest", "ImageDecoder");
+    ImageDecoder::unitTesting();
+    Log::info("UnitTest", "STKAnimatedMesh");
+    STKAnimatedMesh::unitTesting();
+    Log::info("UnitTest", "CullingTree");
+    CullingTree::unitTesting();
+    Log::info("UnitTest", "TrackObjectManager");
+    TrackObjectManager::unitTesting();
+    Log::info("UnitTest", "Ipo");
+    Ipo::unitTesting();
+    Log::info("UnitTest", "CookedMesh");
+    CookedMesh::unitTesting();
     Log::info("UnitTest", "NetworkString");
     NetworkString::unitTesting();
+    Log::info("UnitTest", "BitStream");
+    BitWriter::unitTesting();
+    Log::info("UnitTest", "BufferPool");
+    BufferPool::unitTesting();
+    Log::info("UnitTest", "NetworkStats");
+    NetworkStats::unitTesting();
+    Log::info("UnitTest", "NetworkClock");
+    NetworkClock::unitTesting();
+    Log::info("UnitTest", "InputBuffer");
+    InputBuffer::unitTesting();
+    Log::info("UnitTest", "PredictionBuffer");
+    PredictionBuffer::unitTesting();
+    Log::info("UnitTest", "InterestManager");
+    InterestManager::unitTesting();
+    Log::info("UnitTest", "RequestManager");
+    Online::RequestManager::unitTesting();
+    Log::info("UnitTest", "BatchRunner");
+    BatchRunner::unitTesting();
+    Log::info("UnitTest", "XMLNode");
+    XMLNode::unitTesting();
+    Log::info("UnitTest", "FileManager");
+    FileManager::unitTesting();
+    Log::info("UnitTest", "ReplayCatalog");
+    ReplayCatalog::unitTesting();
+    Log::info("UnitTest", "GhostTimeline");
+    GhostTimeline::unitTesting();
+    Log::info("UnitTest", "FrameStats");
+    FrameStats::unitTesting();
+    Log::info("UnitTest", "ScriptEngine");
+    Scripting::ScriptEngine::unitTesting();
+#if HAVE_OGGVORBIS
+    Log::info("UnitTest", "MusicOggStream");
+    MusicOggStream::unitTesting();
+#endif
 
     Log::info("UnitTest", "Easter detection");
     // Test easter mode: in 2015 Easter is 5th of April - check with 0 days
@@ -1881,6 +2043,9 @@ void runUnitTests()
     UserConfigParams::m_easter_ear_mode = saved_easter_mode;
 
 
+    Log::info("UnitTest", "MaterialManager");
+    MaterialManager::unitTesting();
+
     Log::info("UnitTest", "Kart characteristics");
     CombinedCharacteristic::unitTesting();
 
@@ -40,6 +40,10 @@ public:
         ~MainLoop();
     void run();
     void abort();
+    // ------------------------------------------------------------------------
+    /** Clears the abort flag, so that the main loop can be run again
+     *  (used to run several races in one process). */
+    void resetAbort() { m_abort = false; }
     void setThrottleFPS(bool throttle) { m_throttle_fps = throttle; }
     // ------------------------------------------------------------------------
     /** Returns true if STK is to be stoppe. */
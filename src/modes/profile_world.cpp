@@ -21,19 +21,33 @@
 #include "main_loop.hpp"
 #include "graphics/camera.hpp"
 #include "graphics/irr_driver.hpp"
+#include "io/file_manager.hpp"
 #include "karts/kart_with_stats.hpp"
 #include "karts/controller/controller.hpp"
+#include "network/prediction_buffer.hpp"
+#include "race/batch_runner.hpp"
 #include "tracks/track.hpp"
+#include "utils/frame_stats.hpp"
 
 #include <ISceneManager.h>
 
 #include <iomanip>
 #include <iostream>
+#include <stdio.h>
 
 ProfileWorld::ProfileType ProfileWorld::m_profile_mode=PROFILE_NONE;
 int   ProfileWorld::m_num_laps    = 0;
 float ProfileWorld::m_time        = 0.0f;
 bool  ProfileWorld::m_no_graphics = false;
+std::string ProfileWorld::m_stats_file;
+bool  ProfileWorld::m_check_prediction = false;
+
+namespace
+{
+    /** Number of frames re-simulated in each replay, a bit more than the
+     *  usual age of a server snapshot (about 20 ms to 300 ms). */
+    const unsigned int REPLAY_FRAMES = 20;
+}   // namespace
 
 //-----------------------------------------------------------------------------
 /** The constructor sets the number of (local) players to 0, since only AI
@@ -56,6 +70,13 @@ ProfileWorld::ProfileWorld()
     m_num_transparent  = 0;
     m_num_trans_effect = 0;
     m_num_calls        = 0;
+    m_prediction       = m_check_prediction ? new PredictionBuffer() : NULL;
+    m_num_replays          = 0;
+    m_num_failed_replays   = 0;
+    m_total_replay_error   = 0;
+    m_max_replay_error     = 0;
+    // The profiler adds the time of its markers to the frame statistics
+    FrameStats::create();
 }   // ProfileWorld
 
 //-----------------------------------------------------------------------------
@@ -66,7 +87,9 @@ ProfileWorld::ProfileWorld()
 ProfileWorld::~ProfileWorld()
 {
     m_profile_mode = PROFILE_NONE;
-}
+    FrameStats::destroy();
+    delete m_prediction;
+}   // ~ProfileWorld
 
 //-----------------------------------------------------------------------------
 /** Enables profiling for a certain amount of time. It also sets the
@@ -153,6 +176,8 @@ bool ProfileWorld::isRaceOver()
 void ProfileWorld::update(float dt)
 {
     StandardRace::update(dt);
+    if (m_prediction)
+        checkPrediction(dt);
 
     m_frame_count++;
     video::IVideoDriver *driver = irr_driver->getVideoDriver();
@@ -167,6 +192,92 @@ void ProfileWorld::update(float dt)
 
 }   // update
 
+//-----------------------------------------------------------------------------
+/** Records the state of the first kart after each frame, and re-simulates
+ *  it from the oldest recorded frame every REPLAY_FRAMES frames, like a
+ *  client does after a correction from the server. The result is compared
+ *  with the recorded run. Frames during a kart animation (e.g. a rescue)
+ *  are not recorded, since the physics is not used then.
+ *  \param dt Time step of the world update.
+ */
+void ProfileWorld::checkPrediction(float dt)
+{
+    AbstractKart *kart = m_karts[0];
+    if (kart->getKartAnimation() || kart->isEliminated())
+    {
+        m_prediction->reset();
+        return;
+    }
+    m_prediction->saveFrame(kart, getTime(), dt);
+    if (m_prediction->getNumFrames() <= REPLAY_FRAMES)
+        return;
+
+    float error;
+    if (!m_prediction->replay(kart, 0, &error))
+        m_num_failed_replays++;
+    m_num_replays++;
+    m_total_replay_error += error;
+    m_max_replay_error    = std::max(m_max_replay_error, error);
+}   // checkPrediction
+
+//-----------------------------------------------------------------------------
+/** Writes the frame statistics and the averages printed at the end of the
+ *  race as JSON, so that two runs can be compared automatically (see
+ *  tools/compare_profile.py).
+ *  \param runtime Real time the race took in seconds.
+ */
+void ProfileWorld::writeStats(float runtime) const
+{
+    std::string name = m_stats_file.empty()
+                     ? file_manager->getUserConfigFile("profile.json")
+                     : m_stats_file;
+    FILE *file = fopen(name.c_str(), "w");
+    if (!file)
+    {
+        Log::warn("profile", "Can't open '%s', statistics are not written.",
+                  name.c_str());
+        return;
+    }
+
+    std::ostringstream s;
+    s << "{\n  \"track\": \"" << m_track->getIdent() << "\""
+      << ",\n  \"mode\": \""
+      << (m_profile_mode == PROFILE_TIME ? "time" : "laps") << "\""
+      << ",\n  \"laps\": " << race_manager->getNumLaps()
+      << ",\n  \"num_karts\": " << m_karts.size()
+      << ",\n  \"graphics\": " << (m_no_graphics ? "false" : "true")
+      << ",\n  \"frames\": " << m_frame_count
+      << ",\n  \"runtime\": " << runtime
+      << ",\n  \"fps\": " << m_frame_count/runtime;
+    if (!m_no_graphics)
+    {
+        s << ",\n  \"nodes\": { \"drawn_k\": "
+          << (float)m_num_triangles/m_frame_count
+          << ", \"culled_k\": " << (float)m_num_culls/m_frame_count
+          << ", \"solid_k\": "  << (float)m_num_solid/m_frame_count
+          << ", \"transparent\": "
+          << (float)m_num_transparent/m_frame_count
+          << ", \"transparent_effect\": "
+          << (float)m_num_trans_effect/m_frame_count << " }";
+    }
+    if (m_prediction)
+    {
+        s << ",\n  \"prediction\": { \"replays\": " << m_num_replays
+          << ", \"frames\": " << REPLAY_FRAMES
+          << ", \"failed\": " << m_num_failed_replays
+          << ", \"average_m\": "
+          << (m_num_replays > 0 ? m_total_replay_error/m_num_replays : 0.0f)
+          << ", \"max_m\": " << m_max_replay_error << " }";
+    }
+    if (FrameStats::get())
+        s << ",\n  \"frame_stats\": " << FrameStats::get()->toJSON();
+    s << "\n}\n";
+    std::string json = s.str();
+    fwrite(json.c_str(), 1, json.size(), file);
+    fclose(file);
+    Log::info("profile", "Statistics written to '%s'.", name.c_str());
+}   // writeStats
+
 //-----------------------------------------------------------------------------
 /** This function is called when the race is finished, but end-of-race
  *  animations have still to be played. In the case of profiling,
@@ -219,6 +330,19 @@ void ProfileWorld::enterRaceOverState()
                      (float)m_num_trans_effect/m_frame_count);
     }
 
+    if (m_prediction)
+    {
+        Log::info("profile", "Prediction check: %d replays of %d frames, "
+                  "%d failed, average error %.3f m, max %.3f m.",
+                  m_num_replays, REPLAY_FRAMES, m_num_failed_replays,
+                  m_num_replays > 0 ? m_total_replay_error/m_num_replays
+                                    : 0.0f,
+                  m_max_replay_error);
+    }
+
+    if(!BatchRunner::isBatchMode())
+        writeStats(runtime);
+
     // Print race statistics for each individual kart
     float min_t=999999.9f, max_t=0.0, av_t=0.0;
     Log::verbose("profile", "name start_position end_position time average_speed top_speed "
@@ -345,6 +469,9 @@ void ProfileWorld::enterRaceOverState()
                off_track_count, energy);
         Log::verbose("profile", "");
     }   // for it !=all_groups.end
+
+    if(BatchRunner::isBatchMode())
+        BatchRunner::raceFinished(this);
     delete this;
     main_loop->abort();
 }   // enterRaceOverState
@@ -22,6 +22,7 @@
 #include "modes/standard_race.hpp"
 
 class Kart;
+class PredictionBuffer;
 
 /**
  * \brief An implementation of World, used for profiling only
@@ -43,6 +44,13 @@ private:
     /** In time based profiling only: time to run. */
     static float m_time;
 
+    /** File the frame statistics are written to, if empty a file in the
+     *  user config directory is used. */
+    static std::string m_stats_file;
+
+    /** If the rewinding of the client side prediction is checked. */
+    static bool  m_check_prediction;
+
     /** Return value of real time at start of race. */
     unsigned int m_start_time;
 
@@ -67,6 +75,22 @@ private:
     /** Number of calls to draw. */
     long long    m_num_calls;
 
+    /** With --check-prediction: the recorded frames of the first kart,
+     *  which are re-simulated regularly (see PredictionBuffer::replay). */
+    PredictionBuffer *m_prediction;
+
+    /** Number of replays, and the number of replays that differed so
+     *  much from the recorded run that a client would be corrected. */
+    unsigned int m_num_replays;
+    unsigned int m_num_failed_replays;
+
+    /** Sum and maximum of the position errors of all replays. */
+    float        m_total_replay_error;
+    float        m_max_replay_error;
+
+    void checkPrediction(float dt);
+    void writeStats(float runtime) const;
+
 protected:
     /** In laps based profiling: number of laps to run. Also
      *  used by DemoWorld. */
@@ -89,6 +113,12 @@ public:
     static   void setProfileModeTime(float time);
     static   void setProfileModeLaps(int laps);
     // ------------------------------------------------------------------------
+    /** Sets the file the frame statistics are written to. */
+    static   void setStatsFile(const std::string &file) { m_stats_file = file; }
+    // ------------------------------------------------------------------------
+    /** Checks that the client side prediction can re-simulate the karts. */
+    static   void enablePredictionCheck() { m_check_prediction = true; }
+    // ------------------------------------------------------------------------
     /** Returns true if profile mode was selected. */
     static   bool isProfileMode() {return m_profile_mode!=PROFILE_NONE; }
     // ------------------------------------------------------------------------
@@ -21,7 +21,7 @@
 #include "items/powerup_manager.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
-#include "karts/controller/ghost_controller.hpp"
+#include "karts/ghost_kart.hpp"
 #include "network/network_config.hpp"
 
 //-----------------------------------------------------------------------------
@@ -37,8 +37,7 @@ bool StandardRace::isRaceOver()
 {
     if (race_manager->isWatchingReplay())
     {
-        return dynamic_cast<GhostController*>
-            (m_karts[0]->getController())->isReplayEnd();
+        return dynamic_cast<GhostKart*>(m_karts[0])->isReplayEnd();
     }
     // The race is over if all players have finished the race. Remaining
     // times for AI opponents will be estimated in enterRaceOverState
@@ -0,0 +1,208 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/bit_stream.hpp"
+
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+    /** The layout of an input in the benchmark, similar to the inputs sent
+     *  by the ControllerEventsProtocol. */
+    typedef BitSchema<BitVarUInt, BitDouble, BitRangedInt<0, 31>,
+                      BitUInt<7>, BitQuantizedFloat<0, 1, 8>,
+                      BitQuantizedFloat<-1, 1, 8>, BitRangedInt<0, 15>,
+                      BitRangedInt<0, 32768> > BenchmarkSchema;
+
+    // ------------------------------------------------------------------------
+    /** Encodes and decodes the same inputs with a BitWriter and BitReader
+     *  and byte aligned with a BareNetworkString, and logs the throughput
+     *  of both and the size of the messages.
+     *  \param num_messages Number of messages to encode and decode.
+     */
+    void benchmark(unsigned int num_messages)
+    {
+        uint8_t buffer[BenchmarkSchema::MAX_BYTES];
+        unsigned int bit_bytes = 0;
+        uint32_t checksum = 0;
+        double start = StkTime::getRealTime();
+        for (unsigned int i = 0; i < num_messages; i++)
+        {
+            BitWriter writer(buffer, BenchmarkSchema::MAX_BYTES);
+            BenchmarkSchema::write(&writer, i, i*0.01, i % 32, i % 128,
+                                   (i % 256)/255.0f, (i % 255)/127.0f - 1.0f,
+                                   i % 16, i % 32769);
+            bit_bytes += writer.getNumBytes();
+
+            BitReader reader(buffer, writer.getNumBytes());
+            uint32_t sequence, controls;
+            double time;
+            int kart_id, action, value;
+            float accel, steer;
+            BenchmarkSchema::read(&reader, &sequence, &time, &kart_id,
+                                  &controls, &accel, &steer, &action, &value);
+            checksum += sequence + kart_id + value;
+        }
+        double bit_time = StkTime::getRealTime() - start;
+
+        unsigned int byte_bytes = 0;
+        start = StkTime::getRealTime();
+        for (unsigned int i = 0; i < num_messages; i++)
+        {
+            BareNetworkString s(21);
+            s.addUInt32(i).addDouble(i*0.01).addUInt8(i % 32)
+             .addUInt8(i % 128).addUInt8(uint8_t(i % 256))
+             .addUInt8(uint8_t(i % 255)).addUInt8(i % 16)
+             .addUInt32(i % 32769);
+            byte_bytes += s.size();
+
+            uint32_t sequence = s.getUInt32();
+            s.getDouble();
+            uint8_t kart_id = s.getUInt8();
+            s.getUInt8(); s.getUInt8(); s.getUInt8(); s.getUInt8();
+            uint32_t value = s.getUInt32();
+            checksum -= sequence + kart_id + value;
+        }
+        double byte_time = StkTime::getRealTime() - start;
+        assert(checksum == 0);
+
+        Log::info("BitStream", "%d messages: bit packed %.1f bytes, "
+                  "%.0f messages/s, byte aligned %.1f bytes, %.0f messages/s.",
+                  num_messages, float(bit_bytes)/num_messages,
+                  num_messages/std::max(bit_time, 0.001),
+                  float(byte_bytes)/num_messages,
+                  num_messages/std::max(byte_time, 0.001));
+    }   // benchmark
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Round trip tests of all value types and of a schema, checks for the
+ *  detection of overflows, and runs a small encoding/decoding benchmark.
+ */
+void BitWriter::unitTesting()
+{
+    // Compile time sizes
+    assert(BitsForValue<1>::value == 1);
+    assert(BitsForValue<255>::value == 8);
+    assert(BitsForValue<256>::value == 9);
+    assert((BitRangedInt<-32768, 32768>::MAX_BITS == 17));
+    assert(BenchmarkSchema::MAX_BITS == 40 + 64 + 5 + 7 + 8 + 8 + 4 + 16);
+
+    // Arbitrary bit widths
+    srand(4711);
+    uint8_t buffer[1024];
+    std::vector<std::pair<uint32_t, unsigned int> > values;
+    BitWriter writer(buffer, sizeof(buffer));
+    unsigned int num_bits = 0;
+    for (unsigned int i = 0; i < 200; i++)
+    {
+        unsigned int bits = 1 + rand() % 32;
+        uint32_t value = (uint32_t(rand()) << 16) ^ uint32_t(rand());
+        if (bits < 32)
+            value &= (uint32_t(1) << bits) - 1;
+        writer.writeBits(value, bits);
+        values.push_back(std::make_pair(value, bits));
+        num_bits += bits;
+    }
+    assert(!writer.hasOverflow());
+    assert(writer.getNumBits() == num_bits);
+    assert(writer.getNumBytes() == (num_bits + 7) / 8);
+    BitReader reader(buffer, writer.getNumBytes());
+    for (unsigned int i = 0; i < values.size(); i++)
+        assert(reader.readBits(values[i].second) == values[i].first);
+    assert(!reader.hasOverflow());
+
+    // All other types
+    writer = BitWriter(buffer, sizeof(buffer));
+    writer.writeBool(true);
+    writer.writeRanged(-5, -10, 10, 5);
+    writer.writeRanged(100, -10, 10, 5);    // clamped
+    writer.writeQuantized(0.3f, -1.0f, 1.0f, 10);
+    writer.writeQuantized(5.0f, -1.0f, 1.0f, 10);   // clamped
+    unsigned int before = writer.getNumBits();
+    writer.writeVarUInt(127);
+    assert(writer.getNumBits() == before + 8);
+    writer.writeVarUInt(128);
+    assert(writer.getNumBits() == before + 24);
+    writer.writeVarUInt(0xffffffff);
+    assert(writer.getNumBits() == before + 64);
+    writer.writeFloat(-1.2345f);
+    writer.writeDouble(12345.6789012345);
+    assert(!writer.hasOverflow());
+
+    reader = BitReader(buffer, writer.getNumBytes());
+    assert(reader.readBool());
+    assert(reader.readRanged(-10, 5) == -5);
+    assert(reader.readRanged(-10, 5) == 10);
+    assert(fabsf(reader.readQuantized(-1.0f, 1.0f, 10) - 0.3f)
+           <= 0.5f*2.0f/1023);
+    assert(reader.readQuantized(-1.0f, 1.0f, 10) == 1.0f);
+    assert(reader.readVarUInt() == 127);
+    assert(reader.readVarUInt() == 128);
+    assert(reader.readVarUInt() == 0xffffffff);
+    assert(reader.readFloat() == -1.2345f);
+    assert(reader.readDouble() == 12345.6789012345);
+    assert(!reader.hasOverflow());
+
+    // A value that does not fit is not written, reading past the end
+    // is detected.
+    uint8_t small[3] = { 0, 0, 0xab };
+    writer = BitWriter(small, 2);
+    writer.writeBits(0x1ff, 9);
+    writer.writeBits(0xff, 8);
+    assert(writer.hasOverflow());
+    assert(writer.getNumBytes() == 2 && small[2] == 0xab);
+    reader = BitReader(small, 2);
+    assert(reader.readBits(9) == 0x1ff);
+    assert(!reader.hasOverflow());
+    reader.readBits(8);
+    assert(reader.hasOverflow());
+
+    // A schema, appended to and read from a network string
+    uint8_t message[BenchmarkSchema::MAX_BYTES];
+    writer = BitWriter(message, BenchmarkSchema::MAX_BYTES);
+    BenchmarkSchema::write(&writer, 300, 98.765, 17, 0x55, 0.5f, -0.25f, 3,
+                           32768);
+    assert(!writer.hasOverflow());
+    BareNetworkString s(writer.getNumBytes() + 1);
+    s.addUInt8(42).addBytes(message, writer.getNumBytes());
+    assert(s.getUInt8() == 42);
+    reader = BitReader(s.getCurrentData(), s.size());
+    uint32_t sequence, controls;
+    double time;
+    int kart_id, action, value;
+    float accel, steer;
+    BenchmarkSchema::read(&reader, &sequence, &time, &kart_id, &controls,
+                          &accel, &steer, &action, &value);
+    assert(!reader.hasOverflow());
+    s.skip(reader.getNumBytes());
+    assert(s.size() == 0);
+    assert(sequence == 300 && time == 98.765 && kart_id == 17);
+    assert(controls == 0x55 && action == 3 && value == 32768);
+    assert(fabsf(accel - 0.5f) <= 1.0f/255);
+    assert(fabsf(steer + 0.25f) <= 1.0f/255);
+
+    benchmark(100000);
+}   // unitTesting
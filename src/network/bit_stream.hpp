@@ -0,0 +1,432 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file bit_stream.hpp
+ *  \brief Bit packed serialisation of network messages, and templates to
+ *  describe the layout of a message at compile time.
+ */
+
+#ifndef HEADER_BIT_STREAM_HPP
+#define HEADER_BIT_STREAM_HPP
+
+#include "utils/types.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+/** \brief Writes values with an arbitrary number of bits into a buffer.
+ *  The buffer is provided by the caller (e.g. an array on the stack with
+ *  the maximum size of a message, see BitSchema), and is never
+ *  reallocated. If a value does not fit into the buffer anymore, it is
+ *  not written and hasOverflow() returns true. Bits are stored starting
+ *  with the most significant bit of each byte, the last byte is padded
+ *  with 0 bits.
+ * \ingroup network
+ */
+class BitWriter
+{
+private:
+    /** The buffer to write to. */
+    uint8_t     *m_buffer;
+
+    /** Size of the buffer in bytes. */
+    unsigned int m_capacity;
+
+    /** Number of bits written. */
+    unsigned int m_num_bits;
+
+    /** True if a value did not fit into the buffer. */
+    bool         m_overflow;
+
+public:
+    // ------------------------------------------------------------------------
+    /** Creates a writer for the given buffer.
+     *  \param buffer The buffer to write to.
+     *  \param capacity Size of the buffer in bytes. */
+    BitWriter(uint8_t *buffer, unsigned int capacity)
+    {
+        m_buffer   = buffer;
+        m_capacity = capacity;
+        m_num_bits = 0;
+        m_overflow = false;
+    }   // BitWriter
+
+    // ------------------------------------------------------------------------
+    /** Writes the lowest num_bits bits of a value.
+     *  \param value The value to write.
+     *  \param num_bits Number of bits to write, at most 32. */
+    void writeBits(uint32_t value, unsigned int num_bits)
+    {
+        assert(num_bits <= 32);
+        if (m_num_bits + num_bits > m_capacity*8)
+        {
+            m_overflow = true;
+            return;
+        }
+        while (num_bits > 0)
+        {
+            unsigned int used = m_num_bits & 7;
+            unsigned int n    = 8 - used < num_bits ? 8 - used : num_bits;
+            uint8_t bits = uint8_t((value >> (num_bits - n)) & ((1 << n) - 1));
+            uint8_t &byte = m_buffer[m_num_bits >> 3];
+            if (used == 0)
+                byte = 0;
+            byte |= bits << (8 - used - n);
+            m_num_bits += n;
+            num_bits   -= n;
+        }
+    }   // writeBits
+
+    // ------------------------------------------------------------------------
+    /** Writes a single bit. */
+    void writeBool(bool b) { writeBits(b ? 1 : 0, 1); }
+    // ------------------------------------------------------------------------
+    /** Writes an integer in [min, max] with the given number of bits, which
+     *  must be enough for max-min. Values outside the range are clamped. */
+    void writeRanged(int value, int min, int max, unsigned int num_bits)
+    {
+        if (value < min) value = min;
+        if (value > max) value = max;
+        writeBits(uint32_t(value - min), num_bits);
+    }   // writeRanged
+    // ------------------------------------------------------------------------
+    /** Writes a float in [min, max] quantised to num_bits bits, i.e. with a
+     *  precision of (max-min)/(2^num_bits-1). Values outside the range are
+     *  clamped. */
+    void writeQuantized(float value, float min, float max,
+                        unsigned int num_bits)
+    {
+        const uint32_t steps = uint32_t((uint64_t(1) << num_bits) - 1);
+        if (value < min) value = min;
+        if (value > max) value = max;
+        writeBits(uint32_t((value - min) / (max - min) * steps + 0.5f),
+                  num_bits);
+    }   // writeQuantized
+    // ------------------------------------------------------------------------
+    /** Writes an unsigned integer in groups of 7 bits, each followed by a
+     *  bit that says if another group follows. Small values need few bits,
+     *  e.g. values below 128 take 8 bits. */
+    void writeVarUInt(uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            writeBits((value & 0x7f) | 0x80, 8);
+            value >>= 7;
+        }
+        writeBits(value, 8);
+    }   // writeVarUInt
+    // ------------------------------------------------------------------------
+    /** Writes a float with all 32 bits. */
+    void writeFloat(float f)
+    {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(float));
+        writeBits(u, 32);
+    }   // writeFloat
+    // ------------------------------------------------------------------------
+    /** Writes a double with all 64 bits. */
+    void writeDouble(double d)
+    {
+        uint64_t u;
+        memcpy(&u, &d, sizeof(double));
+        writeBits(uint32_t(u >> 32), 32);
+        writeBits(uint32_t(u & 0xffffffff), 32);
+    }   // writeDouble
+    // ------------------------------------------------------------------------
+    /** Returns the number of bits written. */
+    unsigned int getNumBits() const { return m_num_bits; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of bytes used in the buffer. */
+    unsigned int getNumBytes() const { return (m_num_bits + 7) >> 3; }
+    // ------------------------------------------------------------------------
+    /** Returns true if a value did not fit into the buffer. */
+    bool hasOverflow() const { return m_overflow; }
+    // ------------------------------------------------------------------------
+    static void unitTesting();
+};   // BitWriter
+
+// ============================================================================
+/** \brief Reads values written by a BitWriter.
+ *  Reading past the end of the buffer returns 0 bits and sets the
+ *  overflow flag, so a truncated or corrupted message can be detected
+ *  after reading it.
+ * \ingroup network
+ */
+class BitReader
+{
+private:
+    /** The buffer to read from. */
+    const uint8_t *m_buffer;
+
+    /** Size of the buffer in bytes. */
+    unsigned int   m_size;
+
+    /** Number of bits read. */
+    unsigned int   m_num_bits;
+
+    /** True if it was tried to read past the end of the buffer. */
+    bool           m_overflow;
+
+public:
+    // ------------------------------------------------------------------------
+    /** Creates a reader for the given buffer.
+     *  \param buffer The data to read.
+     *  \param size Size of the data in bytes. */
+    BitReader(const uint8_t *buffer, unsigned int size)
+    {
+        m_buffer   = buffer;
+        m_size     = size;
+        m_num_bits = 0;
+        m_overflow = false;
+    }   // BitReader
+
+    // ------------------------------------------------------------------------
+    /** Reads num_bits bits (at most 32). */
+    uint32_t readBits(unsigned int num_bits)
+    {
+        assert(num_bits <= 32);
+        if (m_num_bits + num_bits > m_size*8)
+        {
+            m_overflow = true;
+            return 0;
+        }
+        uint32_t value = 0;
+        while (num_bits > 0)
+        {
+            unsigned int used = m_num_bits & 7;
+            unsigned int n    = 8 - used < num_bits ? 8 - used : num_bits;
+            uint8_t byte = m_buffer[m_num_bits >> 3];
+            value = (value << n) | ((byte >> (8 - used - n)) & ((1 << n) - 1));
+            m_num_bits += n;
+            num_bits   -= n;
+        }
+        return value;
+    }   // readBits
+
+    // ------------------------------------------------------------------------
+    /** Reads a single bit. */
+    bool readBool() { return readBits(1) != 0; }
+    // ------------------------------------------------------------------------
+    /** Reads an integer written with BitWriter::writeRanged. */
+    int readRanged(int min, unsigned int num_bits)
+    {
+        return min + int(readBits(num_bits));
+    }   // readRanged
+    // ------------------------------------------------------------------------
+    /** Reads a float written with BitWriter::writeQuantized. */
+    float readQuantized(float min, float max, unsigned int num_bits)
+    {
+        const uint32_t steps = uint32_t((uint64_t(1) << num_bits) - 1);
+        return min + readBits(num_bits) * (max - min) / steps;
+    }   // readQuantized
+    // ------------------------------------------------------------------------
+    /** Reads an integer written with BitWriter::writeVarUInt. */
+    uint32_t readVarUInt()
+    {
+        uint32_t value = 0;
+        for (unsigned int shift = 0; shift < 35; shift += 7)
+        {
+            uint32_t group = readBits(8);
+            value |= (group & 0x7f) << shift;
+            if ((group & 0x80) == 0)
+                break;
+        }
+        return value;
+    }   // readVarUInt
+    // ------------------------------------------------------------------------
+    /** Reads a float written with BitWriter::writeFloat. */
+    float readFloat()
+    {
+        uint32_t u = readBits(32);
+        float f;
+        memcpy(&f, &u, sizeof(float));
+        return f;
+    }   // readFloat
+    // ------------------------------------------------------------------------
+    /** Reads a double written with BitWriter::writeDouble. */
+    double readDouble()
+    {
+        uint64_t u = uint64_t(readBits(32)) << 32;
+        u |= readBits(32);
+        double d;
+        memcpy(&d, &u, sizeof(double));
+        return d;
+    }   // readDouble
+    // ------------------------------------------------------------------------
+    /** Returns the number of bits read. */
+    unsigned int getNumBits() const { return m_num_bits; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of bytes read, including the padding of the
+     *  last byte. */
+    unsigned int getNumBytes() const { return (m_num_bits + 7) >> 3; }
+    // ------------------------------------------------------------------------
+    /** Returns true if it was tried to read past the end of the data. */
+    bool hasOverflow() const { return m_overflow; }
+};   // BitReader
+
+// ============================================================================
+// The field types of a BitSchema. Each field type defines the C++ type of
+// its values, the maximum number of bits it needs, and functions to write
+// and read a value.
+
+/** Number of bits needed to store all values from 0 to N. */
+template<uint32_t N>
+struct BitsForValue
+{
+    enum { value = 1 + BitsForValue<N/2>::value };
+};   // BitsForValue
+template<>
+struct BitsForValue<0>
+{
+    enum { value = 0 };
+};   // BitsForValue<0>
+
+// ----------------------------------------------------------------------------
+/** An unsigned integer with N bits. */
+template<unsigned int N>
+struct BitUInt
+{
+    typedef uint32_t Type;
+    enum { MAX_BITS = N };
+    static void write(BitWriter *w, uint32_t v) { w->writeBits(v, N); }
+    static void read(BitReader *r, uint32_t *v) { *v = r->readBits(N);  }
+};   // BitUInt
+
+// ----------------------------------------------------------------------------
+/** A boolean stored in a single bit. */
+struct BitBool
+{
+    typedef bool Type;
+    enum { MAX_BITS = 1 };
+    static void write(BitWriter *w, bool v) { w->writeBool(v);    }
+    static void read(BitReader *r, bool *v) { *v = r->readBool(); }
+};   // BitBool
+
+// ----------------------------------------------------------------------------
+/** An integer in [MIN, MAX], stored with the minimum number of bits. */
+template<int MIN, int MAX>
+struct BitRangedInt
+{
+    typedef int Type;
+    enum { MAX_BITS = BitsForValue<uint32_t(MAX - MIN)>::value };
+    static void write(BitWriter *w, int v)
+    {
+        w->writeRanged(v, MIN, MAX, MAX_BITS);
+    }   // write
+    static void read(BitReader *r, int *v)
+    {
+        *v = r->readRanged(MIN, MAX_BITS);
+    }   // read
+};   // BitRangedInt
+
+// ----------------------------------------------------------------------------
+/** A float in [MIN/SCALE, MAX/SCALE] quantised to N bits (a template
+ *  parameter can not be a float, hence the scale). */
+template<int MIN, int MAX, unsigned int N, int SCALE=1>
+struct BitQuantizedFloat
+{
+    typedef float Type;
+    enum { MAX_BITS = N };
+    static void write(BitWriter *w, float v)
+    {
+        w->writeQuantized(v, float(MIN)/SCALE, float(MAX)/SCALE, N);
+    }   // write
+    static void read(BitReader *r, float *v)
+    {
+        *v = r->readQuantized(float(MIN)/SCALE, float(MAX)/SCALE, N);
+    }   // read
+};   // BitQuantizedFloat
+
+// ----------------------------------------------------------------------------
+/** An unsigned integer stored as variable length integer. */
+struct BitVarUInt
+{
+    typedef uint32_t Type;
+    enum { MAX_BITS = 40 };
+    static void write(BitWriter *w, uint32_t v) { w->writeVarUInt(v);    }
+    static void read(BitReader *r, uint32_t *v) { *v = r->readVarUInt(); }
+};   // BitVarUInt
+
+// ----------------------------------------------------------------------------
+/** A float with full precision. */
+struct BitFloat
+{
+    typedef float Type;
+    enum { MAX_BITS = 32 };
+    static void write(BitWriter *w, float v) { w->writeFloat(v);    }
+    static void read(BitReader *r, float *v) { *v = r->readFloat(); }
+};   // BitFloat
+
+// ----------------------------------------------------------------------------
+/** A double with full precision. */
+struct BitDouble
+{
+    typedef double Type;
+    enum { MAX_BITS = 64 };
+    static void write(BitWriter *w, double v) { w->writeDouble(v);    }
+    static void read(BitReader *r, double *v) { *v = r->readDouble(); }
+};   // BitDouble
+
+// ============================================================================
+/** \brief Describes the layout of a message (or of one record of a message)
+ *  as a list of field types, e.g.
+ *      typedef BitSchema<BitVarUInt, BitRangedInt<0, 15>,
+ *                        BitQuantizedFloat<-1, 1, 8> > MySchema;
+ *      uint8_t buffer[MySchema::MAX_BYTES];
+ *      BitWriter writer(buffer, MySchema::MAX_BYTES);
+ *      MySchema::write(&writer, sequence, kart_id, steer);
+ *  The values are checked against the field types at compile time, and the
+ *  maximum size of a message is known at compile time, so buffers can be
+ *  allocated on the stack.
+ * \ingroup network
+ */
+template<typename... Fields>
+struct BitSchema;
+
+template<>
+struct BitSchema<>
+{
+    enum { MAX_BITS = 0, MAX_BYTES = 0 };
+    static void write(BitWriter *w) {}
+    static void read(BitReader *r)  {}
+};   // BitSchema<>
+
+template<typename Field, typename... Rest>
+struct BitSchema<Field, Rest...>
+{
+    enum { MAX_BITS  = Field::MAX_BITS + BitSchema<Rest...>::MAX_BITS,
+           MAX_BYTES = (MAX_BITS + 7) / 8 };
+    // ------------------------------------------------------------------------
+    /** Writes the values of all fields. */
+    static void write(BitWriter *w, typename Field::Type value,
+                      typename Rest::Type... rest)
+    {
+        Field::write(w, value);
+        BitSchema<Rest...>::write(w, rest...);
+    }   // write
+    // ------------------------------------------------------------------------
+    /** Reads the values of all fields. */
+    static void read(BitReader *r, typename Field::Type *value,
+                     typename Rest::Type*... rest)
+    {
+        Field::read(r, value);
+        BitSchema<Rest...>::read(r, rest...);
+    }   // read
+};   // BitSchema
+
+#endif
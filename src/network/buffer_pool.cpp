@@ -0,0 +1,321 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/buffer_pool.hpp"
+
+#include "network/network_stats.hpp"
+#include "network/network_string.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+#include "utils/types.hpp"
+
+#include "enet/enet.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+namespace
+{
+    /** Size of the smallest block is 2^MIN_SHIFT. */
+    const unsigned int MIN_SHIFT   = 5;
+
+    /** Number of pooled block sizes, from 32 bytes to MAX_POOLED_SIZE. */
+    const unsigned int NUM_CLASSES = 9;
+
+    /** Stored in front of each block. The union keeps the user data
+     *  aligned like memory from malloc. */
+    union Header
+    {
+        struct
+        {
+            /** Index of the block size, NUM_CLASSES if not pooled. */
+            uint32_t m_size_class;
+            /** Usable size of the block. */
+            uint32_t m_capacity;
+        } m_info;
+        double      m_align_double;
+        long double m_align_long_double;
+        void       *m_align_pointer;
+    };   // Header
+
+    /** A released block, the pointer to the next free block is stored in
+     *  the block itself. */
+    struct FreeBlock
+    {
+        FreeBlock *m_next;
+    };   // FreeBlock
+
+    FreeBlock      *g_free_blocks[NUM_CLASSES];
+    pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+    unsigned int    g_num_allocations        = 0;
+    unsigned int    g_num_system_allocations = 0;
+
+    // ------------------------------------------------------------------------
+    /** ENet memory callbacks, see initialiseENet. */
+    void* ENET_CALLBACK enetMalloc(size_t size)
+    {
+        return BufferPool::allocate(size);
+    }   // enetMalloc
+    void ENET_CALLBACK enetFree(void *p)
+    {
+        BufferPool::release(p);
+    }   // enetFree
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Returns a block of at least the given size.
+ *  \param size Number of bytes requested.
+ */
+void *BufferPool::allocate(size_t size)
+{
+    unsigned int size_class = 0;
+    while (size_class < NUM_CLASSES &&
+           (size_t(1) << (size_class + MIN_SHIFT)) < size)
+        size_class++;
+
+    pthread_mutex_lock(&g_mutex);
+    g_num_allocations++;
+    if (size_class < NUM_CLASSES && g_free_blocks[size_class])
+    {
+        FreeBlock *block = g_free_blocks[size_class];
+        g_free_blocks[size_class] = block->m_next;
+        pthread_mutex_unlock(&g_mutex);
+        return block;
+    }
+    g_num_system_allocations++;
+    pthread_mutex_unlock(&g_mutex);
+
+    size_t capacity = size_class < NUM_CLASSES
+                    ? size_t(1) << (size_class + MIN_SHIFT)
+                    : size;
+    Header *header = (Header*)malloc(sizeof(Header) + capacity);
+    if (!header)
+        return NULL;
+    header->m_info.m_size_class = size_class;
+    header->m_info.m_capacity   = (uint32_t)capacity;
+    return header + 1;
+}   // allocate
+
+// ----------------------------------------------------------------------------
+/** Returns a block to the pool.
+ *  \param p A block returned by allocate, or NULL.
+ */
+void BufferPool::release(void *p)
+{
+    if (!p)
+        return;
+    Header *header = (Header*)p - 1;
+    unsigned int size_class = header->m_info.m_size_class;
+    if (size_class >= NUM_CLASSES)
+    {
+        free(header);
+        return;
+    }
+    FreeBlock *block = (FreeBlock*)p;
+    pthread_mutex_lock(&g_mutex);
+    block->m_next = g_free_blocks[size_class];
+    g_free_blocks[size_class] = block;
+    pthread_mutex_unlock(&g_mutex);
+}   // release
+
+// ----------------------------------------------------------------------------
+/** Returns the usable size of a block, which can be bigger than the
+ *  requested size. */
+size_t BufferPool::getCapacity(const void *p)
+{
+    return ((const Header*)p - 1)->m_info.m_capacity;
+}   // getCapacity
+
+// ----------------------------------------------------------------------------
+/** Returns the number of calls to allocate. */
+unsigned int BufferPool::getNumAllocations()
+{
+    pthread_mutex_lock(&g_mutex);
+    unsigned int n = g_num_allocations;
+    pthread_mutex_unlock(&g_mutex);
+    return n;
+}   // getNumAllocations
+
+// ----------------------------------------------------------------------------
+/** Returns the number of blocks that had to be allocated from the system,
+ *  i.e. calls to allocate that could not be served from the pool. */
+unsigned int BufferPool::getNumSystemAllocations()
+{
+    pthread_mutex_lock(&g_mutex);
+    unsigned int n = g_num_system_allocations;
+    pthread_mutex_unlock(&g_mutex);
+    return n;
+}   // getNumSystemAllocations
+
+// ----------------------------------------------------------------------------
+/** Initialises ENet so that it allocates its packets (and all other memory)
+ *  from the pool. Returns 0 on success like enet_initialize.
+ */
+int BufferPool::initialiseENet()
+{
+    ENetCallbacks callbacks = { enetMalloc, enetFree, NULL };
+    return enet_initialize_with_callbacks(ENET_VERSION, &callbacks);
+}   // initialiseENet
+
+// ----------------------------------------------------------------------------
+/** Checks that blocks are reused, and floods a server with messages from a
+ *  client over loopback (using ENet with the pool as allocator, like
+ *  STKHost) and checks that no memory is allocated from the system per
+ *  message once the pool is filled. The messages are counted in the
+ *  NetworkStats like STKHost does, and the time this takes is compared
+ *  with the time per message.
+ */
+void BufferPool::unitTesting()
+{
+    void *a = allocate(100);
+    assert(getCapacity(a) == 128);
+    release(a);
+    void *b = allocate(65);
+    assert(a == b);
+    void *big = allocate(MAX_POOLED_SIZE + 1);
+    assert(getCapacity(big) == MAX_POOLED_SIZE + 1);
+    release(big);
+    release(b);
+    release(NULL);
+
+    if (initialiseENet() != 0)
+    {
+        Log::warn("BufferPool", "Could not initialise ENet, no flood test.");
+        return;
+    }
+    ENetAddress address;
+    enet_address_set_host(&address, "127.0.0.1");
+    ENetHost *server = NULL;
+    for (address.port = 33000; address.port < 33020 && !server;
+         address.port++)
+        server = enet_host_create(&address, 1, 1, 0, 0);
+    address.port--;
+    ENetHost *client = enet_host_create(NULL, 1, 1, 0, 0);
+    if (!server || !client)
+    {
+        Log::warn("BufferPool", "Could not create hosts, no flood test.");
+        if (server) enet_host_destroy(server);
+        if (client) enet_host_destroy(client);
+        return;
+    }
+    ENetPeer *peer = enet_host_connect(client, &address, 1, 0);
+    ENetEvent event;
+    bool connected = false;
+    for (unsigned int i = 0; i < 100 && !connected; i++)
+    {
+        enet_host_service(server, &event, 10);
+        while (enet_host_service(client, &event, 0) > 0)
+            connected |= event.type == ENET_EVENT_TYPE_CONNECT;
+    }
+
+    const unsigned int NUM_MESSAGES = 2000;
+    const unsigned int WARM_UP      = 200;
+    const unsigned int BURST        = 20;
+    unsigned int received = 0, start_allocations = 0;
+    unsigned int start_system_allocations = 0;
+    uint32_t checksum = 0;
+    NetworkStats *stats = NetworkStats::get();
+    NetworkStats::Peer peer_stats;
+    double start_time = StkTime::getRealTime();
+    for (unsigned int sent = 0; sent < NUM_MESSAGES && connected; )
+    {
+        for (unsigned int i = 0; i < BURST; i++, sent++)
+        {
+            NetworkString *ns = new NetworkString(PROTOCOL_KART_UPDATE, 40);
+            ns->addUInt32(sent);
+            for (unsigned int j = 0; j < 9; j++)
+                ns->addFloat(j*1.5f);
+            ENetPacket *packet = enet_packet_create(ns->getData(),
+                                                    ns->getTotalSize(),
+                                          ENET_PACKET_FLAG_RELIABLE);
+            enet_peer_send(peer, 0, packet);
+            peer_stats.m_out.add(ns->getTotalSize());
+            stats->addSent(ns->getProtocolType(), ns->getTotalSize());
+            delete ns;
+            checksum += sent;
+        }
+        enet_host_flush(client);
+        // Wait till the server received the whole burst
+        for (unsigned int n = 0; n < 100 && received < sent; n++)
+        {
+            while (enet_host_service(server, &event, 1) > 0)
+            {
+                if (event.type != ENET_EVENT_TYPE_RECEIVE)
+                    continue;
+                double receive_time = StkTime::getRealTime();
+                NetworkString *ns = new NetworkString(event.packet);
+                peer_stats.m_in.add(ns->getTotalSize());
+                stats->addReceived(ns->getProtocolType(),
+                                   ns->getTotalSize());
+                stats->addDispatchLatency(ns->getProtocolType(),
+                                   StkTime::getRealTime() - receive_time);
+                checksum -= ns->getUInt32();
+                delete ns;
+                received++;
+            }
+            enet_host_service(client, &event, 0);
+        }
+        if (sent == WARM_UP)
+        {
+            start_allocations        = getNumAllocations();
+            start_system_allocations = getNumSystemAllocations();
+            start_time               = StkTime::getRealTime();
+        }
+    }   // for sent < NUM_MESSAGES
+    double message_time = (StkTime::getRealTime() - start_time)
+                        / (NUM_MESSAGES - WARM_UP);
+
+    if (connected)
+    {
+        unsigned int n = NUM_MESSAGES - WARM_UP;
+        float allocations = float(getNumAllocations() - start_allocations)/n;
+        float system      = float(getNumSystemAllocations()
+                                  - start_system_allocations) / n;
+        Log::info("BufferPool", "%d of %d messages received, %.2f pool "
+                  "allocations and %.3f system allocations per message.",
+                  received, NUM_MESSAGES, allocations, system);
+        assert(received == NUM_MESSAGES && checksum == 0);
+        assert(system < 0.01f);
+        assert(peer_stats.m_in.getPackets() == NUM_MESSAGES);
+        assert(peer_stats.m_out.getPackets() == NUM_MESSAGES);
+
+        // The counting done for each message, without the network
+        const unsigned int NUM_COUNTS = 100000;
+        const unsigned int SIZE       = 5 + 4 + 9*4;
+        double count_time = StkTime::getRealTime();
+        for (unsigned int i = 0; i < NUM_COUNTS; i++)
+        {
+            peer_stats.m_out.add(SIZE);
+            stats->addSent(PROTOCOL_KART_UPDATE, SIZE);
+            peer_stats.m_in.add(SIZE);
+            stats->addReceived(PROTOCOL_KART_UPDATE, SIZE);
+            stats->addDispatchLatency(PROTOCOL_KART_UPDATE, i*1.0e-9);
+        }
+        count_time = (StkTime::getRealTime() - count_time) / NUM_COUNTS;
+        Log::info("BufferPool", "%.1f us per message, of which %.0f ns "
+                  "(%.2f%%) are used for the network stats.",
+                  message_time*1.0e6, count_time*1.0e9,
+                  100.0*count_time/message_time);
+    }
+    else
+        Log::warn("BufferPool", "Could not connect, no flood test.");
+    enet_peer_reset(peer);
+    enet_host_destroy(client);
+    enet_host_destroy(server);
+}   // unitTesting
@@ -0,0 +1,53 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file buffer_pool.hpp
+ */
+
+#ifndef HEADER_BUFFER_POOL_HPP
+#define HEADER_BUFFER_POOL_HPP
+
+#include <stddef.h>
+
+/** \brief A thread safe pool of memory blocks for network messages.
+ *  Each request is rounded up to a power of two (between 32 bytes and
+ *  MAX_POOLED_SIZE), and released blocks are kept in a free list for each
+ *  size, so that after a short time sending and receiving messages does
+ *  not allocate any memory from the system anymore. It is used for the
+ *  buffers of network strings, for events, and by ENet for its packets
+ *  (see STKHost). Bigger blocks are allocated and freed directly. The pool
+ *  never returns memory to the system, its size is the maximum number of
+ *  blocks used at the same time.
+ * \ingroup network
+ */
+class BufferPool
+{
+public:
+    /** Blocks bigger than this are not pooled. */
+    static const size_t MAX_POOLED_SIZE = 8192;
+
+    static void  *allocate(size_t size);
+    static void   release(void *p);
+    static size_t getCapacity(const void *p);
+    static unsigned int getNumAllocations();
+    static unsigned int getNumSystemAllocations();
+    static int    initialiseENet();
+    static void   unitTesting();
+};   // BufferPool
+
+#endif
@@ -30,6 +30,7 @@
 Event::Event(ENetEvent* event)
 {
     m_arrival_time = (double)StkTime::getTimeSinceEpoch();
+    m_receive_time = StkTime::getRealTime();
 
     switch (event->type)
     {
@@ -48,16 +49,14 @@ Event::Event(ENetEvent* event)
     }
     if (m_type == EVENT_TYPE_MESSAGE)
     {
-        m_data = new NetworkString(event->packet->data, 
-                                      event->packet->dataLength);
+        // The network string takes over the packet and destroys it
+        m_data = new NetworkString(event->packet);
     }
     else
-        m_data = NULL;
-
-    if (event->packet)
     {
-        // we got all we need, just remove the data.
-        enet_packet_destroy(event->packet);
+        m_data = NULL;
+        if (event->packet)
+            enet_packet_destroy(event->packet);
     }
 
     m_peer = STKHost::get()->getPeer(event->peer);
@@ -24,6 +24,7 @@
 #ifndef EVENT_HPP
 #define EVENT_HPP
 
+#include "network/buffer_pool.hpp"
 #include "network/network_string.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/types.hpp"
@@ -58,7 +59,7 @@ class Event
 private:
     LEAK_CHECK()
 
-    /** Copy of the data passed by the event. */
+    /** The data passed by the event, it uses the received packet. */
     NetworkString *m_data;
 
     /**  Type of the event. */
@@ -70,10 +71,23 @@ private:
     /** Arrivial time of the event, for timeouts. */
     double m_arrival_time;
 
+    /** Real time when the event was received, for the network stats. */
+    double m_receive_time;
+
 public:
          Event(ENetEvent* event);
         ~Event();
 
+    // ------------------------------------------------------------------------
+    /** An event is created for each received message, so events are
+     *  allocated from the pool. */
+    static void* operator new(size_t size)
+    {
+        return BufferPool::allocate(size);
+    }   // operator new
+    // ------------------------------------------------------------------------
+    static void operator delete(void *p) { BufferPool::release(p); }
+
     // ------------------------------------------------------------------------
     /** Returns the type of this event. */
     EVENT_TYPE getType() const { return m_type; }
@@ -88,8 +102,8 @@ public:
     const NetworkString& data() const { return *m_data; }
     // ------------------------------------------------------------------------
     /** \brief Get a non-const reference to the received data.
-     *  A copy of the message data. This is empty for events like
-     *  connection or disconnections. */
+     *  The message data, which can be modified in place. This is empty for
+     *  events like connection or disconnections. */
     NetworkString& data() { return *m_data; }
     // ------------------------------------------------------------------------
     /** Determines if this event should be delivered synchronous or not.
@@ -99,6 +113,10 @@ public:
     // ------------------------------------------------------------------------
     /** Returns the arrival time of this event. */
     double getArrivalTime() const { return m_arrival_time; }
+    // ------------------------------------------------------------------------
+    /** Returns the real time (see StkTime::getRealTime) when this event
+     *  was received. */
+    double getReceiveTime() const { return m_receive_time; }
 
     // ------------------------------------------------------------------------
 
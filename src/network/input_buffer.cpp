@@ -0,0 +1,283 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/input_buffer.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+namespace
+{
+    /** The playout delay is never bigger than this, so that a single very
+     *  late packet does not delay all inputs of a kart for a long time. */
+    const double MAX_DELAY = 0.25;
+}   // namespace
+
+// ----------------------------------------------------------------------------
+InputBuffer::InputBuffer()
+{
+    reset();
+}   // InputBuffer
+
+// ----------------------------------------------------------------------------
+/** Removes all inputs and estimations, e.g. at the start of a race. */
+void InputBuffer::reset()
+{
+    m_streams.clear();
+    m_num_duplicates = 0;
+    m_num_late       = 0;
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Adds the transit time of an input to the window of a stream, and
+ *  updates the minimum transit time and the playout delay.
+ *  \param stream The stream of the kart.
+ *  \param transit Arrival time minus send time of the input.
+ */
+void InputBuffer::updateDelay(Stream *stream, double transit)
+{
+    stream->m_transit[stream->m_next_transit] = transit;
+    stream->m_next_transit = (stream->m_next_transit + 1) % WINDOW_SIZE;
+    if (stream->m_num_transit < WINDOW_SIZE)
+        stream->m_num_transit++;
+
+    double sorted[WINDOW_SIZE];
+    std::copy(stream->m_transit, stream->m_transit + stream->m_num_transit,
+              sorted);
+    std::sort(sorted, sorted + stream->m_num_transit);
+    stream->m_base  = sorted[0];
+    unsigned int quantile = (stream->m_num_transit * 9) / 10;
+    if (quantile >= stream->m_num_transit)
+        quantile = stream->m_num_transit - 1;
+    stream->m_delay = std::min(sorted[quantile] - stream->m_base, MAX_DELAY);
+}   // updateDelay
+
+// ----------------------------------------------------------------------------
+/** Adds a received input.
+ *  \param input The input.
+ *  \param local_time Local time at which the input was received.
+ *  \return False if the input was already received or is too old.
+ */
+bool InputBuffer::add(const Input &input, double local_time)
+{
+    std::map<int, Stream>::iterator i = m_streams.find(input.m_kart_id);
+    if (i == m_streams.end())
+    {
+        Stream stream;
+        stream.m_next_sequence = input.m_sequence;
+        stream.m_num_transit   = 0;
+        stream.m_next_transit  = 0;
+        stream.m_base          = 0;
+        stream.m_delay         = 0;
+        i = m_streams.insert(std::make_pair(input.m_kart_id, stream)).first;
+    }
+    Stream &stream = i->second;
+
+    if (stream.m_pending.find(input.m_sequence) != stream.m_pending.end())
+    {
+        m_num_duplicates++;
+        return false;
+    }
+    if (input.m_sequence < stream.m_next_sequence)
+    {
+        // Either a duplicate of an applied input, or an input that
+        // arrived after a newer one was applied.
+        m_num_duplicates++;
+        return false;
+    }
+
+    updateDelay(&stream, local_time - input.m_time);
+    stream.m_pending[input.m_sequence] = input;
+    return true;
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Returns all inputs which must be applied at the given time, in the
+ *  order in which they must be applied.
+ *  \param local_time The current local time.
+ *  \param inputs On return contains the inputs to apply (appended).
+ */
+void InputBuffer::getDueInputs(double local_time, std::vector<Input> *inputs)
+{
+    for (std::map<int, Stream>::iterator i  = m_streams.begin();
+                                         i != m_streams.end(); i++)
+    {
+        Stream &stream = i->second;
+        while (!stream.m_pending.empty())
+        {
+            std::map<uint32_t, Input>::iterator first =
+                                                   stream.m_pending.begin();
+            const Input &input = first->second;
+            if (input.m_time + stream.m_base + stream.m_delay > local_time)
+                break;
+            // Missing inputs before this one are not applied anymore
+            if (input.m_sequence != stream.m_next_sequence)
+                m_num_late += input.m_sequence - stream.m_next_sequence;
+            stream.m_next_sequence = input.m_sequence + 1;
+            inputs->push_back(input);
+            stream.m_pending.erase(first);
+        }
+    }   // for i in m_streams
+}   // getDueInputs
+
+// ----------------------------------------------------------------------------
+/** Returns the current playout delay for a kart (in addition to the
+ *  minimum transit time).
+ *  \param kart_id The kart.
+ */
+double InputBuffer::getDelay(int kart_id) const
+{
+    std::map<int, Stream>::const_iterator i = m_streams.find(kart_id);
+    return i == m_streams.end() ? 0 : i->second.m_delay;
+}   // getDelay
+
+// ----------------------------------------------------------------------------
+/** Converts a local time to the time of the sender of a kart's inputs, so
+ *  that all inputs created before this time are due at the local time.
+ *  This allows a sender to compare a state of its kart computed here with
+ *  its own (predicted) state at the same time.
+ *  \param kart_id The kart.
+ *  \param local_time The local time.
+ *  \param sender_time On return the time of the sender.
+ *  \return False if no input of the kart was received yet.
+ */
+bool InputBuffer::getSenderTime(int kart_id, double local_time,
+                                double *sender_time) const
+{
+    std::map<int, Stream>::const_iterator i = m_streams.find(kart_id);
+    if (i == m_streams.end())
+        return false;
+    *sender_time = local_time - i->second.m_base - i->second.m_delay;
+    return true;
+}   // getSenderTime
+
+// ----------------------------------------------------------------------------
+/** Simulates a kart sending an input every 50 ms over a connection with
+ *  delay, jitter, reordering and packet loss, with each packet repeating
+ *  the last inputs. Checks that nearly all inputs are applied, in the
+ *  right order, and that the time each input is held is much closer to
+ *  the original time than when inputs are applied when they arrive.
+ */
+void InputBuffer::unitTesting()
+{
+    const double       INTERVAL   = 0.05;
+    const double       MIN_DELAY  = 0.03;
+    const double       JITTER     = 0.04;
+    const double       FRAME_TIME = 1.0/60.0;
+    const unsigned int REDUNDANCY = 3;
+    const unsigned int NUM_INPUTS = 400;
+    // The remote clock is ahead of the local clock
+    const double       OFFSET     = 12.5;
+
+    srand(1234);
+    // Arrival times of all packets, each packet contains the inputs
+    // from i-REDUNDANCY+1 to i.
+    std::vector<std::pair<double, unsigned int> > packets;
+    for (unsigned int i = 0; i < NUM_INPUTS; i++)
+    {
+        // 20% loss
+        if (rand() % 5 == 0)
+            continue;
+        double delay = MIN_DELAY + JITTER * rand() / RAND_MAX;
+        // Some packets are delayed a lot, which reorders them
+        if (rand() % 20 == 0)
+            delay += 0.1;
+        packets.push_back(std::make_pair(i*INTERVAL + delay, i));
+    }
+    std::sort(packets.begin(), packets.end());
+
+    InputBuffer buffer;
+    std::vector<double> applied(NUM_INPUTS, -1.0);
+    std::vector<double> arrived(NUM_INPUTS, -1.0);
+    unsigned int next_packet = 0;
+    int last_sequence = -1;
+    for (double t = 0; t < NUM_INPUTS*INTERVAL + 1.0; t += FRAME_TIME)
+    {
+        // Receive all packets that arrived during the last frame
+        while (next_packet < packets.size() &&
+               packets[next_packet].first <= t)
+        {
+            unsigned int last = packets[next_packet].second;
+            for (unsigned int j = 0; j < REDUNDANCY && j <= last; j++)
+            {
+                Input input;
+                input.m_sequence = last - j;
+                input.m_time     = (last - j)*INTERVAL + OFFSET;
+                input.m_kart_id  = 3;
+                input.m_action   = 0;
+                input.m_value    = last - j;
+                if (arrived[last - j] < 0)
+                    arrived[last - j] = t;
+                buffer.add(input, t);
+            }
+            next_packet++;
+        }
+
+        std::vector<Input> inputs;
+        buffer.getDueInputs(t, &inputs);
+        for (unsigned int j = 0; j < inputs.size(); j++)
+        {
+            assert(inputs[j].m_kart_id == 3);
+            assert((int)inputs[j].m_sequence > last_sequence);
+            last_sequence = inputs[j].m_sequence;
+            applied[inputs[j].m_sequence] = t;
+        }
+    }   // for t
+
+    // Compare the time each input is held with the original interval
+    unsigned int num_applied = 0, num_compared = 0;
+    double error = 0, arrival_error = 0;
+    for (unsigned int i = 0; i < NUM_INPUTS; i++)
+    {
+        if (applied[i] >= 0)
+            num_applied++;
+        if (i == 0 || applied[i] < 0 || applied[i-1] < 0 ||
+            arrived[i] < 0 || arrived[i-1] < 0)
+            continue;
+        error         += fabs(applied[i] - applied[i-1] - INTERVAL);
+        arrival_error += fabs(std::max(arrived[i] - arrived[i-1], 0.0)
+                              - INTERVAL);
+        num_compared++;
+    }
+    error         /= num_compared;
+    arrival_error /= num_compared;
+
+    Log::info("InputBuffer", "%d of %d inputs applied, %d duplicates, "
+              "%d late, delay %.1f ms, hold time error %.1f ms (applied on "
+              "arrival %.1f ms).", num_applied, NUM_INPUTS,
+              buffer.getNumDuplicates(), buffer.getNumLate(),
+              buffer.getDelay(3)*1000, error*1000, arrival_error*1000);
+    assert(num_applied >= 0.98 * NUM_INPUTS);
+    assert(buffer.getDelay(3) > 0 && buffer.getDelay(3) <= MAX_DELAY);
+    assert(error < 0.5 * arrival_error);
+    assert(buffer.getDelay(5) == 0);
+
+    // The sender time is the current time in the clock of the sender,
+    // minus the minimum transit time and the delay
+    double sender_time = 0;
+    bool known = buffer.getSenderTime(3, 100.0, &sender_time);
+    assert(known);
+    assert(fabs(sender_time + buffer.getDelay(3) + MIN_DELAY
+                - 100.0 - OFFSET) < JITTER);
+    known = buffer.getSenderTime(5, 100.0, &sender_time);
+    assert(!known);
+}   // unitTesting
@@ -0,0 +1,111 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file input_buffer.hpp
+ */
+
+#ifndef HEADER_INPUT_BUFFER_HPP
+#define HEADER_INPUT_BUFFER_HPP
+
+#include "utils/types.hpp"
+
+#include <map>
+#include <vector>
+
+/** \brief A jitter buffer for the inputs of remote karts.
+ *  Each input has a sequence number (counted per kart) and the time at
+ *  which it was created on the sending host. Instead of applying an input
+ *  as soon as it arrives (so that late or bunched packets change how long
+ *  an input is held), it is applied when the local time reaches its send
+ *  time plus the estimated transit time plus a playout delay. The transit
+ *  time is the minimum of (arrival time - send time) of the last inputs of
+ *  a kart, the delay is the 90% quantile of the additional transit time,
+ *  so it adapts to the jitter of the connection of each kart. Inputs are
+ *  applied in the order of their sequence numbers, inputs which arrive
+ *  after a newer input was applied are dropped, and duplicated inputs
+ *  (which are sent on purpose to cover lost packets) are ignored.
+ * \ingroup network
+ */
+class InputBuffer
+{
+public:
+    /** One input of a kart. */
+    struct Input
+    {
+        /** Sequence number of this input of the kart. */
+        uint32_t m_sequence;
+        /** Time at which the input was created on the sending host. */
+        double   m_time;
+        uint8_t  m_kart_id;
+        /** Compressed KartControl. */
+        uint8_t  m_controls[3];
+        uint8_t  m_action;
+        int      m_value;
+    };   // Input
+
+    /** Number of transit times used to estimate the delay. */
+    static const unsigned int WINDOW_SIZE = 32;
+
+private:
+    /** The buffered inputs and the delay estimation of one kart. */
+    struct Stream
+    {
+        /** Buffered inputs, sorted by sequence number. */
+        std::map<uint32_t, Input> m_pending;
+        /** Sequence number of the next input to apply. */
+        uint32_t     m_next_sequence;
+        /** Arrival time minus send time of the last inputs. */
+        double       m_transit[WINDOW_SIZE];
+        unsigned int m_num_transit;
+        unsigned int m_next_transit;
+        /** Minimum transit time in the window. */
+        double       m_base;
+        /** Playout delay added to the minimum transit time. */
+        double       m_delay;
+    };   // Stream
+
+    /** The streams of all karts, indexed by kart id. */
+    std::map<int, Stream> m_streams;
+
+    /** Statistics: number of duplicated inputs and of inputs which arrived
+     *  too late to be applied. */
+    unsigned int m_num_duplicates;
+    unsigned int m_num_late;
+
+    void updateDelay(Stream *stream, double transit);
+
+public:
+                 InputBuffer();
+    void         reset();
+    bool         add(const Input &input, double local_time);
+    void         getDueInputs(double local_time, std::vector<Input> *inputs);
+    double       getDelay(int kart_id) const;
+    bool         getSenderTime(int kart_id, double local_time,
+                               double *sender_time) const;
+    static void  unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of inputs that were received more than once. */
+    unsigned int getNumDuplicates() const { return m_num_duplicates; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of inputs that were dropped since they arrived
+     *  after a newer input was applied. */
+    unsigned int getNumLate() const { return m_num_late; }
+};   // InputBuffer
+
+#endif
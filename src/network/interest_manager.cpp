@@ -0,0 +1,305 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/interest_manager.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+namespace
+{
+    /** Karts closer than this distance to a kart of a peer get the
+     *  highest priority. */
+    const float NEAR_DISTANCE = 25.0f;
+
+    /** Minimum priority, so that even distant karts are updated
+     *  regularly. */
+    const float MIN_PRIORITY = 0.1f;
+
+    /** The bucket of a peer can hold at most the tokens for this time. */
+    const float MAX_BURST_TIME = 0.2f;
+
+    // ------------------------------------------------------------------------
+    bool sortByPriority(const std::pair<float, unsigned int> &a,
+                        const std::pair<float, unsigned int> &b)
+    {
+        return a.first > b.first;
+    }   // sortByPriority
+}   // namespace
+
+// ----------------------------------------------------------------------------
+/** Constructor.
+ *  \param bytes_per_second Bandwidth budget for each peer.
+ *  \param track_length Length of the track (or 0 if the track has no
+ *         driveline).
+ */
+InterestManager::InterestManager(float bytes_per_second, float track_length)
+{
+    m_bytes_per_second = bytes_per_second;
+    m_track_length     = track_length;
+}   // InterestManager
+
+// ----------------------------------------------------------------------------
+/** Returns the priority of a kart for a peer, which is between MIN_PRIORITY
+ *  and 1. It is highest for karts close to and in front of one of the
+ *  karts of the peer.
+ *  \param karts Data of all karts.
+ *  \param viewers Indices of the karts of the peer. A peer without karts
+ *         gets all karts with full priority.
+ *  \param kart Index of the kart for which to compute the priority.
+ *  \param is_near If not NULL, set to true if the kart is closer than
+ *         NEAR_DISTANCE to one of the karts of the peer.
+ */
+float InterestManager::getPriority(const std::vector<KartInfo> &karts,
+                                   const std::vector<unsigned int> &viewers,
+                                   unsigned int kart, bool *is_near) const
+{
+    if (is_near)
+        *is_near = viewers.empty();
+    if (viewers.empty())
+        return 1.0f;
+
+    const KartInfo &other = karts[kart];
+    float priority = MIN_PRIORITY;
+    for (unsigned int i = 0; i < viewers.size(); i++)
+    {
+        const KartInfo &me = karts[viewers[i]];
+        Vec3 diff = other.m_xyz - me.m_xyz;
+        float length = diff.length();
+
+        // Use the distance along the track if possible, since a kart just
+        // behind a wall can be far away on the track.
+        float distance = length;
+        if (me.m_distance >= 0 && other.m_distance >= 0 && m_track_length > 0)
+        {
+            distance = fabsf(other.m_distance - me.m_distance);
+            if (distance > 0.5f*m_track_length)
+                distance = m_track_length - distance;
+        }
+
+        // Between 0.5 (behind the kart) and 1 (in front of the kart)
+        float facing = 0.75f;
+        if (length > 0)
+            facing += 0.25f * me.m_forward.dot(diff) / length;
+
+        if (is_near && distance < NEAR_DISTANCE)
+            *is_near = true;
+        float p = facing * NEAR_DISTANCE / std::max(distance, NEAR_DISTANCE);
+        priority = std::max(priority, p);
+    }
+    return priority;
+}   // getPriority
+
+// ----------------------------------------------------------------------------
+/** Selects the karts whose positions are sent to a peer in this update.
+ *  \param host_id Host id of the peer.
+ *  \param karts Data of all karts.
+ *  \param viewers Indices of the karts of the peer, which are not sent.
+ *  \param dt Time since the last update.
+ *  \param header_size Size of a message without kart data.
+ *  \param kart_size Size of the data of one kart in a message.
+ *  \param selected On return the indices of the karts to send.
+ */
+void InterestManager::selectKarts(int host_id,
+                                  const std::vector<KartInfo> &karts,
+                                  const std::vector<unsigned int> &viewers,
+                                  float dt, unsigned int header_size,
+                                  unsigned int kart_size,
+                                  std::vector<unsigned int> *selected)
+{
+    selected->clear();
+    const float max_tokens = std::max(m_bytes_per_second * MAX_BURST_TIME,
+                                      float(header_size + kart_size));
+    PeerInfo &peer = m_peers[host_id];
+    if (peer.m_accumulated_priority.size() != karts.size())
+    {
+        peer.m_accumulated_priority.clear();
+        peer.m_accumulated_priority.resize(karts.size(), 0.0f);
+        peer.m_tokens = max_tokens;
+    }
+    else
+        peer.m_tokens = std::min(peer.m_tokens + m_bytes_per_second*dt,
+                                 max_tokens);
+
+    // Near karts are sorted before all other karts by adding a constant
+    // which is bigger than any accumulated priority.
+    const float near_offset = 1000000.0f;
+    std::vector<std::pair<float, unsigned int> > candidates;
+    for (unsigned int i = 0; i < karts.size(); i++)
+    {
+        if (std::find(viewers.begin(), viewers.end(), i) != viewers.end())
+            continue;
+        bool is_near;
+        peer.m_accumulated_priority[i] += getPriority(karts, viewers, i,
+                                                      &is_near);
+        float key = peer.m_accumulated_priority[i];
+        if (is_near)
+            key += near_offset;
+        candidates.push_back(std::make_pair(key, i));
+    }
+    std::sort(candidates.begin(), candidates.end(), sortByPriority);
+
+    unsigned int num = 0;
+    if (peer.m_tokens >= header_size + kart_size)
+        num = (unsigned int)((peer.m_tokens - header_size) / kart_size);
+    num = std::min(num, (unsigned int)candidates.size());
+
+    // If more than one kart can be sent, the last one is always the distant
+    // kart with the highest accumulated priority, so that distant karts
+    // are not starved if there are many karts close to this peer.
+    if (num >= 2 && candidates[num-1].first >= near_offset)
+    {
+        unsigned int far = num;
+        while (far < candidates.size() && candidates[far].first >= near_offset)
+            far++;
+        if (far < candidates.size())
+            std::rotate(candidates.begin() + num - 1, candidates.begin() + far,
+                        candidates.begin() + far + 1);
+    }
+
+    for (unsigned int i = 0; i < num; i++)
+    {
+        selected->push_back(candidates[i].second);
+        peer.m_accumulated_priority[candidates[i].second] = 0.0f;
+    }
+    if (num > 0)
+        peer.m_tokens -= header_size + num * kart_size;
+}   // selectKarts
+
+// ----------------------------------------------------------------------------
+/** Removes all data of a peer, e.g. when it disconnects.
+ *  \param host_id Host id of the peer.
+ */
+void InterestManager::removePeer(int host_id)
+{
+    m_peers.erase(host_id);
+}   // removePeer
+
+// ----------------------------------------------------------------------------
+/** Simulates 32 clients, each with one kart driving around a circular
+ *  track, and compares the bandwidth and the position error of the kart
+ *  positions known by each client with sending all karts in each update.
+ */
+void InterestManager::unitTesting()
+{
+    const unsigned int NUM_KARTS   = 32;
+    const unsigned int HEADER_SIZE = 4;
+    const unsigned int KART_SIZE   = 29;
+    const float        RADIUS      = 150.0f;
+    const float        DT          = 0.1f;
+    const unsigned int NUM_UPDATES = 600;
+    const float        BUDGET      = 1200.0f;
+    const float        length      = 2.0f * 3.14159265f * RADIUS;
+
+    // Run once with the budget, once with unlimited bandwidth
+    float near_error[2]  = { 0, 0 };
+    float far_error[2]   = { 0, 0 };
+    float bytes_sent[2]  = { 0, 0 };
+    float max_age        = 0;
+    for (unsigned int run = 0; run < 2; run++)
+    {
+        InterestManager im(run == 0 ? BUDGET : 1000000.0f, length);
+        std::vector<KartInfo> karts(NUM_KARTS);
+        std::vector<float> distance(NUM_KARTS);
+        std::vector<Vec3> known(NUM_KARTS*NUM_KARTS);
+        std::vector<float> last_update(NUM_KARTS*NUM_KARTS, 0.0f);
+        unsigned int num_near = 0, num_far = 0;
+
+        for (unsigned int i = 0; i < NUM_KARTS; i++)
+            distance[i] = 0.5f*length*i / NUM_KARTS;
+
+        for (unsigned int n = 0; n <= NUM_UPDATES; n++)
+        {
+            for (unsigned int i = 0; i < NUM_KARTS; i++)
+            {
+                if (n > 0)
+                    distance[i] += (20.0f + (i % 5)) * DT;
+                distance[i] = fmodf(distance[i], length);
+                float angle = distance[i] / RADIUS;
+                karts[i].m_xyz      = Vec3(RADIUS*sinf(angle), 0,
+                                           RADIUS*cosf(angle));
+                karts[i].m_forward  = Vec3(cosf(angle), 0, -sinf(angle));
+                karts[i].m_distance = distance[i];
+            }
+
+            for (unsigned int peer = 0; peer < NUM_KARTS; peer++)
+            {
+                std::vector<unsigned int> viewers(1, peer);
+                // Measure the error of the position known to this client
+                // before the update is received
+                for (unsigned int i = 0; n > 0 && i < NUM_KARTS; i++)
+                {
+                    if (i == peer) continue;
+                    float error = (known[peer*NUM_KARTS + i]
+                                   - karts[i].m_xyz).length();
+                    float d = fabsf(distance[i] - distance[peer]);
+                    if (std::min(d, length - d) < NEAR_DISTANCE)
+                    {
+                        near_error[run] += error;
+                        num_near++;
+                    }
+                    else
+                    {
+                        far_error[run] += error;
+                        num_far++;
+                    }
+                    // Only test the staleness of karts with the budget
+                    if (run == 0)
+                        max_age = std::max(max_age,
+                                    n*DT - last_update[peer*NUM_KARTS + i]);
+                }
+
+                std::vector<unsigned int> selected;
+                im.selectKarts(peer, karts, viewers, DT, HEADER_SIZE,
+                               KART_SIZE, &selected);
+                if (!selected.empty())
+                    bytes_sent[run] += HEADER_SIZE + KART_SIZE*selected.size();
+                for (unsigned int i = 0; i < selected.size(); i++)
+                {
+                    assert(selected[i] != peer);
+                    known[peer*NUM_KARTS + selected[i]] =
+                        karts[selected[i]].m_xyz;
+                    last_update[peer*NUM_KARTS + selected[i]] = n*DT;
+                }
+            }   // for peer < NUM_KARTS
+        }   // for n <= NUM_UPDATES
+        near_error[run] /= num_near;
+        far_error[run]  /= num_far;
+        bytes_sent[run] /= NUM_UPDATES * DT * NUM_KARTS;
+    }   // for run < 2
+
+    Log::info("InterestManager", "%d clients: %.0f bytes/s per client "
+              "(all karts: %.0f), average error of near karts %.2f m "
+              "(all karts: %.2f m), of distant karts %.2f m (all karts: "
+              "%.2f m), oldest update %.1f s.", NUM_KARTS, bytes_sent[0],
+              bytes_sent[1], near_error[0], near_error[1], far_error[0],
+              far_error[1], max_age);
+
+    // The budget must be kept, including the initial burst
+    assert(bytes_sent[0] <= BUDGET * (1.0f + MAX_BURST_TIME/(NUM_UPDATES*DT))
+                            + 1.0f);
+    assert(bytes_sent[0] < 0.2f * bytes_sent[1]);
+    // Near karts are updated (nearly) at the full rate
+    assert(near_error[0] < 1.25f * near_error[1]);
+    assert(far_error[0] > far_error[1]);
+    // About 4 karts can be sent per update, but no kart must starve
+    assert(max_age < 10.0f);
+}   // unitTesting
@@ -0,0 +1,90 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file interest_manager.hpp
+ */
+
+#ifndef HEADER_INTEREST_MANAGER_HPP
+#define HEADER_INTEREST_MANAGER_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <map>
+#include <vector>
+
+/** \brief Decides which kart positions the server sends to each peer.
+ *  Each kart gets a priority for each peer, which depends on the distance
+ *  (along the track if there is a driveline) to the nearest kart of that
+ *  peer, and on whether it is in front of that kart (i.e. visible by the
+ *  camera). The priorities are accumulated in each update, and the karts
+ *  with the highest accumulated priority are sent first, as long as the
+ *  bandwidth budget of the peer (a token bucket) allows. Sending a kart
+ *  resets its accumulated priority. So karts close to a peer's kart are
+ *  updated at the full rate (they are sent before all other karts, except
+ *  for one slot which is kept for the most important distant kart), while
+ *  distant karts are updated less often, but never starve.
+ * \ingroup network
+ */
+class InterestManager : public NoCopy
+{
+public:
+    /** The data of a kart needed to compute its priority. */
+    struct KartInfo
+    {
+        /** Position of the kart. */
+        Vec3  m_xyz;
+        /** Normalised forward direction of the kart. */
+        Vec3  m_forward;
+        /** Distance along the track, or a negative value if there is
+         *  no driveline (e.g. in battle mode). */
+        float m_distance;
+    };   // KartInfo
+
+private:
+    /** The state of the token bucket and the accumulated priorities of
+     *  all karts for a peer. */
+    struct PeerInfo
+    {
+        float              m_tokens;
+        std::vector<float> m_accumulated_priority;
+    };   // PeerInfo
+
+    /** The data of each peer, indexed by host id. */
+    std::map<int, PeerInfo> m_peers;
+
+    /** Bandwidth budget for each peer in bytes per second. */
+    float m_bytes_per_second;
+
+    /** Length of the track, used to wrap the distance between karts. */
+    float m_track_length;
+
+public:
+          InterestManager(float bytes_per_second, float track_length);
+    float getPriority(const std::vector<KartInfo> &karts,
+                      const std::vector<unsigned int> &viewers,
+                      unsigned int kart, bool *is_near=NULL) const;
+    void  selectKarts(int host_id, const std::vector<KartInfo> &karts,
+                      const std::vector<unsigned int> &viewers, float dt,
+                      unsigned int header_size, unsigned int kart_size,
+                      std::vector<unsigned int> *selected);
+    void  removePeer(int host_id);
+    static void unitTesting();
+};   // InterestManager
+
+#endif
@@ -0,0 +1,204 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/lobby_pool.hpp"
+
+#include "addons/news_manager.hpp"
+#include "audio/sfx_manager.hpp"
+#include "config/user_config.hpp"
+#include "graphics/image_decoder.hpp"
+#include "graphics/irr_driver.hpp"
+#include "network/network_config.hpp"
+#include "online/request_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#ifndef WIN32
+#  include <sys/types.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
+int LobbyPool::m_lobby_id    = -1;
+int LobbyPool::m_num_lobbies = 0;
+unsigned int LobbyPool::m_num_pending = 0;
+
+// ----------------------------------------------------------------------------
+/** Starts the given number of lobbies. In each lobby this function returns
+ *  (and the lobby then continues like a normal STK process), the process
+ *  calling this function waits till all lobbies are finished and then
+ *  exits, with exit status 0 only if all lobbies finished without error.
+ *  \pre Graphics are disabled (--no-graphics).
+ *  \param num_lobbies Number of lobbies to start.
+ */
+void LobbyPool::start(unsigned int num_lobbies)
+{
+#ifdef WIN32
+    Log::error("LobbyPool", "Running several lobbies is not supported on "
+               "windows.");
+#else
+    if (num_lobbies > NetworkConfig::MAX_LOBBIES)
+    {
+        Log::warn("LobbyPool", "Only %d lobbies are supported, not %d.",
+                  NetworkConfig::MAX_LOBBIES, num_lobbies);
+        num_lobbies = NetworkConfig::MAX_LOBBIES;
+    }
+    m_num_lobbies = num_lobbies;
+
+    // Only the thread calling fork exists in the new process. So make sure
+    // no other thread exists (and holds a lock) while forking: the news
+    // manager is only running at startup, the image decoder threads are
+    // started again when needed, and the request manager and sfx threads
+    // are stopped and started again in each lobby. The lobbies don't play
+    // sounds, since the thread of the audio device is not forked either.
+    if (UserConfigParams::m_internet_status ==
+                                 Online::RequestManager::IPERM_ALLOWED &&
+        !NewsManager::get()->waitForReadyToDeleted(2.0f))
+        Log::warn("LobbyPool", "News manager still running.");
+    Online::RequestManager::get()->stopNetworkThread();
+    if (!Online::RequestManager::get()->waitForReadyToDeleted(2.0f))
+        Log::warn("LobbyPool", "Request manager still running.");
+    Online::RequestManager::deallocate();
+    irr_driver->getImageDecoder()->stopThreads();
+    SFXManager::get()->stopThread();
+    SFXManager::get()->joinThread();
+    UserConfigParams::m_sfx   = false;
+    UserConfigParams::m_music = false;
+
+    // Otherwise buffered output would be written by each process
+    fflush(NULL);
+
+    double start_time = StkTime::getRealTime();
+    std::vector<pid_t> pids;
+    for (unsigned int i = 0; i < num_lobbies; i++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            m_lobby_id = i;
+            NetworkConfig::get()->setLobbyId(i);
+            // Make sure the lobbies don't all do the same
+            srand((unsigned int)time(0) ^ (unsigned int)getpid());
+            SFXManager::get()->startThread();
+            Online::RequestManager::get()->startNetworkThread();
+            Log::info("LobbyPool", "Lobby %d started (pid %d).", i, getpid());
+            return;
+        }
+        if (pid < 0)
+        {
+            Log::error("LobbyPool", "Could not start lobby %d, errno=%d.",
+                       i, errno);
+            break;
+        }
+        pids.push_back(pid);
+    }   // for i < num_lobbies
+
+    unsigned int num_failed = num_lobbies - (unsigned int)pids.size();
+    unsigned int num_running = (unsigned int)pids.size();
+    while (num_running > 0)
+    {
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        unsigned int id = 0;
+        while (id < pids.size() && pids[id] != pid) id++;
+        if (id == pids.size())
+            continue;
+        num_running--;
+        double t = StkTime::getRealTime() - start_time;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        {
+            Log::info("LobbyPool", "Lobby %d finished after %.1f seconds.",
+                      id, t);
+        }
+        else if (WIFSIGNALED(status))
+        {
+            Log::error("LobbyPool", "Lobby %d was killed by signal %d "
+                       "after %.1f seconds.", id, WTERMSIG(status), t);
+            num_failed++;
+        }
+        else
+        {
+            Log::error("LobbyPool", "Lobby %d exited with status %d after "
+                       "%.1f seconds.", id, WEXITSTATUS(status), t);
+            num_failed++;
+        }
+    }   // while num_running > 0
+
+    Log::info("LobbyPool", "%d of %d lobbies failed, total time %.1f "
+              "seconds.", num_failed, num_lobbies,
+              StkTime::getRealTime() - start_time);
+    // The race might be loaded, which is not cleaned up like a normal
+    // shutdown does
+    fflush(NULL);
+    _exit(num_failed == 0 ? 0 : 1);
+#endif
+}   // start
+
+// ----------------------------------------------------------------------------
+/** Starts the lobbies requested with startAfterLoading(), if any. This is
+ *  called once the race is loaded.
+ */
+void LobbyPool::startPending()
+{
+    if (m_num_pending == 0)
+        return;
+    unsigned int num_lobbies = m_num_pending;
+    m_num_pending = 0;
+    Log::info("LobbyPool", "Race loaded, starting %d lobbies.", num_lobbies);
+    start(num_lobbies);
+}   // startPending
+
+// ----------------------------------------------------------------------------
+/** Ends a lobby. A lobby does not do the normal shutdown of STK: it does
+ *  not have the threads of its parent process (which would be waited for),
+ *  and it must not save the user config, which is shared between all
+ *  lobbies.
+ *  \param status Exit status of this lobby.
+ */
+void LobbyPool::exitLobby(int status)
+{
+    Log::info("LobbyPool", "Lobby %d finished.", m_lobby_id);
+    fflush(NULL);
+#ifndef WIN32
+    _exit(status);
+#endif
+}   // exitLobby
+
+// ----------------------------------------------------------------------------
+/** Returns the server name to use for this lobby, which is the given name
+ *  followed by the number of the lobby (if this process is a lobby).
+ *  \param name Name of the server.
+ */
+std::string LobbyPool::getLobbyName(const std::string &name)
+{
+    if (!isLobby())
+        return name;
+    return name + " " + StringUtils::toString(m_lobby_id + 1);
+}   // getLobbyName
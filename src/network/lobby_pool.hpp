@@ -0,0 +1,83 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file lobby_pool.hpp
+ */
+
+#ifndef HEADER_LOBBY_POOL_HPP
+#define HEADER_LOBBY_POOL_HPP
+
+#include <string>
+
+/** \brief Starts several independent servers (or races) as processes
+ *  forked from one process.
+ *  STK keeps the state of a race (World, STKHost, race manager, ...) in
+ *  singletons, so each lobby runs in its own process. The processes are
+ *  forked after all tracks, karts and materials are loaded, so this data
+ *  is shared between all lobbies (the pages are only copied if a lobby
+ *  modifies them). For a single profile race the race itself is loaded
+ *  before forking (see startAfterLoading()), so the collision meshes and
+ *  drivelines of the track and the loaded karts are shared as well. A
+ *  server lobby only loads its track once a race is started, so it does
+ *  not share the track data. Each lobby uses its own ports (see
+ *  NetworkConfig::getServerPort()).
+ *  The process that starts the pool only waits for all lobbies to finish,
+ *  and reports how many of them failed. Combined with --no-graphics and
+ *  --profile-laps this is used as a soak test running many AI races at
+ *  the same time.
+ *  Only LAN servers are supported, and only without graphics: a GPU
+ *  driver can not be used in a forked process.
+ * \ingroup network
+ */
+class LobbyPool
+{
+private:
+    /** Index of this lobby, or -1 if this process is not a lobby. */
+    static int m_lobby_id;
+
+    /** Number of lobbies in the pool. */
+    static int m_num_lobbies;
+
+    /** Number of lobbies to start once the race is loaded, or 0. */
+    static unsigned int m_num_pending;
+
+public:
+    static void start(unsigned int num_lobbies);
+    static void startPending();
+    // ------------------------------------------------------------------------
+    /** Starts the lobbies only once startPending() is called, i.e. after
+     *  the race is loaded, so that all lobbies share the loaded race. */
+    static void startAfterLoading(unsigned int num_lobbies)
+    {
+        m_num_pending = num_lobbies;
+    }   // startAfterLoading
+    static void exitLobby(int status);
+    static std::string getLobbyName(const std::string &name);
+
+    // ------------------------------------------------------------------------
+    /** Returns true if this process is one of the lobbies of a pool. */
+    static bool isLobby() { return m_lobby_id >= 0; }
+    // ------------------------------------------------------------------------
+    /** Returns the index of this lobby, or -1 if this is not a lobby. */
+    static int getLobbyId() { return m_lobby_id; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of lobbies in the pool this lobby belongs to. */
+    static int getNumLobbies() { return m_num_lobbies; }
+};   // LobbyPool
+
+#endif
@@ -0,0 +1,98 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_buffer.hpp"
+
+#include "network/buffer_pool.hpp"
+
+#include "enet/enet.h"
+
+#include <algorithm>
+
+// ----------------------------------------------------------------------------
+/** Copy constructor, the copy always uses memory from the pool. */
+NetworkBuffer::NetworkBuffer(const NetworkBuffer &other)
+{
+    m_data     = NULL;
+    m_size     = 0;
+    m_capacity = 0;
+    m_packet   = NULL;
+    append(other.m_data, other.m_size);
+}   // NetworkBuffer(const NetworkBuffer&)
+
+// ----------------------------------------------------------------------------
+NetworkBuffer& NetworkBuffer::operator=(const NetworkBuffer &other)
+{
+    if (this == &other)
+        return *this;
+    m_size = 0;
+    if (m_packet)
+    {
+        // Don't write into a received packet which might be bigger
+        freeData();
+    }
+    append(other.m_data, other.m_size);
+    return *this;
+}   // operator=
+
+// ----------------------------------------------------------------------------
+/** Uses the data of a received packet as content of this buffer, without
+ *  copying it. The buffer takes over the packet and destroys it when it is
+ *  not needed anymore.
+ *  \param packet The received packet.
+ */
+void NetworkBuffer::wrap(ENetPacket *packet)
+{
+    freeData();
+    m_packet   = packet;
+    m_data     = packet->data;
+    m_size     = (unsigned int)packet->dataLength;
+    m_capacity = m_size;
+}   // wrap
+
+// ----------------------------------------------------------------------------
+/** Moves the content into a bigger buffer from the pool.
+ *  \param min_capacity Number of bytes that must fit into the new buffer.
+ */
+void NetworkBuffer::grow(unsigned int min_capacity)
+{
+    unsigned int capacity = std::max(min_capacity,
+                                     std::max(2 * m_capacity, 16u));
+    uint8_t *data = (uint8_t*)BufferPool::allocate(capacity);
+    if (m_size > 0)
+        memcpy(data, m_data, m_size);
+    unsigned int size = m_size;
+    freeData();
+    m_data     = data;
+    m_size     = size;
+    m_capacity = (unsigned int)BufferPool::getCapacity(data);
+}   // grow
+
+// ----------------------------------------------------------------------------
+/** Frees the memory or the wrapped packet and empties the buffer. */
+void NetworkBuffer::freeData()
+{
+    if (m_packet)
+        enet_packet_destroy(m_packet);
+    else
+        BufferPool::release(m_data);
+    m_data     = NULL;
+    m_size     = 0;
+    m_capacity = 0;
+    m_packet   = NULL;
+}   // freeData
@@ -0,0 +1,127 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file network_buffer.hpp
+ */
+
+#ifndef HEADER_NETWORK_BUFFER_HPP
+#define HEADER_NETWORK_BUFFER_HPP
+
+#include "utils/types.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+typedef struct _ENetPacket ENetPacket;
+
+/** \brief The byte buffer of a network string.
+ *  It offers the subset of std::vector used by BareNetworkString, but its
+ *  memory comes from the BufferPool, and it can use the data of a received
+ *  ENet packet directly (see wrap()) instead of copying it. The packet is
+ *  then owned by the buffer and destroyed with it. Writing to a wrapped
+ *  packet is done in place, only growing it copies the data into a buffer
+ *  from the pool.
+ * \ingroup network
+ */
+class NetworkBuffer
+{
+private:
+    /** The content, either from the pool or the data of m_packet. */
+    uint8_t     *m_data;
+
+    /** Number of bytes used. */
+    unsigned int m_size;
+
+    /** Number of bytes available in m_data. */
+    unsigned int m_capacity;
+
+    /** The packet whose data is used, or NULL. */
+    ENetPacket  *m_packet;
+
+    void grow(unsigned int min_capacity);
+    void freeData();
+
+public:
+    NetworkBuffer()
+    {
+        m_data     = NULL;
+        m_size     = 0;
+        m_capacity = 0;
+        m_packet   = NULL;
+    }   // NetworkBuffer
+    // ------------------------------------------------------------------------
+    NetworkBuffer(const NetworkBuffer &other);
+    NetworkBuffer& operator=(const NetworkBuffer &other);
+    ~NetworkBuffer() { freeData(); }
+    void wrap(ENetPacket *packet);
+    // ------------------------------------------------------------------------
+    /** Makes sure that n bytes can be stored without allocating memory. */
+    void reserve(unsigned int n)
+    {
+        if (n > m_capacity)
+            grow(n);
+    }   // reserve
+    // ------------------------------------------------------------------------
+    /** Changes the size, new bytes are set to 0. */
+    void resize(unsigned int n)
+    {
+        reserve(n);
+        if (n > m_size)
+            memset(m_data + m_size, 0, n - m_size);
+        m_size = n;
+    }   // resize
+    // ------------------------------------------------------------------------
+    /** Appends a single byte. */
+    void push_back(uint8_t value)
+    {
+        if (m_size == m_capacity)
+            grow(m_size + 1);
+        m_data[m_size++] = value;
+    }   // push_back
+    // ------------------------------------------------------------------------
+    /** Appends len bytes. */
+    void append(const uint8_t *data, unsigned int len)
+    {
+        reserve(m_size + len);
+        if (len > 0)
+            memcpy(m_data + m_size, data, len);
+        m_size += len;
+    }   // append
+    // ------------------------------------------------------------------------
+    unsigned int size() const { return m_size; }
+    // ------------------------------------------------------------------------
+    bool empty() const { return m_size == 0; }
+    // ------------------------------------------------------------------------
+    uint8_t* data() { return m_data; }
+    // ------------------------------------------------------------------------
+    const uint8_t* data() const { return m_data; }
+    // ------------------------------------------------------------------------
+    uint8_t& operator[](unsigned int i)
+    {
+        assert(i < m_size);
+        return m_data[i];
+    }   // operator[]
+    // ------------------------------------------------------------------------
+    const uint8_t& operator[](unsigned int i) const
+    {
+        assert(i < m_size);
+        return m_data[i];
+    }   // operator[]
+};   // NetworkBuffer
+
+#endif
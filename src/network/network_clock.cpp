@@ -0,0 +1,210 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_clock.hpp"
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+// ----------------------------------------------------------------------------
+NetworkClock::NetworkClock()
+{
+    reset();
+}   // NetworkClock
+
+// ----------------------------------------------------------------------------
+/** Removes all samples and pending pings. */
+void NetworkClock::reset()
+{
+    m_num_samples = 0;
+    m_next_sample = 0;
+    m_offset      = 0;
+    m_rtt         = 0;
+    m_jitter      = 0;
+    for (unsigned int i = 0; i < WINDOW_SIZE; i++)
+    {
+        m_ping_sequence[i] = 0;
+        m_ping_time[i]     = -1;
+    }
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Stores the time at which a ping was sent.
+ *  \param sequence Sequence number of the ping.
+ *  \param local_time Local time when the ping is sent.
+ */
+void NetworkClock::addPing(uint32_t sequence, double local_time)
+{
+    m_ping_sequence[sequence % WINDOW_SIZE] = sequence;
+    m_ping_time[sequence % WINDOW_SIZE]     = local_time;
+}   // addPing
+
+// ----------------------------------------------------------------------------
+/** Adds a sample for the response to a ping sent with addPing. The remote
+ *  host answers immediately, so its receive and send times are the same.
+ *  \param sequence Sequence number of the ping.
+ *  \param remote_time Remote time when the ping was answered.
+ *  \param local_time Local time when the response is received.
+ *  \return False if the ping is not known (or too old).
+ */
+bool NetworkClock::addResponse(uint32_t sequence, double remote_time,
+                               double local_time)
+{
+    unsigned int index = sequence % WINDOW_SIZE;
+    if (m_ping_sequence[index] != sequence || m_ping_time[index] < 0)
+        return false;
+    addSample(m_ping_time[index], remote_time, remote_time, local_time);
+    // Each response is only used once
+    m_ping_time[index] = -1;
+    return true;
+}   // addResponse
+
+// ----------------------------------------------------------------------------
+/** Adds one sample to the window and updates the estimation.
+ *  \param t0 Local time when the ping is sent.
+ *  \param t1 Remote time when the ping is received.
+ *  \param t2 Remote time when the response is sent.
+ *  \param t3 Local time when the response is received.
+ */
+void NetworkClock::addSample(double t0, double t1, double t2, double t3)
+{
+    m_sample_offset[m_next_sample] = 0.5*((t1 - t0) + (t2 - t3));
+    m_sample_rtt[m_next_sample]    = (t3 - t0) - (t2 - t1);
+    m_next_sample = (m_next_sample + 1) % WINDOW_SIZE;
+    if (m_num_samples < WINDOW_SIZE)
+        m_num_samples++;
+    update();
+}   // addSample
+
+// ----------------------------------------------------------------------------
+/** Computes offset, round trip time and jitter from the samples in the
+ *  window.
+ */
+void NetworkClock::update()
+{
+    unsigned int best = 0;
+    double total_rtt = 0;
+    for (unsigned int i = 0; i < m_num_samples; i++)
+    {
+        total_rtt += m_sample_rtt[i];
+        if (m_sample_rtt[i] < m_sample_rtt[best])
+            best = i;
+    }
+    m_offset = m_sample_offset[best];
+    m_rtt    = total_rtt / m_num_samples;
+
+    double sum = 0;
+    for (unsigned int i = 0; i < m_num_samples; i++)
+    {
+        double d = m_sample_offset[i] - m_offset;
+        sum += d*d;
+    }
+    m_jitter = m_num_samples > 1 ? sqrt(sum / (m_num_samples - 1)) : 0;
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Sets the estimation directly, e.g. on a client which receives the
+ *  estimation computed by the server.
+ *  \param offset Remote time minus local time.
+ *  \param rtt Round trip time.
+ *  \param jitter Jitter of the offset.
+ */
+void NetworkClock::setEstimate(double offset, double rtt, double jitter)
+{
+    // Store it as the only sample, so that hasEstimate() returns true
+    m_sample_offset[0] = offset;
+    m_sample_rtt[0]    = rtt;
+    m_num_samples      = 1;
+    m_next_sample      = 1;
+    m_offset           = offset;
+    m_rtt              = rtt;
+    m_jitter           = jitter;
+}   // setEstimate
+
+// ----------------------------------------------------------------------------
+/** Simulates a connection with delay, jitter and packet loss to a host
+ *  whose clock has an offset and drifts, and checks that the offset is
+ *  estimated much more precisely than with the last sample only.
+ */
+void NetworkClock::unitTesting()
+{
+    const double OFFSET    = 123.456;
+    const double DRIFT     = 50.0e-6;   // 50 ppm
+    const double MIN_DELAY = 0.02;
+    const double JITTER    = 0.03;
+    const double INTERVAL  = 0.5;
+    const unsigned int NUM_PINGS = 400;
+
+    srand(42);
+    NetworkClock clock;
+    double error = 0, last_sample_error = 0, max_error = 0;
+    bool known = false;
+    unsigned int num_errors = 0;
+    for (unsigned int i = 0; i < NUM_PINGS; i++)
+    {
+        double t0 = i*INTERVAL;
+        clock.addPing(i, t0);
+        // 10% of the pings or responses are lost
+        if (rand() % 10 == 0)
+            continue;
+        double up   = MIN_DELAY + JITTER * rand() / RAND_MAX;
+        double down = MIN_DELAY + JITTER * rand() / RAND_MAX;
+        double remote = t0 + up + OFFSET + (t0 + up)*DRIFT;
+        known = clock.addResponse(i, remote, t0 + up + down);
+        assert(known);
+        // A duplicated response is ignored
+        known = clock.addResponse(i, remote, t0 + up + down);
+        assert(!known);
+
+        if (i < NetworkClock::WINDOW_SIZE)
+            continue;
+        double real_offset = OFFSET + (t0 + up + down)*DRIFT;
+        double e = fabs(clock.getOffset() - real_offset);
+        error += e;
+        max_error = std::max(max_error, e);
+        last_sample_error += fabs(0.5*(up - down));
+        num_errors++;
+        assert(fabs(clock.toLocalTime(clock.toRemoteTime(t0)) - t0) < 1e-9);
+    }   // for i < NUM_PINGS
+    error             /= num_errors;
+    last_sample_error /= num_errors;
+
+    // Responses to pings that are too old are ignored
+    clock.addPing(NUM_PINGS, NUM_PINGS*INTERVAL);
+    known = clock.addResponse(NUM_PINGS - WINDOW_SIZE, 0, 0);
+    assert(!known);
+
+    Log::info("NetworkClock", "Average offset error %.2f ms (last sample "
+              "%.2f ms), max %.2f ms, rtt %.1f ms, jitter %.2f ms.",
+              error*1000, last_sample_error*1000, max_error*1000,
+              clock.getRTT()*1000, clock.getJitter()*1000);
+    assert(error < 0.5 * last_sample_error);
+    assert(max_error < 0.5 * JITTER);
+    assert(fabs(clock.getRTT() - 2*MIN_DELAY - JITTER) < 0.3*JITTER);
+    assert(clock.getJitter() > 0.001 && clock.getJitter() < JITTER);
+
+    NetworkClock client;
+    assert(!client.hasEstimate());
+    client.setEstimate(-clock.getOffset(), clock.getRTT(), clock.getJitter());
+    assert(client.hasEstimate());
+    assert(client.getOffset() == -clock.getOffset());
+}   // unitTesting
@@ -0,0 +1,111 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file network_clock.hpp
+ */
+
+#ifndef HEADER_NETWORK_CLOCK_HPP
+#define HEADER_NETWORK_CLOCK_HPP
+
+#include "utils/types.hpp"
+
+/** \brief Estimates the offset between the local clock and the clock of a
+ *  remote host, the round trip time and the jitter, similar to NTP.
+ *  Each ping and its response give four times: the local time t0 when the
+ *  ping is sent, the remote times t1 and t2 when it is received and
+ *  answered, and the local time t3 when the response is received. The
+ *  offset of one sample is ((t1-t0) + (t2-t3))/2, which is exact if the
+ *  delays in both directions are the same. The error of a sample is at most
+ *  half of its round trip time, so the offset of the sample with the
+ *  smallest round trip time in a sliding window of the last samples is
+ *  used (the clock filter of NTP). The jitter is the RMS difference of the
+ *  offsets of all samples in the window to this offset.
+ *  All memory is allocated in the object, so the estimation can keep
+ *  running for a whole session.
+ * \ingroup network
+ */
+class NetworkClock
+{
+public:
+    /** Number of samples used for the estimation. */
+    static const unsigned int WINDOW_SIZE = 16;
+
+private:
+    /** The offset and round trip time of each sample in the window. */
+    double       m_sample_offset[WINDOW_SIZE];
+    double       m_sample_rtt[WINDOW_SIZE];
+
+    /** Number of valid samples in the window. */
+    unsigned int m_num_samples;
+
+    /** Index at which the next sample is stored. */
+    unsigned int m_next_sample;
+
+    /** Sequence numbers and send times of the last pings. Only the last
+     *  WINDOW_SIZE pings can be answered, older responses are ignored. */
+    uint32_t     m_ping_sequence[WINDOW_SIZE];
+    double       m_ping_time[WINDOW_SIZE];
+
+    /** Estimated remote time minus local time. */
+    double       m_offset;
+
+    /** Average round trip time of the samples in the window. */
+    double       m_rtt;
+
+    /** Estimated jitter of the offset. */
+    double       m_jitter;
+
+    void         update();
+
+public:
+                 NetworkClock();
+    void         reset();
+    void         addPing(uint32_t sequence, double local_time);
+    bool         addResponse(uint32_t sequence, double remote_time,
+                             double local_time);
+    void         addSample(double t0, double t1, double t2, double t3);
+    void         setEstimate(double offset, double rtt, double jitter);
+    static void  unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Returns true once at least one sample was received. */
+    bool   hasEstimate() const { return m_num_samples > 0; }
+    // ------------------------------------------------------------------------
+    /** Returns the estimated remote time minus the local time. */
+    double getOffset() const { return m_offset; }
+    // ------------------------------------------------------------------------
+    /** Returns the average round trip time in seconds. */
+    double getRTT() const { return m_rtt; }
+    // ------------------------------------------------------------------------
+    /** Returns the jitter of the offset in seconds. */
+    double getJitter() const { return m_jitter; }
+    // ------------------------------------------------------------------------
+    /** Converts a local time to the time of the remote clock. */
+    double toRemoteTime(double local_time) const
+    {
+        return local_time + m_offset;
+    }   // toRemoteTime
+    // ------------------------------------------------------------------------
+    /** Converts a time of the remote clock to local time. */
+    double toLocalTime(double remote_time) const
+    {
+        return remote_time - m_offset;
+    }   // toLocalTime
+};   // NetworkClock
+
+#endif
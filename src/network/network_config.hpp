@@ -65,9 +65,24 @@ private:
     /** If this is a server, the server name. */
     irr::core::stringw m_server_name;
 
+    /** Index of this server if several servers are started by one process
+     *  (see LobbyPool), 0 otherwise. */
+    unsigned int m_lobby_id;
+
     NetworkConfig();
 
 public:
+    /** Port a LAN server listens on for discovery requests. Each lobby
+     *  started by a LobbyPool uses the next odd port number. */
+    static const uint16_t SERVER_DISCOVERY_PORT = 2757;
+
+    /** Port a server accepts connections on. Each lobby started by a
+     *  LobbyPool uses the next even port number. */
+    static const uint16_t SERVER_PORT = 2758;
+
+    /** Maximum number of lobbies a client looks for in the LAN. */
+    static const unsigned int MAX_LOBBIES = 32;
+
     /** Singleton get, which creates this object if necessary. */
     static NetworkConfig *get()
     {
@@ -118,6 +133,22 @@ public:
     /** Returns the maximum number of players for this server. */
     int getMaxPlayers() const { return m_max_players; }
     // --------------------------------------------------------------------
+    /** Sets the index of this server if several servers are run by one
+     *  process. */
+    void setLobbyId(unsigned int id) { m_lobby_id = id; }
+    // --------------------------------------------------------------------
+    /** Returns the index of this server (0 if only one server is run). */
+    unsigned int getLobbyId() const { return m_lobby_id; }
+    // --------------------------------------------------------------------
+    /** Returns the port this server accepts connections on. */
+    uint16_t getServerPort() const { return SERVER_PORT + 2*m_lobby_id; }
+    // --------------------------------------------------------------------
+    /** Returns the port this LAN server answers discovery requests on. */
+    uint16_t getServerDiscoveryPort() const
+    {
+        return SERVER_DISCOVERY_PORT + 2*m_lobby_id;
+    }   // getServerDiscoveryPort
+    // --------------------------------------------------------------------
     /** Sets if this instance is a server or client. */
     void setIsServer(bool b) { m_is_server = b; }
     // --------------------------------------------------------------------
@@ -21,6 +21,7 @@
 #include "main_loop.hpp"
 #include "network/network_config.hpp"
 #include "network/network_player_profile.hpp"
+#include "network/network_stats.hpp"
 #include "network/protocol_manager.hpp"
 #include "network/stk_host.hpp"
 #include "network/protocols/client_lobby_room_protocol.hpp"
@@ -71,6 +72,10 @@ void* NetworkConsole::mainLoop(void* data)
         {
             stop = true;
         }
+        else if (str == "stats")
+        {
+            NetworkStats::get()->log(STKHost::get()->getPeers());
+        }
         else if (str == "kickall" && NetworkConfig::get()->isServer())
         {
             me->kickAllPlayers();
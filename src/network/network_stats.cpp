@@ -0,0 +1,224 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/network_stats.hpp"
+
+#include "network/stk_peer.hpp"
+#include "network/transport_address.hpp"
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <assert.h>
+#include <math.h>
+#include <sstream>
+#include <stdio.h>
+
+NetworkStats *NetworkStats::m_network_stats = NULL;
+const float   NetworkStats::WRITE_INTERVAL  = 1.0f;
+
+// ----------------------------------------------------------------------------
+/** Adds one duration.
+ *  \param seconds The duration in seconds.
+ */
+void NetworkStats::Timing::add(double seconds)
+{
+    uint32_t us = seconds > 0 ? uint32_t(seconds * 1.0e6) : 0;
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total_us.fetch_add(us, std::memory_order_relaxed);
+    uint32_t old_max = m_max_us.load(std::memory_order_relaxed);
+    while (us > old_max &&
+           !m_max_us.compare_exchange_weak(old_max, us,
+                                           std::memory_order_relaxed))
+    {
+    }
+}   // Timing::add
+
+// ----------------------------------------------------------------------------
+NetworkStats::NetworkStats()
+{
+    m_start_time      = StkTime::getRealTime();
+    m_last_write_time = m_start_time;
+}   // NetworkStats
+
+// ----------------------------------------------------------------------------
+/** Returns the name used for a protocol type in the stats. */
+const char* NetworkStats::getProtocolName(unsigned int type)
+{
+    switch (type)
+    {
+    case PROTOCOL_CONNECTION:        return "connection";
+    case PROTOCOL_LOBBY_ROOM:        return "lobby_room";
+    case PROTOCOL_START_GAME:        return "start_game";
+    case PROTOCOL_SYNCHRONIZATION:   return "synchronization";
+    case PROTOCOL_KART_UPDATE:       return "kart_update";
+    case PROTOCOL_GAME_EVENTS:       return "game_events";
+    case PROTOCOL_CONTROLLER_EVENTS: return "controller_events";
+    default:                         return "none";
+    }
+}   // getProtocolName
+
+// ----------------------------------------------------------------------------
+/** Returns all counters as a JSON object.
+ *  \param peers The peers of this host.
+ */
+std::string NetworkStats::toJSON(const std::vector<STKPeer*> &peers) const
+{
+    std::ostringstream s;
+    s << "{\n  \"time\": " << StkTime::getRealTime() - m_start_time
+      << ",\n  \"peers\": [";
+    for (unsigned int i = 0; i < peers.size(); i++)
+    {
+        const Peer &p = peers[i]->getStats();
+        TransportAddress address(peers[i]->getAddress(),
+                                 peers[i]->getPort());
+        s << (i > 0 ? "," : "") << "\n    { \"host_id\": "
+          << peers[i]->getHostId()
+          << ", \"address\": \"" << address.toString() << "\""
+          << ", \"packets_in\": "  << p.m_in.getPackets()
+          << ", \"bytes_in\": "    << p.m_in.getBytes()
+          << ", \"packets_out\": " << p.m_out.getPackets()
+          << ", \"bytes_out\": "   << p.m_out.getBytes()
+          << ", \"resends\": "     << p.m_resends.load()
+          << ", \"queue_depth\": " << p.m_queue_depth.load()
+          << ", \"rtt_ms\": "      << p.m_rtt.load() << " }";
+    }
+    s << "\n  ],\n  \"protocols\": [";
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        const Timing &latency = m_dispatch_latency[i];
+        s << (i > 0 ? "," : "") << "\n    { \"type\": \""
+          << getProtocolName(i) << "\""
+          << ", \"packets_in\": "  << m_protocol_in[i].getPackets()
+          << ", \"bytes_in\": "    << m_protocol_in[i].getBytes()
+          << ", \"packets_out\": " << m_protocol_out[i].getPackets()
+          << ", \"bytes_out\": "   << m_protocol_out[i].getBytes()
+          << ", \"dispatched\": "  << latency.getCount()
+          << ", \"dispatch_average_ms\": " << latency.getAverage()*1000.0
+          << ", \"dispatch_max_ms\": "     << latency.getMax()*1000.0
+          << " }";
+    }
+    s << "\n  ],\n  \"kart_update_age\": { \"count\": "
+      << m_kart_update_age.getCount()
+      << ", \"average_ms\": " << m_kart_update_age.getAverage()*1000.0
+      << ", \"max_ms\": "     << m_kart_update_age.getMax()*1000.0
+      << " }\n}\n";
+    return s.str();
+}   // toJSON
+
+// ----------------------------------------------------------------------------
+/** Prints the counters, used by the network console.
+ *  \param peers The peers of this host.
+ */
+void NetworkStats::log(const std::vector<STKPeer*> &peers) const
+{
+    for (unsigned int i = 0; i < peers.size(); i++)
+    {
+        const Peer &p = peers[i]->getStats();
+        TransportAddress address(peers[i]->getAddress(),
+                                 peers[i]->getPort());
+        Log::info("NetworkStats", "Peer %d %s: in %d packets %lu bytes, "
+                  "out %d packets %lu bytes, %d resends, %d queued, rtt %d ms.",
+                  peers[i]->getHostId(), address.toString().c_str(),
+                  p.m_in.getPackets(), (unsigned long)p.m_in.getBytes(),
+                  p.m_out.getPackets(), (unsigned long)p.m_out.getBytes(),
+                  p.m_resends.load(), p.m_queue_depth.load(),
+                  p.m_rtt.load());
+    }
+    for (unsigned int i = 0; i < NUM_PROTOCOL_TYPES; i++)
+    {
+        if (m_protocol_in[i].getPackets() == 0 &&
+            m_protocol_out[i].getPackets() == 0)
+            continue;
+        const Timing &latency = m_dispatch_latency[i];
+        Log::info("NetworkStats", "Protocol %s: in %d packets %lu bytes, "
+                  "out %d packets %lu bytes, dispatch %.2f ms (max %.2f ms).",
+                  getProtocolName(i), m_protocol_in[i].getPackets(),
+                  (unsigned long)m_protocol_in[i].getBytes(),
+                  m_protocol_out[i].getPackets(),
+                  (unsigned long)m_protocol_out[i].getBytes(),
+                  latency.getAverage()*1000.0, latency.getMax()*1000.0);
+    }
+    Log::info("NetworkStats", "Kart updates: %d applied, age %.2f ms "
+              "(max %.2f ms).", m_kart_update_age.getCount(),
+              m_kart_update_age.getAverage()*1000.0,
+              m_kart_update_age.getMax()*1000.0);
+}   // log
+
+// ----------------------------------------------------------------------------
+/** Called regularly by the STKHost thread, writes the stats file every
+ *  WRITE_INTERVAL seconds if a file name is set. The file is written under
+ *  a temporary name and then renamed, so a reader never sees a partially
+ *  written file.
+ *  \param peers The peers of this host.
+ */
+void NetworkStats::update(const std::vector<STKPeer*> &peers)
+{
+    if (m_file_name.empty())
+        return;
+    double now = StkTime::getRealTime();
+    if (now < m_last_write_time + WRITE_INTERVAL)
+        return;
+    m_last_write_time = now;
+
+    std::string tmp_name = m_file_name + ".tmp";
+    FILE *file = fopen(tmp_name.c_str(), "w");
+    if (!file)
+    {
+        Log::warn("NetworkStats", "Can't open '%s', stats are not written.",
+                  tmp_name.c_str());
+        m_file_name = "";
+        return;
+    }
+    std::string json = toJSON(peers);
+    fwrite(json.c_str(), 1, json.size(), file);
+    fclose(file);
+    remove(m_file_name.c_str());
+    rename(tmp_name.c_str(), m_file_name.c_str());
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Tests the counters and the JSON output.
+ */
+void NetworkStats::unitTesting()
+{
+    NetworkStats *stats = new NetworkStats();
+    stats->addReceived(PROTOCOL_KART_UPDATE, 100);
+    stats->addReceived(ProtocolType(PROTOCOL_KART_UPDATE |
+                                    PROTOCOL_SYNCHRONOUS), 50);
+    stats->addSent(PROTOCOL_SILENT, 10);
+    assert(stats->getReceived(PROTOCOL_KART_UPDATE).getPackets() == 2);
+    assert(stats->getReceived(PROTOCOL_KART_UPDATE).getBytes() == 150);
+    assert(stats->getSent(PROTOCOL_NONE).getBytes() == 10);
+
+    stats->addDispatchLatency(PROTOCOL_LOBBY_ROOM, 0.002);
+    stats->addDispatchLatency(PROTOCOL_LOBBY_ROOM, 0.004);
+    stats->addDispatchLatency(PROTOCOL_LOBBY_ROOM, -1.0);
+    const Timing &latency = stats->getDispatchLatency(PROTOCOL_LOBBY_ROOM);
+    assert(latency.getCount() == 3);
+    assert(fabs(latency.getAverage() - 0.002) < 1.0e-6);
+    assert(fabs(latency.getMax() - 0.004) < 1.0e-6);
+
+    std::vector<STKPeer*> peers;
+    std::string json = stats->toJSON(peers);
+    assert(json.find("\"peers\": [\n  ]") != std::string::npos);
+    assert(json.find("{ \"type\": \"kart_update\", \"packets_in\": 2, "
+                     "\"bytes_in\": 150,") != std::string::npos);
+    assert(json.find("\"kart_update_age\": { \"count\": 0,")
+           != std::string::npos);
+    delete stats;
+}   // unitTesting
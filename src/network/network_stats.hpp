@@ -0,0 +1,224 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file network_stats.hpp
+ */
+
+#ifndef HEADER_NETWORK_STATS_HPP
+#define HEADER_NETWORK_STATS_HPP
+
+#include "network/protocol.hpp"
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class STKPeer;
+
+/** \brief Counters about the network traffic and its timing.
+ *  The counters are atomic, so that they can be updated by the STKHost
+ *  thread and the protocols without locking, and be read at any time by
+ *  the network console or to write the stats file. Each STKPeer has its
+ *  own Peer counters, the counters for each protocol type and the timings
+ *  are kept in the singleton.
+ * \ingroup network
+ */
+class NetworkStats : public NoCopy
+{
+public:
+    /** Number of packets and bytes sent or received. */
+    class Traffic
+    {
+    private:
+        std::atomic<uint32_t> m_packets;
+        std::atomic<uint64_t> m_bytes;
+    public:
+        Traffic() : m_packets(0), m_bytes(0) {}
+        // --------------------------------------------------------------------
+        /** Counts one packet of the given size. */
+        void add(unsigned int bytes)
+        {
+            m_packets.fetch_add(1, std::memory_order_relaxed);
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }   // add
+        // --------------------------------------------------------------------
+        uint32_t getPackets() const { return m_packets.load(); }
+        // --------------------------------------------------------------------
+        uint64_t getBytes() const { return m_bytes.load(); }
+    };   // Traffic
+
+    // ------------------------------------------------------------------------
+    /** Number, average and maximum of a duration. */
+    class Timing
+    {
+    private:
+        std::atomic<uint32_t> m_count;
+        /** Sum of all durations in microseconds. */
+        std::atomic<uint64_t> m_total_us;
+        std::atomic<uint32_t> m_max_us;
+    public:
+        Timing() : m_count(0), m_total_us(0), m_max_us(0) {}
+        void add(double seconds);
+        // --------------------------------------------------------------------
+        uint32_t getCount() const { return m_count.load(); }
+        // --------------------------------------------------------------------
+        /** Returns the average duration in seconds. */
+        double getAverage() const
+        {
+            uint32_t n = m_count.load();
+            return n > 0 ? m_total_us.load() * 1.0e-6 / n : 0.0;
+        }   // getAverage
+        // --------------------------------------------------------------------
+        /** Returns the longest duration in seconds. */
+        double getMax() const { return m_max_us.load() * 1.0e-6; }
+    };   // Timing
+
+    // ------------------------------------------------------------------------
+    /** The counters of one peer. The ENet values are sampled by the STKHost
+     *  thread, see STKPeer::updateStats(). */
+    class Peer
+    {
+    public:
+        Traffic m_in, m_out;
+        /** Number of reliable packets that had to be sent again. */
+        std::atomic<uint32_t> m_resends;
+        /** Number of packets waiting to be sent or acknowledged. */
+        std::atomic<uint32_t> m_queue_depth;
+        /** Round trip time reported by ENet in ms. */
+        std::atomic<uint32_t> m_rtt;
+        /** Value of the (periodically reset) ENet lost packets counter at
+         *  the last sample. Only used by the STKHost thread. */
+        uint32_t m_last_packets_lost;
+
+        Peer() : m_resends(0), m_queue_depth(0), m_rtt(0),
+                 m_last_packets_lost(0) {}
+    };   // Peer
+
+private:
+    /** The singleton instance. */
+    static NetworkStats *m_network_stats;
+
+    /** Protocol types are used as index, anything else is counted as
+     *  PROTOCOL_NONE. */
+    enum { NUM_PROTOCOL_TYPES = PROTOCOL_CONTROLLER_EVENTS + 1 };
+
+    Traffic m_protocol_in [NUM_PROTOCOL_TYPES];
+    Traffic m_protocol_out[NUM_PROTOCOL_TYPES];
+
+    /** Time from receiving a message to handing it to its protocol. */
+    Timing m_dispatch_latency[NUM_PROTOCOL_TYPES];
+
+    /** Time from sending a kart update on the server to applying it to a
+     *  kart on the client. */
+    Timing m_kart_update_age;
+
+    /** Time the stats were created. */
+    double m_start_time;
+
+    /** If not empty, the stats are written to this file periodically. */
+    std::string m_file_name;
+
+    /** Time the stats file was written last. */
+    double m_last_write_time;
+
+    NetworkStats();
+    // ------------------------------------------------------------------------
+    static unsigned int getIndex(ProtocolType type)
+    {
+        unsigned int i = type & ~PROTOCOL_SYNCHRONOUS;
+        return i < NUM_PROTOCOL_TYPES ? i : PROTOCOL_NONE;
+    }   // getIndex
+
+public:
+    /** Interval in seconds in which the stats file is written. */
+    static const float WRITE_INTERVAL;
+
+    /** Singleton get, which creates this object if necessary. */
+    static NetworkStats *get()
+    {
+        if (!m_network_stats)
+            m_network_stats = new NetworkStats();
+        return m_network_stats;
+    }   // get
+    // ------------------------------------------------------------------------
+    static void destroy()
+    {
+        delete m_network_stats;   // It's ok to delete NULL
+        m_network_stats = NULL;
+    }   // destroy
+
+    // ------------------------------------------------------------------------
+    static const char* getProtocolName(unsigned int type);
+    std::string toJSON(const std::vector<STKPeer*> &peers) const;
+    void log(const std::vector<STKPeer*> &peers) const;
+    void update(const std::vector<STKPeer*> &peers);
+    static void unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Counts a received message. */
+    void addReceived(ProtocolType type, unsigned int bytes)
+    {
+        m_protocol_in[getIndex(type)].add(bytes);
+    }   // addReceived
+    // ------------------------------------------------------------------------
+    /** Counts a sent message. */
+    void addSent(ProtocolType type, unsigned int bytes)
+    {
+        m_protocol_out[getIndex(type)].add(bytes);
+    }   // addSent
+    // ------------------------------------------------------------------------
+    /** Adds the time a message waited before it was handed to a protocol. */
+    void addDispatchLatency(ProtocolType type, double seconds)
+    {
+        m_dispatch_latency[getIndex(type)].add(seconds);
+    }   // addDispatchLatency
+    // ------------------------------------------------------------------------
+    /** Adds the age of a kart update when it was applied to a kart. */
+    void addKartUpdateAge(double seconds)
+    {
+        m_kart_update_age.add(seconds);
+    }   // addKartUpdateAge
+    // ------------------------------------------------------------------------
+    /** Sets the file the stats are written to every WRITE_INTERVAL
+     *  seconds. */
+    void setFileName(const std::string &name) { m_file_name = name; }
+    // ------------------------------------------------------------------------
+    /** Returns the name of the stats file, empty if none is written. */
+    const std::string& getFileName() const { return m_file_name; }
+    // ------------------------------------------------------------------------
+    const Traffic& getReceived(ProtocolType type) const
+    {
+        return m_protocol_in[getIndex(type)];
+    }   // getReceived
+    // ------------------------------------------------------------------------
+    const Traffic& getSent(ProtocolType type) const
+    {
+        return m_protocol_out[getIndex(type)];
+    }   // getSent
+    // ------------------------------------------------------------------------
+    const Timing& getDispatchLatency(ProtocolType type) const
+    {
+        return m_dispatch_latency[getIndex(type)];
+    }   // getDispatchLatency
+    // ------------------------------------------------------------------------
+    const Timing& getKartUpdateAge() const { return m_kart_update_age; }
+};   // NetworkStats
+
+#endif
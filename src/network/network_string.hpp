@@ -23,6 +23,8 @@
 #ifndef NETWORK_STRING_HPP
 #define NETWORK_STRING_HPP
 
+#include "network/buffer_pool.hpp"
+#include "network/network_buffer.hpp"
 #include "network/protocol.hpp"
 #include "utils/leak_check.hpp"
 #include "utils/types.hpp"
@@ -36,7 +38,6 @@
 #include <stdarg.h>
 #include <string>
 #include <string.h>
-#include <vector>
 
 typedef unsigned char uchar;
 
@@ -56,7 +57,7 @@ private:
 
 protected:
     /** The actual buffer. */
-    std::vector<uint8_t> m_buffer;
+    NetworkBuffer m_buffer;
 
     /** To avoid copying the buffer when bytes are deleted (which only
     *  happens at the front), use an offset index. All positions given
@@ -74,8 +75,7 @@ protected:
     */
     std::string getString(int len) const
     {
-        std::string a(m_buffer.begin() + (m_current_offset      ),
-                      m_buffer.begin() + (m_current_offset + len));
+        std::string a((const char*)m_buffer.data() + m_current_offset, len);
         m_current_offset += len;
         return a;
     }   // getString
@@ -137,6 +137,16 @@ public:
         memcpy(m_buffer.data(), data, len);
     }   // BareNetworkString
 
+    // ------------------------------------------------------------------------
+    /** Network strings are created and deleted for each message, so they
+     *  are allocated from the pool. */
+    static void* operator new(size_t size)
+    {
+        return BufferPool::allocate(size);
+    }   // operator new
+    // ------------------------------------------------------------------------
+    static void operator delete(void *p) { BufferPool::release(p); }
+
     // ------------------------------------------------------------------------
     BareNetworkString& encodeString(const std::string &value);
     BareNetworkString& encodeString(const irr::core::stringw &value);
@@ -151,6 +161,14 @@ public:
     /** Returns a byte pointer to the content of the network string. */
     const char* getData() const { return (char*)(m_buffer.data()); };
 
+    // ------------------------------------------------------------------------
+    /** Returns a pointer to the data which was not read yet, e.g. to read
+     *  it with a BitReader. */
+    const uint8_t* getCurrentData() const
+    {
+        return m_buffer.data() + m_current_offset;
+    }   // getCurrentData
+
     // ------------------------------------------------------------------------
     /** Returns the remaining length of the network string. */
     unsigned int size() const { return (int)m_buffer.size()-m_current_offset; }
@@ -161,7 +179,7 @@ public:
     {
         m_current_offset += n;
         assert(m_current_offset >=0 &&
-               m_current_offset < (int)m_buffer.size());
+               m_current_offset <= (int)m_buffer.size());
     }   // skip
     // ------------------------------------------------------------------------
     /** Returns the send size, which is the full length of the buffer. A 
@@ -213,14 +231,31 @@ public:
         return addUInt32(*p);
     }   // addFloat
 
+    // ------------------------------------------------------------------------
+    /** Adds an 8 byte floating point value. */
+    BareNetworkString& addDouble(const double value)
+    {
+        uint64_t u;
+        memcpy(&u, &value, sizeof(double));
+        addUInt32(uint32_t(u >> 32));
+        return addUInt32(uint32_t(u & 0xffffffff));
+    }   // addDouble
+
+    // ------------------------------------------------------------------------
+    /** Adds a sequence of bytes, e.g. a message written with a BitWriter. */
+    BareNetworkString& addBytes(const uint8_t *data, unsigned int len)
+    {
+        m_buffer.append(data, len);
+        return *this;
+    }   // addBytes
+
     // ------------------------------------------------------------------------
     /** Adds the content of another network string. It only copies data which
      *  has not been 'removed' (i.e. skipped). */
     BareNetworkString& operator+=(BareNetworkString const& value)
     {
-        m_buffer.insert(m_buffer.end(),
-                       value.m_buffer.begin()+value.m_current_offset,
-                       value.m_buffer.end()   );
+        m_buffer.append(value.m_buffer.data() + value.m_current_offset,
+                        value.m_buffer.size() - value.m_current_offset);
         return *this;
     }   // operator+=
 
@@ -275,6 +310,17 @@ public:
         return f;
     }   // getFloat
 
+    // ------------------------------------------------------------------------
+    /** Gets an 8 byte floating point value. */
+    double getDouble() const
+    {
+        uint64_t u = uint64_t(getUInt32()) << 32;
+        u |= getUInt32();
+        double d;
+        memcpy(&d, &u, sizeof(double));
+        return d;
+    }   // getDouble
+
     // ------------------------------------------------------------------------
     /** Gets a Vec3. */
     Vec3 getVec3() const
@@ -344,6 +390,16 @@ public:
         m_current_offset = 5;   // ignore type and token
     }   // NetworkString
 
+    // ------------------------------------------------------------------------
+    /** Constructor for a received message which uses the data of the packet
+     *  without copying it. The network string takes over the packet and
+     *  destroys it. */
+    NetworkString(ENetPacket *packet)
+    {
+        m_buffer.wrap(packet);
+        m_current_offset = 5;   // ignore type and token
+    }   // NetworkString
+
     // ------------------------------------------------------------------------
     /** Returns the protocol type of this message. */
     ProtocolType getProtocolType() const
@@ -0,0 +1,313 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "network/prediction_buffer.hpp"
+
+#include "karts/abstract_kart.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+
+namespace
+{
+    /** A snapshot which differs less than this from the prediction is
+     *  accepted, the remaining error is caused by the precision of the
+     *  timestamps and by the physics not being deterministic. */
+    const float MAX_ERROR = 0.5f;
+
+    /** Maximum time step used when re-simulating, the same as the fixed
+     *  time step of the physics. */
+    const float MAX_STEP  = 1.0f/60.0f;
+}   // namespace
+
+// ----------------------------------------------------------------------------
+PredictionBuffer::PredictionBuffer()
+{
+    m_frames.resize(SIZE);
+    reset();
+}   // PredictionBuffer
+
+// ----------------------------------------------------------------------------
+/** Removes all frames and statistics. */
+void PredictionBuffer::reset()
+{
+    m_first            = 0;
+    m_num_frames       = 0;
+    m_num_snapshots    = 0;
+    m_num_corrections  = 0;
+    m_num_resimulated  = 0;
+    m_total_correction = 0;
+    m_max_correction   = 0;
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Adds a new frame, overwriting the oldest frame if the buffer is full.
+ *  \param time Local real time at the end of the frame.
+ *  \param dt Time step of the frame.
+ *  \return The frame, whose states must be filled in by the caller.
+ */
+PredictionBuffer::Frame *PredictionBuffer::addFrame(double time, float dt)
+{
+    if (m_num_frames == SIZE)
+    {
+        m_first = (m_first + 1) % SIZE;
+        m_num_frames--;
+    }
+    Frame &frame = getFrame(m_num_frames);
+    m_num_frames++;
+    frame.m_time = time;
+    frame.m_dt   = dt;
+    return &frame;
+}   // addFrame
+
+// ----------------------------------------------------------------------------
+/** Stores the current state of a kart. This must be called after each
+ *  world update.
+ *  \param kart The kart.
+ *  \param time Local real time.
+ *  \param dt Time step of the world update.
+ */
+void PredictionBuffer::saveFrame(const AbstractKart *kart, double time,
+                                 float dt)
+{
+    Frame *frame = addFrame(time, dt);
+    kart->saveState(&frame->m_body);
+    kart->getVehicle()->saveState(&frame->m_vehicle);
+}   // saveFrame
+
+// ----------------------------------------------------------------------------
+/** Finds the frame at which a snapshot with the given time has to be
+ *  applied, and the predicted position at that time.
+ *  \param time Local time of the snapshot.
+ *  \param n On return the index of the first frame not older than the
+ *         snapshot.
+ *  \param xyz On return the predicted position, interpolated between the
+ *         frames before and after the snapshot.
+ *  \return False if the snapshot is older than all frames or newer than
+ *          the last frame.
+ */
+bool PredictionBuffer::findFrame(double time, unsigned int *n,
+                                 Vec3 *xyz) const
+{
+    if (m_num_frames < 2 || time <= getFrame(0).m_time ||
+        time > getFrame(m_num_frames - 1).m_time)
+        return false;
+
+    // Snapshots are usually close to the newest frames
+    unsigned int i = m_num_frames - 1;
+    while (getFrame(i - 1).m_time >= time)
+        i--;
+    const Frame &before = getFrame(i - 1);
+    const Frame &after  = getFrame(i);
+    float f = float((time - before.m_time) / (after.m_time - before.m_time));
+    *xyz = Vec3(before.m_body.m_transform.getOrigin())
+         + (Vec3(after.m_body.m_transform.getOrigin())
+         -  Vec3(before.m_body.m_transform.getOrigin())) * f;
+    *n = i;
+    return true;
+}   // findFrame
+
+// ----------------------------------------------------------------------------
+/** Compares a snapshot from the server with the prediction and updates the
+ *  statistics.
+ *  \param time Local time of the snapshot.
+ *  \param xyz Position of the kart in the snapshot.
+ *  \param n On return the index of the frame to correct.
+ *  \return True if the prediction must be corrected.
+ */
+bool PredictionBuffer::checkSnapshot(double time, const Vec3 &xyz,
+                                     unsigned int *n)
+{
+    m_num_snapshots++;
+    Vec3 predicted;
+    if (!findFrame(time, n, &predicted))
+        return false;
+    float error = (xyz - predicted).length();
+    if (error < MAX_ERROR)
+        return false;
+    m_num_corrections++;
+    m_total_correction += error;
+    m_max_correction    = std::max(m_max_correction, error);
+    return true;
+}   // checkSnapshot
+
+// ----------------------------------------------------------------------------
+/** Sets the state of frame n to the state from the server, and re-simulates
+ *  the kart from there to the last frame. Each frame is simulated with the
+ *  controls (engine force, brake, steering and skidding) which were set
+ *  in the previous frame, and keeps its own controls for the next frame.
+ *  The vehicle state of frame n is kept, since it is not sent by the
+ *  server. Only this kart is simulated, so it does not collide with
+ *  other objects during the re-simulation (its wheels still do).
+ *  \param kart The kart.
+ *  \param n Index of the frame to correct.
+ *  \param state The state from the server.
+ */
+void PredictionBuffer::rewind(AbstractKart *kart, unsigned int n,
+                              const Moveable::State &state)
+{
+    assert(n < m_num_frames);
+    btKart *vehicle = kart->getVehicle();
+    getFrame(n).m_body = state;
+    kart->restoreState(state);
+    vehicle->restoreState(getFrame(n).m_vehicle);
+
+    for (unsigned int i = n + 1; i < m_num_frames; i++)
+    {
+        Frame &frame = getFrame(i);
+        float dt = frame.m_dt;
+        while (dt > 0)
+        {
+            float step = std::min(dt, MAX_STEP);
+            vehicle->simulate(step);
+            dt -= step;
+        }
+
+        // Keep the controls that were set after this frame
+        for (int w = 0; w < vehicle->getNumWheels(); w++)
+        {
+            const btWheelInfo &old_wheel = frame.m_vehicle.m_wheel_info[w];
+            btWheelInfo &wheel           = vehicle->getWheelInfo(w);
+            wheel.m_engineForce          = old_wheel.m_engineForce;
+            wheel.m_brake                = old_wheel.m_brake;
+            wheel.m_steering             = old_wheel.m_steering;
+        }
+        vehicle->setSkidAngularVelocity(
+                                 frame.m_vehicle.m_skid_angular_velocity);
+        vehicle->saveState(&frame.m_vehicle);
+        kart->saveState(&frame.m_body);
+        m_num_resimulated++;
+    }   // for i < m_num_frames
+
+    // Update the graphical position and the velocity in kart coordinates
+    kart->restoreState(getFrame(m_num_frames - 1).m_body);
+}   // rewind
+
+// ----------------------------------------------------------------------------
+/** Compares a snapshot from the server with the prediction, and rewinds and
+ *  re-simulates the kart if they differ too much.
+ *  \param kart The kart.
+ *  \param time Local time of the snapshot.
+ *  \param state The state of the kart in the snapshot.
+ *  \return True if the kart was corrected.
+ */
+bool PredictionBuffer::correct(AbstractKart *kart, double time,
+                               const Moveable::State &state)
+{
+    unsigned int n;
+    if (!checkSnapshot(time, state.m_transform.getOrigin(), &n))
+        return false;
+    rewind(kart, n, state);
+    return true;
+}   // correct
+
+// ----------------------------------------------------------------------------
+/** Re-simulates a kart from a recorded frame to the last frame and compares
+ *  the result with the recorded last frame. This checks that rewind()
+ *  reproduces a run of the real physics (see --check-prediction). The kart
+ *  is set back to its recorded state afterwards, so the run is not
+ *  changed. Since rewind() overwrites the frames, the buffer is emptied.
+ *  \param kart The kart the frames were recorded for.
+ *  \param n Index of the frame to start from.
+ *  \param error On return the distance between the re-simulated and the
+ *         recorded position.
+ *  \return True if the error is small enough that a server snapshot would
+ *          not cause a correction.
+ */
+bool PredictionBuffer::replay(AbstractKart *kart, unsigned int n,
+                              float *error)
+{
+    assert(n < m_num_frames);
+    const Frame last = getFrame(m_num_frames - 1);
+    rewind(kart, n, getFrame(n).m_body);
+    *error = (Vec3(getFrame(m_num_frames - 1).m_body.m_transform.getOrigin())
+           -  Vec3(last.m_body.m_transform.getOrigin())).length();
+
+    kart->restoreState(last.m_body);
+    kart->getVehicle()->restoreState(last.m_vehicle);
+    m_first      = 0;
+    m_num_frames = 0;
+    return *error < MAX_ERROR;
+}   // replay
+
+// ----------------------------------------------------------------------------
+/** Simulates a kart driving with 20 m/s for ten seconds at 60 fps, with
+ *  snapshots from the server every 100 ms. The prediction of the client
+ *  deviates for a while in the middle, which must be detected. Since
+ *  there is no kart, the correction is done by the test itself. Rewinding
+ *  a real kart is checked with --check-prediction (see ProfileWorld).
+ */
+void PredictionBuffer::unitTesting()
+{
+    const float  SPEED      = 20.0f;
+    const float  FRAME_TIME = 1.0f/60.0f;
+    const double START      = 1000.0;
+
+    PredictionBuffer buffer;
+    Vec3 dummy;
+    unsigned int n;
+    assert(!buffer.findFrame(START, &n, &dummy));
+
+    float offset = 0;
+    unsigned int corrections = 0;
+    for (unsigned int i = 0; i < 600; i++)
+    {
+        double time = START + i*FRAME_TIME;
+        // The client goes wrong between 4 and 4.5 seconds
+        if (i >= 240 && i < 270)
+            offset += 0.05f;
+        Frame *frame = buffer.addFrame(time, FRAME_TIME);
+        frame->m_body.m_transform.setIdentity();
+        frame->m_body.m_transform.setOrigin(
+                                     Vec3(0, 0, SPEED*i*FRAME_TIME + offset));
+        assert(buffer.getNumFrames() == std::min(i + 1, (unsigned int)SIZE));
+
+        // A snapshot arrives every 6 frames, for a time about 5 frames ago
+        if (i % 6 != 0 || i < 10)
+            continue;
+        double snapshot_time = time - 5.3*FRAME_TIME;
+        Vec3 xyz(0, 0, float(SPEED*(snapshot_time - START)));
+        if (buffer.checkSnapshot(snapshot_time, xyz, &n))
+        {
+            assert(n == buffer.getNumFrames() - 6);
+            // Correct the prediction, like rewind() would do
+            offset = 0;
+            corrections++;
+        }
+    }   // for i < 600
+
+    // Snapshots that are too old or newer than the prediction are ignored
+    assert(!buffer.findFrame(START, &n, &dummy));
+    assert(!buffer.findFrame(START + 600*FRAME_TIME, &n, &dummy));
+    assert(buffer.findFrame(START + 599*FRAME_TIME, &n, &dummy));
+    assert(n == SIZE - 1);
+
+    Log::info("PredictionBuffer", "%d snapshots, %d corrections, average "
+              "%.2f m, max %.2f m.", buffer.getNumSnapshots(),
+              buffer.getNumCorrections(), buffer.getAverageCorrection(),
+              buffer.getMaxCorrection());
+    assert(buffer.getNumSnapshots() == 98);
+    assert(corrections == buffer.getNumCorrections());
+    // The client goes wrong by 1.5 m in total, which is detected twice
+    // (each time the error is at least 0.5 m)
+    assert(corrections == 2);
+    assert(buffer.getAverageCorrection() >= 0.5f);
+    assert(buffer.getMaxCorrection() < 0.5f + 6*0.05f);
+}   // unitTesting
@@ -0,0 +1,134 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file prediction_buffer.hpp
+ */
+
+#ifndef HEADER_PREDICTION_BUFFER_HPP
+#define HEADER_PREDICTION_BUFFER_HPP
+
+#include "karts/moveable.hpp"
+#include "physics/btKart.hpp"
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include <vector>
+
+class AbstractKart;
+
+/** \brief Client side prediction for a local kart.
+ *  A client simulates its own karts immediately, while the server only
+ *  simulates them once it applies the inputs of the client (see
+ *  InputBuffer). The server sends the state of the karts of a client
+ *  together with the time (of the client's clock) of the last input
+ *  applied, so the state can be compared with the state the client
+ *  predicted at that time. This buffer stores the state of the kart
+ *  after each frame in a ring buffer. If a snapshot from the server
+ *  differs too much from the prediction, the frame is set to the state of
+ *  the server, and all following frames are re-simulated with the stored
+ *  engine forces, brakes and steering of the kart.
+ * \ingroup network
+ */
+class PredictionBuffer : public NoCopy
+{
+public:
+    /** The state of the kart after one frame. */
+    struct Frame
+    {
+        /** Local real time at the end of the frame. */
+        double          m_time;
+        /** Time step of the frame. */
+        float           m_dt;
+        Moveable::State m_body;
+        btKart::State   m_vehicle;
+    };   // Frame
+
+    /** Number of frames stored, about two seconds at 60 fps. */
+    static const unsigned int SIZE = 128;
+
+private:
+    /** The ring buffer of frames. */
+    std::vector<Frame> m_frames;
+
+    /** Index of the oldest frame in m_frames. */
+    unsigned int m_first;
+
+    /** Number of valid frames. */
+    unsigned int m_num_frames;
+
+    /** Statistics: number of snapshots compared, number of corrections,
+     *  and the number of frames that were re-simulated. */
+    unsigned int m_num_snapshots;
+    unsigned int m_num_corrections;
+    unsigned int m_num_resimulated;
+
+    /** Statistics: sum and maximum of the position errors corrected. */
+    float        m_total_correction;
+    float        m_max_correction;
+
+    // ------------------------------------------------------------------------
+    /** Returns the n-th oldest frame. */
+    Frame &getFrame(unsigned int n)
+    {
+        return m_frames[(m_first + n) % SIZE];
+    }   // getFrame
+    // ------------------------------------------------------------------------
+    const Frame &getFrame(unsigned int n) const
+    {
+        return m_frames[(m_first + n) % SIZE];
+    }   // getFrame
+
+public:
+                 PredictionBuffer();
+    void         reset();
+    Frame       *addFrame(double time, float dt);
+    void         saveFrame(const AbstractKart *kart, double time, float dt);
+    bool         findFrame(double time, unsigned int *n, Vec3 *xyz) const;
+    bool         checkSnapshot(double time, const Vec3 &xyz, unsigned int *n);
+    void         rewind(AbstractKart *kart, unsigned int n,
+                        const Moveable::State &state);
+    bool         correct(AbstractKart *kart, double time,
+                         const Moveable::State &state);
+    bool         replay(AbstractKart *kart, unsigned int n, float *error);
+    static void  unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Returns the number of frames stored. */
+    unsigned int getNumFrames() const { return m_num_frames; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of server snapshots that were compared. */
+    unsigned int getNumSnapshots() const { return m_num_snapshots; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of corrections. */
+    unsigned int getNumCorrections() const { return m_num_corrections; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of frames that were re-simulated. */
+    unsigned int getNumResimulated() const { return m_num_resimulated; }
+    // ------------------------------------------------------------------------
+    /** Returns the average position error of all corrections. */
+    float getAverageCorrection() const
+    {
+        return m_num_corrections > 0 ? m_total_correction / m_num_corrections
+                                     : 0.0f;
+    }   // getAverageCorrection
+    // ------------------------------------------------------------------------
+    /** Returns the biggest position error corrected. */
+    float getMaxCorrection() const { return m_max_correction; }
+};   // PredictionBuffer
+
+#endif
@@ -19,6 +19,7 @@
 #include "network/protocol_manager.hpp"
 
 #include "network/event.hpp"
+#include "network/network_stats.hpp"
 #include "network/protocol.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
@@ -302,6 +303,12 @@ bool ProtocolManager::sendEvent(Event* event)
 
     m_protocols.unlock();
 
+    if (count > 0 && event->getType() == EVENT_TYPE_MESSAGE)
+    {
+        NetworkStats::get()->addDispatchLatency(event->data().getProtocolType(),
+                             StkTime::getRealTime() - event->getReceiveTime());
+    }
+
     if (count>0 || StkTime::getTimeSinceEpoch()-event->getArrivalTime()
                     >= TIME_TO_KEEP_EVENTS                                  )
     {
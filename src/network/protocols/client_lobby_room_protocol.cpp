@@ -648,6 +648,12 @@ void ClientLobbyRoomProtocol::raceFinished(Event* event)
         Log::error("ClientLobbyRoomProtocol",
                    "No game events protocol registered.");
 
+    // The synchronization protocol keeps running during the race
+    protocol = ProtocolManager::getInstance()
+             ->getProtocol(PROTOCOL_SYNCHRONIZATION);
+    if (protocol)
+        ProtocolManager::getInstance()->requestTerminate(protocol);
+
     // finish the race
     WorldWithRank* ranked_world = (WorldWithRank*)(World::getWorld());
     ranked_world->beginSetKartPositions();
@@ -26,9 +26,11 @@
 #include "network/game_setup.hpp"
 #include "network/network_config.hpp"
 #include "network/protocol_manager.hpp"
+#include "network/protocols/synchronization_protocol.hpp"
 #include "network/stk_host.hpp"
 #include "network/stk_peer.hpp"
 #include "utils/log.hpp"
+#include "utils/time.hpp"
 
 //-----------------------------------------------------------------------------
 
@@ -47,44 +49,57 @@ ControllerEventsProtocol::~ControllerEventsProtocol()
 
 bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
 {
-    if(!checkDataSize(event, 13)) return true;
+    if(!checkDataSize(event, 2)) return true;
 
     NetworkString &data = event->data();
-    float time = data.getFloat();
+    unsigned int count = data.getUInt8();
+    double current_time = StkTime::getRealTime();
 
-    uint8_t client_index = -1;
-    while (data.size() >= 9)
+    // The server converts the times of the inputs from the clock of the
+    // client to network time, so that the transit times of the inputs of
+    // all clients are comparable.
+    SynchronizationProtocol *sync = NULL;
+    if (NetworkConfig::get()->isServer())
     {
-        uint8_t kart_id = data.getUInt8();
-        if (kart_id >=World::getWorld()->getNumKarts())
+        sync = static_cast<SynchronizationProtocol*>(ProtocolManager
+                 ::getInstance()->getProtocol(PROTOCOL_SYNCHRONIZATION));
+    }
+    const int host_id = event->getPeer()->getHostId();
+
+    BitReader reader(data.getCurrentData(), data.size());
+    m_input_buffer.lock();
+    for (unsigned int i = 0; i < count; i++)
+    {
+        InputBuffer::Input input;
+        uint32_t kart_id, controls[3];
+        int action;
+        InputSchema::read(&reader, &input.m_sequence, &input.m_time,
+                          &kart_id, &controls[0], &controls[1], &controls[2],
+                          &action, &input.m_value);
+        if (reader.hasOverflow())
+            break;
+        input.m_kart_id     = kart_id;
+        input.m_controls[0] = controls[0];
+        input.m_controls[1] = controls[1];
+        input.m_controls[2] = controls[2];
+        input.m_action      = action;
+        if (sync)
+            input.m_time = sync->peerToNetworkTime(host_id, input.m_time);
+        if (input.m_kart_id >= World::getWorld()->getNumKarts())
         {
-            Log::warn("ControllerEventProtocol", "No valid kart id (%s).",
-                      kart_id);
+            Log::warn("ControllerEventProtocol", "No valid kart id (%d).",
+                      input.m_kart_id);
             continue;
         }
-        uint8_t serialized_1   = data.getUInt8();
-        uint8_t serialized_2   = data.getUInt8();
-        uint8_t serialized_3   = data.getUInt8();
-        PlayerAction action    = (PlayerAction)(data.getUInt8());
-        int action_value       = data.getUInt32();
-        Log::info("ControllerEventsProtocol", "KartID %d action %d value %d",
-                  kart_id, action, action_value);
-        Controller *controller = World::getWorld()->getKart(kart_id)
-                                                  ->getController();
-        KartControl *controls  = controller->getControls();
-        controls->m_brake      = (serialized_1 & 0x40)!=0;
-        controls->m_nitro      = (serialized_1 & 0x20)!=0;
-        controls->m_rescue     = (serialized_1 & 0x10)!=0;
-        controls->m_fire       = (serialized_1 & 0x08)!=0;
-        controls->m_look_back  = (serialized_1 & 0x04)!=0;
-        controls->m_skid       = KartControl::SkidControl(serialized_1 & 0x03);
-
-        controller->action(action, action_value);
+        m_input_buffer.getData().add(input, current_time);
     }
-    if (data.size() > 0 )
+    m_input_buffer.unlock();
+
+    if (reader.hasOverflow() || reader.getNumBytes() < data.size())
     {
         Log::warn("ControllerEventProtocol",
-                  "The data seems corrupted. Remains %d", data.size());
+                  "The data seems corrupted. Remains %d",
+                  (int)data.size() - (int)reader.getNumBytes());
     }
     if (NetworkConfig::get()->isServer())
     {
@@ -95,10 +110,65 @@ bool ControllerEventsProtocol::notifyEventAsynchronous(Event* event)
     return true;
 }   // notifyEventAsynchronous
 
+//-----------------------------------------------------------------------------
+/** Applies all received inputs which are due. This is called in the main
+ *  thread, so the controls are not changed while the world is updated.
+ *  \param dt Time step size.
+ */
+void ControllerEventsProtocol::update(float dt)
+{
+    std::vector<InputBuffer::Input> inputs;
+    m_input_buffer.lock();
+    m_input_buffer.getData().getDueInputs(StkTime::getRealTime(), &inputs);
+    m_input_buffer.unlock();
+
+    for (unsigned int i = 0; i < inputs.size(); i++)
+    {
+        const InputBuffer::Input &input = inputs[i];
+        uint8_t serialized_1   = input.m_controls[0];
+        PlayerAction action    = (PlayerAction)(input.m_action);
+        Log::info("ControllerEventsProtocol", "KartID %d action %d value %d",
+                  input.m_kart_id, action, input.m_value);
+        Controller *controller = World::getWorld()->getKart(input.m_kart_id)
+                                                  ->getController();
+        KartControl *controls  = controller->getControls();
+        controls->m_brake      = (serialized_1 & 0x40)!=0;
+        controls->m_nitro      = (serialized_1 & 0x20)!=0;
+        controls->m_rescue     = (serialized_1 & 0x10)!=0;
+        controls->m_fire       = (serialized_1 & 0x08)!=0;
+        controls->m_look_back  = (serialized_1 & 0x04)!=0;
+        controls->m_skid       = KartControl::SkidControl(serialized_1 & 0x03);
+
+        controller->action(action, input.m_value);
+    }   // for i < inputs.size()
+}   // update
+
+//-----------------------------------------------------------------------------
+/** Converts a local time to the time of the host controlling a kart, such
+ *  that all inputs of the kart created before that time have been applied
+ *  at the local time (see InputBuffer::getSenderTime). On the server the
+ *  returned time is a network time, since the times of the received inputs
+ *  are converted.
+ *  \param kart_id The kart.
+ *  \param local_time The local real time.
+ *  \param sender_time On return the time of the host of the kart.
+ *  \return False if no input of this kart was received yet.
+ */
+bool ControllerEventsProtocol::getSenderTime(int kart_id, double local_time,
+                                             double *sender_time)
+{
+    m_input_buffer.lock();
+    bool known = m_input_buffer.getData().getSenderTime(kart_id, local_time,
+                                                        sender_time);
+    m_input_buffer.unlock();
+    return known;
+}   // getSenderTime
+
 //-----------------------------------------------------------------------------
 /** Called from the local kart controller when an action (like steering,
  *  acceleration, ...) was triggered. It compresses the current kart control
- *  state and sends a message with the new info to the server.
+ *  state and sends a message with the new info and the last inputs to the
+ *  server.
  *  \param controller The controller that triggered the action.
  *  \param action Which action was triggered.
  *  \param value New value for the given action.
@@ -124,11 +194,38 @@ void ControllerEventsProtocol::controllerAction(Controller* controller,
     uint8_t serialized_2 = (uint8_t)(controls->m_accel*255.0);
     uint8_t serialized_3 = (uint8_t)(controls->m_steer*127.0);
 
-    NetworkString *ns = getNetworkString(13);
-    ns->addFloat(World::getWorld()->getTime());
-    ns->addUInt8(controller->getKart()->getWorldKartId());
-    ns->addUInt8(serialized_1).addUInt8(serialized_2).addUInt8(serialized_3);
-    ns->addUInt8((uint8_t)(action)).addUInt32(value);
+    unsigned int kart_id = controller->getKart()->getWorldKartId();
+    if (kart_id >= m_next_sequence.size())
+        m_next_sequence.resize(kart_id + 1, 0);
+
+    InputBuffer::Input input;
+    input.m_sequence    = m_next_sequence[kart_id]++;
+    input.m_time        = StkTime::getRealTime();
+    input.m_kart_id     = kart_id;
+    input.m_controls[0] = serialized_1;
+    input.m_controls[1] = serialized_2;
+    input.m_controls[2] = serialized_3;
+    input.m_action      = (uint8_t)(action);
+    input.m_value       = value;
+    if (m_last_inputs.size() == REDUNDANCY)
+        m_last_inputs.erase(m_last_inputs.begin());
+    m_last_inputs.push_back(input);
+
+    uint8_t buffer[REDUNDANCY*InputSchema::MAX_BYTES];
+    BitWriter writer(buffer, sizeof(buffer));
+    for (unsigned int i = 0; i < m_last_inputs.size(); i++)
+    {
+        const InputBuffer::Input &last = m_last_inputs[i];
+        InputSchema::write(&writer, last.m_sequence, last.m_time,
+                           last.m_kart_id, last.m_controls[0],
+                           last.m_controls[1], last.m_controls[2],
+                           last.m_action, last.m_value);
+    }
+    assert(!writer.hasOverflow());
+
+    NetworkString *ns = getNetworkString(1 + writer.getNumBytes());
+    ns->addUInt8((uint8_t)m_last_inputs.size())
+       .addBytes(buffer, writer.getNumBytes());
     sendToServer(ns, false); // send message to server
     delete ns;
 
@@ -19,28 +19,66 @@
 #ifndef CONTROLLER_EVENTS_PROTOCOL_HPP
 #define CONTROLLER_EVENTS_PROTOCOL_HPP
 
+#include "network/bit_stream.hpp"
+#include "network/input_buffer.hpp"
 #include "network/protocol.hpp"
 
 #include "input/input.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/synchronised.hpp"
+
+#include <vector>
 
 class Controller;
 class STKPeer;
 
+/** \brief Sends the inputs of local karts to the server, which forwards
+ *  them to all other clients.
+ *  Each message contains the last inputs of the local karts (not only the
+ *  newest one), so that an input is only lost if several unreliable
+ *  packets in a row are lost. Received inputs are not applied immediately,
+ *  but collected in an InputBuffer and applied in update() (i.e. in the
+ *  main thread between two world updates) when they are due, so that the
+ *  time an input is held does not depend on the network jitter.
+ * \ingroup network
+ */
 class ControllerEventsProtocol : public Protocol
 {
+private:
+    /** Number of inputs sent in each message. */
+    static const unsigned int REDUNDANCY = 3;
+
+    /** The layout of one input in a message: sequence number, send time,
+     *  kart id, the three bytes of compressed controls (the first one only
+     *  uses 7 bits), the action and its value. */
+    typedef BitSchema<BitVarUInt, BitDouble, BitUInt<8>, BitUInt<7>,
+                      BitUInt<8>, BitUInt<8>, BitRangedInt<0, PA_COUNT - 1>,
+                      BitRangedInt<-Input::MAX_VALUE, Input::MAX_VALUE> >
+            InputSchema;
+
+    /** Received inputs, filled in the protocol thread and applied in the
+     *  main thread. */
+    Synchronised<InputBuffer> m_input_buffer;
+
+    /** The last inputs of the local karts, which are sent again with
+     *  each new input. */
+    std::vector<InputBuffer::Input> m_last_inputs;
+
+    /** The sequence number of the next input of each local kart. */
+    std::vector<uint32_t> m_next_sequence;
 
 public:
              ControllerEventsProtocol();
     virtual ~ControllerEventsProtocol();
 
     virtual bool notifyEventAsynchronous(Event* event) OVERRIDE;
-    virtual void update(float dt) OVERRIDE {};
+    virtual void update(float dt) OVERRIDE;
     virtual void setup() OVERRIDE {};
     virtual void asynchronousUpdate() OVERRIDE {}
 
     void controllerAction(Controller* controller, PlayerAction action,
                           int value);
+    bool getSenderTime(int kart_id, double local_time, double *sender_time);
 
 };   // class ControllerEventsProtocol
 
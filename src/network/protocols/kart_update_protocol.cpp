@@ -1,28 +1,108 @@
 #include "network/protocols/kart_update_protocol.hpp"
 
+#include "config/user_config.hpp"
 #include "karts/abstract_kart.hpp"
 #include "karts/controller/controller.hpp"
-#include "modes/world.hpp"
+#include "modes/linear_world.hpp"
 #include "network/event.hpp"
+#include "network/interest_manager.hpp"
 #include "network/network_config.hpp"
+#include "network/network_stats.hpp"
+#include "network/prediction_buffer.hpp"
 #include "network/protocol_manager.hpp"
+#include "network/protocols/controller_events_protocol.hpp"
+#include "network/protocols/synchronization_protocol.hpp"
+#include "network/remote_kart_info.hpp"
+#include "network/stk_host.hpp"
+#include "network/stk_peer.hpp"
+#include "race/race_manager.hpp"
+#include "tracks/track.hpp"
 #include "utils/time.hpp"
 
+namespace
+{
+    /** Size of the state of a kart sent to the peer controlling it:
+     *  id, time, position, rotation, linear and angular velocity. */
+    const int OWN_KART_SIZE   = 1 + 8 + 12 + 16 + 12 + 12;
+
+    /** Size of the state of any other kart: id, position and rotation. */
+    const int OTHER_KART_SIZE = 1 + 12 + 16;
+}   // namespace
+
 KartUpdateProtocol::KartUpdateProtocol() : Protocol(PROTOCOL_KART_UPDATE)
 {
+    World *world = World::getWorld();
     // Allocate arrays to store one position and rotation for each kart
     // (which is the update information from the server to the client).
-    m_next_positions.resize(World::getWorld()->getNumKarts());
-    m_next_quaternions.resize(World::getWorld()->getNumKarts());
+    m_next_positions.resize(world->getNumKarts());
+    m_next_quaternions.resize(world->getNumKarts());
 
     // This flag keeps track if valid data for an update is in
     // the arrays
-    m_was_updated = false;
+    m_was_updated.resize(world->getNumKarts(), false);
+    m_send_times.resize(world->getNumKarts(), 0);
+    m_last_update_time = 0;
+
+    // A client predicts its local karts, which are corrected with the
+    // states received from the server.
+    m_server_states.resize(world->getNumKarts());
+    m_server_times.resize(world->getNumKarts(), 0);
+    m_server_state_received.resize(world->getNumKarts(), false);
+    m_predictions.resize(world->getNumKarts(), NULL);
+    if (!NetworkConfig::get()->isServer())
+    {
+        for (unsigned int i = 0; i < world->getNumKarts(); i++)
+        {
+            if (world->getKart(i)->getController()
+                                 ->isLocalPlayerController())
+                m_predictions[i] = new PredictionBuffer();
+        }
+    }
+
+    // Find the peer controlling each kart, its karts are not sent to it,
+    // and the relevance of all other karts depends on its karts.
+    m_kart_host_ids.resize(world->getNumKarts(), -1);
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        RaceManager::KartType type = race_manager->getKartType(i);
+        int id = race_manager->getKartGlobalPlayerId(i);
+        if ((type == RaceManager::KT_PLAYER ||
+             type == RaceManager::KT_NETWORK_PLAYER) &&
+            id >= 0 && id < (int)race_manager->getNumPlayers())
+        {
+            m_kart_host_ids[i] = race_manager->getKartInfo(id).getHostId();
+        }
+    }
+
+    m_interest_manager = NULL;
+    if (NetworkConfig::get()->isServer())
+    {
+        LinearWorld *lw = dynamic_cast<LinearWorld*>(world);
+        float length = lw ? world->getTrack()->getTrackLength() : 0.0f;
+        m_interest_manager = new InterestManager(
+            (float)UserConfigParams::m_server_kart_update_bandwidth, length);
+    }
 }   // KartUpdateProtocol
 
 // ----------------------------------------------------------------------------
 KartUpdateProtocol::~KartUpdateProtocol()
 {
+    delete m_interest_manager;
+    for (unsigned int i = 0; i < m_predictions.size(); i++)
+    {
+        PredictionBuffer *prediction = m_predictions[i];
+        if (!prediction)
+            continue;
+        Log::info("KartUpdateProtocol", "Prediction of kart %d: %d "
+                  "snapshots, %d corrections, average %.3f m, max %.3f m, "
+                  "%d frames re-simulated.", i,
+                  prediction->getNumSnapshots(),
+                  prediction->getNumCorrections(),
+                  prediction->getAverageCorrection(),
+                  prediction->getMaxCorrection(),
+                  prediction->getNumResimulated());
+        delete prediction;
+    }
 }   // ~KartUpdateProtocol
 
 // ----------------------------------------------------------------------------
@@ -33,35 +113,202 @@ void KartUpdateProtocol::setup()
 // ----------------------------------------------------------------------------
 /** Store the update events in the queue. Since the events are handled in the
  *  synchronous notify function, there is no lock necessary to 
+ *  protect the arrays.
+ *  A message starts with the world time and the network time at which it
+ *  was sent, followed by the states of the karts of the receiving client
+ *  (including velocities and the time of the client to which the state
+ *  belongs), followed by the position and rotation of other karts.
  */
 bool KartUpdateProtocol::notifyEvent(Event* event)
 {
+    if (event->getType() == EVENT_TYPE_DISCONNECTED && m_interest_manager)
+        m_interest_manager->removePeer(event->getPeer()->getHostId());
     if (event->getType() != EVENT_TYPE_MESSAGE)
         return true;
     NetworkString &ns = event->data();
-    if (ns.size() < 33)
+    if (ns.size() < 13)
     {
         Log::info("KartUpdateProtocol", "Message too short.");
         return true;
     }
     float time = ns.getFloat();
-    while(ns.size() >= 29)
+    // Convert the time the message was sent to the local clock. Without a
+    // clock estimate the receive time is used, which misses the transit.
+    double send_time = event->getReceiveTime();
+    double network_send_time = ns.getDouble();
+    SynchronizationProtocol *sync = static_cast<SynchronizationProtocol*>
+        (ProtocolManager::getInstance()->getProtocol(PROTOCOL_SYNCHRONIZATION));
+    if (sync && sync->hasNetworkTime())
+    {
+        send_time = network_send_time - sync->getNetworkTime()
+                  + StkTime::getRealTime();
+    }
+    unsigned int num_own = ns.getUInt8();
+    for (unsigned int i = 0; i < num_own && ns.size() >= OWN_KART_SIZE; i++)
+    {
+        uint8_t kart_id   = ns.getUInt8();
+        double state_time = ns.getDouble();
+        Moveable::State state;
+        state.m_transform.setOrigin(ns.getVec3());
+        state.m_transform.setRotation(ns.getQuat());
+        state.m_velocity         = ns.getVec3();
+        state.m_angular_velocity = ns.getVec3();
+        if (kart_id >= m_predictions.size() || !m_predictions[kart_id])
+            continue;
+        m_server_states        [kart_id] = state;
+        m_server_times         [kart_id] = state_time;
+        m_server_state_received[kart_id] = true;
+        m_send_times           [kart_id] = send_time;
+    }   // for i < num_own
+
+    while(ns.size() >= OTHER_KART_SIZE)
     {
         uint8_t kart_id             = ns.getUInt8();
         Vec3 xyz                    = ns.getVec3();
         btQuaternion quat           = ns.getQuat();
+        if (kart_id >= m_next_positions.size())
+            continue;
         m_next_positions  [kart_id] = xyz;
         m_next_quaternions[kart_id] = quat;
-    }   // while ns.size()>29
+        // Set the flag that a new update was received
+        m_was_updated     [kart_id] = true;
+        m_send_times      [kart_id] = send_time;
+    }   // while ns.size() >= OTHER_KART_SIZE
 
-    // Set the flag that a new update was received
-    m_was_updated = true;
     return true;
 }   // notifyEvent
 
 // ----------------------------------------------------------------------------
-/** Sends regular update events from the server to all clients and from the
- *  clients to the server (FIXME - is that actually necessary??)
+/** Sends the positions of the karts to all clients. Each client only gets
+ *  the karts selected by the interest manager, i.e. karts close to its
+ *  own karts are sent in every update, distant karts less often. The
+ *  state of its own karts is sent to each client in every update, with
+ *  the time of the client's last input applied to the kart, so that the
+ *  client can check its prediction.
+ *  \param dt Time since the last update.
+ */
+void KartUpdateProtocol::sendServerUpdates(float dt)
+{
+    World *world = World::getWorld();
+    LinearWorld *lw = dynamic_cast<LinearWorld*>(world);
+    std::vector<InterestManager::KartInfo> karts(world->getNumKarts());
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        AbstractKart *kart    = world->getKart(i);
+        karts[i].m_xyz        = kart->getXYZ();
+        karts[i].m_forward    = kart->getTrans().getBasis().getColumn(2);
+        karts[i].m_distance   = lw ? lw->getDistanceDownTrackForKart(i)
+                                   : -1.0f;
+    }
+
+    ControllerEventsProtocol *controller_events =
+        static_cast<ControllerEventsProtocol*>(ProtocolManager::getInstance()
+                                  ->getProtocol(PROTOCOL_CONTROLLER_EVENTS));
+    double current_time = StkTime::getRealTime();
+    SynchronizationProtocol *sync = static_cast<SynchronizationProtocol*>
+        (ProtocolManager::getInstance()->getProtocol(PROTOCOL_SYNCHRONIZATION));
+    double network_time = sync ? sync->getNetworkTime() : current_time;
+
+    const std::vector<STKPeer*> &peers = STKHost::get()->getPeers();
+    std::vector<unsigned int> viewers, selected;
+    std::vector<double> viewer_times;
+    for (unsigned int p = 0; p < peers.size(); p++)
+    {
+        const int host_id = peers[p]->getHostId();
+        viewers.clear();
+        viewer_times.clear();
+        for (unsigned int i = 0; i < m_kart_host_ids.size(); i++)
+        {
+            if (m_kart_host_ids[i] == host_id)
+                viewers.push_back(i);
+        }
+
+        // The state of a kart is only sent to its client once an input
+        // was received, otherwise the client's time is not known.
+        std::vector<unsigned int> own;
+        for (unsigned int i = 0; i < viewers.size(); i++)
+        {
+            double sender_time;
+            if (controller_events &&
+                controller_events->getSenderTime(viewers[i], current_time,
+                                                  &sender_time))
+            {
+                // The input times are network times on the server
+                if (sync)
+                    sender_time = sync->networkToPeerTime(host_id,
+                                                          sender_time);
+                own.push_back(viewers[i]);
+                viewer_times.push_back(sender_time);
+            }
+        }
+        const int header = 13 + (int)own.size()*OWN_KART_SIZE;
+        m_interest_manager->selectKarts(host_id, karts, viewers, dt,
+                                        header, OTHER_KART_SIZE, &selected);
+        if (selected.empty() && own.empty())
+            continue;
+
+        NetworkString *ns = getNetworkString(header +
+                                      (int)selected.size()*OTHER_KART_SIZE);
+        ns->setSynchronous(true);
+        ns->addFloat(world->getTime()).addDouble(network_time);
+        ns->addUInt8((uint8_t)own.size());
+        for (unsigned int i = 0; i < own.size(); i++)
+        {
+            AbstractKart *kart = world->getKart(own[i]);
+            const btRigidBody *body = kart->getBody();
+            ns->addUInt8(kart->getWorldKartId()).addDouble(viewer_times[i]);
+            ns->add(Vec3(body->getWorldTransform().getOrigin()))
+               .add(body->getWorldTransform().getRotation())
+               .add(Vec3(body->getLinearVelocity()))
+               .add(Vec3(body->getAngularVelocity()));
+        }
+        for (unsigned int i = 0; i < selected.size(); i++)
+        {
+            AbstractKart *kart = world->getKart(selected[i]);
+            ns->addUInt8(kart->getWorldKartId());
+            ns->add(kart->getXYZ()).add(kart->getRotation());
+        }
+        peers[p]->sendPacket(ns, /*reliable*/false);
+        delete ns;
+    }   // for p < peers.size()
+}   // sendServerUpdates
+
+// ----------------------------------------------------------------------------
+/** Stores the state of all local karts after the world update, and corrects
+ *  a local kart if the state received from the server differs too much
+ *  from its predicted state at that time.
+ *  \param dt Time step of the world update.
+ */
+void KartUpdateProtocol::updatePredictions(float dt)
+{
+    World *world = World::getWorld();
+    double current_time = StkTime::getRealTime();
+    for (unsigned int id = 0; id < m_predictions.size(); id++)
+    {
+        PredictionBuffer *prediction = m_predictions[id];
+        if (!prediction)
+            continue;
+        AbstractKart *kart = world->getKart(id);
+        prediction->saveFrame(kart, current_time, dt);
+        if (!m_server_state_received[id])
+            continue;
+        m_server_state_received[id] = false;
+        NetworkStats::get()->addKartUpdateAge(current_time
+                                              - m_send_times[id]);
+        if (prediction->correct(kart, m_server_times[id],
+                                m_server_states[id]))
+        {
+            Log::verbose("KartUpdateProtocol", "Corrected kart %d.", id);
+        }
+    }   // for id < m_predictions.size()
+}   // updatePredictions
+
+// ----------------------------------------------------------------------------
+/** Sends regular update events from the server to all clients. The server
+ *  is authoritative for all karts, so clients do not send their positions:
+ *  the server simulates the karts of the clients with the inputs received
+ *  by the ControllerEventsProtocol, and each client predicts its own karts
+ *  and corrects them with the states received from the server.
  *  Then it applies all update events that have been received in notifyEvent.
  *  This two-part implementation means that if the server should send two
  *  or more updates before this client handles them, only the last one will
@@ -71,73 +318,39 @@ void KartUpdateProtocol::update(float dt)
 {
     if (!World::getWorld())
         return;
-    static double time = 0;
     double current_time = StkTime::getRealTime();
-    if (current_time > time + 0.1) // 10 updates per second
+    if (NetworkConfig::get()->isServer() &&
+        current_time > m_last_update_time + 0.1) // 10 updates per second
     {
-        time = current_time;
-        if (NetworkConfig::get()->isServer())
-        {
-            World *world = World::getWorld();
-            NetworkString *ns = getNetworkString(4+world->getNumKarts()*29);
-            ns->setSynchronous(true);
-            ns->addFloat( world->getTime() );
-            for (unsigned int i = 0; i < world->getNumKarts(); i++)
-            {
-                AbstractKart* kart = world->getKart(i);
-                Vec3 xyz = kart->getXYZ();
-                ns->addUInt8( kart->getWorldKartId());
-                ns->add(xyz).add(kart->getRotation());
-                Log::verbose("KartUpdateProtocol",
-                             "Sending %d's positions %f %f %f",
-                             kart->getWorldKartId(), xyz[0], xyz[1], xyz[2]);
-            }
-            sendMessageToPeersChangingToken(ns, /*reliable*/false);
-            delete ns;
-        }
-        else
-        {
-            NetworkString *ns =
-                     getNetworkString(4+29*race_manager->getNumLocalPlayers());
-            ns->setSynchronous(true);
-            ns->addFloat(World::getWorld()->getTime());
-            for(unsigned int i=0; i<race_manager->getNumLocalPlayers(); i++)
-            {
-                AbstractKart *kart = World::getWorld()->getLocalPlayerKart(i);
-                const Vec3 &xyz = kart->getXYZ();
-                ns->addUInt8(kart->getWorldKartId());
-                ns->add(xyz).add(kart->getRotation());
-                Log::verbose("KartUpdateProtocol",
-                             "Sending %d's positions %f %f %f",
-                              kart->getWorldKartId(), xyz[0], xyz[1], xyz[2]);
-            }
-            sendToServer(ns, /*reliable*/false);
-            delete ns;
-        }   // if server
-    }   // if (current_time > time + 0.1)
+        float update_dt = m_last_update_time > 0
+                        ? float(current_time - m_last_update_time) : 0.1f;
+        m_last_update_time = current_time;
+        sendServerUpdates(update_dt);
+    }   // if server and current_time > time + 0.1
 
+    updatePredictions(dt);
 
     // Now handle all update events that have been received.
     // There is no lock necessary, since receiving new positions is done in
     // notifyEvent, which is called from the same thread that calls this
     // function.
-    if(m_was_updated)
+    for (unsigned id = 0; id < m_next_positions.size(); id++)
     {
-        for (unsigned id = 0; id < m_next_positions.size(); id++)
+        if (!m_was_updated[id])
+            continue;
+        AbstractKart *kart = World::getWorld()->getKart(id);
+        if (!kart->getController()->isLocalPlayerController())
         {
-            AbstractKart *kart = World::getWorld()->getKart(id);
-            if (!kart->getController()->isLocalPlayerController())
-            {
-                btTransform transform = kart->getBody()
-                                      ->getInterpolationWorldTransform();
-                transform.setOrigin(m_next_positions[id]);
-                transform.setRotation(m_next_quaternions[id]);
-                kart->getBody()->setCenterOfMassTransform(transform);
-                Log::verbose("KartUpdateProtocol", "Update kart %i pos",
-                             id);
-            }   // if not local player
-        }   // for id < num_karts
-        m_was_updated = false;  // mark that all updates were applied
-    }   // if m_was_updated
+            btTransform transform = kart->getBody()
+                                  ->getInterpolationWorldTransform();
+            transform.setOrigin(m_next_positions[id]);
+            transform.setRotation(m_next_quaternions[id]);
+            kart->getBody()->setCenterOfMassTransform(transform);
+            NetworkStats::get()->addKartUpdateAge(current_time
+                                                  - m_send_times[id]);
+            Log::verbose("KartUpdateProtocol", "Update kart %i pos",
+                         id);
+        }   // if not local player
+        m_was_updated[id] = false;  // mark that the update was applied
+    }   // for id < num_karts
 }   // update
-
@@ -1,6 +1,7 @@
 #ifndef KART_UPDATE_PROTOCOL_HPP
 #define KART_UPDATE_PROTOCOL_HPP
 
+#include "karts/moveable.hpp"
 #include "network/protocol.hpp"
 #include "utils/cpp2011.hpp"
 #include "utils/vec3.hpp"
@@ -11,6 +12,8 @@
 #include "pthread.h"
 
 class AbstractKart;
+class InterestManager;
+class PredictionBuffer;
 
 class KartUpdateProtocol : public Protocol
 {
@@ -22,8 +25,39 @@ private:
     /** Stores the last updated rotation for a kart. */
     std::vector<btQuaternion> m_next_quaternions;
 
-    /** True if a new update for the kart positions was received. */
-    bool m_was_updated;
+    /** True for each kart for which a new update was received. A server
+     *  only sends the karts that are relevant for a client. */
+    std::vector<bool> m_was_updated;
+
+    /** Local real time at which the server sent the last update of each
+     *  kart, to measure the age of updates when they are applied (see
+     *  NetworkStats). */
+    std::vector<double> m_send_times;
+
+    /** Client only: the state of each local kart received from the
+     *  server, and the local time the state belongs to. */
+    std::vector<Moveable::State> m_server_states;
+    std::vector<double> m_server_times;
+
+    /** Client only: true for each local kart for which a new state was
+     *  received from the server. */
+    std::vector<bool> m_server_state_received;
+
+    /** Client only: the prediction of each local kart, NULL for all other
+     *  karts. */
+    std::vector<PredictionBuffer*> m_predictions;
+
+    /** The host id of the peer controlling each kart, or -1. */
+    std::vector<int> m_kart_host_ids;
+
+    /** Server only: selects the karts sent to each peer. */
+    InterestManager *m_interest_manager;
+
+    /** Time of the last update sent. */
+    double m_last_update_time;
+
+    void sendServerUpdates(float dt);
+    void updatePredictions(float dt);
 
 public:
              KartUpdateProtocol();
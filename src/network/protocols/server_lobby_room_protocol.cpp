@@ -175,6 +175,7 @@ void ServerLobbyRoomProtocol::update(float dt)
             findAndTerminateProtocol(PROTOCOL_CONTROLLER_EVENTS);
             findAndTerminateProtocol(PROTOCOL_KART_UPDATE);
             findAndTerminateProtocol(PROTOCOL_GAME_EVENTS);
+            findAndTerminateProtocol(PROTOCOL_SYNCHRONIZATION);
         }
         break;
     case DONE:
@@ -14,11 +14,6 @@
 SynchronizationProtocol::SynchronizationProtocol() 
                        : Protocol(PROTOCOL_SYNCHRONIZATION)
 {
-    unsigned int size = STKHost::get()->getPeerCount();
-    m_pings.resize(size, std::map<uint32_t,double>());
-    m_successed_pings.resize(size, 0);
-    m_total_diff.resize(size, 0);
-    m_average_ping.resize(size, 0);
     m_pings_count = 0;
     m_countdown_activated = false;
     m_last_time = -1;
@@ -40,42 +35,59 @@ void SynchronizationProtocol::setup()
 
 bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
 {
+    if (event->getType() == EVENT_TYPE_DISCONNECTED)
+    {
+        if (NetworkConfig::get()->isServer())
+        {
+            m_clocks.lock();
+            m_clocks.getData().erase(event->getPeer()->getHostId());
+            m_clocks.unlock();
+        }
+        return true;
+    }
     if (event->getType() != EVENT_TYPE_MESSAGE)
         return true;
-    if(!checkDataSize(event, 5)) return true;
+    if(!checkDataSize(event, 13)) return true;
 
     const NetworkString &data = event->data();
     uint32_t request  = data.getUInt8();
     uint32_t sequence = data.getUInt32();
-
-    const std::vector<STKPeer*> &peers = STKHost::get()->getPeers();
-    assert(peers.size() > 0);
-
-    // Find the right peer id. The host id (i.e. each host sendings its
-    // host id) can not be used here, since host ids can have gaps (if a
-    // host should disconnect)
-    uint8_t peer_id = -1;
-    for (unsigned int i = 0; i < peers.size(); i++)
-    {
-        if (peers[i]->isSamePeer(event->getPeer()))
-        {
-            peer_id = i;
-            break;
-        }
-    }
+    double   time     = data.getDouble();
 
     if (request)
     {
         // Only a client should receive a request for a ping response
         assert(NetworkConfig::get()->isClient());
-        NetworkString *response = getNetworkString(5);
+        NetworkString *response = getNetworkString(13);
         // The '0' indicates a response to a ping request
-        response->addUInt8(0).addUInt32(sequence);
+        response->addUInt8(0).addUInt32(sequence)
+                 .addDouble(StkTime::getRealTime());
         event->getPeer()->sendPacket(response, false);
         delete response;
         Log::verbose("SynchronizationProtocol", "Answering sequence %u at %lf",
                      sequence, StkTime::getRealTime());
 
+        // The estimate of the server is for the client clock relative
+        // to the server clock.
+        // The fields are always sent, so they are read even if there is no
+        // estimate yet, otherwise the countdown would not be found.
+        if (data.size() >= 25)
+        {
+            bool has_estimate = data.getUInt8() != 0;
+            double offset     = data.getDouble();
+            double rtt        = data.getDouble();
+            double jitter     = data.getDouble();
+            if (has_estimate)
+            {
+                m_server_clock.lock();
+                m_server_clock.getData().setEstimate(-offset, rtt, jitter);
+                m_server_clock.unlock();
+                Log::debug("SynchronizationProtocol", "Server time %lf "
+                           "offset %lf rtt %lf jitter %lf", time, -offset,
+                           rtt, jitter);
+            }
+        }
+
         // countdown time in the message
         if (data.size() == 4)
         {
@@ -84,7 +96,7 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
                        "Request to start game in %d.", time_to_start);
             if (!m_countdown_activated)
                 startCountdown(time_to_start);
-            else
+            else if (!m_has_quit)
             {
                 // Adjust the time based on the value sent from the server.
                 m_countdown = (double)(time_to_start/1000.0);
@@ -97,40 +109,43 @@ bool SynchronizationProtocol::notifyEventAsynchronous(Event* event)
     {
         // Only a server should receive this kind of message
         assert(NetworkConfig::get()->isServer());
-        if (sequence >= m_pings[peer_id].size())
+        int host_id = event->getPeer()->getHostId();
+        m_clocks.lock();
+        NetworkClock &clock = m_clocks.getData()[host_id];
+        bool known = clock.addResponse(sequence, time,
+                                       StkTime::getRealTime());
+        NetworkClock estimate = clock;
+        m_clocks.unlock();
+        if (!known)
         {
             Log::warn("SynchronizationProtocol",
                       "The sequence# %u isn't known.", sequence);
             return true;
         }
-        double current_time = StkTime::getRealTime();
-        m_total_diff[peer_id] += current_time - m_pings[peer_id][sequence];
-        m_successed_pings[peer_id]++;
-        m_average_ping[peer_id] =
-            (int)((m_total_diff[peer_id]/m_successed_pings[peer_id])*1000.0);
 
         Log::debug("SynchronizationProtocol",
-            "Peer %d sequence %d ping %u average %u at %lf",
-            peer_id, sequence,
-            (unsigned int)((current_time - m_pings[peer_id][sequence])*1000),
-            m_average_ping[peer_id],
-            StkTime::getRealTime());
+            "Host %d sequence %d offset %lf rtt %lf jitter %lf at %lf",
+            host_id, sequence, estimate.getOffset(), estimate.getRTT(),
+            estimate.getJitter(), StkTime::getRealTime());
     }
     return true;
 }   // notifyEventAsynchronous
 
 //-----------------------------------------------------------------------------
-
+/** Updates the countdown, and on the server sends a ping to each client
+ *  once a second. After the countdown the race protocols are started, but
+ *  this protocol keeps running to keep the clock estimates up to date.
+ */
 void SynchronizationProtocol::asynchronousUpdate()
 {
     double current_time = StkTime::getRealTime();
-    if (m_countdown_activated)
+    if (m_countdown_activated && !m_has_quit)
     {
         m_countdown -= (current_time - m_last_countdown_update);
         m_last_countdown_update = current_time;
         Log::debug("SynchronizationProtocol",
                    "Update! Countdown remaining : %f", m_countdown);
-        if (m_countdown < 0.0 && !m_has_quit)
+        if (m_countdown < 0.0)
         {
             m_has_quit = true;
             Log::info("SynchronizationProtocol",
@@ -138,7 +153,6 @@ void SynchronizationProtocol::asynchronousUpdate()
             (new KartUpdateProtocol())->requestStart();
             (new ControllerEventsProtocol())->requestStart();
             (new GameEventsProtocol())->requestStart();
-            requestTerminate();
             return;
         }
         static int seconds = -1;
@@ -156,33 +170,115 @@ void SynchronizationProtocol::asynchronousUpdate()
 
     if (NetworkConfig::get()->isServer() &&  current_time > m_last_time+1)
     {
+        // The countdown is only sent till the race is started
+        bool send_countdown = m_countdown_activated && !m_has_quit;
         const std::vector<STKPeer*> &peers = STKHost::get()->getPeers();
+        m_clocks.lock();
         for (unsigned int i = 0; i < peers.size(); i++)
         {
+            NetworkClock &clock = m_clocks.getData()[peers[i]->getHostId()];
             NetworkString *ping_request = 
-                            getNetworkString(m_countdown_activated ? 9 : 5);
-            ping_request->addUInt8(1).addUInt32(m_pings[i].size());
+                            getNetworkString(send_countdown ? 42 : 38);
+            ping_request->addUInt8(1).addUInt32(m_pings_count)
+                         .addDouble(current_time);
+            // Send the estimate for the clock of the client
+            ping_request->addUInt8(clock.hasEstimate() ? 1 : 0)
+                         .addDouble(clock.getOffset())
+                         .addDouble(clock.getRTT())
+                         .addDouble(clock.getJitter());
             // Server adds the countdown if it has started. This will indicate
             // to the client to start the countdown as well (first time the 
             // message is received), or to update the countdown time.
-            if (m_countdown_activated)
+            if (send_countdown)
             {
                 ping_request->addUInt32((int)(m_countdown*1000.0));
                 Log::debug("SynchronizationProtocol",
                            "CNTActivated: Countdown value : %f", m_countdown);
             }
             Log::verbose("SynchronizationProtocol",
-                         "Added sequence number %u for peer %d at %lf",
-                         m_pings[i].size(), i, StkTime::getRealTime());
-            m_pings[i] [ m_pings_count ] = current_time;
+                         "Added sequence number %u for host %d at %lf",
+                         m_pings_count, peers[i]->getHostId(), current_time);
+            clock.addPing(m_pings_count, current_time);
             peers[i]->sendPacket(ping_request, false);
             delete ping_request;
         }   // for i M peers
+        m_clocks.unlock();
         m_last_time = current_time;
         m_pings_count++;
     }   // if current_time > m_last_time + 0.1
 }   // asynchronousUpdate
 
+//-----------------------------------------------------------------------------
+/** Returns true if the network time is known, i.e. always on the server,
+ *  and on a client after the first estimate was received from the server.
+ */
+bool SynchronizationProtocol::hasNetworkTime() const
+{
+    if (NetworkConfig::get()->isServer())
+        return true;
+    return m_server_clock.getAtomic().hasEstimate();
+}   // hasNetworkTime
+
+//-----------------------------------------------------------------------------
+/** Returns the current network time, which is the real time of the server.
+ *  On a client this is an estimate, see hasNetworkTime().
+ */
+double SynchronizationProtocol::getNetworkTime() const
+{
+    if (NetworkConfig::get()->isServer())
+        return StkTime::getRealTime();
+    return m_server_clock.getAtomic().toRemoteTime(StkTime::getRealTime());
+}   // getNetworkTime
+
+//-----------------------------------------------------------------------------
+/** On the server converts a real time of a client to network time. This
+ *  can be called from any thread.
+ *  \param host_id Host id of the client.
+ *  \param peer_time Real time of the client.
+ */
+double SynchronizationProtocol::peerToNetworkTime(int host_id,
+                                                  double peer_time) const
+{
+    NetworkClock clock;
+    getPeerClock(host_id, &clock);
+    return clock.toLocalTime(peer_time);
+}   // peerToNetworkTime
+
+//-----------------------------------------------------------------------------
+/** On the server converts a network time to the real time of a client. This
+ *  can be called from any thread.
+ *  \param host_id Host id of the client.
+ *  \param network_time The network time.
+ */
+double SynchronizationProtocol::networkToPeerTime(int host_id,
+                                                  double network_time) const
+{
+    NetworkClock clock;
+    getPeerClock(host_id, &clock);
+    return clock.toRemoteTime(network_time);
+}   // networkToPeerTime
+
+//-----------------------------------------------------------------------------
+/** On the server returns a copy of the clock estimate of a client. Without
+ *  an estimate the offset of the clock is 0.
+ *  \param host_id Host id of the client.
+ *  \param clock On return the clock of the client (unchanged if the client
+ *         is not known).
+ *  \return False if the client is not known.
+ */
+bool SynchronizationProtocol::getPeerClock(int host_id,
+                                           NetworkClock *clock) const
+{
+    m_clocks.lock();
+    std::map<int, NetworkClock>::const_iterator i =
+                                          m_clocks.getData().find(host_id);
+    bool found = i != m_clocks.getData().end();
+    if (found)
+        *clock = i->second;
+    m_clocks.unlock();
+    return found;
+}   // getPeerClock
+
 //-----------------------------------------------------------------------------
 /** Starts the countdown on this machine. On the server side this function
  *  is called from the StartGameProtocol (when all players have confirmed that
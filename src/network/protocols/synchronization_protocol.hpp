@@ -1,22 +1,43 @@
 #ifndef SYNCHRONIZATION_PROTOCOL_HPP
 #define SYNCHRONIZATION_PROTOCOL_HPP
 
+#include "network/network_clock.hpp"
 #include "network/protocol.hpp"
 #include "utils/cpp2011.hpp"
+#include "utils/synchronised.hpp"
 
-#include <vector>
 #include <map>
 
+/** \brief Synchronises the clocks of all hosts and starts the race.
+ *  The server pings each client once a second, and the clients answer
+ *  with their current time. From this the server estimates the clock
+ *  offset, round trip time and jitter of each client (see NetworkClock),
+ *  and sends the estimate back to the client with the next ping. The
+ *  protocol keeps running during the race, so that the estimate follows
+ *  changes of the network and clock drift.
+ *  The network time is the real time of the server. A client uses it to
+ *  convert times sent by the server to its own clock, e.g. the time at
+ *  which a kart update was sent (see KartUpdateProtocol). The server
+ *  converts times sent by a client with the clock estimate of that client
+ *  (see peerToNetworkTime()), e.g. the creation time of inputs (see
+ *  ControllerEventsProtocol).
+ *  The server also sends the countdown to the start of the race with
+ *  the pings.
+ * \ingroup network
+ */
 class SynchronizationProtocol : public Protocol
 {
 private:
-    std::vector<std::map<uint32_t, double> > m_pings;
-    std::vector<uint32_t> m_average_ping;
+    /** On the server the clock of each client, indexed by host id. */
+    Synchronised<std::map<int, NetworkClock> > m_clocks;
+
+    /** On a client the clock of the server, as estimated by the server.
+     *  It is updated in the protocol thread, but used by other protocols
+     *  in the main thread. */
+    Synchronised<NetworkClock> m_server_clock;
 
     /** Counts the number of pings sent. */
     uint32_t m_pings_count;
-    std::vector<uint32_t> m_successed_pings;
-    std::vector<double> m_total_diff;
     bool m_countdown_activated;
     double m_countdown;
     double m_last_countdown_update;
@@ -34,12 +55,16 @@ public:
     virtual void setup() OVERRIDE;
     virtual void asynchronousUpdate() OVERRIDE;
     void startCountdown(int ms_countdown);
+    bool   hasNetworkTime() const;
+    double getNetworkTime() const;
+    double peerToNetworkTime(int host_id, double peer_time) const;
+    double networkToPeerTime(int host_id, double network_time) const;
+    bool   getPeerClock(int host_id, NetworkClock *clock) const;
 
     // ------------------------------------------------------------------------
     virtual void update(float dt) OVERRIDE {}
     // ------------------------------------------------------------------------
     int getCountdown() { return (int)(m_countdown*1000.0); }
-
 };   // class SynchronizationProtocol
 
 #endif // SYNCHRONIZATION_PROTOCOL_HPP
@@ -152,9 +152,15 @@ Online::XMLRequest* ServersManager::getLANRefreshRequest() const
         {
             Network *broadcast = new Network(1, 1, 0, 0);
 
+            // A process can run several LAN servers (see LobbyPool), each
+            // listening on a different port.
             BareNetworkString s(std::string("stk-server"));
-            TransportAddress broadcast_address(-1, 2757);
-            broadcast->sendRawPacket(s, broadcast_address);
+            for (unsigned int i = 0; i < NetworkConfig::MAX_LOBBIES; i++)
+            {
+                TransportAddress broadcast_address(-1,
+                    NetworkConfig::SERVER_DISCOVERY_PORT + 2*i);
+                broadcast->sendRawPacket(s, broadcast_address);
+            }
 
             Log::info("ServersManager", "Sent broadcast message.");
 
@@ -201,6 +207,9 @@ Online::XMLRequest* ServersManager::getLANRefreshRequest() const
          *  functions are called, which will cause a crash. */
         virtual void afterOperation() OVERRIDE {}
         // --------------------------------------------------------------------
+        /** This is not a http transfer, so just execute operation(). */
+        virtual CURL* startOperation() OVERRIDE { operation(); return NULL; }
+        // --------------------------------------------------------------------
     };   // LANRefreshRequest
     // ========================================================================
 
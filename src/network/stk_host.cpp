@@ -20,9 +20,11 @@
 
 #include "config/user_config.hpp"
 #include "io/file_manager.hpp"
+#include "network/buffer_pool.hpp"
 #include "network/event.hpp"
 #include "network/network_config.hpp"
 #include "network/network_console.hpp"
+#include "network/network_stats.hpp"
 #include "network/network_string.hpp"
 #include "network/protocols/connect_to_peer.hpp"
 #include "network/protocols/connect_to_server.hpp"
@@ -258,7 +260,7 @@ STKHost::STKHost(const irr::core::stringw &server_name)
 
     ENetAddress addr;
     addr.host = STKHost::HOST_ANY;
-    addr.port = 2758;
+    addr.port = NetworkConfig::get()->getServerPort();
 
     m_network= new Network(NetworkConfig::get()->getMaxPlayers(),
                            /*channel_limit*/2,
@@ -291,14 +293,23 @@ void STKHost::init()
 
     pthread_mutex_init(&m_exit_mutex, NULL);
 
-    // Start with initialising ENet
-    // ============================
-    if (enet_initialize() != 0)
+    // Start with initialising ENet, which allocates packets from the pool
+    // ===================================================================
+    if (BufferPool::initialiseENet() != 0)
     {
         Log::error("STKHost", "Could not initialize enet.");
         return;
     }
 
+    // Create the stats before any thread can access them. Each lobby of
+    // a LobbyPool writes its own stats file.
+    NetworkStats *stats = NetworkStats::get();
+    unsigned int lobby_id = NetworkConfig::get()->getLobbyId();
+    if (lobby_id > 0 && !stats->getFileName().empty())
+    {
+        stats->setFileName(stats->getFileName() + "."
+                           + StringUtils::toString(lobby_id));
+    }
     Log::info("STKHost", "Host initialized.");
     Network::openLog();  // Open packet log file
     ProtocolManager::getInstance<ProtocolManager>();
@@ -511,7 +522,8 @@ void* STKHost::mainLoop(void* self)
     if(NetworkConfig::get()->isServer() && 
         NetworkConfig::get()->isLAN()      )
     {
-        TransportAddress address(0, 2757);
+        TransportAddress address(0,
+                             NetworkConfig::get()->getServerDiscoveryPort());
         ENetAddress eaddr = address.toEnetAddress();
         myself->m_lan_network = new Network(1, 1, 0, 0, &eaddr);
     }
@@ -543,6 +555,10 @@ void* STKHost::mainLoop(void* self)
             }   // EVENT_TYPE_CONNECTED
             else if (stk_event->getType() == EVENT_TYPE_MESSAGE)
             {
+                const NetworkString &data = stk_event->data();
+                peer->getStats().m_in.add(data.getTotalSize());
+                NetworkStats::get()->addReceived(data.getProtocolType(),
+                                                 data.getTotalSize());
                 Network::logPacket(stk_event->data(), true);
                 TransportAddress stk_addr(peer->getAddress());
                 Log::verbose("NetworkManager",
@@ -556,6 +572,10 @@ void* STKHost::mainLoop(void* self)
             ProtocolManager::getInstance()->propagateEvent(stk_event);
             
         }   // while enet_host_service
+
+        for (unsigned int i = 0; i < myself->m_peers.size(); i++)
+            myself->m_peers[i]->updateStats();
+        NetworkStats::get()->update(myself->m_peers);
     }   // while !mustStopListening
 
     free(myself->m_listening_thread);
@@ -71,8 +71,35 @@ void STKPeer::sendPacket(NetworkString *data, bool reliable)
                                     (reliable ? ENET_PACKET_FLAG_RELIABLE
                                               : ENET_PACKET_FLAG_UNSEQUENCED));
     enet_peer_send(m_enet_peer, 0, packet);
+    m_stats.m_out.add(data->getTotalSize());
+    NetworkStats::get()->addSent(data->getProtocolType(),
+                                 data->getTotalSize());
 }   // sendPacket
 
+//-----------------------------------------------------------------------------
+/** Samples the ENet values of this peer for the stats: the round trip time,
+ *  the number of packets queued or not yet acknowledged, and the number of
+ *  resent reliable packets. ENet only counts the latter in a counter that
+ *  is reset every few seconds, so the increase since the last sample is
+ *  added up. Must be called from the STKHost thread, since ENet is not
+ *  thread safe.
+ */
+void STKPeer::updateStats()
+{
+    uint32_t lost = m_enet_peer->packetsLost;
+    m_stats.m_resends.fetch_add(lost >= m_stats.m_last_packets_lost
+                                ? lost - m_stats.m_last_packets_lost : lost,
+                                std::memory_order_relaxed);
+    m_stats.m_last_packets_lost = lost;
+    m_stats.m_queue_depth.store(
+        (uint32_t)(enet_list_size(&m_enet_peer->outgoingReliableCommands)
+                 + enet_list_size(&m_enet_peer->outgoingUnreliableCommands)
+                 + enet_list_size(&m_enet_peer->sentReliableCommands)),
+        std::memory_order_relaxed);
+    m_stats.m_rtt.store(m_enet_peer->roundTripTime,
+                        std::memory_order_relaxed);
+}   // updateStats
+
 //-----------------------------------------------------------------------------
 /** Returns the IP address (in host format) of this client.
  */
@@ -23,6 +23,7 @@
 #ifndef STK_PEER_HPP
 #define STK_PEER_HPP
 
+#include "network/network_stats.hpp"
 #include "utils/no_copy.hpp"
 #include "utils/types.hpp"
 
@@ -55,6 +56,9 @@ protected:
 
     /** True if this peer is authorised to control a server. */
     bool m_is_authorised;
+
+    /** Traffic and ENet counters of this peer. */
+    NetworkStats::Peer m_stats;
 public:
              STKPeer(ENetPeer *enet_peer);
     virtual ~STKPeer();
@@ -68,6 +72,7 @@ public:
     uint16_t getPort() const;
     bool isSamePeer(const STKPeer* peer) const;
     bool isSamePeer(const ENetPeer* peer) const;
+    void updateStats();
     std::vector<NetworkPlayerProfile*> getAllPlayerProfiles();
     // ------------------------------------------------------------------------
     /** Sets the token for this client. */
@@ -100,6 +105,12 @@ public:
      *  peer) to see if this client is allowed certain command (i.e. to
      *  display additional GUI elements). */
     bool isAuthorised() const { return m_is_authorised; }
+    // ------------------------------------------------------------------------
+    /** Returns the counters of this peer. */
+    NetworkStats::Peer& getStats() { return m_stats; }
+    // ------------------------------------------------------------------------
+    /** Returns the counters of this peer. */
+    const NetworkStats::Peer& getStats() const { return m_stats; }
 };   // STKPeer
 
 #endif // STK_PEER_HPP
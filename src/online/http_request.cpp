@@ -93,6 +93,8 @@ namespace Online
         m_filename      = "";
         m_parameters    = "";
         m_curl_code     = CURLE_OK;
+        m_curl_session  = NULL;
+        m_file          = NULL;
         m_progress.setAtomic(0);
     }   // init
 
@@ -196,26 +198,42 @@ namespace Online
     }   // prepareOperation
 
     // ------------------------------------------------------------------------
-    /** The actual curl download happens here.
+    /** The actual curl download happens here. This is only used when the
+     *  request is executed directly (executeNow()), the RequestManager
+     *  runs the transfer set up by startOperation() itself.
      */
     void HTTPRequest::operation()
     {
-        if (!m_curl_session)
+        CURL *handle = HTTPRequest::startOperation();
+        if (!handle)
             return;
 
-        FILE *fout = NULL;
+        finishOperation(curl_easy_perform(handle));
+    }   // operation
+
+    // ------------------------------------------------------------------------
+    /** Sets up the curl download, but does not execute it.
+     *  \return The curl handle to execute, or NULL if the download can not
+     *          be started.
+     */
+    CURL* HTTPRequest::startOperation()
+    {
+        if (!m_curl_session)
+            return NULL;
+
+        m_file = NULL;
         if (m_filename.size() > 0)
         {
-            fout = fopen((m_filename+".part").c_str(), "wb");
+            m_file = fopen((m_filename+".part").c_str(), "wb");
 
-            if (!fout)
+            if (!m_file)
             {
                 Log::error("HTTPRequest",
                            "Can't open '%s' for writing, ignored.",
                            (m_filename+".part").c_str());
-                return;
+                return NULL;
             }
-            curl_easy_setopt(m_curl_session,  CURLOPT_WRITEDATA,     fout  );
+            curl_easy_setopt(m_curl_session,  CURLOPT_WRITEDATA,     m_file);
             curl_easy_setopt(m_curl_session,  CURLOPT_WRITEFUNCTION, fwrite);
         }
         else
@@ -280,12 +298,23 @@ namespace Online
             #endif
         curl_easy_setopt(m_curl_session, CURLOPT_USERAGENT, uagent.c_str());
 
-        m_curl_code = curl_easy_perform(m_curl_session);
+        return m_curl_session;
+    }   // startOperation
+
+    // ------------------------------------------------------------------------
+    /** Called once the download is finished. If the data was saved to a
+     *  file, the temporary file is renamed.
+     *  \param code The curl result of the download.
+     */
+    void HTTPRequest::finishOperation(CURLcode code)
+    {
+        m_curl_code = code;
         Request::operation();
 
-        if (fout)
+        if (m_file)
         {
-            fclose(fout);
+            fclose(m_file);
+            m_file = NULL;
             if (m_curl_code == CURLE_OK)
             {
                 if(UserConfigParams::logAddons())
@@ -311,8 +340,8 @@ namespace Online
                     m_curl_code = CURLE_WRITE_ERROR;
                 }
             }   // m_curl_code ==CURLE_OK
-        }   // if fout
-    }   // operation
+        }   // if m_file
+    }   // finishOperation
 
     // ------------------------------------------------------------------------
     /** Cleanup once the download is finished. The value of progress is
@@ -328,6 +357,7 @@ namespace Online
 
         Request::afterOperation();
         curl_easy_cleanup(m_curl_session);
+        m_curl_session = NULL;
     }   // afterOperation
 
     // ------------------------------------------------------------------------
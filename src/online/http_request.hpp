@@ -65,6 +65,10 @@ namespace Online
         /** Pointer to the curl data structure for this request. */
         CURL *m_curl_session;
 
+        /** The file the data is written to while downloading (if
+         *  m_filename is set). */
+        FILE *m_file;
+
         /** curl return code. */
         CURLcode m_curl_code;
 
@@ -75,6 +79,8 @@ namespace Online
         virtual void prepareOperation() OVERRIDE;
         virtual void operation() OVERRIDE;
         virtual void afterOperation() OVERRIDE;
+        virtual CURL* startOperation() OVERRIDE;
+        virtual void finishOperation(CURLcode code) OVERRIDE;
 
         static int progressDownload(void *clientp, double dltotal,
                                     double dlnow,  double ultotal,
@@ -71,6 +71,43 @@ namespace Online
         afterOperation();
     }   // execute
 
+    // ------------------------------------------------------------------------
+    /** Starts executing this request in the RequestManager thread. If the
+     *  request is a transfer that can run concurrently with other requests,
+     *  the curl handle is returned, and finishExecution() must be called
+     *  once the transfer is done. Otherwise the request is executed
+     *  completely (like execute()), and NULL is returned.
+     */
+    CURL* Request::startExecution()
+    {
+        assert(isBusy());
+        // Abort as early as possible if abort is requested
+        if (RequestManager::get()->getAbort() && isAbortable()) return NULL;
+        prepareOperation();
+        if (RequestManager::get()->getAbort() && isAbortable()) return NULL;
+        CURL *handle = startOperation();
+        if (handle) return handle;
+        if (RequestManager::get()->getAbort() && isAbortable()) return NULL;
+        setExecuted();
+        if (RequestManager::get()->getAbort() && isAbortable()) return NULL;
+        afterOperation();
+        return NULL;
+    }   // startExecution
+
+    // ------------------------------------------------------------------------
+    /** Finishes a request whose transfer was started by startExecution().
+     *  \param code The curl result of the transfer.
+     */
+    void Request::finishExecution(CURLcode code)
+    {
+        assert(isBusy());
+        finishOperation(code);
+        if (RequestManager::get()->getAbort() && isAbortable()) return;
+        setExecuted();
+        if (RequestManager::get()->getAbort() && isAbortable()) return;
+        afterOperation();
+    }   // finishExecution
+
     // ------------------------------------------------------------------------
     /** Executes the request now, i.e. in the main thread and without involving
      *  the manager thread.. This calles prepareOperation, operation, and
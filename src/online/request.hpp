@@ -127,6 +127,22 @@ namespace Online
         /** Virtual function to be called after an operation. */
         virtual void afterOperation()   {}
 
+        // --------------------------------------------------------------------
+        /** Called by startExecution() instead of operation(). A request that
+         *  can be executed as a libcurl transfer sets up the transfer and
+         *  returns the curl handle, which the RequestManager will then run
+         *  together with other transfers. The default implementation just
+         *  executes operation() (in the RequestManager thread) and returns
+         *  NULL, so a request that overwrites operation() must also
+         *  overwrite this function. */
+        virtual CURL* startOperation() { operation(); return NULL; }
+
+        // --------------------------------------------------------------------
+        /** Called when the transfer returned by startOperation() is
+         *  finished (or was aborted).
+         *  \param code The curl result of the transfer. */
+        virtual void finishOperation(CURLcode code) {}
+
     public:
         enum RequestType
         {
@@ -138,6 +154,8 @@ namespace Online
         void     execute();
         void     executeNow();
         void     queue();
+        CURL*    startExecution();
+        void     finishExecution(CURLcode code);
 
         // --------------------------------------------------------------------
         /** Executed when a request has finished. */
@@ -22,9 +22,15 @@
 
 #include "config/player_manager.hpp"
 #include "config/user_config.hpp"
+#include "network/buffer_pool.hpp"
+#include "online/http_request.hpp"
 #include "states_screens/state_manager.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 #include "utils/vs.hpp"
 
+#include "enet/enet.h"
+
 #include <iostream>
 #include <stdio.h>
 #include <memory.h>
@@ -73,6 +79,9 @@ namespace Online
         m_game_polling_interval = 60;  // same for game polling
         m_time_since_poll       = m_menu_polling_interval;
         curl_global_init(CURL_GLOBAL_DEFAULT);
+        // Created here, so that addRequest can wake up the thread while it
+        // waits for network activity.
+        m_curl_multi            = curl_multi_init();
         pthread_cond_init(&m_cond_request, NULL);
         m_abort.setAtomic(false);
     }   // RequestManager
@@ -85,6 +94,7 @@ namespace Online
         delete m_thread_id.getData();
         m_thread_id.unlock();
         pthread_cond_destroy(&m_cond_request);
+        curl_multi_cleanup(m_curl_multi);
         curl_global_cleanup();
     }   // ~RequestManager
 
@@ -176,6 +186,10 @@ namespace Online
         // Wake up the network http thread
         pthread_cond_signal(&m_cond_request);
         m_request_queue.unlock();
+#if LIBCURL_VERSION_NUM >= 0x074400
+        // In case that the thread is waiting for running transfers
+        curl_multi_wakeup(m_curl_multi);
+#endif
     }   // addRequest
 
     // ------------------------------------------------------------------------
@@ -191,35 +205,57 @@ namespace Online
 
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
 
-        me->m_current_request = NULL;
+        int max_transfers = UserConfigParams::m_max_http_transfers;
+        if (max_transfers < 1) max_transfers = 1;
+        // Keep (at least) one open connection for each transfer
+        curl_multi_setopt(me->m_curl_multi, CURLMOPT_MAXCONNECTS,
+                          (long)max_transfers);
+
         me->m_request_queue.lock();
-        while (me->m_request_queue.getData().empty() ||
-               me->m_request_queue.getData().top()->getType() != Request::RT_QUIT)
+        while (true)
         {
-            bool empty = me->m_request_queue.getData().empty();
+            std::priority_queue<Online::Request*,
+                                std::vector<Online::Request*>,
+                                Online::Request::Compare > &queue =
+                me->m_request_queue.getData();
 
             // Wait in cond_wait for a request to arrive. The 'while' is necessary
             // since "spurious wakeups from the pthread_cond_wait ... may occur"
             // (pthread_cond_wait man page)!
-            while (empty)
+            while (queue.empty() && me->m_active_requests.empty())
             {
                 pthread_cond_wait(&me->m_cond_request, me->m_request_queue.getMutex());
-                empty = me->m_request_queue.getData().empty();
             }
-            me->m_current_request = me->m_request_queue.getData().top();
-            me->m_request_queue.getData().pop();
 
-            if (me->m_current_request->getType() == Request::RT_QUIT)
+            // Start the queued requests in order of priority, as long as
+            // the number of concurrent transfers allows it.
+            bool quit = false;
+            while (!queue.empty() &&
+                   (int)me->m_active_requests.size() < max_transfers)
             {
-                delete me->m_current_request;
+                Online::Request *request = queue.top();
+                if (request->getType() == Request::RT_QUIT)
+                {
+                    // Only quit once all running transfers are finished
+                    // (which includes a sign-out request).
+                    quit = me->m_active_requests.empty();
+                    break;
+                }
+                queue.pop();
+                me->m_request_queue.unlock();
+                me->startRequest(request);
+                me->m_request_queue.lock();
+            }
+
+            if (quit)
+            {
+                delete queue.top();
+                queue.pop();
                 break;
             }
 
             me->m_request_queue.unlock();
-            me->m_current_request->execute();
-            // This test is necessary in case that execute() was aborted
-            // (otherwise the assert in addResult will be triggered).
-            if (!me->getAbort()) me->addResult(me->m_current_request);
+            me->handleTransfers();
             me->m_request_queue.lock();
         } // while handle all requests
 
@@ -244,6 +280,86 @@ namespace Online
         return 0;
     }   // mainLoop
 
+    // ------------------------------------------------------------------------
+    /** Starts executing a request. If the request is a http transfer, it is
+     *  added to the curl multi handle, otherwise it is executed immediately.
+     *  \param request The request to start.
+     */
+    void RequestManager::startRequest(Online::Request *request)
+    {
+        CURL *handle = request->startExecution();
+        if (handle)
+        {
+            CURLMcode code = curl_multi_add_handle(m_curl_multi, handle);
+            if (code == CURLM_OK)
+            {
+                m_active_requests[handle] = request;
+                return;
+            }
+            Log::error("HTTP Manager", "Could not start transfer: %s.",
+                       curl_multi_strerror(code));
+            request->finishExecution(CURLE_FAILED_INIT);
+        }
+
+        // This test is necessary in case that execute() was aborted
+        // (otherwise the assert in addResult will be triggered).
+        if (!getAbort()) addResult(request);
+    }   // startRequest
+
+    // ------------------------------------------------------------------------
+    /** Lets libcurl work on all active transfers, and finishes all requests
+     *  whose transfers are done. This waits at most 50 ms for network
+     *  activity. A newly queued request interrupts the wait (with libcurl
+     *  7.68 or later), so that it is started immediately.
+     */
+    void RequestManager::handleTransfers()
+    {
+        if (m_active_requests.empty()) return;
+
+        int running = 0;
+        curl_multi_perform(m_curl_multi, &running);
+
+        int num_messages = 0;
+        CURLMsg *message;
+        while ((message = curl_multi_info_read(m_curl_multi, &num_messages)))
+        {
+            if (message->msg != CURLMSG_DONE) continue;
+
+            // The message is invalid once the handle is removed
+            CURL *handle  = message->easy_handle;
+            CURLcode code = message->data.result;
+            curl_multi_remove_handle(m_curl_multi, handle);
+
+            std::map<CURL*, Online::Request*>::iterator i =
+                m_active_requests.find(handle);
+            assert(i != m_active_requests.end());
+            Online::Request *request = i->second;
+            m_active_requests.erase(i);
+
+            request->finishExecution(code);
+            if (!getAbort()) addResult(request);
+        }
+
+        if (m_active_requests.empty()) return;
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+        // Unlike curl_multi_wait this also waits if curl has no socket to
+        // wait on, e.g. while resolving a host name.
+        curl_multi_poll(m_curl_multi, NULL, 0, 50, NULL);
+#else
+        // Don't wait longer than curl needs to handle its timeouts
+        long timeout = 50;
+        curl_multi_timeout(m_curl_multi, &timeout);
+        if (timeout < 0 || timeout > 50) timeout = 50;
+        int num_fds = 0;
+        curl_multi_wait(m_curl_multi, NULL, 0, (int)timeout, &num_fds);
+        // If curl has nothing to wait on curl_multi_wait returns
+        // immediately, so avoid busy waiting.
+        if (num_fds == 0 && timeout > 0)
+            StkTime::sleep((int)timeout);
+#endif
+    }   // handleTransfers
+
     // ------------------------------------------------------------------------
     /** Inserts a request into the queue of results.
      *  \param request The pointer to the request to insert.
@@ -312,4 +428,233 @@ namespace Online
         }
 
     }   // update
+
+    // ========================================================================
+    namespace
+    {
+        /** A minimal HTTP/1.1 keep-alive server on loopback for the unit
+         *  test. A real server is further away than loopback, so it waits
+         *  30 ms for each new connection (a stand-in for the TCP and TLS
+         *  handshakes) and 5 ms for each request. */
+        class TestServer
+        {
+        public:
+            ENetSocket         m_socket;
+            int                m_port;
+            Synchronised<bool> m_stop;
+            /** Number of connections accepted so far. */
+            Synchronised<int>  m_num_connections;
+            /** Number of connections which are still open. */
+            Synchronised<int>  m_num_open;
+            // ----------------------------------------------------------------
+            TestServer() : m_stop(false), m_num_connections(0), m_num_open(0)
+            {
+                m_port   = 0;
+                m_socket = enet_socket_create(ENET_SOCKET_TYPE_STREAM);
+                if (m_socket == ENET_SOCKET_NULL) return;
+                enet_socket_set_option(m_socket, ENET_SOCKOPT_REUSEADDR, 1);
+                ENetAddress address;
+                enet_address_set_host(&address, "127.0.0.1");
+                for (address.port = 33020; address.port < 33040;
+                     address.port++)
+                {
+                    if (enet_socket_bind(m_socket, &address) == 0 &&
+                        enet_socket_listen(m_socket, 16) == 0)
+                    {
+                        m_port = address.port;
+                        return;
+                    }
+                }
+            }   // TestServer
+            // ----------------------------------------------------------------
+            ~TestServer()
+            {
+                if (m_socket != ENET_SOCKET_NULL)
+                    enet_socket_destroy(m_socket);
+            }   // ~TestServer
+            // ----------------------------------------------------------------
+            /** Answers all requests on one connection. */
+            static void *serveConnection(void *obj)
+            {
+                std::pair<TestServer*, ENetSocket> *data =
+                    (std::pair<TestServer*, ENetSocket>*)obj;
+                TestServer *server = data->first;
+                ENetSocket socket  = data->second;
+                delete data;
+
+                StkTime::sleep(30);
+                std::string body(8192, 'x');
+                std::string header = "HTTP/1.1 200 OK\r\nContent-Length: "
+                                   + StringUtils::toString(body.size())
+                                   + "\r\n\r\n";
+                std::string request;
+                char buffer[1024];
+                while (!server->m_stop.getAtomic())
+                {
+                    enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+                    if (enet_socket_wait(socket, &condition, 20) != 0)
+                        break;
+                    if (condition == ENET_SOCKET_WAIT_NONE)
+                        continue;
+                    ENetBuffer in;
+                    in.data       = buffer;
+                    in.dataLength = sizeof(buffer);
+                    int n = enet_socket_receive(socket, NULL, &in, 1);
+                    // 0 means that the client closed the connection
+                    if (n <= 0)
+                        break;
+                    request.append(buffer, n);
+                    size_t end = request.find("\r\n\r\n");
+                    for (; end != std::string::npos;
+                         end = request.find("\r\n\r\n"))
+                    {
+                        request.erase(0, end + 4);
+                        StkTime::sleep(5);
+                        ENetBuffer out[2];
+                        out[0].data       = (void*)header.c_str();
+                        out[0].dataLength = header.size();
+                        out[1].data       = (void*)body.c_str();
+                        out[1].dataLength = body.size();
+                        enet_socket_send(socket, NULL, out, 2);
+                    }
+                }
+                enet_socket_destroy(socket);
+                server->m_num_open.lock();
+                server->m_num_open.getData()--;
+                server->m_num_open.unlock();
+                return NULL;
+            }   // serveConnection
+            // ----------------------------------------------------------------
+            /** Accepts connections until m_stop is set. */
+            static void *acceptLoop(void *obj)
+            {
+                TestServer *server = (TestServer*)obj;
+                while (!server->m_stop.getAtomic())
+                {
+                    ENetSocket listen     = server->m_socket;
+                    enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+                    if (enet_socket_wait(listen, &condition, 20) != 0)
+                        break;
+                    if (condition == ENET_SOCKET_WAIT_NONE)
+                        continue;
+                    ENetSocket socket = enet_socket_accept(listen, NULL);
+                    if (socket == ENET_SOCKET_NULL)
+                        continue;
+                    server->m_num_connections.lock();
+                    server->m_num_connections.getData()++;
+                    server->m_num_connections.unlock();
+                    server->m_num_open.lock();
+                    server->m_num_open.getData()++;
+                    server->m_num_open.unlock();
+                    pthread_t thread;
+                    void *data = new std::pair<TestServer*, ENetSocket>(server,
+                                                                        socket);
+                    if (pthread_create(&thread, NULL, &serveConnection, data))
+                    {
+                        delete (std::pair<TestServer*, ENetSocket>*)data;
+                        enet_socket_destroy(socket);
+                        server->m_num_open.lock();
+                        server->m_num_open.getData()--;
+                        server->m_num_open.unlock();
+                        continue;
+                    }
+                    pthread_detach(thread);
+                }
+                return NULL;
+            }   // acceptLoop
+        };   // TestServer
+
+        // --------------------------------------------------------------------
+        /** A request which counts its successful results. */
+        class TestRequest : public HTTPRequest
+        {
+        public:
+            static int m_num_done, m_num_ok;
+            TestRequest(bool manage_memory) : HTTPRequest(manage_memory) {}
+            virtual void callback() OVERRIDE
+            {
+                m_num_done++;
+                if (!hadDownloadError() && getData().size() == 8192)
+                    m_num_ok++;
+            }   // callback
+        };   // TestRequest
+        int TestRequest::m_num_done = 0;
+        int TestRequest::m_num_ok   = 0;
+    }   // namespace
+
+    // ------------------------------------------------------------------------
+    /** Downloads files from a local test server, once one after the other
+     *  with executeNow() (each with its own connection), and once queued,
+     *  so that they are executed concurrently on the multi handle, and
+     *  compares the time and the number of connections used.
+     *  \pre The RequestManager thread is running.
+     */
+    void RequestManager::unitTesting()
+    {
+        if (BufferPool::initialiseENet() != 0)
+        {
+            Log::warn("RequestManager", "Could not initialise ENet, no test.");
+            return;
+        }
+        TestServer *server = new TestServer();
+        pthread_t accept_thread;
+        if (server->m_port == 0 ||
+            pthread_create(&accept_thread, NULL, &TestServer::acceptLoop,
+                           server))
+        {
+            Log::warn("RequestManager", "Could not start server, no test.");
+            delete server;
+            return;
+        }
+        int saved_internet_status = UserConfigParams::m_internet_status;
+        UserConfigParams::m_internet_status = IPERM_ALLOWED;
+        const int NUM_REQUESTS = 50;
+        std::string url = StringUtils::insertValues("http://127.0.0.1:%d/",
+                                                    server->m_port);
+
+        double start = StkTime::getRealTime();
+        for (int i = 0; i < NUM_REQUESTS; i++)
+        {
+            TestRequest request(false);
+            request.setURL(url + StringUtils::toString(i));
+            request.executeNow();
+        }
+        double sequential_time = StkTime::getRealTime() - start;
+        int sequential_connections = server->m_num_connections.getAtomic();
+        assert(TestRequest::m_num_ok == NUM_REQUESTS);
+
+        TestRequest::m_num_done = TestRequest::m_num_ok = 0;
+        start = StkTime::getRealTime();
+        for (int i = 0; i < NUM_REQUESTS; i++)
+        {
+            TestRequest *request = new TestRequest(true);
+            request->setURL(url + StringUtils::toString(i));
+            request->queue();
+        }
+        while (TestRequest::m_num_done < NUM_REQUESTS &&
+               StkTime::getRealTime() - start < 30.0)
+        {
+            get()->update(0);
+            StkTime::sleep(1);
+        }
+        double queued_time = StkTime::getRealTime() - start;
+        int queued_connections = server->m_num_connections.getAtomic()
+                               - sequential_connections;
+        assert(TestRequest::m_num_ok == NUM_REQUESTS);
+        // All connections are reused
+        assert(queued_connections <=
+               std::max(1, (int)UserConfigParams::m_max_http_transfers));
+
+        UserConfigParams::m_internet_status = saved_internet_status;
+        server->m_stop.setAtomic(true);
+        pthread_join(accept_thread, NULL);
+        while (server->m_num_open.getAtomic() > 0)
+            StkTime::sleep(1);
+        delete server;
+        Log::info("RequestManager", "%d requests: %.2f s with %d connections "
+                  "one after the other, %.2f s with %d connections queued "
+                  "(max_http_transfers %d).", NUM_REQUESTS, sequential_time,
+                  sequential_connections, queued_time, queued_connections,
+                  (int)UserConfigParams::m_max_http_transfers);
+    }   // unitTesting
 } // namespace Online
@@ -36,6 +36,7 @@
 #endif
 
 #include <curl/curl.h>
+#include <map>
 #include <queue>
 #include <pthread.h>
 
@@ -46,6 +47,13 @@ namespace Online
      *  receive an answer (e.g. to sign in; or to download an addon). The
      *  requests are sorted by priority (e.g. sign in and out have higher
      *  priority than downloading addon icons).
+     *  Http requests are executed as libcurl transfers of one curl multi
+     *  handle, so that several transfers (up to a configurable limit) can
+     *  run at the same time, and connections to the same server are kept
+     *  alive and reused by later requests. Requests are still started in
+     *  order of priority. A request is cancelled cooperatively: its progress
+     *  callback tells libcurl to abort the transfer, and the request is
+     *  then finished as usual.
      *  A request is created and initialised from the main thread. When it
      *  is moved into the request queue, it must not be handled by the main
      *  thread anymore, only the RequestManager thread can handle it.
@@ -94,8 +102,15 @@ namespace Online
             /** Time passed since the last poll request. */
             float                     m_time_since_poll;
 
-            /** The current requested being worked on. */
-            Online::Request *         m_current_request;
+            /** The curl multi handle executing all http transfers. It also
+             *  caches open connections for reuse. Apart from the wake up in
+             *  addRequest, only accessed by the RequestManager thread. */
+            CURLM *                   m_curl_multi;
+
+            /** The requests whose transfers are currently running, indexed
+             *  by their curl handle. Only accessed by the RequestManager
+             *  thread. */
+            std::map<CURL*, Online::Request*> m_active_requests;
 
             /** A conditional variable to wake up the main loop. */
             pthread_cond_t            m_cond_request;
@@ -128,6 +143,8 @@ namespace Online
 
             void addResult(Online::Request *request);
             void handleResultQueue();
+            void startRequest(Online::Request *request);
+            void handleTransfers();
 
             static void *mainLoop(void *obj);
 
@@ -161,6 +178,7 @@ namespace Online
 
             bool getAbort() { return m_abort.getAtomic(); }
             void update(float dt);
+            static void unitTesting();
 
             // ----------------------------------------------------------------
             /** Sets the interval with which poll requests are send to the
@@ -371,6 +371,74 @@ void btKart::updateAllWheelPositions()
 
 }   // updateAllWheelPositions
 
+// ----------------------------------------------------------------------------
+/** Saves the state of the vehicle (but not of the chassis body).
+ *  \param state On return contains the state.
+ */
+void btKart::saveState(State *state) const
+{
+    // btWheelInfo has no default constructor, which is needed to copy
+    // a btAlignedObjectArray
+    state->m_wheel_info.clear();
+    for (int i = 0; i < m_wheelInfo.size(); i++)
+        state->m_wheel_info.push_back(m_wheelInfo[i]);
+    state->m_zipper_active            = m_zipper_active;
+    state->m_zipper_velocity          = m_zipper_velocity;
+    state->m_skid_angular_velocity    = m_skid_angular_velocity;
+    state->m_is_skidding              = m_is_skidding;
+    state->m_allow_sliding            = m_allow_sliding;
+    state->m_additional_impulse       = m_additional_impulse;
+    state->m_time_additional_impulse  = m_time_additional_impulse;
+    state->m_additional_rotation      = m_additional_rotation;
+    state->m_time_additional_rotation = m_time_additional_rotation;
+    state->m_num_wheels_on_ground     = m_num_wheels_on_ground;
+    state->m_visual_rotation          = m_visual_rotation;
+}   // saveState
+
+// ----------------------------------------------------------------------------
+/** Restores a state saved with saveState.
+ *  \param state The state to restore.
+ */
+void btKart::restoreState(const State &state)
+{
+    assert((int)state.m_wheel_info.size() == m_wheelInfo.size());
+    for (int i = 0; i < m_wheelInfo.size(); i++)
+        m_wheelInfo[i] = state.m_wheel_info[i];
+    m_zipper_active            = state.m_zipper_active;
+    m_zipper_velocity          = state.m_zipper_velocity;
+    m_skid_angular_velocity    = state.m_skid_angular_velocity;
+    m_is_skidding              = state.m_is_skidding;
+    m_allow_sliding            = state.m_allow_sliding;
+    m_additional_impulse       = state.m_additional_impulse;
+    m_time_additional_impulse  = state.m_time_additional_impulse;
+    m_additional_rotation      = state.m_additional_rotation;
+    m_time_additional_rotation = state.m_time_additional_rotation;
+    m_num_wheels_on_ground     = state.m_num_wheels_on_ground;
+    m_visual_rotation          = state.m_visual_rotation;
+}   // restoreState
+
+// ----------------------------------------------------------------------------
+/** Simulates only this vehicle for one time step, using the current engine
+ *  force, brake and steering of the wheels. This does the same as one sub
+ *  step of the dynamics world for the chassis body, except that no
+ *  collisions of the chassis are handled (the wheels still use the
+ *  raycaster). It is used to re-simulate a kart after its state was
+ *  corrected, without changing any other object in the world.
+ *  \param step Time step size, should not be bigger than the fixed time
+ *         step of the physics.
+ */
+void btKart::simulate(btScalar step)
+{
+    m_chassisBody->applyGravity();
+    m_chassisBody->integrateVelocities(step);
+    m_chassisBody->applyDamping(step);
+    btTransform predicted;
+    m_chassisBody->predictIntegratedTransform(step, predicted);
+    m_chassisBody->proceedToTransform(predicted);
+    updateVehicle(step);
+    m_chassisBody->clearForces();
+}   // simulate
+
 // ----------------------------------------------------------------------------
 void btKart::updateVehicle( btScalar step )
 {
@@ -19,6 +19,8 @@ class btDynamicsWorld;
 #include "BulletDynamics/Vehicle/btWheelInfo.h"
 #include "BulletDynamics/Dynamics/btActionInterface.h"
 
+#include <vector>
+
 class btVehicleTuning;
 class Kart;
 struct btWheelContactPoint;
@@ -52,6 +54,25 @@ public:
 
     };   // class btVehicleTuning
 
+    /** The state of the vehicle which is not stored in the chassis body,
+     *  so that it can be saved and restored (e.g. to re-simulate a kart
+     *  after a correction from the server). */
+    struct State
+    {
+        std::vector<btWheelInfo> m_wheel_info;
+        bool      m_zipper_active;
+        btScalar  m_zipper_velocity;
+        btScalar  m_skid_angular_velocity;
+        bool      m_is_skidding;
+        bool      m_allow_sliding;
+        btVector3 m_additional_impulse;
+        float     m_time_additional_impulse;
+        btVector3 m_additional_rotation;
+        float     m_time_additional_rotation;
+        int       m_num_wheels_on_ground;
+        float     m_visual_rotation;
+    };   // State
+
 private:
 
     btAlignedObjectArray<btVector3> m_forwardWS;
@@ -181,6 +202,9 @@ public:
     void               instantSpeedIncreaseTo(float speed);
     void               capSpeed(float max_speed);
     void               updateAllWheelPositions();
+    void               saveState(State *state) const;
+    void               restoreState(const State &state);
+    void               simulate(btScalar step);
     // ------------------------------------------------------------------------
     /** Returns true if both rear visual wheels touch the ground. */
     bool visualWheelsTouchGround() const
@@ -31,6 +31,7 @@ using namespace irr;
 #include "modes/world.hpp"
 #include "physics/physics.hpp"
 #include "physics/triangle_mesh.hpp"
+#include "scriptengine/script_engine.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/constants.hpp"
@@ -160,6 +161,8 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
     m_reset_height       = settings.m_reset_height;
     m_on_kart_collision  = settings.m_on_kart_collision;
     m_on_item_collision  = settings.m_on_item_collision;
+    m_on_kart_collision_function = NULL;
+    m_on_item_collision_function = NULL;
     m_body_added = false;
 
     m_init_pos.setIdentity();
@@ -172,6 +175,7 @@ PhysicalObject::PhysicalObject(bool is_dynamic,
     m_init_pos.setOrigin(init_xyz);
 
     m_is_dynamic = is_dynamic;
+    m_is_sleeping = false;
 
     init(settings);
 }   // PhysicalObject
@@ -212,6 +216,7 @@ void PhysicalObject::move(const Vec3& xyz, const core::vector3df& hpr)
 
     btTransform trans(q, xyz-quatRotate(q,m_graphical_offset));
     m_motion_state->setWorldTransform(trans);
+    m_is_sleeping = false;
 }   // move
 
 // ----------------------------------------------------------------------------
@@ -550,6 +555,18 @@ void PhysicalObject::update(float dt)
 {
     if (!m_is_dynamic) return;
 
+    // A body deactivated by bullet does not move, so once the graphical
+    // position has been updated for its final transform nothing needs to
+    // be done until it is activated again (by a collision, an explosion
+    // or a reset).
+    if (!m_body->isActive())
+    {
+        if (m_is_sleeping) return;
+        m_is_sleeping = true;
+    }
+    else
+        m_is_sleeping = false;
+
     btTransform t;
     m_motion_state->getWorldTransform(t);
 
@@ -603,6 +620,27 @@ bool PhysicalObject::castRay(const btVector3 &from, const btVector3 &to,
     return result;
 }   // castRay
 
+// ----------------------------------------------------------------------------
+/** Looks up the script functions called on collisions, so that they are not
+ *  looked up on each collision. Called once the scripts of the track are
+ *  compiled.
+ */
+void PhysicalObject::initScriptFunctions()
+{
+    Scripting::ScriptEngine *script_engine =
+        World::getWorld()->getScriptEngine();
+    if (!m_on_kart_collision.empty())
+    {
+        m_on_kart_collision_function = script_engine->getFunction(true,
+            "void " + m_on_kart_collision + "(int, const string, const string)");
+    }
+    if (!m_on_item_collision.empty())
+    {
+        m_on_item_collision_function = script_engine->getFunction(true,
+            "void " + m_on_item_collision + "(int, int, const string)");
+    }
+}   // initScriptFunctions
+
 // ----------------------------------------------------------------------------
 void PhysicalObject::reset()
 {
@@ -610,6 +648,7 @@ void PhysicalObject::reset()
     m_body->setAngularVelocity(btVector3(0,0,0));
     m_body->setLinearVelocity(btVector3(0,0,0));
     m_body->activate();
+    m_is_sleeping = false;
 }   // reset
 
 // ----------------------------------------------------------------------------
@@ -28,6 +28,7 @@
 #include "utils/leak_check.hpp"
 
 
+class asIScriptFunction;
 class Material;
 class TrackObject;
 class XMLNode;
@@ -173,11 +174,20 @@ private:
     * when a (flyable) item collides with this object
     */
     std::string           m_on_item_collision;
+    /** The script functions for m_on_kart_collision and m_on_item_collision,
+     *  or NULL. They are looked up once the scripts are compiled. */
+    asIScriptFunction    *m_on_kart_collision_function;
+    asIScriptFunction    *m_on_item_collision_function;
     /** If this body is a bullet dynamic body, i.e. affected by physics
      *  or not (static (not moving) or kinematic (animated outside
      *  of physics). */
     bool                  m_is_dynamic;
 
+    /** True if the body was already deactivated by bullet in the last
+     *  update, i.e. the graphical position is up to date and the body
+     *  will not move until it is activated again. */
+    bool                  m_is_sleeping;
+
     /** Non-null only if the shape is exact */
     TriangleMesh         *m_triangle_mesh;
 
@@ -196,6 +206,10 @@ public:
     void         move           (const Vec3& xyz, const core::vector3df& hpr);
     void         hit            (const Material *m, const Vec3 &normal);
     bool         isSoccerBall   () const;
+    // ------------------------------------------------------------------------
+    /** Returns true if this object is moved by the physics. */
+    bool         isDynamic      () const { return m_is_dynamic; }
+    // ------------------------------------------------------------------------
     bool castRay(const btVector3 &from,
                  const btVector3 &to, btVector3 *hit_point,
                  const Material **material, btVector3 *normal,
@@ -228,9 +242,21 @@ public:
     // ------------------------------------------------------------------------
     float getRadius() const { return m_radius; }
     // ------------------------------------------------------------------------
-    const std::string& getOnKartCollisionFunction() const { return m_on_kart_collision; }
+    void initScriptFunctions();
     // ------------------------------------------------------------------------
-    const std::string& getOnItemCollisionFunction() const { return m_on_item_collision; }
+    /** Returns the script function to call if a kart hits this object, or
+     *  NULL. */
+    asIScriptFunction* getOnKartCollisionScript() const
+    {
+        return m_on_kart_collision_function;
+    }   // getOnKartCollisionScript
+    // ------------------------------------------------------------------------
+    /** Returns the script function to call if an item hits this object, or
+     *  NULL. */
+    asIScriptFunction* getOnItemCollisionScript() const
+    {
+        return m_on_item_collision_function;
+    }   // getOnItemCollisionScript
     // ------------------------------------------------------------------------
     TrackObject* getTrackObject() { return m_object; }
 
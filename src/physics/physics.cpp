@@ -51,6 +51,7 @@ Physics::Physics() : btSequentialImpulseConstraintSolver()
 {
     m_collision_conf      = new btDefaultCollisionConfiguration();
     m_dispatcher          = new btCollisionDispatcher(m_collision_conf);
+    m_kart_kart_collision_function = NULL;
 }   // Physics
 
 //-----------------------------------------------------------------------------
@@ -75,6 +76,17 @@ void Physics::init(const Vec3 &world_min, const Vec3 &world_max)
     m_dynamics_world->setDebugDrawer(m_debug_drawer);
 }   // init
 
+//-----------------------------------------------------------------------------
+/** Looks up the script functions called by the physics, so that they are
+ *  not looked up on each collision. Called once the scripts of the track
+ *  are compiled.
+ */
+void Physics::initScriptFunctions()
+{
+    m_kart_kart_collision_function = World::getWorld()->getScriptEngine()
+        ->getFunction(false, "void onKartKartCollision(int, int)");
+}   // initScriptFunctions
+
 //-----------------------------------------------------------------------------
 Physics::~Physics()
 {
@@ -169,14 +181,17 @@ void Physics::update(float dt)
                               p->getContactPointCS(0),
                               p->getUserPointer(1)->getPointerKart(),
                               p->getContactPointCS(1)                );
-            Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
-            int kartid1 = p->getUserPointer(0)->getPointerKart()->getWorldKartId();
-            int kartid2 = p->getUserPointer(1)->getPointerKart()->getWorldKartId();
-            script_engine->runFunction(false, "void onKartKartCollision(int, int)",
-                [=](asIScriptContext* ctx) {
-                    ctx->SetArgDWord(0, kartid1);
-                    ctx->SetArgDWord(1, kartid2);
-                });
+            if (m_kart_kart_collision_function)
+            {
+                Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
+                int kartid1 = p->getUserPointer(0)->getPointerKart()->getWorldKartId();
+                int kartid2 = p->getUserPointer(1)->getPointerKart()->getWorldKartId();
+                script_engine->runFunction(m_kart_kart_collision_function,
+                    [=](asIScriptContext* ctx) {
+                        ctx->SetArgDWord(0, kartid1);
+                        ctx->SetArgDWord(1, kartid2);
+                    }, nullptr);
+            }
             continue;
         }  // if kart-kart collision
 
@@ -189,7 +204,8 @@ void Physics::update(float dt)
             int kartId = kart->getWorldKartId();
             PhysicalObject* obj = p->getUserPointer(0)->getPointerPhysicalObject();
             std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnKartCollisionFunction();
+            asIScriptFunction *scripting_function =
+                                           obj->getOnKartCollisionScript();
 
             TrackObject* to = obj->getTrackObject();
             TrackObject* library = to->getParentLibrary();
@@ -199,14 +215,14 @@ void Physics::update(float dt)
                 lib_id = library->getID();
             lib_id_ptr = &lib_id;
 
-            if (scripting_function.size() > 0)
+            if (scripting_function)
             {
-                script_engine->runFunction(true, "void " + scripting_function + "(int, const string, const string)",
+                script_engine->runFunction(scripting_function,
                     [&](asIScriptContext* ctx) {
                         ctx->SetArgDWord(0, kartId);
                         ctx->SetArgObject(1, lib_id_ptr);
                         ctx->SetArgObject(2, &obj_id);
-                    });
+                    }, nullptr);
             }
             if (obj->isCrashReset())
             {
@@ -271,15 +287,16 @@ void Physics::update(float dt)
             Flyable* flyable = p->getUserPointer(0)->getPointerFlyable();
             PhysicalObject* obj = p->getUserPointer(1)->getPointerPhysicalObject();
             std::string obj_id = obj->getID();
-            std::string scripting_function = obj->getOnItemCollisionFunction();
-            if (scripting_function.size() > 0)
+            asIScriptFunction *scripting_function =
+                                           obj->getOnItemCollisionScript();
+            if (scripting_function)
             {
-                script_engine->runFunction(true, "void " + scripting_function + "(int, int, const string)",
+                script_engine->runFunction(scripting_function,
                         [&](asIScriptContext* ctx) {
                         ctx->SetArgDWord(0, (int)flyable->getType());
                         ctx->SetArgDWord(1, flyable->getOwnerId());
                         ctx->SetArgObject(2, &obj_id);
-                    });
+                    }, nullptr);
             }
             flyable->hit(NULL, obj);
 
@@ -34,6 +34,7 @@
 #include "physics/user_pointer.hpp"
 
 class AbstractKart;
+class asIScriptFunction;
 class STKDynamicsWorld;
 class Vec3;
 
@@ -145,10 +146,14 @@ private:
     btDefaultCollisionConfiguration *m_collision_conf;
     CollisionList                    m_all_collisions;
 
+    /** The script function called for kart-kart collisions, or NULL. */
+    asIScriptFunction               *m_kart_kart_collision_function;
+
 public:
           Physics          ();
          ~Physics          ();
     void  init             (const Vec3 &min_world, const Vec3 &max_world);
+    void  initScriptFunctions();
     void  addKart          (const AbstractKart *k);
     void  addBody          (btRigidBody* b) {m_dynamics_world->addRigidBody(b);}
     void  removeKart       (const AbstractKart *k);
@@ -0,0 +1,371 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "race/batch_runner.hpp"
+
+#include "main_loop.hpp"
+#include "config/user_config.hpp"
+#include "io/file_manager.hpp"
+#include "io/xml_node.hpp"
+#include "karts/controller/controller.hpp"
+#include "karts/kart_properties_manager.hpp"
+#include "karts/kart_with_stats.hpp"
+#include "modes/profile_world.hpp"
+#include "network/lobby_pool.hpp"
+#include "race/race_manager.hpp"
+#include "tracks/track.hpp"
+#include "tracks/track_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+std::vector<BatchRunner::Run> BatchRunner::m_runs;
+std::string                   BatchRunner::m_result_file;
+int                           BatchRunner::m_current_run     = -1;
+bool                          BatchRunner::m_race_finished   = false;
+double                        BatchRunner::m_race_start_time = 0;
+
+// ----------------------------------------------------------------------------
+/** Expands the run elements of a batch file into the list of races.
+ *  \param root The root node of the batch file.
+ *  \param runs On return contains the races (appended).
+ *  \return False if the matrix is invalid (e.g. a run without tracks).
+ */
+bool BatchRunner::parseMatrix(const XMLNode *root, std::vector<Run> *runs)
+{
+    for (unsigned int i = 0; i < root->getNumNodes(); i++)
+    {
+        const XMLNode *node = root->getNode(i);
+        if (node->getName() != "run")
+        {
+            Log::warn("BatchRunner", "Unknown node '%s' ignored.",
+                      node->getName().c_str());
+            continue;
+        }
+
+        std::vector<std::string> tracks, karts;
+        node->get("tracks", &tracks);
+        node->get("karts", &karts);
+        if (tracks.empty() || karts.empty())
+        {
+            Log::error("BatchRunner", "Run %d needs at least one track and "
+                       "one kart.", i);
+            return false;
+        }
+        std::vector<int> seeds;
+        node->get("seeds", &seeds);
+        if (seeds.empty())
+            seeds.push_back(1);
+        int laps = 3;
+        node->get("laps", &laps);
+        int difficulty = -1;
+        node->get("difficulty", &difficulty);
+        if (laps < 1 || difficulty > RaceManager::DIFFICULTY_LAST)
+        {
+            Log::error("BatchRunner", "Invalid laps or difficulty in run %d.",
+                       i);
+            return false;
+        }
+
+        // An empty list of AI karts means random AI karts
+        std::vector<std::vector<std::string> > ai_sets;
+        for (unsigned int j = 0; j < node->getNumNodes(); j++)
+        {
+            const XMLNode *ai = node->getNode(j);
+            if (ai->getName() != "ai")
+                continue;
+            std::vector<std::string> ai_karts;
+            ai->get("karts", &ai_karts);
+            ai_sets.push_back(ai_karts);
+        }
+        if (ai_sets.empty())
+            ai_sets.push_back(std::vector<std::string>());
+
+        for (unsigned int t = 0; t < tracks.size(); t++)
+        {
+            for (unsigned int k = 0; k < karts.size(); k++)
+            {
+                for (unsigned int a = 0; a < ai_sets.size(); a++)
+                {
+                    for (unsigned int s = 0; s < seeds.size(); s++)
+                    {
+                        Run run;
+                        run.m_track      = tracks[t];
+                        run.m_kart       = karts[k];
+                        run.m_ai_karts   = ai_sets[a];
+                        run.m_seed       = seeds[s];
+                        run.m_laps       = laps;
+                        run.m_difficulty = difficulty;
+                        runs->push_back(run);
+                    }
+                }   // for a < ai_sets.size()
+            }   // for k < karts.size()
+        }   // for t < tracks.size()
+    }   // for i < root->getNumNodes()
+    return true;
+}   // parseMatrix
+
+// ----------------------------------------------------------------------------
+/** Loads the batch file, checks that all tracks and karts exist, and
+ *  writes the header of the result file (if the file is new). This must
+ *  be called before the worker processes are started, so that only one
+ *  process writes the header.
+ *  \param filename Name of the batch file.
+ *  \return False if the batch file could not be loaded.
+ */
+bool BatchRunner::load(const std::string &filename)
+{
+    XMLNode *root = file_manager->createXMLTree(filename);
+    if (!root || root->getName() != "batch")
+    {
+        Log::error("BatchRunner", "Can't load batch file '%s'.",
+                   filename.c_str());
+        delete root;
+        return false;
+    }
+
+    m_result_file = StringUtils::removeExtension(filename) + ".csv";
+    root->get("results", &m_result_file);
+
+    std::vector<Run> runs;
+    bool ok = parseMatrix(root, &runs);
+    delete root;
+    if (!ok)
+        return false;
+
+    // Only races are supported, since the results are based on laps
+    m_runs.clear();
+    for (unsigned int i = 0; i < runs.size(); i++)
+    {
+        const Run &run = runs[i];
+        const Track *track = track_manager->getTrack(run.m_track);
+        if (!track || track->isArena() || track->isSoccer())
+        {
+            Log::warn("BatchRunner", "'%s' is not a race track, ignored.",
+                      run.m_track.c_str());
+            continue;
+        }
+        bool all_karts = kart_properties_manager->getKart(run.m_kart) != NULL;
+        for (unsigned int j = 0; j < run.m_ai_karts.size(); j++)
+        {
+            if (!kart_properties_manager->getKart(run.m_ai_karts[j]))
+                all_karts = false;
+        }
+        if (!all_karts)
+        {
+            Log::warn("BatchRunner", "Unknown kart in run with kart '%s' "
+                      "on '%s', ignored.", run.m_kart.c_str(),
+                      run.m_track.c_str());
+            continue;
+        }
+        m_runs.push_back(run);
+    }   // for i < runs.size()
+
+    if (m_runs.empty())
+    {
+        Log::error("BatchRunner", "No races in batch file '%s'.",
+                   filename.c_str());
+        return false;
+    }
+
+    FILE *f = fopen(m_result_file.c_str(), "a");
+    if (!f)
+    {
+        Log::error("BatchRunner", "Can't open result file '%s'.",
+                   m_result_file.c_str());
+        m_runs.clear();
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    if (ftell(f) == 0)
+    {
+        fprintf(f, "run,track,seed,laps,kart,controller,start_position,"
+                   "end_position,time,average_speed,top_speed,skid_time,"
+                   "rescue_time,rescue_count,brake_count,explosion_time,"
+                   "explosion_count,bonus_count,banana_count,"
+                   "small_nitro_count,large_nitro_count,bubblegum_count,"
+                   "off_track_count,energy,real_time\n");
+    }
+    fclose(f);
+
+    // All races use the profile world, without start screen
+    UserConfigParams::m_no_start_screen = true;
+    ProfileWorld::setProfileModeLaps(m_runs[0].m_laps);
+    Log::info("BatchRunner", "%d races, results are written to '%s'.",
+              (int)m_runs.size(), m_result_file.c_str());
+    return true;
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Runs all races of the batch (or, in a worker process, every n-th race).
+ *  On return the main loop is aborted.
+ */
+void BatchRunner::run()
+{
+    int worker      = LobbyPool::isLobby() ? LobbyPool::getLobbyId() : 0;
+    int num_workers = LobbyPool::isLobby() ? LobbyPool::getNumLobbies() : 1;
+    double start_time = StkTime::getRealTime();
+    int num_races = 0;
+
+    for (unsigned int i = worker; i < m_runs.size(); i += num_workers)
+    {
+        const Run &run = m_runs[i];
+        m_current_run = i;
+        Log::info("BatchRunner", "Race %d: kart '%s' on '%s', seed %d.",
+                  i, run.m_kart.c_str(), run.m_track.c_str(), run.m_seed);
+
+        race_manager->setMajorMode(RaceManager::MAJOR_MODE_SINGLE);
+        race_manager->setMinorMode(RaceManager::MINOR_MODE_NORMAL_RACE);
+        race_manager->setTrack(run.m_track);
+        race_manager->setPlayerKart(0, run.m_kart);
+        race_manager->setDefaultAIKartList(run.m_ai_karts);
+        if (!run.m_ai_karts.empty())
+            race_manager->setNumKarts((int)run.m_ai_karts.size() + 1);
+        else
+            race_manager->setNumKarts(UserConfigParams::m_num_karts);
+        if (run.m_difficulty >= 0)
+            race_manager->setDifficulty(
+                                 RaceManager::Difficulty(run.m_difficulty));
+        ProfileWorld::setProfileModeLaps(run.m_laps);
+        race_manager->setNumLaps(run.m_laps);
+        srand(run.m_seed);
+
+        m_race_finished   = false;
+        m_race_start_time = StkTime::getRealTime();
+        race_manager->setupPlayerKartInfo();
+        race_manager->startNew(false);
+        main_loop->run();
+
+        // The main loop was aborted by something else than the end of
+        // the race, e.g. the window was closed.
+        if (!m_race_finished)
+        {
+            Log::warn("BatchRunner", "Race %d was aborted.", i);
+            break;
+        }
+        num_races++;
+        main_loop->resetAbort();
+    }   // for i < m_runs.size()
+
+    m_current_run = -1;
+    main_loop->abort();
+
+    double t = StkTime::getRealTime() - start_time;
+    Log::info("BatchRunner", "%d races in %.1f seconds, %.0f races per hour.",
+              num_races, t, t > 0 ? num_races * 3600.0 / t : 0.0);
+}   // run
+
+// ----------------------------------------------------------------------------
+/** Called by ProfileWorld at the end of each race. Appends one row for
+ *  each kart to the result file. The rows of a race are written with one
+ *  write, so that the rows of different workers are not mixed.
+ *  \param world The world of the finished race.
+ */
+void BatchRunner::raceFinished(const World *world)
+{
+    m_race_finished = true;
+    if (m_current_run < 0)
+        return;
+    const Run &run = m_runs[m_current_run];
+
+    float real_time = (float)(StkTime::getRealTime() - m_race_start_time);
+    float distance  = run.m_laps * world->getTrack()->getTrackLength();
+    std::string rows;
+    for (unsigned int i = 0; i < world->getNumKarts(); i++)
+    {
+        const KartWithStats *kart =
+            dynamic_cast<const KartWithStats*>(world->getKart(i));
+        if (!kart)
+            continue;
+        float time = kart->getFinishTime();
+        char row[1024];
+        snprintf(row, sizeof(row), "%d,%s,%d,%d,%s,%s,%d,%d,%f,%f,%f,%f,%f,"
+                 "%d,%d,%f,%d,%d,%d,%d,%d,%d,%d,%f,%f\n", m_current_run,
+                 run.m_track.c_str(), run.m_seed, run.m_laps,
+                 kart->getIdent().c_str(),
+                 kart->getController()->getControllerName().c_str(),
+                 i + 1, kart->getPosition(), time,
+                 time > 0 ? distance / time : 0.0f, kart->getTopSpeed(),
+                 kart->getSkiddingTime(), kart->getRescueTime(),
+                 kart->getRescueCount(), kart->getBrakeCount(),
+                 kart->getExplosionTime(), kart->getExplosionCount(),
+                 kart->getBonusCount(), kart->getBananaCount(),
+                 kart->getSmallNitroCount(), kart->getLargeNitroCount(),
+                 kart->getBubblegumCount(), kart->getOffTrackCount(),
+                 kart->getEnergy(), real_time);
+        rows += row;
+    }   // for i < getNumKarts
+
+    FILE *f = fopen(m_result_file.c_str(), "a");
+    if (!f)
+    {
+        Log::error("BatchRunner", "Can't write to result file '%s'.",
+                   m_result_file.c_str());
+        return;
+    }
+    // A buffer big enough for all rows, so they are written at once
+    setvbuf(f, NULL, _IOFBF, rows.size() + 1);
+    fwrite(rows.c_str(), 1, rows.size(), f);
+    fclose(f);
+}   // raceFinished
+
+// ----------------------------------------------------------------------------
+/** Tests the expansion of the run matrix.
+ */
+void BatchRunner::unitTesting()
+{
+    std::string s =
+        "<?xml version=\"1.0\"?>"
+        "<batch>"
+        "  <run tracks=\"a b\" karts=\"x y z\" seeds=\"1 2\" laps=\"2\">"
+        "    <ai karts=\"p q\"/>"
+        "    <ai karts=\"r\"/>"
+        "  </run>"
+        "  <run tracks=\"c\" karts=\"x\"/>"
+        "</batch>";
+    XMLNode *root = file_manager->createXMLTreeFromString(s);
+    assert(root);
+    std::vector<Run> runs;
+    bool ok = parseMatrix(root, &runs);
+    assert(ok);
+    delete root;
+
+    // 2 tracks * 3 karts * 2 ai sets * 2 seeds, and one default race
+    assert(runs.size() == 2*3*2*2 + 1);
+    assert(runs[0].m_track == "a" && runs[0].m_kart == "x");
+    assert(runs[0].m_ai_karts.size() == 2 && runs[0].m_ai_karts[1] == "q");
+    assert(runs[0].m_seed == 1 && runs[1].m_seed == 2);
+    assert(runs[0].m_laps == 2 && runs[0].m_difficulty == -1);
+    assert(runs[2].m_ai_karts.size() == 1 && runs[2].m_ai_karts[0] == "r");
+    assert(runs[4].m_kart == "y");
+    assert(runs[12].m_track == "b");
+    assert(runs.back().m_track == "c" && runs.back().m_ai_karts.empty());
+    assert(runs.back().m_seed == 1 && runs.back().m_laps == 3);
+
+    // A run without tracks is an error
+    root = file_manager->createXMLTreeFromString(
+                 "<?xml version=\"1.0\"?><batch><run karts=\"x\"/></batch>");
+    runs.clear();
+    ok = parseMatrix(root, &runs);
+    assert(!ok);
+    delete root;
+}   // unitTesting
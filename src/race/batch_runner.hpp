@@ -0,0 +1,97 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+/*! \file batch_runner.hpp
+ */
+
+#ifndef HEADER_BATCH_RUNNER_HPP
+#define HEADER_BATCH_RUNNER_HPP
+
+#include <string>
+#include <vector>
+
+class World;
+class XMLNode;
+
+/** \brief Runs many profile races back to back in one process.
+ *  The races are described by a run matrix in an xml file, e.g.:
+ *  \code
+ *  <batch results="results.csv">
+ *    <run tracks="lighthouse snowmountain" karts="gnu tux" laps="3"
+ *         seeds="1 2 3" difficulty="3">
+ *      <ai karts="sara tux elephpant"/>
+ *      <ai karts="beastie beastie beastie"/>
+ *    </run>
+ *  </batch>
+ *  \endcode
+ *  Each run element is expanded into one race for each combination of
+ *  track, kart, ai set and seed (a run without ai elements uses random
+ *  AI karts). All races use ProfileWorld, and the statistics of each
+ *  kart are appended as one row to a CSV file, so the results are
+ *  available while the batch is still running. Since the karts, tracks
+ *  and materials are only loaded once, this is a lot faster than starting
+ *  a new process for each race (see tools/test.sh). Combined with
+ *  --lobbies the races are distributed between several worker processes,
+ *  which share the data loaded before they are forked (see LobbyPool).
+ * \ingroup race
+ */
+class BatchRunner
+{
+public:
+    /** The description of one race. */
+    struct Run
+    {
+        std::string              m_track;
+        std::string              m_kart;
+        std::vector<std::string> m_ai_karts;
+        int                      m_seed;
+        int                      m_laps;
+        /** Difficulty, or -1 to use the current difficulty. */
+        int                      m_difficulty;
+    };   // Run
+
+private:
+    /** All races of the batch. */
+    static std::vector<Run> m_runs;
+
+    /** Name of the file to which the results are written. */
+    static std::string m_result_file;
+
+    /** Index of the race that is currently running. */
+    static int m_current_run;
+
+    /** Set when the current race is finished, to detect if the main
+     *  loop was aborted (e.g. because the window was closed). */
+    static bool m_race_finished;
+
+    /** Real time at the start of the current race. */
+    static double m_race_start_time;
+
+public:
+    static bool parseMatrix(const XMLNode *root, std::vector<Run> *runs);
+    static bool load(const std::string &filename);
+    static void run();
+    static void raceFinished(const World *world);
+    static void unitTesting();
+
+    // ------------------------------------------------------------------------
+    /** Returns true if a batch of races is run. */
+    static bool isBatchMode() { return !m_runs.empty(); }
+};   // BatchRunner
+
+#endif
@@ -0,0 +1,301 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/ghost_timeline.hpp"
+
+#include "utils/log.hpp"
+#include "utils/time.hpp"
+
+#include <math.h>
+#include <string.h>
+
+// ----------------------------------------------------------------------------
+/** Removes all ghosts. */
+void GhostTimeline::clear()
+{
+    m_time.clear();
+    for (unsigned int c = 0; c < NUM_COMPONENTS; c++)
+        m_samples[c].clear();
+    m_first.clear();
+    m_end.clear();
+    m_current.clear();
+    m_blocks.clear();
+}   // clear
+
+// ----------------------------------------------------------------------------
+/** Adds a ghost without samples, and returns its index. The samples of a
+ *  ghost must be added before the next ghost is added.
+ */
+unsigned int GhostTimeline::addGhost()
+{
+    unsigned int n = getNumGhosts();
+    m_first.push_back((unsigned int)m_time.size());
+    m_end.push_back((unsigned int)m_time.size());
+    m_current.push_back((unsigned int)m_time.size());
+    if (n % BLOCK_SIZE == 0)
+    {
+        // Unused entries of a block get the identity transform, so that
+        // normalising their rotation is well defined.
+        Block b;
+        memset(&b, 0, sizeof(b));
+        for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+        {
+            b.m_from[QW][i] = b.m_to[QW][i] = b.m_result[QW][i] = 1.0f;
+        }
+        m_blocks.push_back(b);
+    }
+    return n;
+}   // addGhost
+
+// ----------------------------------------------------------------------------
+/** Adds a sample to the last ghost. A sample with the same time as the
+ *  previous one is ignored (to avoid a division by zero when
+ *  interpolating).
+ *  \param ghost Index of the ghost, which must be the last ghost added.
+ *  \param time Time of the sample.
+ *  \param t The transform at that time.
+ *  \return False if the sample was ignored.
+ */
+bool GhostTimeline::addTransform(unsigned int ghost, float time,
+                                 const btTransform &t)
+{
+    assert(ghost + 1 == getNumGhosts());
+    if (m_end[ghost] > m_first[ghost] && m_time.back() == time)
+        return false;
+    const btVector3 &xyz = t.getOrigin();
+    const btQuaternion q = t.getRotation();
+    m_time.push_back(time);
+    m_samples[X ].push_back(xyz.getX());
+    m_samples[Y ].push_back(xyz.getY());
+    m_samples[Z ].push_back(xyz.getZ());
+    m_samples[QX].push_back(q.getX());
+    m_samples[QY].push_back(q.getY());
+    m_samples[QZ].push_back(q.getZ());
+    m_samples[QW].push_back(q.getW());
+    m_end[ghost]++;
+    return true;
+}   // addTransform
+
+// ----------------------------------------------------------------------------
+/** Moves all ghosts back to their first sample. */
+void GhostTimeline::reset()
+{
+    m_current = m_first;
+    update(0.0f);
+}   // reset
+
+// ----------------------------------------------------------------------------
+/** Finds the samples of all ghosts for the current time, and interpolates
+ *  their transforms.
+ *  \param time The current world time. The ghosts stay at their first
+ *         sample while the time is 0 (i.e. before the race starts).
+ */
+void GhostTimeline::update(float time)
+{
+    const unsigned int n = getNumGhosts();
+    for (unsigned int g = 0; g < n; g++)
+    {
+        if (m_first[g] == m_end[g])
+            continue;
+        // Each ghost only moves a few samples forward each frame, so a
+        // linear search is cheaper than a binary search.
+        unsigned int i = m_current[g];
+        if (time != 0.0f)
+        {
+            while (i + 1 < m_end[g] && time >= m_time[i + 1])
+                i++;
+            m_current[g] = i;
+        }
+        unsigned int j = i + 1 < m_end[g] ? i + 1 : i;
+        float d = j > i ? (time - m_time[i]) / (m_time[j] - m_time[i]) : 0.0f;
+
+        Block &b = m_blocks[g / BLOCK_SIZE];
+        const unsigned int k = g % BLOCK_SIZE;
+        b.m_delta[k] = d < 0.0f ? 0.0f : (d > 1.0f ? 1.0f : d);
+        for (unsigned int c = 0; c < NUM_COMPONENTS; c++)
+        {
+            b.m_from[c][k] = m_samples[c][i];
+            b.m_to  [c][k] = m_samples[c][j];
+        }
+    }
+    interpolate();
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Interpolates between m_from and m_to for all ghosts. Each inner loop
+ *  runs over the ghosts of a block, i.e. over BLOCK_SIZE consecutive
+ *  floats, so the compiler turns it into SIMD instructions. The square
+ *  roots are done in a separate loop, since sqrtf can set errno, which
+ *  prevents this.
+ */
+void GhostTimeline::interpolate()
+{
+    for (unsigned int n = 0; n < m_blocks.size(); n++)
+    {
+        Block &b = m_blocks[n];
+        const float *d = b.m_delta;
+        for (unsigned int c = X; c <= Z; c++)
+        {
+            for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+                b.m_result[c][i] = b.m_from[c][i]
+                                 + d[i]*(b.m_to[c][i] - b.m_from[c][i]);
+        }
+
+        // Use the shorter way between the two rotations
+        float sign[BLOCK_SIZE] = { 0 };
+        for (unsigned int c = QX; c <= QW; c++)
+        {
+            for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+                sign[i] += b.m_from[c][i]*b.m_to[c][i];
+        }
+        for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+            sign[i] = sign[i] < 0.0f ? -1.0f : 1.0f;
+
+        float scale[BLOCK_SIZE] = { 0 };
+        for (unsigned int c = QX; c <= QW; c++)
+        {
+            for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+            {
+                float q = b.m_from[c][i]
+                        + d[i]*(sign[i]*b.m_to[c][i] - b.m_from[c][i]);
+                b.m_result[c][i] = q;
+                scale[i] += q*q;
+            }
+        }
+        for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+            scale[i] = 1.0f / sqrtf(scale[i]);
+        for (unsigned int c = QX; c <= QW; c++)
+        {
+            for (unsigned int i = 0; i < BLOCK_SIZE; i++)
+                b.m_result[c][i] *= scale[i];
+        }
+    }   // for n < m_blocks.size()
+}   // interpolate
+
+// ----------------------------------------------------------------------------
+/** Checks the interpolation against the per kart interpolation that was
+ *  used before (a linear search, lerp and slerp for each GhostKart), and
+ *  compares the time both need for 64 ghosts.
+ */
+void GhostTimeline::unitTesting()
+{
+    const unsigned int NUM_GHOSTS  = 64;
+    const float        SAMPLE_DT   = 0.05f;   // replay delta-t
+    const float        RACE_TIME   = 180.0f;
+    const float        FRAME_DT    = 1.0f / 60.0f;
+
+    // The data as it was stored per ghost kart
+    std::vector<std::vector<float> >       all_times(NUM_GHOSTS);
+    std::vector<std::vector<btTransform> > all_transforms(NUM_GHOSTS);
+
+    GhostTimeline timeline;
+    for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+    {
+        unsigned int ghost = timeline.addGhost();
+        assert(ghost == g);
+        // Each ghost drives on a circle with its own speed, with a
+        // different sample time so that they switch samples in different
+        // frames.
+        float speed = 0.5f + 0.01f*g;
+        for (float t = 0.001f*g; t < RACE_TIME; t += SAMPLE_DT)
+        {
+            btQuaternion q(btVector3(0, 1, 0), t*speed);
+            btTransform trans(q, btVector3(100.0f*sinf(t*speed), 0.1f*g,
+                                           100.0f*cosf(t*speed)));
+            timeline.addTransform(g, t, trans);
+            all_times[g].push_back(t);
+            all_transforms[g].push_back(trans);
+        }
+        assert(!timeline.addTransform(g, all_times[g].back(),
+                                      all_transforms[g].back()));
+        assert(timeline.getNumTransforms(g) == all_times[g].size());
+    }
+
+    // Compare the results
+    std::vector<unsigned int> index(NUM_GHOSTS, 0);
+    timeline.reset();
+    for (float time = FRAME_DT; time < RACE_TIME; time += FRAME_DT)
+    {
+        timeline.update(time);
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            const std::vector<float> &times = all_times[g];
+            unsigned int &i = index[g];
+            while (i + 1 < times.size() && time >= times[i + 1])
+                i++;
+            assert(timeline.getIndex(g) == i);
+            if (i + 1 >= times.size())
+            {
+                assert(timeline.isFinished(g));
+                continue;
+            }
+            float d = (time - times[i]) / (times[i + 1] - times[i]);
+            d = d < 0.0f ? 0.0f : d;
+            Vec3 xyz = (1.0f - d)*all_transforms[g][i].getOrigin()
+                     +         d *all_transforms[g][i + 1].getOrigin();
+            btQuaternion q = all_transforms[g][i].getRotation()
+                            .slerp(all_transforms[g][i + 1].getRotation(), d);
+            assert((timeline.getXYZ(g) - xyz).length() < 1.0e-3f);
+            assert(fabsf(timeline.getRotation(g).dot(q)) > 0.99999f);
+        }
+    }
+
+    // Time both versions for a whole race
+    double start = StkTime::getRealTime();
+    unsigned int num_frames = 0;
+    timeline.reset();
+    for (float time = FRAME_DT; time < RACE_TIME; time += FRAME_DT)
+    {
+        timeline.update(time);
+        num_frames++;
+    }
+    double timeline_time = StkTime::getRealTime() - start;
+
+    // The previous version stored a transform per ghost kart
+    std::vector<btTransform> result(NUM_GHOSTS);
+    std::fill(index.begin(), index.end(), 0);
+    // Sum of the interpolated positions, which is logged so that the loop
+    // is not optimised away
+    float checksum = 0;
+    start = StkTime::getRealTime();
+    for (float time = FRAME_DT; time < RACE_TIME; time += FRAME_DT)
+    {
+        for (unsigned int g = 0; g < NUM_GHOSTS; g++)
+        {
+            const std::vector<float> &times = all_times[g];
+            unsigned int &i = index[g];
+            while (i + 1 < times.size() && time >= times[i + 1])
+                i++;
+            if (i + 1 >= times.size())
+                continue;
+            float d = (time - times[i]) / (times[i + 1] - times[i]);
+            const std::vector<btTransform> &t = all_transforms[g];
+            result[g].setOrigin((1.0f - d)*t[i].getOrigin()
+                                +       d *t[i + 1].getOrigin());
+            result[g].setRotation(t[i].getRotation()
+                                  .slerp(t[i + 1].getRotation(), d));
+            checksum += result[g].getOrigin().getX();
+        }
+    }
+    double per_kart_time = StkTime::getRealTime() - start;
+
+    Log::info("GhostTimeline", "%d ghosts, %d frames: %.2f us per frame "
+              "(per kart interpolation: %.2f us, checksum %f).", NUM_GHOSTS,
+              num_frames, timeline_time*1.0e6/num_frames,
+              per_kart_time*1.0e6/num_frames, checksum);
+}   // unitTesting
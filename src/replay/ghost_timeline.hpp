@@ -0,0 +1,146 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_GHOST_TIMELINE_HPP
+#define HEADER_GHOST_TIMELINE_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/vec3.hpp"
+
+#include "LinearMath/btQuaternion.h"
+#include "LinearMath/btTransform.h"
+
+#include <assert.h>
+#include <vector>
+
+/**
+  * \brief The transforms of all ghost karts of a replay.
+  *  The samples of all ghosts are stored in one timeline as a structure of
+  *  arrays (each ghost uses a consecutive range of samples), and update()
+  *  interpolates the transforms of all ghosts for the current world time in
+  *  one pass. The interpolation works on blocks of four ghosts, with the
+  *  data of each component of the four ghosts next to each other, so that
+  *  the compiler can use SIMD instructions for it. Rotations are
+  *  interpolated with a normalised linear interpolation, which is very
+  *  close to a slerp for the small angles between consecutive samples.
+  *  The GhostKarts only read the results.
+  * \ingroup replay
+  */
+class GhostTimeline : public NoCopy
+{
+private:
+    /** The components of a transform. */
+    enum { X, Y, Z, QX, QY, QZ, QW, NUM_COMPONENTS };
+
+    /** The interpolation data of BLOCK_SIZE ghosts, stored so that the
+     *  interpolation of these ghosts can be done with SIMD instructions. */
+    enum { BLOCK_SIZE = 4 };
+    struct Block
+    {
+        /** The samples before and after the current time. */
+        float m_from  [NUM_COMPONENTS][BLOCK_SIZE];
+        float m_to    [NUM_COMPONENTS][BLOCK_SIZE];
+        /** Interpolation factor between m_from and m_to. */
+        float m_delta [BLOCK_SIZE];
+        /** The interpolated transforms. */
+        float m_result[NUM_COMPONENTS][BLOCK_SIZE];
+    };   // Block
+
+    /** The time of each sample. */
+    std::vector<float> m_time;
+
+    /** The transform of each sample, one array per component. */
+    std::vector<float> m_samples[NUM_COMPONENTS];
+
+    /** Index of the first sample of each ghost. */
+    std::vector<unsigned int> m_first;
+
+    /** One more than the index of the last sample of each ghost. */
+    std::vector<unsigned int> m_end;
+
+    /** Index of the last sample of each ghost which is not after the
+     *  current time. */
+    std::vector<unsigned int> m_current;
+
+    /** The interpolation data, ghost g is stored at index g % BLOCK_SIZE
+     *  of block g / BLOCK_SIZE. */
+    std::vector<Block> m_blocks;
+
+    void interpolate();
+    // ------------------------------------------------------------------------
+    const Block& getBlock(unsigned int ghost) const
+    {
+        return m_blocks[ghost / BLOCK_SIZE];
+    }   // getBlock
+
+public:
+    void         clear();
+    unsigned int addGhost();
+    bool         addTransform(unsigned int ghost, float time,
+                              const btTransform &t);
+    void         reset();
+    void         update(float time);
+    static void  unitTesting();
+    // ------------------------------------------------------------------------
+    unsigned int getNumGhosts() const { return (unsigned int)m_first.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns the number of samples of a ghost. */
+    unsigned int getNumTransforms(unsigned int ghost) const
+    {
+        return m_end[ghost] - m_first[ghost];
+    }   // getNumTransforms
+    // ------------------------------------------------------------------------
+    /** Returns the index (counted from the first sample of this ghost) of
+     *  the last sample of a ghost which is not after the current time. */
+    unsigned int getIndex(unsigned int ghost) const
+    {
+        return m_current[ghost] - m_first[ghost];
+    }   // getIndex
+    // ------------------------------------------------------------------------
+    /** Returns how far the current time is between the sample getIndex()
+     *  and the next one, between 0 and 1. */
+    float getDelta(unsigned int ghost) const
+    {
+        return getBlock(ghost).m_delta[ghost % BLOCK_SIZE];
+    }   // getDelta
+    // ------------------------------------------------------------------------
+    /** True if the current time is after the last sample of a ghost. */
+    bool isFinished(unsigned int ghost) const
+    {
+        return m_current[ghost] + 1 >= m_end[ghost];
+    }   // isFinished
+    // ------------------------------------------------------------------------
+    /** Returns the interpolated position of a ghost. */
+    Vec3 getXYZ(unsigned int ghost) const
+    {
+        const Block &b = getBlock(ghost);
+        unsigned int i = ghost % BLOCK_SIZE;
+        return Vec3(b.m_result[X][i], b.m_result[Y][i], b.m_result[Z][i]);
+    }   // getXYZ
+    // ------------------------------------------------------------------------
+    /** Returns the interpolated rotation of a ghost. */
+    btQuaternion getRotation(unsigned int ghost) const
+    {
+        const Block &b = getBlock(ghost);
+        unsigned int i = ghost % BLOCK_SIZE;
+        return btQuaternion(b.m_result[QX][i], b.m_result[QY][i],
+                            b.m_result[QZ][i], b.m_result[QW][i]);
+    }   // getRotation
+};   // GhostTimeline
+
+#endif
@@ -77,13 +77,14 @@ protected:
     // ------------------------------------------------------------------------
     /** Returns the filename that was opened. */
     virtual const std::string& getReplayFilename() const = 0;
+
+public:
     // ------------------------------------------------------------------------
     /** Returns the version number of the replay file. This is used to check
      *  that a loaded replay file can still be understood by this
      *  executable. */
-    unsigned int getReplayVersion() const { return 3; }
+    static unsigned int getReplayVersion() { return 3; }
 
-public:
              ReplayBase();
     virtual ~ReplayBase() {};
 };   // ReplayBase
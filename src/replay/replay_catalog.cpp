@@ -0,0 +1,323 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "replay/replay_catalog.hpp"
+
+#include "io/file_manager.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <assert.h>
+#include <set>
+#include <stdio.h>
+
+ReplayCatalog *ReplayCatalog::m_replay_catalog = NULL;
+const char    *ReplayCatalog::CATALOG_FILE     = "replay_catalog.txt";
+
+// ----------------------------------------------------------------------------
+void ReplayCatalog::create()
+{
+    m_replay_catalog = new ReplayCatalog(file_manager->getReplayDir());
+}   // create
+
+// ----------------------------------------------------------------------------
+/** Creates an empty catalog, the catalog file is only read when it is used.
+ *  \param directory The replay directory, with trailing '/'.
+ */
+ReplayCatalog::ReplayCatalog(const std::string &directory)
+{
+    m_directory      = directory;
+    m_loaded         = false;
+    m_num_files_read = 0;
+}   // ReplayCatalog
+
+// ----------------------------------------------------------------------------
+/** Reads the catalog file. The catalog is discarded if it was written for
+ *  a different replay version. Each line contains the modification time,
+ *  the header data and the name of one file, see save().
+ */
+void ReplayCatalog::load()
+{
+    m_loaded = true;
+    m_entries.clear();
+    std::string filename = m_directory + CATALOG_FILE;
+    FILE *fd = fopen(filename.c_str(), "r");
+    if (!fd)
+        return;
+
+    char s[4096], s1[1024];
+    unsigned int version = 0;
+    if (!fgets(s, 4095, fd) || sscanf(s, "version: %u", &version) != 1 ||
+        version != ReplayPlay::getReplayVersion())
+    {
+        Log::info("ReplayCatalog", "Ignoring outdated or invalid '%s'.",
+                  filename.c_str());
+        fclose(fd);
+        return;
+    }
+
+    while (fgets(s, 4095, fd))
+    {
+        ReplayPlay::ReplayData rd;
+        long long mtime;
+        int valid, reverse, n;
+        unsigned int num_karts;
+        if (sscanf(s, "%lld %d %d %u %u %f %1023s %u%n", &mtime, &valid,
+                   &reverse, &rd.m_difficulty, &rd.m_laps, &rd.m_min_time,
+                   s1, &num_karts, &n) != 8)
+        {
+            Log::warn("ReplayCatalog", "Invalid line '%s' in '%s'.", s,
+                      filename.c_str());
+            continue;
+        }
+        rd.m_track_name = s1;
+        const char *p = s + n;
+        for (unsigned int i = 0; i < num_karts; i++)
+        {
+            if (sscanf(p, " %1023s%n", s1, &n) != 1)
+                break;
+            rd.m_kart_list.push_back(s1);
+            p += n;
+        }
+        if (rd.m_kart_list.size() != num_karts || *p != ' ')
+            continue;
+        // The file name is the rest of the line, it can contain spaces
+        std::string file(p + 1);
+        while (!file.empty() && (file[file.size()-1] == '\n' ||
+                                 file[file.size()-1] == '\r'))
+            file.erase(file.size() - 1);
+        if (file.empty())
+            continue;
+
+        rd.m_filename           = file;
+        rd.m_custom_replay_file = false;
+        rd.m_reverse            = reverse != 0;
+        Entry &entry  = m_entries[file];
+        entry.m_data  = rd;
+        entry.m_mtime = (time_t)mtime;
+        entry.m_valid = valid != 0;
+    }
+    fclose(fd);
+}   // load
+
+// ----------------------------------------------------------------------------
+/** Writes the catalog file. It uses a simple line based format like the
+ *  replay files, since parsing it is much faster than parsing XML with
+ *  thousands of replays: after the version, each line contains
+ *  "mtime valid reverse difficulty laps min_time track num_karts
+ *  kart... filename". Invalid files are stored with track "-".
+ */
+void ReplayCatalog::save() const
+{
+    std::string filename = m_directory + CATALOG_FILE;
+    FILE *fd = fopen(filename.c_str(), "w");
+    if (!fd)
+    {
+        Log::error("ReplayCatalog", "Can't open '%s' for writing.",
+                   filename.c_str());
+        return;
+    }
+    fprintf(fd, "version: %d\n", ReplayPlay::getReplayVersion());
+    std::map<std::string, Entry>::const_iterator i;
+    for (i = m_entries.begin(); i != m_entries.end(); i++)
+    {
+        const ReplayPlay::ReplayData &rd = i->second.m_data;
+        if (i->second.m_valid)
+        {
+            fprintf(fd, "%lld 1 %d %u %u %f %s %u",
+                    (long long)i->second.m_mtime, (int)rd.m_reverse,
+                    rd.m_difficulty, rd.m_laps, rd.m_min_time,
+                    rd.m_track_name.c_str(),
+                    (unsigned int)rd.m_kart_list.size());
+            for (unsigned int k = 0; k < rd.m_kart_list.size(); k++)
+                fprintf(fd, " %s", rd.m_kart_list[k].c_str());
+        }
+        else
+            fprintf(fd, "%lld 0 0 0 0 0 - 0", (long long)i->second.m_mtime);
+        fprintf(fd, " %s\n", i->first.c_str());
+    }
+    fclose(fd);
+}   // save
+
+// ----------------------------------------------------------------------------
+/** Reads the header of a replay file and stores it in the catalog.
+ *  \param filename Name of the file in the replay directory.
+ *  \param mtime Modification time of the file.
+ */
+void ReplayCatalog::readFile(const std::string &filename, time_t mtime)
+{
+    Entry &entry = m_entries[filename];
+    entry.m_mtime = mtime;
+    entry.m_data.m_filename           = filename;
+    entry.m_data.m_custom_replay_file = false;
+    entry.m_valid = ReplayPlay::readHeader(m_directory + filename,
+                                           &entry.m_data);
+    m_num_files_read++;
+}   // readFile
+
+// ----------------------------------------------------------------------------
+/** Brings the catalog up to date with the replay directory: files that were
+ *  added or modified are read, and deleted files are removed. The catalog
+ *  file is only written if anything changed.
+ */
+void ReplayCatalog::update()
+{
+    if (!m_loaded)
+        load();
+    m_num_files_read = 0;
+
+    std::set<std::string> files;
+    file_manager->listFiles(files, m_directory, /*is_full_path*/ false);
+
+    bool modified = false;
+    std::map<std::string, Entry>::iterator e = m_entries.begin();
+    while (e != m_entries.end())
+    {
+        if (files.find(e->first) == files.end())
+        {
+            m_entries.erase(e++);
+            modified = true;
+        }
+        else
+            e++;
+    }
+
+    for (std::set<std::string>::iterator i  = files.begin();
+                                         i != files.end(); ++i)
+    {
+        if (StringUtils::getExtension(*i) != "replay")
+            continue;
+        time_t mtime = file_manager->getFileModificationTime(m_directory+*i);
+        e = m_entries.find(*i);
+        if (e != m_entries.end() && e->second.m_mtime == mtime)
+            continue;
+        readFile(*i, mtime);
+        modified = true;
+    }
+
+    if (modified)
+        save();
+}   // update
+
+// ----------------------------------------------------------------------------
+/** Adds (or updates) a replay file that was just written, and saves the
+ *  catalog. Used by the ReplayRecorder, so that the next update() does not
+ *  need to read the file again.
+ *  \param filename Name of the file in the replay directory.
+ */
+void ReplayCatalog::addFile(const std::string &filename)
+{
+    if (!m_loaded)
+        load();
+    readFile(filename,
+             file_manager->getFileModificationTime(m_directory + filename));
+    save();
+}   // addFile
+
+// ----------------------------------------------------------------------------
+/** Returns the data of all valid replay files, sorted by file name.
+ *  \param replays The replay data is appended to this vector.
+ */
+void ReplayCatalog::getReplays(std::vector<ReplayPlay::ReplayData> *replays)
+                                                                         const
+{
+    std::map<std::string, Entry>::const_iterator i;
+    for (i = m_entries.begin(); i != m_entries.end(); i++)
+    {
+        if (i->second.m_valid)
+            replays->push_back(i->second.m_data);
+    }
+}   // getReplays
+
+// ----------------------------------------------------------------------------
+/** Creates 5000 replay headers in a temporary directory, and compares the
+ *  time to read them all with the time to update an existing catalog. Also
+ *  checks that added and deleted files are detected.
+ */
+void ReplayCatalog::unitTesting()
+{
+    const unsigned int NUM_REPLAYS = 5000;
+    std::string dir = file_manager->getReplayDir() + "catalog-test/";
+    if (!file_manager->checkAndCreateDirectoryP(dir))
+    {
+        Log::warn("ReplayCatalog", "Can't create '%s', test skipped.",
+                  dir.c_str());
+        return;
+    }
+
+    std::vector<std::string> names;
+    for (unsigned int i = 0; i <= NUM_REPLAYS; i++)
+    {
+        names.push_back(StringUtils::insertValues("test_%d.replay", i));
+        FILE *fd = fopen((dir + names.back()).c_str(), "w");
+        assert(fd);
+        // The last file is from an older version
+        fprintf(fd, "version: %d\n", i < NUM_REPLAYS
+                                     ? ReplayPlay::getReplayVersion() : 1);
+        fprintf(fd, "kart: tux\nkart: nolok\nkart_list_end\n");
+        fprintf(fd, "reverse: %d\ndifficulty: %d\ntrack: track%d\n",
+                i % 2, i % 4, i % 20);
+        fprintf(fd, "laps: %d\nmin_time: %f\n", 1 + i % 3, 60.0f + i*0.25f);
+        fclose(fd);
+    }
+
+    // Without a catalog all files are read
+    double start = StkTime::getRealTime();
+    ReplayCatalog *catalog = new ReplayCatalog(dir);
+    catalog->update();
+    double read_all = StkTime::getRealTime() - start;
+    assert(catalog->getNumFilesRead() == NUM_REPLAYS + 1);
+    assert(catalog->getNumEntries() == NUM_REPLAYS + 1);
+    delete catalog;
+
+    // With the catalog no file is read
+    start = StkTime::getRealTime();
+    catalog = new ReplayCatalog(dir);
+    catalog->update();
+    std::vector<ReplayPlay::ReplayData> replays;
+    catalog->getReplays(&replays);
+    double read_catalog = StkTime::getRealTime() - start;
+    assert(catalog->getNumFilesRead() == 0);
+    assert(replays.size() == NUM_REPLAYS);
+    const ReplayPlay::ReplayData &rd = replays[0];   // test_0.replay
+    assert(rd.m_filename == "test_0.replay" && rd.m_track_name == "track0");
+    assert(rd.m_kart_list.size() == 2 && rd.m_kart_list[1] == "nolok");
+    assert(!rd.m_reverse && rd.m_difficulty == 0 && rd.m_laps == 1);
+    assert(rd.m_min_time == 60.0f);
+
+    // Deleted and added files
+    file_manager->removeFile(dir + names[1]);
+    names[1] = "new.replay";
+    file_manager->copyFile(dir + names[2], dir + names[1]);
+    catalog->update();
+    assert(catalog->getNumFilesRead() == 1);
+    assert(catalog->getNumEntries() == NUM_REPLAYS + 1);
+    catalog->addFile(names[1]);
+    assert(catalog->getNumEntries() == NUM_REPLAYS + 1);
+    delete catalog;
+
+    Log::info("ReplayCatalog", "%d replays: reading all files %.1f ms, "
+              "using the catalog %.1f ms.", NUM_REPLAYS, read_all*1000.0,
+              read_catalog*1000.0);
+
+    for (unsigned int i = 0; i < names.size(); i++)
+        file_manager->removeFile(dir + names[i]);
+    file_manager->removeFile(dir + CATALOG_FILE);
+    file_manager->removeDirectory(dir);
+}   // unitTesting
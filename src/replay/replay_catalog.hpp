@@ -0,0 +1,101 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_REPLAY_CATALOG_HPP
+#define HEADER_REPLAY_CATALOG_HPP
+
+#include "replay/replay_play.hpp"
+#include "utils/no_copy.hpp"
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+  * \brief A persistent index of the headers of all replay files in a
+  *  directory.
+  *  Reading the header of each replay file every time the ghost replay
+  *  selection is opened is slow with many replays. The catalog stores the
+  *  header (track, karts, difficulty, laps, finish time) and the
+  *  modification time of each file in a text file in the replay directory.
+  *  update() only reads the files that are new or were modified since
+  *  they were added to the catalog, and ReplayRecorder adds each replay
+  *  it saves directly. Invalid files are stored as well, so that they
+  *  are not read again.
+  * \ingroup replay
+  */
+class ReplayCatalog : public NoCopy
+{
+private:
+    /** The information stored about each file. */
+    struct Entry
+    {
+        ReplayPlay::ReplayData m_data;
+        /** Modification time of the file when it was read. */
+        time_t                 m_mtime;
+        /** False if the file is not a replay file this version can read. */
+        bool                   m_valid;
+    };   // Entry
+
+    static ReplayCatalog *m_replay_catalog;
+
+    /** Directory of the replay files, with trailing '/'. */
+    std::string m_directory;
+
+    /** The entries, indexed by file name (without directory). */
+    std::map<std::string, Entry> m_entries;
+
+    /** True once the catalog file was read. */
+    bool m_loaded;
+
+    /** Number of replay files read in the last update. */
+    unsigned int m_num_files_read;
+
+    void load();
+    void save() const;
+    void readFile(const std::string &filename, time_t mtime);
+
+public:
+    /** Name of the catalog file in the replay directory. */
+    static const char *CATALOG_FILE;
+
+          ReplayCatalog(const std::string &directory);
+    void  update();
+    void  addFile(const std::string &filename);
+    void  getReplays(std::vector<ReplayPlay::ReplayData> *replays) const;
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    /** Returns the number of files in the catalog (including invalid
+     *  ones). */
+    unsigned int getNumEntries() const { return (unsigned int)m_entries.size(); }
+    // ------------------------------------------------------------------------
+    /** Returns the number of replay files that had to be read in the last
+     *  update(). */
+    unsigned int getNumFilesRead() const { return m_num_files_read; }
+    // ------------------------------------------------------------------------
+    /** Creates the catalog of the user's replay directory. */
+    static void create();
+    // ------------------------------------------------------------------------
+    /** Returns the catalog of the user's replay directory. */
+    static ReplayCatalog *get() { return m_replay_catalog; }
+    // ------------------------------------------------------------------------
+    static void destroy() { delete m_replay_catalog; m_replay_catalog = NULL; }
+};   // ReplayCatalog
+
+#endif
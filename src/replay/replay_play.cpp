@@ -24,10 +24,12 @@
 #include "karts/controller/ghost_controller.hpp"
 #include "modes/world.hpp"
 #include "race/race_manager.hpp"
+#include "replay/replay_catalog.hpp"
 #include "tracks/track.hpp"
 #include "tracks/track_manager.hpp"
 
 #include <irrlicht.h>
+#include <algorithm>
 #include <stdio.h>
 #include <string>
 
@@ -53,12 +55,22 @@ ReplayPlay::~ReplayPlay()
  */
 void ReplayPlay::reset()
 {
+    m_ghost_timeline.reset();
     for(unsigned int i=0; i<(unsigned int)m_ghost_karts.size(); i++)
     {
         m_ghost_karts[i].reset();
     }
 }   // reset
 
+//-----------------------------------------------------------------------------
+/** Interpolates the transforms of all ghost karts for the current world
+ *  time. Called once per frame before the karts are updated.
+ */
+void ReplayPlay::update()
+{
+    m_ghost_timeline.update(World::getWorld()->getTime());
+}   // update
+
 //-----------------------------------------------------------------------------
 void ReplayPlay::loadAllReplayFile()
 {
@@ -78,37 +90,72 @@ void ReplayPlay::loadAllReplayFile()
         }
     }
 
-    // Now user recorded replay
-    std::set<std::string> files;
-    file_manager->listFiles(files, file_manager->getReplayDir(),
-        /*is_full_path*/ false);
-
-    for (std::set<std::string>::iterator i  = files.begin();
-                                         i != files.end(); ++i)
+    // Now user recorded replays, whose headers are taken from the replay
+    // catalog (which only reads new or modified files).
+    ReplayCatalog::get()->update();
+    std::vector<ReplayData> replays;
+    ReplayCatalog::get()->getReplays(&replays);
+    m_replay_file_list.reserve(m_replay_file_list.size() + replays.size());
+    for (unsigned int i = 0; i < replays.size(); i++)
     {
-        if (!addReplayFile(*i))
-        {
-            // Skip invalid replay file
+        // Skip replays of tracks that are not installed (anymore)
+        if (!track_manager->getTrack(replays[i].m_track_name))
             continue;
-        }
+        m_replay_file_list.push_back(replays[i]);
     }
 
 }   // loadAllReplayFile
 
 //-----------------------------------------------------------------------------
+/** Adds a replay file to the list of replays if it can be read and its
+ *  track exists.
+ *  \param fn Name of the replay file in the replay directory, or full path
+ *         of the file if custom_replay is set.
+ *  \param custom_replay True if a full path is given.
+ */
 bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
 {
-
-    char s[1024], s1[1024];
     if (StringUtils::getExtension(fn) != "replay") return false;
-    FILE *fd = fopen(custom_replay ? fn.c_str() :
-        (file_manager->getReplayDir() + fn).c_str(), "r");
-    if (fd == NULL) return false;
     ReplayData rd;
 
     // custom_replay is true when full path of filename is given
     rd.m_custom_replay_file = custom_replay;
     rd.m_filename = fn;
+    if (!readHeader(custom_replay ? fn : file_manager->getReplayDir() + fn,
+                    &rd))
+        return false;
+
+    Track* t = track_manager->getTrack(rd.m_track_name);
+    if (t == NULL)
+    {
+        Log::warn("Replay", "Track '%s' used in replay not found in STK!",
+        rd.m_track_name.c_str());
+        return false;
+    }
+    m_replay_file_list.push_back(rd);
+
+    assert(m_replay_file_list.size() > 0);
+    // Force to use custom replay file immediately
+    if (custom_replay)
+        m_current_replay_file = m_replay_file_list.size() - 1;
+
+    return true;
+
+}   // addReplayFile
+
+//-----------------------------------------------------------------------------
+/** Reads the header of a replay file (karts, track, difficulty etc.) without
+ *  checking if the track exists. The file name and custom flag of the
+ *  replay data are not changed.
+ *  \param path Full path of the replay file.
+ *  \param rd The replay data to fill in.
+ *  \return False if the file can not be read or is not a valid replay file.
+ */
+bool ReplayPlay::readHeader(const std::string &path, ReplayData *rd)
+{
+    char s[1024], s1[1024];
+    FILE *fd = fopen(path.c_str(), "r");
+    if (fd == NULL) return false;
 
     fgets(s, 1023, fd);
     unsigned int version;
@@ -123,11 +170,12 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
     {
         Log::warn("Replay", "Replay is version '%d'", version);
         Log::warn("Replay", "STK version is '%d'", getReplayVersion());
-        Log::warn("Replay", "Skipped '%s'", fn.c_str());
+        Log::warn("Replay", "Skipped '%s'", path.c_str());
         fclose(fd);
         return false;
     }
 
+    rd->m_kart_list.clear();
     while(true)
     {
         fgets(s, 1023, fd);
@@ -141,7 +189,7 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
             Log::warn("Replay", "Could not read ghost karts info!");
             break;
         }
-        rd.m_kart_list.push_back(std::string(s1));
+        rd->m_kart_list.push_back(std::string(s1));
     }
 
     int reverse = 0;
@@ -152,10 +200,10 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
         fclose(fd);
         return false;
     }
-    rd.m_reverse = reverse != 0;
+    rd->m_reverse = reverse != 0;
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "difficulty: %u", &rd.m_difficulty) != 1)
+    if (sscanf(s, "difficulty: %u", &rd->m_difficulty) != 1)
     {
         Log::warn("Replay", " No difficulty found in replay file.");
         fclose(fd);
@@ -169,18 +217,10 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
         fclose(fd);
         return false;
     }
-    rd.m_track_name = std::string(s1);
-    Track* t = track_manager->getTrack(rd.m_track_name);
-    if (t == NULL)
-    {
-        Log::warn("Replay", "Track '%s' used in replay not found in STK!",
-        rd.m_track_name.c_str());
-        fclose(fd);
-        return false;
-    }
+    rd->m_track_name = std::string(s1);
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "laps: %u", &rd.m_laps) != 1)
+    if (sscanf(s, "laps: %u", &rd->m_laps) != 1)
     {
         Log::warn("Replay", "No number of laps found in replay file.");
         fclose(fd);
@@ -188,28 +228,50 @@ bool ReplayPlay::addReplayFile(const std::string& fn, bool custom_replay)
     }
 
     fgets(s, 1023, fd);
-    if (sscanf(s, "min_time: %f", &rd.m_min_time) != 1)
+    if (sscanf(s, "min_time: %f", &rd->m_min_time) != 1)
     {
         Log::warn("Replay", "Finish time not found in replay file.");
         fclose(fd);
         return false;
     }
     fclose(fd);
-    m_replay_file_list.push_back(rd);
-
-    assert(m_replay_file_list.size() > 0);
-    // Force to use custom replay file immediately
-    if (custom_replay)
-        m_current_replay_file = m_replay_file_list.size() - 1;
-
     return true;
+}   // readHeader
 
-}   // addReplayFile
+//-----------------------------------------------------------------------------
+/** Returns the indices of the replays with the given difficulty (or all
+ *  replays), sorted by the current sort order (see setSortOrder). Only the
+ *  indices are sorted, the replay data is not moved.
+ *  \param reverse True to sort in descending order.
+ *  \param difficulty Only replays with this difficulty are returned, all
+ *         replays if it is negative.
+ *  \param list The indices (see getReplayData) are stored here.
+ */
+void ReplayPlay::getReplayList(bool reverse, int difficulty,
+                               std::vector<unsigned int> *list) const
+{
+    list->clear();
+    list->reserve(m_replay_file_list.size());
+    for (unsigned int i = 0; i < m_replay_file_list.size(); i++)
+    {
+        if (difficulty < 0 ||
+            m_replay_file_list[i].m_difficulty == (unsigned int)difficulty)
+            list->push_back(i);
+    }
+    const std::vector<ReplayData> &replays = m_replay_file_list;
+    std::stable_sort(list->begin(), list->end(),
+                     [&replays, reverse](unsigned int a, unsigned int b)
+                     {
+                         return reverse ? replays[b] < replays[a]
+                                        : replays[a] < replays[b];
+                     });
+}   // getReplayList
 
 //-----------------------------------------------------------------------------
 void ReplayPlay::load()
 {
     m_ghost_karts.clearAndDeleteAll();
+    m_ghost_timeline.clear();
     char s[1024];
 
     FILE *fd = openReplayFile(/*writeable*/false,
@@ -251,7 +313,7 @@ void ReplayPlay::readKartData(FILE *fd, char *next_line)
     const unsigned int kart_num = m_ghost_karts.size();
     m_ghost_karts.push_back(new GhostKart(m_replay_file_list
         [m_current_replay_file].m_kart_list.at(kart_num),
-        kart_num, kart_num + 1));
+        kart_num, kart_num + 1, &m_ghost_timeline));
     m_ghost_karts[kart_num].init(RaceManager::KT_GHOST);
     Controller* controller = new GhostController(getGhostKart(kart_num));
     getGhostKart(kart_num)->setController(controller);
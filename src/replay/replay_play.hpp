@@ -20,6 +20,7 @@
 #define HEADER_REPLAY__PLAY_HPP
 
 #include "karts/ghost_kart.hpp"
+#include "replay/ghost_timeline.hpp"
 #include "replay/replay_base.hpp"
 #include "utils/ptr_vector.hpp"
 
@@ -99,23 +100,23 @@ private:
     /** All ghost karts. */
     PtrVector<GhostKart>     m_ghost_karts;
 
+    /** The transforms of all ghost karts. */
+    GhostTimeline            m_ghost_timeline;
+
           ReplayPlay();
          ~ReplayPlay();
     void  readKartData(FILE *fd, char *next_line);
 public:
     void  reset();
+    void  update();
     void  load();
     void  loadAllReplayFile();
+    void  getReplayList(bool reverse, int difficulty,
+                        std::vector<unsigned int> *list) const;
+    static bool readHeader(const std::string &path, ReplayData *rd);
     // ------------------------------------------------------------------------
     static void        setSortOrder(SortOrder so)       { m_sort_order = so; }
     // ------------------------------------------------------------------------
-    void               sortReplay(bool reverse)
-    {
-        (reverse ? std::sort(m_replay_file_list.rbegin(),
-            m_replay_file_list.rend()) : std::sort(m_replay_file_list.begin(),
-            m_replay_file_list.end()));
-    }
-    // ------------------------------------------------------------------------
     void               setReplayFile(unsigned int n)
                                                 { m_current_replay_file = n; }
     // ------------------------------------------------------------------------
@@ -26,6 +26,7 @@
 #include "modes/world.hpp"
 #include "physics/btKart.hpp"
 #include "race/race_manager.hpp"
+#include "replay/replay_catalog.hpp"
 #include "tracks/track.hpp"
 
 #include <algorithm>
@@ -272,4 +273,6 @@ void ReplayRecorder::save()
         }   // for i
     }
     fclose(fd);
+    if (ReplayCatalog::get())
+        ReplayCatalog::get()->addFile(m_filename);
 }   // save
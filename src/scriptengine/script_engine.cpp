@@ -16,6 +16,7 @@
 //  along with this program; if not, write to the Free Software
 //  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
+#include <algorithm>
 #include <assert.h>
 #include <angelscript.h>
 #include "io/file_manager.hpp"
@@ -36,6 +37,7 @@
 #include "tracks/track_object_manager.hpp"
 #include "tracks/track.hpp"
 #include "utils/profiler.hpp"
+#include "utils/time.hpp"
 
 
 using namespace Scripting;
@@ -72,14 +74,60 @@ namespace Scripting
         // Configure the script engine with all the functions, 
         // and variables that the script should be able to use.
         configureEngine(m_engine);
+
+        // Reuse contexts from a pool instead of creating a new one for
+        // each call. This is also used by AngelScript itself, e.g. when
+        // calling script functions from the string and array add-ons.
+        m_engine->SetContextCallbacks(&ScriptEngine::requestContext,
+                                      &ScriptEngine::returnContext, this);
     }
 
     ScriptEngine::~ScriptEngine()
     {
+        for (unsigned int i = 0; i < m_context_pool.size(); i++)
+            m_context_pool[i]->Release();
+        m_context_pool.clear();
+
         // Release the engine
         m_engine->Release();
     }
 
+    //-----------------------------------------------------------------------------
+    /** Called by AngelScript (and from m_engine->RequestContext()) to get a
+     *  context. Returns an unused context from the pool, or creates a new
+     *  context if all pooled contexts are in use.
+     *  \param engine The AngelScript engine.
+     *  \param param The ScriptEngine this callback was registered for.
+     */
+    asIScriptContext* ScriptEngine::requestContext(asIScriptEngine *engine,
+                                                   void *param)
+    {
+        ScriptEngine *script_engine = static_cast<ScriptEngine*>(param);
+        std::vector<asIScriptContext*> &pool = script_engine->m_context_pool;
+        if (pool.empty())
+            return engine->CreateContext();
+
+        asIScriptContext *ctx = pool.back();
+        pool.pop_back();
+        return ctx;
+    }   // requestContext
+
+    //-----------------------------------------------------------------------------
+    /** Called when a context is not needed anymore. The context is
+     *  unprepared (which releases any objects it still references) and
+     *  added to the pool.
+     *  \param engine The AngelScript engine.
+     *  \param ctx The context that is returned.
+     *  \param param The ScriptEngine this callback was registered for.
+     */
+    void ScriptEngine::returnContext(asIScriptEngine *engine,
+                                     asIScriptContext *ctx, void *param)
+    {
+        ScriptEngine *script_engine = static_cast<ScriptEngine*>(param);
+        ctx->Unprepare();
+        script_engine->m_context_pool.push_back(ctx);
+    }   // returnContext
+
 
 
     /** Get Script By it's file name
@@ -131,11 +179,12 @@ namespace Scripting
             return;
         }
 
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = m_engine->RequestContext();
         if (ctx == NULL)
         {
             Log::error("Scripting", "evalScript: Failed to create the context.");
             //m_engine->Release();
+            func->Release();
             return;
         }
 
@@ -143,38 +192,52 @@ namespace Scripting
         if (r < 0)
         {
             Log::error("Scripting", "evalScript: Failed to prepare the context.");
-            ctx->Release();
+            m_engine->ReturnContext(ctx);
+            func->Release();
             return;
         }
 
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
+        executeContext(ctx);
 
-        ctx->Release();
+        m_engine->ReturnContext(ctx);
         func->Release();
     }
 
+    //-----------------------------------------------------------------------------
+    /** Executes a prepared context, and prints an error message if the
+     *  execution did not finish.
+     *  \param ctx The prepared context.
+     *  \return True if the script function finished.
+     */
+    bool ScriptEngine::executeContext(asIScriptContext *ctx)
+    {
+        int r = ctx->Execute();
+        if (r == asEXECUTION_FINISHED)
+            return true;
+
+        // The execution didn't finish as we had planned. Determine why.
+        if (r == asEXECUTION_ABORTED)
+        {
+            Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
+        }
+        else if (r == asEXECUTION_EXCEPTION)
+        {
+            Log::error("Scripting", "The script ended with an exception : (line %i) %s",
+                ctx->GetExceptionLineNumber(),
+                ctx->GetExceptionString());
+        }
+        else
+        {
+            Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
+        }
+        return false;
+    }   // executeContext
+
     //-----------------------------------------------------------------------------
 
     void ScriptEngine::runDelegate(asIScriptFunction* delegate)
     {
-        asIScriptContext *ctx = m_engine->CreateContext();
+        asIScriptContext *ctx = m_engine->RequestContext();
         if (ctx == NULL)
         {
             Log::error("Scripting", "runMethod: Failed to create the context.");
@@ -186,32 +249,13 @@ namespace Scripting
         if (r < 0)
         {
             Log::error("Scripting", "runMethod: Failed to prepare the context.");
-            ctx->Release();
+            m_engine->ReturnContext(ctx);
             return;
         }
 
-        // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception : (line %i) %s",
-                    ctx->GetExceptionLineNumber(), 
-                    ctx->GetExceptionString());
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
+        executeContext(ctx);
 
-        ctx->Release();
+        m_engine->ReturnContext(ctx);
     }
 
     //-----------------------------------------------------------------------------
@@ -286,28 +330,28 @@ namespace Scripting
 
     //-----------------------------------------------------------------------------
 
-    /** runs the specified script
-    *  \param string scriptName = name of script to run
-    */
-    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name,
-        std::function<void(asIScriptContext*)> callback,
-        std::function<void(asIScriptContext*)> get_return_value)
+    /** Returns the script function with the given declaration, or NULL if
+     *  the main module has no such function. The result is cached, so
+     *  callers can use this to avoid looking up a function they call often.
+     *  The function stays valid until cleanupCache() is called, so it must
+     *  be looked up after compileLoadedScripts().
+     *  \param warn_if_not_found Print a warning if the function is missing.
+     *  \param function_name Declaration of the function, e.g. "void onStart()".
+     */
+    asIScriptFunction* ScriptEngine::getFunction(bool warn_if_not_found,
+                                                 const std::string& function_name)
     {
-        int r; //int for error checking
-
         asIScriptFunction *func;
 
-        // TODO: allow splitting in multiple files
-        std::string script_filename = "scripting.as";
         auto cached_function = m_functions_cache.find(function_name);
         if (cached_function == m_functions_cache.end())
         {
             // Find the function for the function we want to execute.
             //      This is how you call a normal function with arguments
             //      asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void func(arg1Type, arg2Type)");
-            func = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE)
-                        ->GetFunctionByDecl(function_name.c_str());
-        
+            asIScriptModule *mod = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE);
+            func = mod ? mod->GetFunctionByDecl(function_name.c_str()) : NULL;
+
             if (func == NULL)
             {
                 if (warn_if_not_found)
@@ -315,7 +359,7 @@ namespace Scripting
                 else
                     Log::debug("Scripting", "Scripting function was not found : %s", function_name.c_str());
                 m_functions_cache[function_name] = NULL; // remember that this function is unavailable
-                return;
+                return NULL;
             }
 
             m_functions_cache[function_name] = func;
@@ -327,15 +371,41 @@ namespace Scripting
             func = cached_function->second;
         }
 
+        if (func == NULL && warn_if_not_found)
+            Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
+        return func;
+    }   // getFunction
+
+    //-----------------------------------------------------------------------------
+
+    /** runs the specified script
+    *  \param string scriptName = name of script to run
+    */
+    void ScriptEngine::runFunction(bool warn_if_not_found, std::string function_name,
+        std::function<void(asIScriptContext*)> callback,
+        std::function<void(asIScriptContext*)> get_return_value)
+    {
+        asIScriptFunction *func = getFunction(warn_if_not_found, function_name);
         if (func == NULL)
-        {
-            if (warn_if_not_found)
-                Log::warn("Scripting", "Scripting function was not found : %s", function_name.c_str());
             return; // function unavailable
-        }
 
-        // Create a context that will execute the script.
-        asIScriptContext *ctx = m_engine->CreateContext();
+        runFunction(func, callback, get_return_value);
+    }
+
+    //-----------------------------------------------------------------------------
+    /** Runs the given script function.
+     *  \param func The function to run, e.g. as returned by getFunction().
+     *  \param callback If set, called before the function is executed to set
+     *         the arguments.
+     *  \param get_return_value If set, called after the function finished
+     *         to get the return value.
+     */
+    void ScriptEngine::runFunction(asIScriptFunction* func,
+        std::function<void(asIScriptContext*)> callback,
+        std::function<void(asIScriptContext*)> get_return_value)
+    {
+        // Get a context that will execute the script.
+        asIScriptContext *ctx = m_engine->RequestContext();
         if (ctx == NULL)
         {
             Log::error("Scripting", "Failed to create the context.");
@@ -348,11 +418,11 @@ namespace Scripting
         // executed. Note, that if because we intend to execute the same function 
         // several times, we will store the function returned by 
         // GetFunctionByDecl(), so that this relatively slow call can be skipped.
-        r = ctx->Prepare(func);
+        int r = ctx->Prepare(func);
         if (r < 0)
         {
             Log::error("Scripting", "Failed to prepare the context.");
-            ctx->Release();
+            m_engine->ReturnContext(ctx);
             //m_engine->Release();
             return;
         }
@@ -365,32 +435,7 @@ namespace Scripting
             callback(ctx);
 
         // Execute the function
-        r = ctx->Execute();
-        if (r != asEXECUTION_FINISHED)
-        {
-            // The execution didn't finish as we had planned. Determine why.
-            if (r == asEXECUTION_ABORTED)
-            {
-                Log::error("Scripting", "The script was aborted before it could finish. Probably it timed out.");
-            }
-            else if (r == asEXECUTION_EXCEPTION)
-            {
-                Log::error("Scripting", "The script ended with an exception.");
-
-                // Write some information about the script exception
-                asIScriptFunction *func = ctx->GetExceptionFunction();
-                //std::cout << "func: " << func->GetDeclaration() << std::endl;
-                //std::cout << "modl: " << func->GetModuleName() << std::endl;
-                //std::cout << "sect: " << func->GetScriptSectionName() << std::endl;
-                //std::cout << "line: " << ctx->GetExceptionLineNumber() << std::endl;
-                //std::cout << "desc: " << ctx->GetExceptionString() << std::endl;
-            }
-            else
-            {
-                Log::error("Scripting", "The script ended for some unforeseen reason (%i)", r);
-            }
-        }
-        else
+        if (executeContext(ctx))
         {
             // Retrieve the return value from the context here (for scripts that return values)
             // <type> returnValue = ctx->getReturnType(); for example
@@ -400,8 +445,8 @@ namespace Scripting
                 get_return_value(ctx);
         }
 
-        // We must release the contexts when no longer using them
-        ctx->Release();
+        // Contexts are returned to the pool when no longer used
+        m_engine->ReturnContext(ctx);
     }
 
     //-----------------------------------------------------------------------------
@@ -493,6 +538,8 @@ namespace Scripting
             return false;
         }
 
+        cacheModuleFunctions();
+
         // The engine doesn't keep a copy of the script sections after Build() has
         // returned. So if the script needs to be recompiled, then all the script
         // sections must be added again.
@@ -506,6 +553,38 @@ namespace Scripting
         return true;
     }
 
+    //-----------------------------------------------------------------------------
+    /** Adds all global functions of the main module to the function cache,
+     *  so that calling a script function does not need to look up its
+     *  declaration in the module first. Declarations given by the caller
+     *  that are written differently are still looked up in getFunction().
+     */
+    void ScriptEngine::cacheModuleFunctions()
+    {
+        for (auto curr : m_functions_cache)
+        {
+            if (curr.second != NULL)
+                curr.second->Release();
+        }
+        m_functions_cache.clear();
+
+        asIScriptModule *mod = m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE,
+                                                   asGM_ONLY_IF_EXISTS);
+        if (mod == NULL)
+            return;
+
+        for (unsigned int i = 0; i < mod->GetFunctionCount(); i++)
+        {
+            asIScriptFunction *func = mod->GetFunctionByIndex(i);
+            std::string decl = func->GetDeclaration(/*includeObjectName*/true,
+                                                    /*includeNamespace*/true);
+            if (m_functions_cache.find(decl) != m_functions_cache.end())
+                continue;
+            m_functions_cache[decl] = func;
+            func->AddRef();
+        }
+    }   // cacheModuleFunctions
+
     //-----------------------------------------------------------------------------
 
     PendingTimeout::PendingTimeout(double time, asIScriptFunction* callback_delegate) 
@@ -562,4 +641,88 @@ namespace Scripting
             }
         }
     }
+
+    //-----------------------------------------------------------------------------
+    /** Tests the function cache and the context pool, and prints the number
+     *  of script function calls per second.
+     */
+    void ScriptEngine::unitTesting()
+    {
+        ScriptEngine *script_engine = new ScriptEngine();
+        asIScriptModule *mod =
+            script_engine->m_engine->GetModule(MODULE_ID_MAIN_SCRIPT_FILE,
+                                               asGM_ALWAYS_CREATE);
+        const char *script =
+            "int counter = 0;\n"
+            "void increase() { counter++; }\n"
+            "int add(int a, int b) { return a + b; }\n"
+            "int getCounter() { return counter; }\n";
+        int r = mod->AddScriptSection("unit_test", script);
+        assert(r >= 0);
+        bool ok = script_engine->compileLoadedScripts();
+        assert(ok);
+
+        // All functions of the module must be cached after building.
+        assert(script_engine->m_functions_cache.size() == 3);
+        asIScriptFunction *increase =
+            script_engine->getFunction(true, "void increase()");
+        asIScriptFunction *add =
+            script_engine->getFunction(true, "int add(int, int)");
+        assert(increase != NULL && add != NULL);
+        assert(script_engine->getFunction(false, "void doesNotExist()") == NULL);
+
+        int result = 0;
+        script_engine->runFunction(add,
+            [](asIScriptContext* ctx) { ctx->SetArgDWord(0, 3);
+                                        ctx->SetArgDWord(1, 4); },
+            [&](asIScriptContext* ctx) { result = (int)ctx->GetReturnDWord(); });
+        assert(result == 7);
+        // Only one context is needed for consecutive calls.
+        assert(script_engine->m_context_pool.size() == 1);
+
+        // A call made while a context is in use must use a second context,
+        // and the result of the outer call must not be affected.
+        int nested = 0;
+        script_engine->runFunction(add,
+            [](asIScriptContext* ctx) { ctx->SetArgDWord(0, 1);
+                                        ctx->SetArgDWord(1, 2); },
+            [&](asIScriptContext* ctx)
+            {
+                script_engine->runFunction(true, "int add(int, int)",
+                    [](asIScriptContext* ctx2) { ctx2->SetArgDWord(0, 10);
+                                                 ctx2->SetArgDWord(1, 20); },
+                    [&](asIScriptContext* ctx2)
+                    {
+                        nested = (int)ctx2->GetReturnDWord();
+                    });
+                result = (int)ctx->GetReturnDWord();
+            });
+        assert(result == 3 && nested == 30);
+        assert(script_engine->m_context_pool.size() == 2);
+
+        const int num_calls = 100000;
+        double start = StkTime::getRealTime();
+        for (int i = 0; i < num_calls; i++)
+            script_engine->runFunction(increase, nullptr, nullptr);
+        double cached_time = StkTime::getRealTime() - start;
+
+        start = StkTime::getRealTime();
+        for (int i = 0; i < num_calls; i++)
+            script_engine->runFunction(true, "void increase()");
+        double by_name_time = StkTime::getRealTime() - start;
+
+        int counter = 0;
+        script_engine->runFunction(true, "int getCounter()", nullptr,
+            [&](asIScriptContext* ctx) { counter = (int)ctx->GetReturnDWord(); });
+        assert(counter == 2 * num_calls);
+        assert(script_engine->m_context_pool.size() == 2);
+
+        Log::info("ScriptEngine", "%d calls: %.0f calls/s with handle, "
+                  "%.0f calls/s by declaration.", num_calls,
+                  num_calls / std::max(cached_time, 1e-6),
+                  num_calls / std::max(by_name_time, 1e-6));
+
+        script_engine->cleanupCache();
+        delete script_engine;
+    }   // unitTesting
 }
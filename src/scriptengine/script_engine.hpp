@@ -22,6 +22,7 @@
 #include <string>
 #include <angelscript.h>
 #include <functional>
+#include <vector>
 
 #include "scriptengine/script_utils.hpp"
 #include "utils/ptr_vector.hpp"
@@ -66,6 +67,11 @@ namespace Scripting
         void runFunction(bool warn_if_not_found, std::string function_name,
             std::function<void(asIScriptContext*)> callback,
             std::function<void(asIScriptContext*)> get_return_value);
+        void runFunction(asIScriptFunction* func,
+            std::function<void(asIScriptContext*)> callback,
+            std::function<void(asIScriptContext*)> get_return_value);
+        asIScriptFunction* getFunction(bool warn_if_not_found,
+                                       const std::string& function_name);
         void runDelegate(asIScriptFunction* delegate_fn);
         void evalScript(std::string script_fragment);
         void cleanupCache();
@@ -79,12 +85,29 @@ namespace Scripting
 
         asIScriptEngine* getEngine() { return m_engine; }
 
+        static void unitTesting();
+
     private:
         asIScriptEngine *m_engine;
+        /** Maps the declaration of a function to the function. All functions
+         *  of the main module are added when it is built, functions that
+         *  are not found are stored as NULL. */
         std::map<std::string, asIScriptFunction*> m_functions_cache;
         PtrVector<PendingTimeout> m_pending_timeouts;
 
+        /** Contexts that are not in use, to avoid creating a new context
+         *  for each function call. A call made while another script is
+         *  running (e.g. a script calling a function that runs another
+         *  script) simply takes a different context from the pool. */
+        std::vector<asIScriptContext*> m_context_pool;
+
         void configureEngine(asIScriptEngine *engine);
+        void cacheModuleFunctions();
+        bool executeContext(asIScriptContext *ctx);
+        static asIScriptContext* requestContext(asIScriptEngine *engine,
+                                                void *param);
+        static void returnContext(asIScriptEngine *engine,
+                                  asIScriptContext *ctx, void *param);
     };   // class ScriptEngine
 
 }
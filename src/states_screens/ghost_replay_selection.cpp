@@ -96,16 +96,16 @@ void GhostReplaySelection::init()
  */
 void GhostReplaySelection::loadList()
 {
-    ReplayPlay::get()->sortReplay(m_sort_desc);
+    std::vector<unsigned int> list;
+    ReplayPlay::get()->getReplayList(m_sort_desc,
+                                     m_same_difficulty ? m_cur_difficulty : -1,
+                                     &list);
     m_replay_list_widget->clear();
-    for (unsigned int i = 0; i < ReplayPlay::get()->getNumReplayFile() ; i++)
+    for (unsigned int n = 0; n < list.size(); n++)
     {
+        unsigned int i = list[n];
         const ReplayPlay::ReplayData& rd = ReplayPlay::get()->getReplayData(i);
 
-        if (m_same_difficulty && m_cur_difficulty !=
-            (RaceManager::Difficulty)rd.m_difficulty)
-            continue;
-
         std::vector<GUIEngine::ListWidget::ListCell> row;
         Track* t = track_manager->getTrack(rd.m_track_name);
         row.push_back(GUIEngine::ListWidget::ListCell
@@ -29,6 +29,8 @@
 #include "graphics/camera_end.hpp"
 #include "graphics/CBatchingMesh.hpp"
 #include "graphics/central_settings.hpp"
+#include "graphics/cooked_mesh.hpp"
+#include "graphics/culling_tree.hpp"
 #include "graphics/glwrap.hpp"
 #include "graphics/irr_driver.hpp"
 #include "graphics/lod_node.hpp"
@@ -64,6 +66,7 @@
 #include "utils/constants.hpp"
 #include "utils/log.hpp"
 #include "utils/string_utils.hpp"
+#include "utils/time.hpp"
 #include "utils/translation.hpp"
 
 #include <IBillboardTextSceneNode.h>
@@ -145,6 +148,7 @@ Track::Track(const std::string &filename)
     m_minimap_x_scale       = 1.0f;
     m_minimap_y_scale       = 1.0f;
     m_startup_run = false;
+    m_start_function = NULL;
     m_default_number_of_laps= 3;
     m_all_nodes.clear();
     m_static_physics_only_nodes.clear();
@@ -294,6 +298,7 @@ void Track::cleanup()
     }
     m_animated_textures.clear();
 
+    irr_driver->getCullingTree()->clear();
     for (unsigned int i = 0; i < m_all_nodes.size(); i++)
     {
         irr_driver->removeNode(m_all_nodes[i]);
@@ -1077,10 +1082,22 @@ bool Track::loadMainTrack(const XMLNode &root)
     track_node->get("model", &model_name);
     std::string full_path = m_root+model_name;
 
-    scene::IMesh *mesh;
+    double load_start = StkTime::getRealTime();
+    // First try the cooked version of the mesh, which is already batched
+    // (see below), or load and cook the mesh if it is not cooked yet.
+    bool was_cooked = false;
+    scene::IMesh *merged_mesh = NULL;
+    if (UserConfigParams::m_cooked_meshes)
+        merged_mesh = CookedMesh::getMesh(full_path, &was_cooked);
+
+    scene::IMesh *mesh = NULL;
     // If the hd texture option is disabled, we generate smaller textures
     // and configure the path to them before loading the mesh.
-    if ( (UserConfigParams::m_high_definition_textures & 0x01) == 0x00)
+    if (merged_mesh)
+    {
+        // Nothing to do, the mesh was loaded from the cooked file.
+    }
+    else if ( (UserConfigParams::m_high_definition_textures & 0x01) == 0x00)
     {
 #undef USE_RESIZE_CACHE
 #ifdef USE_RESIZE_CACHE
@@ -1104,7 +1121,7 @@ bool Track::loadMainTrack(const XMLNode &root)
         mesh = irr_driver->getMesh(full_path);
     }
 
-    if(!mesh)
+    if(!mesh && !merged_mesh)
     {
         Log::fatal("track",
                    "Main track model '%s' in '%s' not found, aborting.\n",
@@ -1119,9 +1136,17 @@ bool Track::loadMainTrack(const XMLNode &root)
     // So till we have a better b3d exporter which can combine the different
     // meshes which use the same texture when exporting, the meshes are
     // combined using CBatchingMesh.
-    scene::CBatchingMesh *merged_mesh = new scene::CBatchingMesh();
-    merged_mesh->addMesh(mesh);
-    merged_mesh->finalize();
+    if (!merged_mesh)
+    {
+        scene::CBatchingMesh *batching_mesh = new scene::CBatchingMesh();
+        batching_mesh->addMesh(mesh);
+        batching_mesh->finalize();
+        merged_mesh = batching_mesh;
+    }
+    Log::info("Track", "Loading main track model '%s' (%s) took %.1f ms.",
+              model_name.c_str(),
+              was_cooked ? "cooked" : (mesh ? "b3d" : "b3d, now cooked"),
+              (StkTime::getRealTime() - load_start)*1000.0);
 
     scene::IMesh* tangent_mesh = MeshTools::createMeshWithTangents(merged_mesh, &MeshTools::isNormalMap);
 
@@ -1139,7 +1164,8 @@ bool Track::loadMainTrack(const XMLNode &root)
 
     // The reference count of the mesh is 1, since it is in irrlicht's
     // cache. So we only have to remove it from the cache.
-    irr_driver->removeMeshFromCache(mesh);
+    if (mesh)
+        irr_driver->removeMeshFromCache(mesh);
 
 #ifdef DEBUG
     std::string debug_name=model_name+" (main track, octtree)";
@@ -1429,8 +1455,11 @@ void Track::update(float dt)
 {
     if (!m_startup_run) // first time running update = good point to run startup script
     {
-        Scripting::ScriptEngine* script_engine = World::getWorld()->getScriptEngine();
-        script_engine->runFunction(false, "void onStart()");
+        if (m_start_function)
+        {
+            World::getWorld()->getScriptEngine()
+                ->runFunction(m_start_function, nullptr, nullptr);
+        }
         m_startup_run = true;
     }
     m_track_object_manager->update(dt);
@@ -1743,7 +1772,12 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
 
     model_def_loader.cleanLibraryNodesAfterLoad();
 
-    World::getWorld()->getScriptEngine()->compileLoadedScripts();
+    Scripting::ScriptEngine *script_engine =
+        World::getWorld()->getScriptEngine();
+    script_engine->compileLoadedScripts();
+    // Look up the functions called by the engine once, not on each call
+    m_start_function = script_engine->getFunction(false, "void onStart()");
+    World::getWorld()->getPhysics()->initScriptFunctions();
 
     // Init all track objects
     m_track_object_manager->init();
@@ -1922,6 +1956,9 @@ void Track::loadTrackModel(bool reverse_track, unsigned int mode_id)
         easter_world->readData(dir+"/easter_eggs.xml");
     }
 
+    // The static track nodes are put into a tree for faster culling
+    irr_driver->getCullingTree()->setNodes(m_all_nodes);
+
     irr_driver->unsetTextureErrorMessage();
 }   // loadTrackModel
 
@@ -49,6 +49,7 @@ class ModelDefinitionLoader;
 #include "utils/ptr_vector.hpp"
 
 class AnimationManager;
+class asIScriptFunction;
 class BezierCurve;
 class CheckManager;
 class MovingTexture;
@@ -132,6 +133,10 @@ private:
 
     /* For running the startup script */
     bool m_startup_run;
+
+    /** The script function run at the start of the race, or NULL. */
+    asIScriptFunction* m_start_function;
+
     /** The full filename of the config (xml) file. */
     std::string              m_filename;
 
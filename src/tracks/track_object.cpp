@@ -288,6 +288,12 @@ void TrackObject::init(const XMLNode &xml_node, scene::ISceneNode* parent,
 
 void TrackObject::onWorldReady()
 {
+    // The scripts are compiled now, so the script functions can be found
+    if (m_physical_object)
+        m_physical_object->initScriptFunctions();
+    if (m_presentation)
+        m_presentation->onWorldReady();
+
     if (m_visibility_condition == "false")
     {
         m_initially_visible = false;
@@ -328,16 +334,21 @@ void TrackObject::onWorldReady()
         }
 
         TrackObject* self = this;
-        script_engine->runFunction(true, fn_signature.str(),
-            [&](asIScriptContext* ctx) 
-            {
-                for (unsigned int i = 0; i < arguments.size(); i++)
+        asIScriptFunction *func = script_engine->getFunction(true,
+                                                         fn_signature.str());
+        if (func)
+        {
+            script_engine->runFunction(func,
+                [&](asIScriptContext* ctx) 
                 {
-                    ctx->SetArgObject(i, &arguments[i]);
-                }
-                ctx->SetArgObject(arguments.size(), self);
-            },
-            [&](asIScriptContext* ctx) { result = ctx->GetReturnByte(); });
+                    for (unsigned int i = 0; i < arguments.size(); i++)
+                    {
+                        ctx->SetArgObject(i, &arguments[i]);
+                    }
+                    ctx->SetArgObject(arguments.size(), self);
+                },
+                [&](asIScriptContext* ctx) { result = ctx->GetReturnByte(); });
+        }
 
         if (result == 0)
             m_initially_visible = false;
@@ -434,6 +445,18 @@ void TrackObject::update(float dt)
     if (m_animator) m_animator->update(dt);
 }   // update
 
+// ----------------------------------------------------------------------------
+/** Returns true if update() does anything for this object, i.e. if it is
+ *  animated, moved by the physics, or has a presentation that changes over
+ *  time. All other objects are static and never updated.
+ */
+bool TrackObject::needsUpdate() const
+{
+    if (m_animator) return true;
+    if (m_presentation && m_presentation->needsUpdate()) return true;
+    return m_physical_object && m_physical_object->isDynamic();
+}   // needsUpdate
+
 
 // ----------------------------------------------------------------------------
 /** Does a raycast against the track object. The object must have a physical
@@ -27,10 +27,36 @@
 #include "physics/physical_object.hpp"
 #include "tracks/track_object.hpp"
 #include "utils/log.hpp"
+#include "utils/time.hpp"
 
 #include <IMeshSceneNode.h>
 #include <ISceneManager.h>
 
+#include <assert.h>
+
+namespace
+{
+    /** A presentation that only counts how often it is updated, used in
+     *  the unit test. */
+    class CountingPresentation : public TrackObjectPresentation
+    {
+    private:
+        unsigned int *m_counter;
+        bool          m_needs_update;
+    public:
+        CountingPresentation(unsigned int *counter, bool needs_update)
+            : TrackObjectPresentation(core::vector3df(0, 0, 0))
+        {
+            m_counter      = counter;
+            m_needs_update = needs_update;
+        }   // CountingPresentation
+        // --------------------------------------------------------------------
+        virtual void update(float dt) OVERRIDE { (*m_counter)++; }
+        // --------------------------------------------------------------------
+        virtual bool needsUpdate() const OVERRIDE { return m_needs_update; }
+    };   // CountingPresentation
+}   // namespace
+
 TrackObjectManager::TrackObjectManager()
 {
 }   // TrackObjectManager
@@ -51,9 +77,7 @@ void TrackObjectManager::add(const XMLNode &xml_node, scene::ISceneNode* parent,
     try
     {
         TrackObject *obj = new TrackObject(xml_node, parent, model_def_loader, parent_library, ri);
-        m_all_objects.push_back(obj);
-        if(obj->isDriveable())
-            m_driveable_objects.push_back(obj);
+        addToLists(obj);
     }
     catch (std::exception& e)
     {
@@ -62,6 +86,23 @@ void TrackObjectManager::add(const XMLNode &xml_node, scene::ISceneNode* parent,
     }
 }   // add
 
+// ----------------------------------------------------------------------------
+/** Adds an object to the list of all objects, and to the lists of objects
+ *  that need special handling (driveable, updated every frame, moved by
+ *  the physics).
+ *  \param obj The object to add.
+ */
+void TrackObjectManager::addToLists(TrackObject *obj)
+{
+    m_all_objects.push_back(obj);
+    if(obj->isDriveable())
+        m_driveable_objects.push_back(obj);
+    if(obj->needsUpdate())
+        m_active_objects.push_back(obj);
+    if(obj->getPhysicalObject() && obj->getPhysicalObject()->isDynamic())
+        m_dynamic_objects.push_back(obj);
+}   // addToLists
+
 // ----------------------------------------------------------------------------
 /** Initialises all track objects.
  */
@@ -119,7 +160,8 @@ TrackObject* TrackObjectManager::getTrackObject(const std::string& libraryInstan
     return NULL;
 }
 /** Handles an explosion, i.e. it makes sure that all physical objects are
- *  affected accordingly.
+ *  affected accordingly. Only objects moved by the physics can be affected
+ *  by an explosion, so static objects are not considered.
  *  \param pos  Position of the explosion.
  *  \param obj  If the hit was a physical object, this object will be affected
  *              more. Otherwise this is NULL.
@@ -131,7 +173,7 @@ void TrackObjectManager::handleExplosion(const Vec3 &pos, const PhysicalObject *
                                          bool secondary_hits)
 {
     TrackObject* curr;
-    for_in (curr, m_all_objects)
+    for_in (curr, m_dynamic_objects)
     {
         if(secondary_hits || mp == curr->getPhysicalObject())
             curr->handleExplosion(pos, mp == curr->getPhysicalObject());
@@ -139,13 +181,15 @@ void TrackObjectManager::handleExplosion(const Vec3 &pos, const PhysicalObject *
 }   // handleExplosion
 
 // ----------------------------------------------------------------------------
-/** Updates all track objects.
+/** Updates all track objects that are not static. Physical objects that
+ *  were deactivated by bullet are still updated, but return immediately
+ *  (see PhysicalObject::update).
  *  \param dt Time step size.
  */
 void TrackObjectManager::update(float dt)
 {
     TrackObject* curr;
-    for_in (curr, m_all_objects)
+    for_in (curr, m_active_objects)
     {
         curr->update(dt);
     }
@@ -275,8 +319,8 @@ void TrackObjectManager::enableFog(bool enable)
 
 void TrackObjectManager::insertObject(TrackObject* object)
 {
-    m_all_objects.push_back(object);
-}
+    addToLists(object);
+}   // insertObject
 
 // ----------------------------------------------------------------------------
 /** Removes the object from the scene graph, bullet, and the list of
@@ -285,10 +329,74 @@ void TrackObjectManager::insertObject(TrackObject* object)
  */
 void TrackObjectManager::removeObject(TrackObject* obj)
 {
+    m_driveable_objects.remove(obj);
+    m_active_objects.remove(obj);
+    m_dynamic_objects.remove(obj);
     m_all_objects.remove(obj);
     delete obj;
 }   // removeObject
 
 // ----------------------------------------------------------------------------
+/** Checks that only objects that need an update are updated, and compares
+ *  the time of an update with the time needed to update all objects (as it
+ *  was done before static objects were skipped).
+ */
+void TrackObjectManager::unitTesting()
+{
+    const unsigned int num_static = 20000;
+    const unsigned int num_active = 100;
+    const unsigned int num_frames = 100;
+
+    unsigned int static_updates = 0, active_updates = 0;
+    TrackObjectManager *tom = new TrackObjectManager();
+    std::vector<TrackObject*> active;
+    for (unsigned int i = 0; i < num_static + num_active; i++)
+    {
+        // Mix the active objects between the static ones
+        bool is_active = i % ((num_static + num_active) / num_active) == 0;
+        TrackObjectPresentation *presentation =
+            new CountingPresentation(is_active ? &active_updates
+                                               : &static_updates,
+                                     is_active);
+        TrackObject *obj = new TrackObject(core::vector3df(0, 0, 0),
+                                           core::vector3df(0, 0, 0),
+                                           core::vector3df(1, 1, 1),
+                                           "none", presentation,
+                                           /*is_dynamic*/false,
+                                           /*physics settings*/NULL);
+        tom->insertObject(obj);
+        if (is_active)
+            active.push_back(obj);
+    }
+    assert(tom->getNumActiveObjects() == num_active);
+
+    double start = StkTime::getRealTime();
+    for (unsigned int frame = 0; frame < num_frames; frame++)
+        tom->update(1.0f / 60.0f);
+    double active_time = StkTime::getRealTime() - start;
+    assert(static_updates == 0);
+    assert(active_updates == num_active * num_frames);
+
+    // Update all objects, which is what update() did for all objects
+    start = StkTime::getRealTime();
+    for (unsigned int frame = 0; frame < num_frames; frame++)
+    {
+        for (TrackObject *curr : tom->m_all_objects)
+            curr->update(1.0f / 60.0f);
+    }
+    double all_time = StkTime::getRealTime() - start;
+    assert(static_updates == num_static * num_frames);
 
+    // A removed object must not be updated anymore
+    tom->removeObject(active[0]);
+    assert(tom->getNumActiveObjects() == num_active - 1);
+    active_updates = 0;
+    tom->update(1.0f / 60.0f);
+    assert(active_updates == num_active - 1);
 
+    Log::info("TrackObjectManager", "Updating %u of %u objects: %f ms per "
+              "frame (%f ms when updating all objects).", num_active,
+              num_static + num_active, active_time * 1000.0 / num_frames,
+              all_time * 1000.0 / num_frames);
+    delete tom;
+}   // unitTesting
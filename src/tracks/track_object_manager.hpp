@@ -52,6 +52,18 @@ protected:
     /** A second list which holds all objects that karts can drive on. */
     PtrVector<TrackObject, REF> m_driveable_objects;
 
+    /** All objects that need to be updated every frame (animated objects,
+     *  objects moved by the physics, sound emitters, ...). All other
+     *  objects are static and are never updated, so the cost per frame
+     *  only depends on the number of these objects. */
+    PtrVector<TrackObject, REF> m_active_objects;
+
+    /** All objects that are moved by the physics, i.e. can be affected
+     *  by an explosion. */
+    PtrVector<TrackObject, REF> m_dynamic_objects;
+
+    void addToLists(TrackObject *obj);
+
 public:
          TrackObjectManager();
         ~TrackObjectManager();
@@ -77,8 +89,16 @@ public:
 
     TrackObject* getTrackObject(const std::string& libraryInstance, const std::string& name);
 
+    static void unitTesting();
+
           PtrVector<TrackObject>& getObjects()       { return m_all_objects; }
     const PtrVector<TrackObject>& getObjects() const { return m_all_objects; }
+    // ------------------------------------------------------------------------
+    /** Returns the number of objects that are updated every frame. */
+    unsigned int getNumActiveObjects() const
+    {
+        return m_active_objects.size();
+    }   // getNumActiveObjects
 
 };   // class TrackObjectManager
 
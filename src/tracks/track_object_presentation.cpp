@@ -1024,7 +1024,9 @@ TrackObjectPresentationActionTrigger::TrackObjectPresentationActionTrigger(
         assert(false);
     }
 
-    m_action_active = true;
+    m_action_active   = true;
+    // The scripts are not compiled yet, see onWorldReady()
+    m_action_function = NULL;
 
     if (m_action.size() == 0)
         Log::warn("TrackObject", "Action-trigger has no action defined.");
@@ -1060,8 +1062,20 @@ TrackObjectPresentationActionTrigger::TrackObjectPresentationActionTrigger(
     m_action_active        = true;
     m_type                 = TRIGGER_TYPE_POINT;
     ItemManager::get()->newItem(m_init_xyz, trigger_distance, this);
+    // This trigger is created by a script, so the scripts are compiled
+    onWorldReady();
 }   // TrackObjectPresentationActionTrigger
 
+// ----------------------------------------------------------------------------
+/** Looks up the script function of the action, so that it is not looked up
+ *  each time the trigger is approached.
+ */
+void TrackObjectPresentationActionTrigger::onWorldReady()
+{
+    m_action_function = World::getWorld()->getScriptEngine()
+                      ->getFunction(true, "void " + m_action + "(int)");
+}   // onWorldReady
+
 // ----------------------------------------------------------------------------
 void TrackObjectPresentationActionTrigger::onTriggerItemApproached()
 {
@@ -1074,6 +1088,10 @@ void TrackObjectPresentationActionTrigger::onTriggerItemApproached()
     Camera* camera = Camera::getActiveCamera();
     if (camera != NULL && camera->getKart() != NULL)
         idKart = camera->getKart()->getWorldKartId();
-    script_engine->runFunction(true, "void " + m_action + "(int)",
-        [=](asIScriptContext* ctx) { ctx->SetArgDWord(0, idKart); });
+    if (m_action_function)
+    {
+        script_engine->runFunction(m_action_function,
+            [=](asIScriptContext* ctx) { ctx->SetArgDWord(0, idKart); },
+            nullptr);
+    }
 }   // onTriggerItemApproached
@@ -32,6 +32,7 @@
 
 #include <string>
 
+class asIScriptFunction;
 class SFXBase;
 class ParticleEmitter;
 class PhysicalObject;
@@ -82,11 +83,18 @@ public:
     // ------------------------------------------------------------------------
 
     virtual void reset() {}
+    /** Called once the world (including the scripts) is loaded. */
+    virtual void onWorldReady() {}
     virtual void setEnable(bool enabled)
     {
         Log::warn("TrackObjectPresentation", "setEnable unimplemented for this presentation type");
     }
     virtual void update(float dt) {}
+    // ------------------------------------------------------------------------
+    /** Returns true if update() must be called every frame. Objects whose
+     *  presentation returns false (and which are not animated or moved by
+     *  the physics) are never updated by the TrackObjectManager. */
+    virtual bool needsUpdate() const { return false; }
     virtual void move(const core::vector3df& xyz, const core::vector3df& hpr,
         const core::vector3df& scale, bool isAbsoluteCoord) {}
 
@@ -296,6 +304,9 @@ public:
 
     virtual void setEnable(bool enabled) OVERRIDE;
 
+    // ------------------------------------------------------------------------
+    /** The muting state of a sound must be updated when the listener moves. */
+    virtual bool needsUpdate() const OVERRIDE { return m_sound != NULL; }
     // ------------------------------------------------------------------------
     /** Currently used for sound effects only, in cutscenes only atm */
     const std::string& getTriggerCondition() const { return m_trigger_condition; }
@@ -319,6 +330,8 @@ public:
                                      scene::ISceneNode* parent);
     virtual ~TrackObjectPresentationBillboard();
     virtual void update(float dt) OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual bool needsUpdate() const OVERRIDE { return m_fade_out_when_close; }
 };   // TrackObjectPresentationBillboard
 
 
@@ -341,6 +354,9 @@ public:
     virtual ~TrackObjectPresentationParticles();
 
     virtual void update(float dt) OVERRIDE;
+    // ------------------------------------------------------------------------
+    virtual bool needsUpdate() const OVERRIDE { return true; }
+    // ------------------------------------------------------------------------
     void triggerParticles();
     void stop();
     void stopIn(double delay);
@@ -386,6 +402,9 @@ private:
     /** For action trigger objects */
     std::string m_action;
 
+    /** The script function of m_action, or NULL if it does not exist. */
+    asIScriptFunction* m_action_function;
+
     bool m_action_active;
 
     ActionTriggerType m_type;
@@ -399,6 +418,7 @@ public:
     virtual ~TrackObjectPresentationActionTrigger() {}
 
     virtual void onTriggerItemApproached() OVERRIDE;
+    virtual void onWorldReady() OVERRIDE;
     // ------------------------------------------------------------------------
     /** Reset the trigger (i.e. sets it to active again). */
     virtual void reset() OVERRIDE { m_action_active = true; }
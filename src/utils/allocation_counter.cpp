@@ -0,0 +1,137 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/allocation_counter.hpp"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+namespace
+{
+    /** Number of calls to operator new while counting. Both are constant
+     *  initialised, so they can be used before any static constructor
+     *  runs. */
+    std::atomic<uint32_t> g_num_allocations(0);
+    std::atomic<bool>     g_counting(false);
+
+    // ------------------------------------------------------------------------
+    void *allocate(size_t size)
+    {
+        if (g_counting.load(std::memory_order_relaxed))
+            g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+        return malloc(size > 0 ? size : 1);
+    }   // allocate
+}   // namespace
+
+// ----------------------------------------------------------------------------
+void* operator new(size_t size)
+{
+    void *p = allocate(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}   // operator new
+
+// ----------------------------------------------------------------------------
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}   // operator new[]
+
+// ----------------------------------------------------------------------------
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    return allocate(size);
+}   // operator new(nothrow)
+
+// ----------------------------------------------------------------------------
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    return allocate(size);
+}   // operator new[](nothrow)
+
+// ----------------------------------------------------------------------------
+void operator delete(void *p) throw()
+{
+    free(p);
+}   // operator delete
+
+// ----------------------------------------------------------------------------
+void operator delete[](void *p) throw()
+{
+    free(p);
+}   // operator delete[]
+
+// ----------------------------------------------------------------------------
+void operator delete(void *p, const std::nothrow_t&) throw()
+{
+    free(p);
+}   // operator delete(nothrow)
+
+// ----------------------------------------------------------------------------
+void operator delete[](void *p, const std::nothrow_t&) throw()
+{
+    free(p);
+}   // operator delete[](nothrow)
+
+#endif   // COUNT_ALLOCATIONS
+
+// ============================================================================
+/** Returns true if STK was built with COUNT_ALLOCATIONS, otherwise no
+ *  allocations are counted. */
+bool AllocationCounter::isAvailable()
+{
+#ifdef COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}   // isAvailable
+
+// ----------------------------------------------------------------------------
+/** Starts counting the allocations. */
+void AllocationCounter::start()
+{
+#ifdef COUNT_ALLOCATIONS
+    g_counting.store(true, std::memory_order_relaxed);
+#endif
+}   // start
+
+// ----------------------------------------------------------------------------
+/** Stops counting the allocations. */
+void AllocationCounter::stop()
+{
+#ifdef COUNT_ALLOCATIONS
+    g_counting.store(false, std::memory_order_relaxed);
+#endif
+}   // stop
+
+// ----------------------------------------------------------------------------
+/** Returns the number of allocations counted so far. The counter wraps
+ *  around, so only differences should be used. */
+uint32_t AllocationCounter::getNumAllocations()
+{
+#ifdef COUNT_ALLOCATIONS
+    return g_num_allocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}   // getNumAllocations
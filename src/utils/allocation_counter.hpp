@@ -0,0 +1,42 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_ALLOCATION_COUNTER_HPP
+#define HEADER_ALLOCATION_COUNTER_HPP
+
+#include "utils/types.hpp"
+
+/**
+  * \brief Counts the calls to the global operator new, e.g. to measure the
+  *  allocations per frame of a profile run (see FrameStats).
+  *  The global operator new is only replaced if STK is built with the
+  *  CMake option COUNT_ALLOCATIONS, since this affects every allocation of
+  *  the game and of all libraries. Even then allocations are only counted
+  *  between start() and stop(). The memory itself still comes from malloc.
+  * \ingroup utils
+  */
+class AllocationCounter
+{
+public:
+    static bool     isAvailable();
+    static void     start();
+    static void     stop();
+    static uint32_t getNumAllocations();
+};   // AllocationCounter
+
+#endif
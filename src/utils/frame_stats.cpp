@@ -0,0 +1,297 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#include "utils/frame_stats.hpp"
+
+#include "utils/allocation_counter.hpp"
+#include "utils/log.hpp"
+#include "utils/string_utils.hpp"
+#include "utils/time.hpp"
+
+#include <assert.h>
+#include <math.h>
+#include <sstream>
+#include <string.h>
+#include <vector>
+
+FrameStats *FrameStats::m_frame_stats = NULL;
+
+// ============================================================================
+FrameStats::Histogram::Histogram()
+{
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_max   = 0;
+    m_total = 0.0;
+}   // Histogram
+
+// ----------------------------------------------------------------------------
+/** Returns the index of the bucket for a value: the values below NUM_EXACT
+ *  have their own bucket, above that each power of two is split into
+ *  SUB_BUCKETS buckets.
+ */
+unsigned int FrameStats::Histogram::getBucket(uint32_t value)
+{
+    if (value < NUM_EXACT)
+        return value;
+    unsigned int exponent = 5;   // 2^5 = NUM_EXACT
+    while ((value >> exponent) > 1)
+        exponent++;
+    unsigned int sub = (value >> (exponent - 4)) - SUB_BUCKETS;
+    return NUM_EXACT + (exponent - 5)*SUB_BUCKETS + sub;
+}   // getBucket
+
+// ----------------------------------------------------------------------------
+/** Returns the value in the middle of a bucket. */
+uint32_t FrameStats::Histogram::getBucketValue(unsigned int bucket)
+{
+    if (bucket < NUM_EXACT)
+        return bucket;
+    unsigned int exponent = 5 + (bucket - NUM_EXACT) / SUB_BUCKETS;
+    unsigned int sub      = (bucket - NUM_EXACT) % SUB_BUCKETS;
+    uint32_t     width    = uint32_t(1) << (exponent - 4);
+    return (SUB_BUCKETS + sub) * width + width / 2;
+}   // getBucketValue
+
+// ----------------------------------------------------------------------------
+void FrameStats::Histogram::add(uint32_t value)
+{
+    m_buckets[getBucket(value)]++;
+    m_count++;
+    m_total += value;
+    if (value > m_max)
+        m_max = value;
+}   // add
+
+// ----------------------------------------------------------------------------
+/** Returns the value below or at which the given percentage of all values
+ *  are.
+ *  \param percent The percentile, between 0 and 100.
+ */
+uint32_t FrameStats::Histogram::getPercentile(float percent) const
+{
+    if (m_count == 0)
+        return 0;
+    uint32_t rank = (uint32_t)ceil(percent * 0.01 * m_count);
+    if (rank < 1)
+        rank = 1;
+    uint32_t sum = 0;
+    for (unsigned int i = 0; i < NUM_BUCKETS; i++)
+    {
+        sum += m_buckets[i];
+        if (sum >= rank)
+        {
+            uint32_t value = getBucketValue(i);
+            return value < m_max ? value : m_max;
+        }
+    }
+    return m_max;
+}   // getPercentile
+
+// ----------------------------------------------------------------------------
+/** Returns count, average, percentiles and maximum as a JSON object.
+ *  \param scale All values are multiplied by this, e.g. to convert
+ *         microseconds to ms.
+ */
+std::string FrameStats::Histogram::toJSON(double scale) const
+{
+    std::ostringstream s;
+    s << "{ \"count\": " << m_count
+      << ", \"average\": " << getAverage()*scale
+      << ", \"p50\": "     << getPercentile(50)*scale
+      << ", \"p95\": "     << getPercentile(95)*scale
+      << ", \"p99\": "     << getPercentile(99)*scale
+      << ", \"max\": "     << m_max*scale << " }";
+    return s.str();
+}   // toJSON
+
+// ============================================================================
+/** Starts counting the allocations, if STK was built with
+ *  COUNT_ALLOCATIONS. */
+FrameStats::FrameStats()
+{
+    AllocationCounter::start();
+    m_last_num_allocations = AllocationCounter::getNumAllocations();
+    m_frames_to_skip       = 1;
+}   // FrameStats
+
+// ----------------------------------------------------------------------------
+FrameStats::~FrameStats()
+{
+    AllocationCounter::stop();
+}   // ~FrameStats
+
+// ----------------------------------------------------------------------------
+/** Adds the time of a marker in the current frame. A marker that is used
+ *  more than once in a frame is counted with the sum of its times.
+ *  \param name Name of the marker.
+ *  \param time Time of the marker in ms.
+ */
+void FrameStats::addMarker(const std::string &name, double time)
+{
+    if (m_frames_to_skip > 0)
+        return;
+    Marker &marker = m_markers[name];
+    marker.m_frame_time += time;
+    marker.m_in_frame    = true;
+}   // addMarker
+
+// ----------------------------------------------------------------------------
+/** Adds the markers of the frame that has just finished to their
+ *  histograms, and counts the frame time and allocations of the frame.
+ *  \param time Time of the frame in ms.
+ */
+void FrameStats::endFrame(double time)
+{
+    uint32_t num_allocations = AllocationCounter::getNumAllocations();
+    uint32_t allocations     = num_allocations - m_last_num_allocations;
+    m_last_num_allocations   = num_allocations;
+    if (m_frames_to_skip > 0)
+    {
+        m_frames_to_skip--;
+        return;
+    }
+
+    m_frame_time.add((uint32_t)(time*1000.0 + 0.5));
+    m_allocations.add(allocations);
+    std::map<std::string, Marker>::iterator i;
+    for (i = m_markers.begin(); i != m_markers.end(); i++)
+    {
+        Marker &marker = i->second;
+        if (!marker.m_in_frame)
+            continue;
+        marker.m_histogram.add((uint32_t)(marker.m_frame_time*1000.0 + 0.5));
+        marker.m_frame_time = 0.0;
+        marker.m_in_frame   = false;
+    }
+}   // endFrame
+
+// ----------------------------------------------------------------------------
+/** Returns all histograms as a JSON object. Times are in ms, "count" of a
+ *  marker is the number of frames in which it was used. The allocations
+ *  are only written if they were counted.
+ */
+std::string FrameStats::toJSON() const
+{
+    std::ostringstream s;
+    s << "{\n    \"frame_time_ms\": " << m_frame_time.toJSON(0.001);
+    if (AllocationCounter::isAvailable())
+    {
+        s << ",\n    \"allocations_per_frame\": "
+          << m_allocations.toJSON(1.0);
+    }
+    s << ",\n    \"markers\": [";
+    std::map<std::string, Marker>::const_iterator i;
+    for (i = m_markers.begin(); i != m_markers.end(); i++)
+    {
+        // Marker names are plain text, but escape them just in case
+        std::string name = StringUtils::replace(i->first, "\\", "\\\\");
+        name = StringUtils::replace(name, "\"", "\\\"");
+        s << (i == m_markers.begin() ? "" : ",")
+          << "\n      { \"name\": \"" << name << "\", \"time_ms\": "
+          << i->second.m_histogram.toJSON(0.001) << " }";
+    }
+    s << "\n    ]\n  }";
+    return s.str();
+}   // toJSON
+
+// ----------------------------------------------------------------------------
+/** Checks the percentiles, the per frame values and (if available) the
+ *  allocation counting, and measures the time used per marker.
+ */
+void FrameStats::unitTesting()
+{
+    Histogram h;
+    assert(h.getPercentile(50) == 0);
+    for (uint32_t i = 1; i <= 1000; i++)
+        h.add(i);
+    assert(h.getCount() == 1000 && h.getMax() == 1000);
+    assert(fabs(h.getAverage() - 500.5) < 1.0e-6);
+    assert(fabs(h.getPercentile(50) - 500.0) <= 0.04*500.0);
+    assert(fabs(h.getPercentile(95) - 950.0) <= 0.04*950.0);
+    assert(fabs(h.getPercentile(99) - 990.0) <= 0.04*990.0);
+    assert(h.getPercentile(100) == 1000);
+
+    // Small values are exact, big ones within the bucket precision
+    Histogram small;
+    for (uint32_t i = 0; i < 10; i++)
+        small.add(i < 9 ? 7 : 4000000000u);
+    assert(small.getPercentile(50) == 7 && small.getPercentile(90) == 7);
+    assert(fabs(small.getPercentile(99) - 4.0e9) <= 0.04*4.0e9);
+    assert(small.getMax() == 4000000000u);
+
+    FrameStats *stats = new FrameStats();
+    // The first frame is ignored
+    stats->addMarker("Physics", 100.0);
+    stats->endFrame(200.0);
+    assert(stats->getNumFrames() == 0);
+    for (unsigned int i = 0; i < 100; i++)
+    {
+        stats->addMarker("Physics", 1.0 + 0.01*i);
+        // A marker used twice in a frame is counted with the sum
+        stats->addMarker("- culling", 0.25);
+        if (i % 2 == 0)
+            stats->addMarker("- culling", 0.25);
+        // volatile, so that the compiler can't remove the allocations
+        int *volatile a = new int[4];
+        int *volatile b = new int;
+        delete b;
+        delete[] a;
+        stats->endFrame(16.0);
+    }
+    assert(stats->getNumFrames() == 100);
+    assert(stats->m_allocations.getPercentile(50) >= 2 ||
+           !AllocationCounter::isAvailable());
+    const Histogram &physics = stats->m_markers["Physics"].m_histogram;
+    assert(physics.getCount() == 100 && physics.getMax() == 1990);
+    assert(fabs(physics.getPercentile(50) - 1490.0) <= 0.04*1490.0);
+    const Histogram &culling = stats->m_markers["- culling"].m_histogram;
+    assert(fabs(culling.getPercentile(50) - 250.0) <= 0.04*250.0);
+    assert(culling.getPercentile(51) == 500 && culling.getMax() == 500);
+    std::string json = stats->toJSON();
+    assert(json.find("\"frame_time_ms\": { \"count\": 100, \"average\": 16, "
+                     "\"p50\": 16,") != std::string::npos);
+    assert(json.find("{ \"name\": \"- culling\", \"time_ms\": { \"count\": "
+                     "100,") != std::string::npos);
+    delete stats;
+
+    // Time used per marker with a typical number of markers per frame
+    const unsigned int NUM_FRAMES  = 10000;
+    const unsigned int NUM_MARKERS = 40;
+    std::vector<std::string> names;
+    for (unsigned int i = 0; i < NUM_MARKERS; i++)
+        names.push_back(StringUtils::insertValues("Marker %d", i));
+    stats = new FrameStats();
+    uint32_t start_allocations = AllocationCounter::getNumAllocations();
+    double start = StkTime::getRealTime();
+    for (unsigned int f = 0; f < NUM_FRAMES; f++)
+    {
+        for (unsigned int i = 0; i < NUM_MARKERS; i++)
+            stats->addMarker(names[i], 0.001*(f % 100 + i));
+        stats->endFrame(16.0);
+    }
+    double time = StkTime::getRealTime() - start;
+    uint32_t allocations = AllocationCounter::getNumAllocations()
+                         - start_allocations;
+    // Only the first use of each marker allocates memory
+    assert(allocations <= 4*NUM_MARKERS);
+    delete stats;
+    Log::info("FrameStats", "%.1f ns per marker, %d allocations for %d "
+              "frames.", time*1.0e9/(NUM_FRAMES*NUM_MARKERS), allocations,
+              NUM_FRAMES);
+}   // unitTesting
@@ -0,0 +1,139 @@
+//
+//  SuperTuxKart - a fun racing game with go-kart
+//  Copyright (C) 2016 SuperTuxKart-Team
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 3
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+#ifndef HEADER_FRAME_STATS_HPP
+#define HEADER_FRAME_STATS_HPP
+
+#include "utils/no_copy.hpp"
+#include "utils/types.hpp"
+
+#include <map>
+#include <string>
+
+/**
+  * \brief Histograms of the frame time, the time of each profiler marker
+  *  and the number of allocations per frame.
+  *  While it exists, the Profiler adds the markers of each frame in
+  *  synchronizeFrame(). ProfileWorld creates it for --profile-laps and
+  *  --profile-time and writes it as JSON at the end of the race, so that
+  *  two runs can be compared with tools/compare_profile.py. The histograms
+  *  have a fixed size, so no memory is allocated per frame once each
+  *  marker was seen. Allocations are only counted if STK is built with
+  *  COUNT_ALLOCATIONS (see AllocationCounter), and include the allocations
+  *  of the profiler itself.
+  * \ingroup utils
+  */
+class FrameStats : public NoCopy
+{
+public:
+    /** A histogram of integer values (microseconds or counts). Values below
+     *  NUM_EXACT are stored exactly, bigger values in buckets which are
+     *  1/SUB_BUCKETS of a power of two wide, so a percentile is accurate
+     *  to about 3%. */
+    class Histogram
+    {
+    private:
+        enum { NUM_EXACT   = 32,
+               SUB_BUCKETS = 16,
+               NUM_BUCKETS = NUM_EXACT + (32 - 5) * SUB_BUCKETS };
+
+        uint32_t m_buckets[NUM_BUCKETS];
+        uint32_t m_count;
+        uint32_t m_max;
+        double   m_total;
+
+        static unsigned int getBucket(uint32_t value);
+        static uint32_t     getBucketValue(unsigned int bucket);
+    public:
+                 Histogram();
+        void     add(uint32_t value);
+        uint32_t getPercentile(float percent) const;
+        std::string toJSON(double scale) const;
+        // --------------------------------------------------------------------
+        uint32_t getCount() const { return m_count; }
+        // --------------------------------------------------------------------
+        uint32_t getMax() const { return m_max; }
+        // --------------------------------------------------------------------
+        double getAverage() const
+        {
+            return m_count > 0 ? m_total / m_count : 0.0;
+        }   // getAverage
+    };   // Histogram
+
+private:
+    /** The singleton instance, NULL if no statistics are collected. */
+    static FrameStats *m_frame_stats;
+
+    /** The data of one marker name. */
+    struct Marker
+    {
+        Histogram m_histogram;
+        /** Sum of the time of all markers with this name in the current
+         *  frame, in ms. */
+        double    m_frame_time;
+        /** True if the marker was used in the current frame. */
+        bool      m_in_frame;
+        Marker() : m_frame_time(0.0), m_in_frame(false) {}
+    };   // Marker
+
+    /** The markers, indexed by name. */
+    std::map<std::string, Marker> m_markers;
+
+    /** Frame time in microseconds. */
+    Histogram m_frame_time;
+
+    /** Number of allocations per frame. */
+    Histogram m_allocations;
+
+    /** Value of the allocation counter at the end of the last frame. */
+    uint32_t m_last_num_allocations;
+
+    /** Number of frames which are still ignored. The first frame contains
+     *  the time to load the race. */
+    unsigned int m_frames_to_skip;
+
+    FrameStats();
+    ~FrameStats();
+
+public:
+    void        addMarker(const std::string &name, double time);
+    void        endFrame(double time);
+    std::string toJSON() const;
+    static void unitTesting();
+    // ------------------------------------------------------------------------
+    /** Returns the number of frames counted. */
+    unsigned int getNumFrames() const { return m_frame_time.getCount(); }
+    // ------------------------------------------------------------------------
+    /** Starts collecting statistics. */
+    static void create()
+    {
+        delete m_frame_stats;
+        m_frame_stats = new FrameStats();
+    }   // create
+    // ------------------------------------------------------------------------
+    /** Returns the statistics, or NULL if none are collected. */
+    static FrameStats *get() { return m_frame_stats; }
+    // ------------------------------------------------------------------------
+    static void destroy()
+    {
+        delete m_frame_stats;   // It's ok to delete NULL
+        m_frame_stats = NULL;
+    }   // destroy
+};   // FrameStats
+
+#endif
@@ -21,6 +21,7 @@
 #include "guiengine/event_handler.hpp"
 #include "guiengine/engine.hpp"
 #include "guiengine/scalable_font.hpp"
+#include "utils/frame_stats.hpp"
 #include "utils/vs.hpp"
 
 #include <assert.h>
@@ -250,6 +251,21 @@ void Profiler::synchronizeFrame()
         }
     }
 
+    // Add the markers of the finished frame to the frame statistics
+    FrameStats *frame_stats = FrameStats::get();
+    if (frame_stats)
+    {
+        for (size_t i = 0; i < m_thread_infos.size(); i++)
+        {
+            const MarkerList &markers =
+                                    m_thread_infos[i].markers_done[old_write_id];
+            for (MarkerList::const_iterator m = markers.begin();
+                 m != markers.end(); m++)
+                frame_stats->addMarker(m->name, m->end - m->start);
+        }
+        frame_stats->endFrame(now - m_time_last_sync);
+    }
+
     // Remember the date of last synchronization
     m_time_between_sync = now - m_time_last_sync;
     m_time_last_sync = now;
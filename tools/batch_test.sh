@@ -0,0 +1,60 @@
+#!/bin/bash
+# Compares the number of races per hour of running one supertuxkart process
+# per race (like test.sh) with running all races in one process (--batch),
+# optionally split between several worker processes (--lobbies).
+#
+# Usage: batch_test.sh [path/to/supertuxkart] [number of races] [workers...]
+# e.g.:  batch_test.sh ./cmake_build/bin/supertuxkart 20 1 4
+# The rate is only reported if all races finished (the batch mode is checked
+# with the rows written to its result file).
+
+stk=${1:-./cmake_build/bin/supertuxkart}
+races=${2:-10}
+shift $(( $# < 2 ? $# : 2 ))
+workers=${@:-1}
+track=snowmountain
+laps=4
+karts=4
+
+dir=$(mktemp -d)
+seeds=$(seq -s ' ' 1 $races)
+cat > $dir/batch.xml <<XML
+<?xml version="1.0"?>
+<batch results="$dir/results.csv">
+  <run tracks="$track" karts="gnu" laps="$laps" seeds="$seeds" difficulty="3">
+    <ai karts="sara tux elephpant"/>
+  </run>
+</batch>
+XML
+
+# Prints the races per hour, or why there is no result.
+# $1: races finished, $2: start time, $3: end time
+rate() {
+	if [ "$1" -ne "$races" ]; then
+		echo "only $1 of $races races finished"
+	else
+		awk "BEGIN { printf \"%d races per hour\n\", \
+		             $races * 3600 / ($3 - $2) }"
+	fi
+}
+
+finished=0
+start=$(date +%s.%N)
+for run in $(seq 1 $races); do
+	$stk -R --mode=3 --numkarts=$karts --track=$track --with-profile \
+	     --profile-laps=$laps --kart=gnu --ai=sara,tux,elephpant \
+	     --no-graphics > /dev/null && finished=$((finished + 1))
+done
+end=$(date +%s.%N)
+echo "One process per race:  $(rate $finished $start $end)"
+
+for w in $workers; do
+	rm -f $dir/results.csv
+	start=$(date +%s.%N)
+	$stk --batch=$dir/batch.xml --lobbies=$w --no-graphics > /dev/null
+	end=$(date +%s.%N)
+	# One row per kart and race, plus the header
+	rows=$(($(cat $dir/results.csv 2>/dev/null | wc -l) - 1))
+	echo "Batch with $w worker(s): $(rate $((rows / karts)) $start $end)"
+done
+echo "Results: $dir/results.csv"
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+#
+#  SuperTuxKart - a fun racing game with go-kart
+#  Copyright (C) 2016 SuperTuxKart-Team
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 3
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+# This script compares the statistics of two profile runs, as written by
+# --profile-laps or --profile-time (see --profile-stats), e.g.:
+#
+#   supertuxkart --no-graphics --profile-laps=3 --track=lighthouse \
+#                --profile-stats=new.json
+#   tools/compare_profile.py base.json new.json --marker Physics \
+#                --marker "World::update()"
+#
+# A value is a regression if it is more than --threshold percent and more
+# than --min-ms (for times) worse than in the base run. The script exits
+# with 1 if there is a regression or if a marker given with --marker is
+# missing, so it can be used to gate a CI build. Allocations are only
+# compared if both runs counted them (built with COUNT_ALLOCATIONS).
+
+import argparse
+import json
+import sys
+
+PERCENTILES = ["p50", "p95", "p99"]
+
+
+def load(filename):
+    with open(filename) as f:
+        return json.load(f)
+
+
+def compare(name, base, new, threshold, min_delta, unit, regressions,
+            verbose):
+    """Compares the percentiles of two histograms and adds all
+    regressions to the list."""
+    for p in PERCENTILES:
+        b = base[p]
+        n = new[p]
+        delta = n - b
+        percent = 100.0 * delta / b if b > 0 else (0.0 if n == 0 else 100.0)
+        regressed = delta > min_delta and percent > threshold
+        if regressed:
+            regressions.append("%s %s: %.3f -> %.3f%s (%+.1f%%)"
+                               % (name, p, b, n, unit, percent))
+        if regressed or verbose:
+            print("%-40s %-4s %10.3f %10.3f %+8.1f%%%s"
+                  % (name, p, b, n, percent,
+                     "  REGRESSION" if regressed else ""))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compares the frame statistics of two profile runs.")
+    parser.add_argument("base", help="Statistics of the reference run")
+    parser.add_argument("new", help="Statistics of the run to check")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="Regression threshold in percent (default 10)")
+    parser.add_argument("--min-ms", type=float, default=0.05,
+                        help="Ignore time differences below this many ms "
+                             "(default 0.05)")
+    parser.add_argument("--max-allocations", type=float, default=5.0,
+                        help="Ignore differences of allocations per frame "
+                             "below this (default 5)")
+    parser.add_argument("--marker", action="append", default=[],
+                        help="Only check this profiler marker (can be used "
+                             "several times, default: all markers)")
+    parser.add_argument("-v", "--verbose", action="store_true",
+                        help="Print all values, not only regressions")
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new)
+    for key in ["track", "mode", "laps", "num_karts", "graphics"]:
+        if base.get(key) != new.get(key):
+            print("Warning: runs differ in %s: %s and %s"
+                  % (key, base.get(key), new.get(key)))
+
+    base_stats = base["frame_stats"]
+    new_stats = new["frame_stats"]
+    regressions = []
+    compare("frame time", base_stats["frame_time_ms"],
+            new_stats["frame_time_ms"], args.threshold, args.min_ms, " ms",
+            regressions, args.verbose)
+    if ("allocations_per_frame" in base_stats and
+            "allocations_per_frame" in new_stats):
+        compare("allocations per frame", base_stats["allocations_per_frame"],
+                new_stats["allocations_per_frame"], args.threshold,
+                args.max_allocations, "", regressions, args.verbose)
+    else:
+        print("Allocations were not counted in both runs, not compared.")
+
+    base_markers = dict((m["name"], m["time_ms"])
+                        for m in base_stats["markers"])
+    new_markers = dict((m["name"], m["time_ms"])
+                       for m in new_stats["markers"])
+    names = args.marker if args.marker else sorted(base_markers)
+    missing = []
+    for name in names:
+        if name not in base_markers or name not in new_markers:
+            print("%s: marker '%s' is missing in %s"
+                  % ("Error" if args.marker else "Warning", name,
+                     args.new if name in base_markers else args.base))
+            missing.append(name)
+            continue
+        compare(name, base_markers[name], new_markers[name], args.threshold,
+                args.min_ms, " ms", regressions, args.verbose)
+
+    if regressions:
+        print("%d regression(s):" % len(regressions))
+        for r in regressions:
+            print("  " + r)
+        return 1
+    # Markers requested explicitly must exist, otherwise a renamed marker
+    # would silently pass the check
+    if args.marker and missing:
+        print("%d requested marker(s) missing." % len(missing))
+        return 1
+    print("No regressions.")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
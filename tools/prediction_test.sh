@@ -0,0 +1,33 @@
+#!/bin/bash
+# Checks the re-simulation of the client side prediction (see
+# PredictionBuffer) with a real kart: a race without graphics is run with
+# --check-prediction, which regularly rewinds the first kart and
+# re-simulates it like a client does after a correction from the server,
+# and compares the result with the recorded race. Fails if more than
+# max_failed percent of the replays are so far off that a client would be
+# corrected again.
+#
+# Usage: prediction_test.sh [path/to/supertuxkart] [track] [max_failed]
+
+stk=${1:-./cmake_build/bin/supertuxkart}
+track=${2:-lighthouse}
+max_failed=${3:-10}
+
+dir=$(mktemp -d)
+$stk --no-graphics --profile-laps=1 --numkarts=4 --track=$track \
+     --check-prediction --profile-stats=$dir/stats.json \
+     > $dir/stk.log 2>&1
+
+line=$(grep "Prediction check" $dir/stk.log)
+if [ -z "$line" ]; then
+	echo "The race did not finish, see $dir/stk.log for details."
+	exit 1
+fi
+echo "$line"
+replays=$(echo "$line" | sed 's/.*: \([0-9]*\) replays.*/\1/')
+failed=$(echo "$line" | sed 's/.*, \([0-9]*\) failed.*/\1/')
+if [ "$replays" -eq 0 ] || [ $((failed * 100)) -gt $((replays * max_failed)) ]; then
+	echo "Too many replays differ from the race, see $dir for details."
+	exit 1
+fi
+echo "Logs: $dir"
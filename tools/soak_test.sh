@@ -0,0 +1,20 @@
+#!/bin/bash
+# Runs many headless AI races at the same time (see LobbyPool): the race is
+# loaded once, then one supertuxkart process per race is forked, which all
+# share the loaded track and karts. The exit status is 0 only if all races
+# finished.
+#
+# Usage: soak_test.sh [path/to/supertuxkart] [number of races] [laps]
+
+stk=${1:-./cmake_build/bin/supertuxkart}
+races=${2:-16}
+laps=${3:-3}
+
+$stk -R --mode=3 --numkarts=4 --track=lighthouse --with-profile \
+     --profile-laps=$laps --ai=sara,tux,elephpant,gnu --no-graphics \
+     --lobbies=$races
+status=$?
+if [ $status -ne 0 ]; then
+	echo "Soak test failed, see stdout.log for details."
+fi
+exit $status